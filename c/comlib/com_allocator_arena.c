@@ -0,0 +1,261 @@
+#include "com_allocator_arena.h"
+
+#include "com_assert.h"
+#include "com_mem.h"
+
+// number of bytes requested from the parent for each chunk
+#define CHUNK_LEN ((usize)64 * 1024)
+// allocations longer than this get their own allocation from the parent
+#define LARGE_LEN (CHUNK_LEN / 8)
+#define ALIGNMENT ((usize)16)
+
+static usize internal_align(usize len) {
+  return (len + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+// stored immediately before the memory of every allocation
+typedef struct {
+  usize len;
+  com_allocator_Flag flags;
+  bool large;
+} Header;
+
+// stored at the start of every chunk
+struct com_allocator_arena_Chunk_s {
+  com_allocator_Handle handle;
+  com_allocator_arena_Chunk *next;
+};
+
+// stored at the start of every large allocation, before its header
+struct com_allocator_arena_Large_s {
+  com_allocator_Handle handle;
+  com_allocator_arena_Large *prev;
+  com_allocator_arena_Large *next;
+};
+
+#define HEADER_LEN internal_align(sizeof(Header))
+#define CHUNK_HEADER_LEN internal_align(sizeof(com_allocator_arena_Chunk))
+#define LARGE_HEADER_LEN                                                       \
+  (internal_align(sizeof(com_allocator_arena_Large)) + HEADER_LEN)
+
+static Header *internal_header(u8 *data) {
+  return (Header *)(void *)(data - HEADER_LEN);
+}
+
+static com_allocator_arena_Large *internal_large(u8 *data) {
+  return (com_allocator_arena_Large *)(void *)(data - LARGE_HEADER_LEN);
+}
+
+static com_allocator_Handle internal_handle(const com_allocator *allocator,
+                                            u8 *data) {
+  return (com_allocator_Handle){
+      ._allocator = allocator, ._id = (usize)data, .valid = true};
+}
+
+static com_allocator_Handle internal_invalid(const com_allocator *allocator) {
+  return (com_allocator_Handle){._allocator = allocator, .valid = false};
+}
+
+// returns the memory of a new allocation of `len` bytes in a chunk, or NULL
+static u8 *internal_alloc_small(com_allocator_arena_Backing *backing,
+                                usize len) {
+  usize needed = HEADER_LEN + internal_align(len);
+  if ((usize)(backing->_end - backing->_next) < needed) {
+    // the rest of the current chunk is abandoned
+    com_allocator *parent = backing->_parent;
+    com_allocator_Handle h = com_allocator_alloc(
+        parent, (com_allocator_HandleData){
+                    .len = CHUNK_LEN, .flags = com_allocator_defaults(parent)});
+    if (!h.valid) {
+      return NULL;
+    }
+    u8 *base = com_allocator_handle_get(h);
+    com_assert_m((usize)base % ALIGNMENT == 0, "parent memory is not aligned");
+
+    com_allocator_arena_Chunk *chunk =
+        (com_allocator_arena_Chunk *)(void *)base;
+    chunk->handle = h;
+    chunk->next = backing->_chunks;
+    backing->_chunks = chunk;
+    backing->_next = base + CHUNK_HEADER_LEN;
+    backing->_end = base + CHUNK_LEN;
+  }
+
+  u8 *data = backing->_next + HEADER_LEN;
+  backing->_next += needed;
+  backing->_last = data;
+  return data;
+}
+
+// returns the memory of a new allocation of `len` bytes with its own
+// allocation from the parent, or NULL
+static u8 *internal_alloc_large(com_allocator_arena_Backing *backing,
+                                usize len) {
+  com_allocator *parent = backing->_parent;
+  com_allocator_Handle h = com_allocator_alloc(
+      parent, (com_allocator_HandleData){
+                  .len = LARGE_HEADER_LEN + len,
+                  .flags = com_allocator_defaults(parent) |
+                           com_allocator_REALLOCABLE});
+  if (!h.valid) {
+    return NULL;
+  }
+  u8 *base = com_allocator_handle_get(h);
+  com_assert_m((usize)base % ALIGNMENT == 0, "parent memory is not aligned");
+
+  com_allocator_arena_Large *large = (com_allocator_arena_Large *)(void *)base;
+  large->handle = h;
+  large->prev = NULL;
+  large->next = backing->_large;
+  if (backing->_large != NULL) {
+    backing->_large->prev = large;
+  }
+  backing->_large = large;
+  return base + LARGE_HEADER_LEN;
+}
+
+static com_allocator_Handle arena_allocator_fn(const com_allocator *allocator,
+                                               com_allocator_HandleData data) {
+  com_allocator_arena_Backing *backing = allocator->_backing;
+
+  bool large = data.len > LARGE_LEN;
+  u8 *mem = large ? internal_alloc_large(backing, data.len)
+                  : internal_alloc_small(backing, data.len);
+  if (mem == NULL) {
+    return internal_invalid(allocator);
+  }
+  *internal_header(mem) =
+      (Header){.len = data.len, .flags = data.flags, .large = large};
+  return internal_handle(allocator, mem);
+}
+
+static void arena_deallocator_fn(com_allocator_Handle handle) {
+  com_allocator_arena_Backing *backing = handle._allocator->_backing;
+  u8 *data = (u8 *)handle._id;
+
+  if (internal_header(data)->large) {
+    com_allocator_arena_Large *large = internal_large(data);
+    if (large->prev != NULL) {
+      large->prev->next = large->next;
+    } else {
+      backing->_large = large->next;
+    }
+    if (large->next != NULL) {
+      large->next->prev = large->prev;
+    }
+    com_allocator_dealloc(large->handle);
+  } else if (data == backing->_last) {
+    // only the newest allocation can be given back to its chunk
+    backing->_next = data - HEADER_LEN;
+    backing->_last = NULL;
+  }
+}
+
+static com_allocator_Handle arena_reallocator_fn(com_allocator_Handle handle,
+                                                 usize len) {
+  const com_allocator *allocator = handle._allocator;
+  com_allocator_arena_Backing *backing = allocator->_backing;
+  u8 *data = (u8 *)handle._id;
+  Header *header = internal_header(data);
+
+  if (header->large && len > LARGE_LEN) {
+    com_allocator_arena_Large *large = internal_large(data);
+    com_allocator_Handle h =
+        com_allocator_realloc(large->handle, LARGE_HEADER_LEN + len);
+    if (!h.valid) {
+      return internal_invalid(allocator);
+    }
+    // the allocation may have moved, so its neighbours must be relinked
+    u8 *base = com_allocator_handle_get(h);
+    com_assert_m((usize)base % ALIGNMENT == 0, "parent memory is not aligned");
+    large = (com_allocator_arena_Large *)(void *)base;
+    large->handle = h;
+    if (large->prev != NULL) {
+      large->prev->next = large;
+    } else {
+      backing->_large = large;
+    }
+    if (large->next != NULL) {
+      large->next->prev = large;
+    }
+    data = base + LARGE_HEADER_LEN;
+    internal_header(data)->len = len;
+    return internal_handle(allocator, data);
+  }
+
+  if (!header->large) {
+    if (data == backing->_last &&
+        internal_align(len) <= (usize)(backing->_end - data)) {
+      // the newest allocation can grow or shrink in place
+      backing->_next = data + internal_align(len);
+      header->len = len;
+      return handle;
+    } else if (len <= header->len) {
+      header->len = len;
+      return handle;
+    }
+  }
+
+  // otherwise move to a new allocation
+  usize old_len = header->len;
+  com_allocator_Handle h =
+      arena_allocator_fn(allocator, (com_allocator_HandleData){
+                                        .len = len, .flags = header->flags});
+  if (!h.valid) {
+    return h;
+  }
+  com_mem_move((u8 *)h._id, data, old_len < len ? old_len : len);
+  arena_deallocator_fn(handle);
+  return h;
+}
+
+static void *arena_get_fn(const com_allocator_Handle handle) {
+  return (void *)handle._id;
+}
+
+static com_allocator_HandleData
+arena_query_fn(const com_allocator_Handle handle) {
+  Header *header = internal_header((u8 *)handle._id);
+  return (com_allocator_HandleData){.len = header->len,
+                                    .flags = header->flags};
+}
+
+static void arena_destroy_fn(com_allocator *allocator) {
+  com_allocator_arena_Backing *backing = allocator->_backing;
+  while (backing->_large != NULL) {
+    com_allocator_arena_Large *next = backing->_large->next;
+    com_allocator_dealloc(backing->_large->handle);
+    backing->_large = next;
+  }
+  while (backing->_chunks != NULL) {
+    com_allocator_arena_Chunk *next = backing->_chunks->next;
+    com_allocator_dealloc(backing->_chunks->handle);
+    backing->_chunks = next;
+  }
+  allocator->_valid = false;
+}
+
+com_allocator
+com_allocator_arena(com_allocator *parent,
+                    com_allocator_arena_Backing *backing_storage) {
+  com_assert_m(com_allocator_supports(parent) & com_allocator_REALLOCABLE,
+               "parent allocator does not support reallocation");
+  *backing_storage = (com_allocator_arena_Backing){._parent = parent,
+                                                   ._chunks = NULL,
+                                                   ._next = NULL,
+                                                   ._end = NULL,
+                                                   ._last = NULL,
+                                                   ._large = NULL};
+  return (com_allocator){
+      // everything is freed when the arena is destroyed
+      ._valid = true,
+      ._default_flags = com_allocator_NOLEAK,
+      ._supported_flags = com_allocator_NOLEAK | com_allocator_REALLOCABLE,
+      ._backing = backing_storage,
+      ._allocator_fn = arena_allocator_fn,
+      ._deallocator_fn = arena_deallocator_fn,
+      ._reallocator_fn = arena_reallocator_fn,
+      ._get_fn = arena_get_fn,
+      ._query_fn = arena_query_fn,
+      ._destroy_allocator_fn = arena_destroy_fn};
+}
@@ -0,0 +1,46 @@
+#ifndef COM_ALLOCATOR_ARENA
+#define COM_ALLOCATOR_ARENA
+
+// An arena allocator hands out memory from large chunks, which it gets from a
+// parent allocator. Allocating is usually just bumping a pointer, and nothing
+// is returned to the parent until the arena is destroyed, which frees all of
+// it at once without visiting each allocation.
+// Allocations too large to share a chunk get their own allocation from the
+// parent instead, so that they can still be grown and freed individually.
+// All memory it returns is aligned to 16 bytes.
+
+#include "com_allocator.h"
+
+typedef struct com_allocator_arena_Chunk_s com_allocator_arena_Chunk;
+typedef struct com_allocator_arena_Large_s com_allocator_arena_Large;
+
+typedef struct {
+  com_allocator *_parent;
+  // singly linked list of chunks, newest first
+  com_allocator_arena_Chunk *_chunks;
+  // the unused part of the newest chunk
+  u8 *_next;
+  u8 *_end;
+  // the newest allocation in a chunk, which can be grown or freed in place
+  u8 *_last;
+  // doubly linked list of large allocations
+  com_allocator_arena_Large *_large;
+} com_allocator_arena_Backing;
+
+/** Creates an arena allocator that gets its memory from `parent`
+ * REQUIRES: `parent` is a valid pointer to a valid `com_allocator` supporting
+ * com_allocator_REALLOCABLE, which returns memory aligned to 16 bytes
+ * REQUIRES: `parent` outlives the returned allocator
+ * REQUIRES: `backing_storage` is a valid pointer
+ * REQUIRES: `backing_storage` must be stored at the same address for the
+ * duration of the allocator
+ * GUARANTEES: returns a valid allocator supporting com_allocator_NOLEAK and
+ * com_allocator_REALLOCABLE
+ * GUARANTEES: `backing_storage` will be overwritten
+ * GUARANTEES: destroying the returned allocator returns all of its memory to
+ * `parent`
+ */
+com_allocator com_allocator_arena(com_allocator *parent,
+                                  com_allocator_arena_Backing *backing_storage);
+
+#endif
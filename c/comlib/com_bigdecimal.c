@@ -1,6 +1,8 @@
 #include "com_bigdecimal.h"
 #include "com_assert.h"
+#include "com_fmath.h"
 #include "com_imath.h"
+#include "com_wideint.h"
 
 com_bigdecimal com_bigdecimal_from(com_bigint value) {
   return (com_bigdecimal){._precision = 0, ._value = value};
@@ -10,6 +12,10 @@ com_bigdecimal com_bigdecimal_create(com_allocator_Handle h) {
   return com_bigdecimal_from(com_bigint_create(h));
 }
 
+com_bigdecimal com_bigdecimal_create_inline(com_allocator *a) {
+  return com_bigdecimal_from(com_bigint_create_inline(a));
+}
+
 void com_bigdecimal_magnitude(com_biguint *dest, const com_bigdecimal *a) {
   com_bigint_magnitude(dest, &a->_value);
 }
@@ -27,41 +33,55 @@ void com_bigdecimal_set_i64(com_bigdecimal *dest, i64 a) {
   dest->_precision = 0;
 }
 
-static u64 internal_get_magnitude(const com_bigdecimal *a) {
+// returns the magnitude of the integer part of `a`
+// sets *overflow if it doesn't fit in a u64
+static u64 internal_get_magnitude(const com_bigdecimal *a, bool *overflow) {
   usize len = com_bigint_len(&a->_value);
-
-  // if there are more than 2 u32 words then it won't fit in a u64
-  isize scale = (isize)len - (isize)a->_precision > 2;
-  if (scale > 2) {
-    return false;
-  }
-  if (scale <= 1) {
-    return true;
+  u64 magnitude = 0;
+  *overflow = false;
+  for (usize i = len; i > a->_precision; i--) {
+    u32 word = com_bigint_get_at(&a->_value, i - 1);
+    if (magnitude >> 32 != 0) {
+      *overflow = true;
+      return u64_max_m;
+    }
+    magnitude = (magnitude << 32) | word;
   }
+  return magnitude;
+}
 
-  // here scale must be 2
-  // this means that both of these are defined
-  u64 lsw = com_bigint_get_at(&a->_value, a->_precision);
-  u64 msw = com_bigint_get_at(&a->_value, a->_precision + 1);
-
-  // reconstruct magnitude
-  return (msw << 32) + lsw;
+// returns true if `a` has a nonzero fractional part
+static bool internal_has_fraction(const com_bigdecimal *a) {
+  usize len = com_bigint_len(&a->_value);
+  for (usize i = 0; i < a->_precision && i < len; i++) {
+    if (com_bigint_get_at(&a->_value, i) != 0) {
+      return true;
+    }
+  }
+  return false;
 }
 
 i64 com_bigdecimal_get_i64(const com_bigdecimal *a) {
-  u64 magnitude = internal_get_magnitude(a);
+  bool overflow;
+  u64 magnitude = internal_get_magnitude(a, &overflow);
 
   if (com_bigint_sign(&a->_value) == com_math_NEGATIVE) {
-    // ensure no owverflows
-    return -(i64)com_imath_u64_min(magnitude, positive_i64_min_m - 1) - 1;
+    // ensure no overflows
+    if (magnitude >= positive_i64_min_m) {
+      return i64_min_m;
+    }
+    return -(i64)magnitude;
   } else {
-    // return if we can fit it properly
-    return magnitude <= i64_max_m;
+    return (i64)com_imath_u64_min(magnitude, i64_max_m);
   }
 }
 
 bool com_bigdecimal_fits_i64(const com_bigdecimal *a) {
-  u64 magnitude = internal_get_magnitude(a);
+  bool overflow;
+  u64 magnitude = internal_get_magnitude(a, &overflow);
+  if (overflow || internal_has_fraction(a)) {
+    return false;
+  }
 
   if (com_bigint_sign(&a->_value) == com_math_NEGATIVE) {
     return magnitude <= positive_i64_min_m;
@@ -71,12 +91,48 @@ bool com_bigdecimal_fits_i64(const com_bigdecimal *a) {
   }
 }
 
-// lossy by definiton but we could definitely make this more accurate
-// TODO
 f64 com_bigdecimal_get_f64(const com_bigdecimal *a) {
-  f64 magnitude = com_bigint_get_f64(&a->_value);
-  magnitude /= 2 << (a->_precision * 32);
-  return magnitude;
+  // scaling by the precision happens before rounding, so it is rounded once
+  return com_bigint_get_f64_exp2(&a->_value, -(i64)a->_precision * 32);
+}
+
+void com_bigdecimal_set_f64(com_bigdecimal *dest, f64 a) {
+  com_assert_m(com_fmath_f64_is_finite(a), "a is not finite");
+
+  union {
+    f64 value;
+    u64 bits;
+  } u = {.value = a};
+  u64 mantissa = u.bits & (((u64)1 << 52) - 1);
+  i64 exponent = (i64)((u.bits >> 52) & 0x7FF);
+  if (exponent == 0) {
+    // subnormal, so there is no hidden bit
+    exponent = 1;
+  } else {
+    mantissa |= (u64)1 << 52;
+  }
+  // a = mantissa * 2^exponent
+  exponent -= 1023 + 52;
+
+  if (mantissa == 0) {
+    com_bigint_set_i64(&dest->_value, 0);
+    dest->_precision = 0;
+    return;
+  }
+
+  // with the mantissa odd, its lowest bit is the lowest bit of `a`, and the
+  // value fits exactly in the fewest words of precision that can hold it
+  i32 zeros = __builtin_ctzll(mantissa);
+  mantissa >>= zeros;
+  exponent += zeros;
+  usize precision = exponent < 0 ? (usize)(-exponent + 31) / 32 : 0;
+  com_bigint_set_i64(&dest->_value, (i64)mantissa);
+  com_bigint_lshift(&dest->_value, &dest->_value,
+                    (usize)(exponent + (i64)precision * 32));
+  if (u.bits >> 63) {
+    com_bigint_negate(&dest->_value);
+  }
+  dest->_precision = precision;
 }
 
 void com_bigdecimal_set(com_bigdecimal *dest, const com_bigdecimal *src) {
@@ -97,6 +153,72 @@ void com_bigdecimal_set_precision(com_bigdecimal *a, usize prec) {
 }
 
 
+// returns true if bit `i` of the magnitude of `a` is set
+static bool internal_bit(const com_bigint *a, usize i) {
+  usize word = i / 32;
+  return word < com_bigint_len(a) &&
+         ((com_bigint_get_at(a, word) >> (i % 32)) & 1) != 0;
+}
+
+// returns true if any bit of the magnitude of `a` below bit `n` is set
+static bool internal_any_below(const com_bigint *a, usize n) {
+  usize len = com_bigint_len(a);
+  usize words = n / 32;
+  for (usize i = 0; i < words && i < len; i++) {
+    if (com_bigint_get_at(a, i) != 0) {
+      return true;
+    }
+  }
+  return words < len && n % 32 != 0 &&
+         (com_bigint_get_at(a, words) & ((1u << (n % 32)) - 1)) != 0;
+}
+
+// Returns true if a magnitude that was truncated towards zero should have one
+// added to it to round as `mode` describes
+// REQUIRES: `half` is true if the part cut off was at least half of one
+// REQUIRES: `rest` is true if the part cut off was neither zero nor half
+// REQUIRES: `odd` is true if the truncated magnitude is odd
+static bool internal_round_away(com_bigdecimal_RoundingMode mode,
+                                bool negative, bool half, bool rest,
+                                bool odd) {
+  switch (mode) {
+  case com_bigdecimal_RNE: {
+    return half && (rest || odd);
+  }
+  case com_bigdecimal_RTZ: {
+    return false;
+  }
+  case com_bigdecimal_RDN: {
+    return negative && (half || rest);
+  }
+  case com_bigdecimal_RUP: {
+    return !negative && (half || rest);
+  }
+  }
+  com_assert_unreachable_m("unknown rounding mode");
+}
+
+void com_bigdecimal_round(com_bigdecimal *a, usize prec,
+                          com_bigdecimal_RoundingMode mode) {
+  com_assert_m(a != NULL, "a is null");
+  if (prec >= a->_precision) {
+    com_bigdecimal_set_precision(a, prec);
+    return;
+  }
+
+  usize nbits = (a->_precision - prec) * 32;
+  bool negative = com_bigint_sign(&a->_value) == com_math_NEGATIVE;
+  bool half = internal_bit(&a->_value, nbits - 1);
+  bool rest = internal_any_below(&a->_value, nbits - 1);
+
+  com_bigint_rshift(&a->_value, &a->_value, nbits);
+  if (internal_round_away(mode, negative, half, rest,
+                          internal_bit(&a->_value, 0))) {
+    com_bigint_add_i32(&a->_value, &a->_value, negative ? -1 : 1);
+  }
+  a->_precision = prec;
+}
+
 usize com_bigdecimal_get_precision(const com_bigdecimal* a) {
   return a->_precision;
 }
@@ -144,6 +266,175 @@ void com_bigdecimal_div(com_bigdecimal *dest, const com_bigdecimal *a,
   dest->_precision = a->_precision - b->_precision;
 }
 
+// returns the magnitude of `a` and sets *fits if it fits in a u64
+static u64 internal_small_magnitude(const com_bigint *a, bool *fits) {
+  usize len = com_bigint_len(a);
+  *fits = len <= 2;
+  if (!*fits || len == 0) {
+    return 0;
+  }
+  u64 magnitude = com_bigint_get_at(a, 0);
+  if (len == 2) {
+    magnitude |= (u64)com_bigint_get_at(a, 1) << 32;
+  }
+  return magnitude;
+}
+
+// Computes dest := a / b with u128 arithmetic, for when both magnitudes fit
+// in a u64
+// REQUIRES: `shift` is the number of words to shift `a`'s magnitude left by,
+// or if negative, the number of words to shift `b`'s magnitude left by
+// GUARANTEES: returns false and leaves `dest` unchanged if the operands or the
+// result are too large
+static bool internal_div_round_small(com_bigint *dest, u64 a, u64 b,
+                                     isize shift, bool negative,
+                                     com_bigdecimal_RoundingMode mode) {
+  com_u128 num = com_u128_from_u64(a);
+  com_u128 den = com_u128_from_u64(b);
+  if (shift >= 0) {
+    if (com_u128_shl(&num, num, (usize)shift * 32)) {
+      return false;
+    }
+  } else if (com_u128_shl(&den, den, (usize)-shift * 32) ||
+             !com_u128_fits_u64(den)) {
+    return false;
+  }
+
+  com_u128 q;
+  com_u128 r;
+  com_u128_div_rem(&q, &r, num, den);
+  // den fits in a u64, so r < den <= u64_max_m and this can't overflow
+  com_u128 half_den = com_u128_from_u64(den.words[0] - r.words[0]);
+  com_math_cmptype cmp = com_u128_cmp(half_den, r);
+  bool half = cmp != com_math_LESS;
+  bool rest = cmp != com_math_EQUAL && !com_u128_is_zero(r);
+  u64 magnitude = q.words[0];
+  if (!com_u128_fits_u64(q) || magnitude >= i64_max_m) {
+    return false;
+  }
+  if (internal_round_away(mode, negative, half, rest, magnitude & 1)) {
+    magnitude++;
+  }
+  com_bigint_set_i64(dest, negative ? -(i64)magnitude : (i64)magnitude);
+  return true;
+}
+
+void com_bigdecimal_div_round(com_bigdecimal *dest, const com_bigdecimal *a,
+                              const com_bigdecimal *b, usize prec,
+                              com_bigdecimal_RoundingMode mode,
+                              com_allocator *allocator) {
+  com_assert_m(a != NULL, "a is null");
+  com_assert_m(b != NULL, "b is null");
+  com_assert_m(dest != NULL, "dest is null");
+  com_assert_m(!com_bigdecimal_is_zero(b), "b is zero");
+
+  // a / b = (A / 2^(32 pa)) / (B / 2^(32 pb)), so the value of the result,
+  // which is scaled by 2^(32 prec), is A * 2^(32 (pb + prec - pa)) / B
+  isize shift = (isize)(b->_precision + prec) - (isize)a->_precision;
+  bool negative =
+      com_bigint_sign(&a->_value) != com_math_ZERO &&
+      (com_bigint_sign(&a->_value) == com_math_NEGATIVE) !=
+          (com_bigint_sign(&b->_value) == com_math_NEGATIVE);
+
+  bool a_fits;
+  bool b_fits;
+  u64 a_small = internal_small_magnitude(&a->_value, &a_fits);
+  u64 b_small = internal_small_magnitude(&b->_value, &b_fits);
+  if (a_fits && b_fits &&
+      internal_div_round_small(&dest->_value, a_small, b_small, shift,
+                               negative, mode)) {
+    dest->_precision = prec;
+    return;
+  }
+
+  // divide the magnitudes, so the remainder is never negative
+  com_bigint num = com_bigint_create_inline(allocator);
+  com_bigint den = com_bigint_create_inline(allocator);
+  com_bigint rem = com_bigint_create_inline(allocator);
+  com_bigint_lshift(&num, &a->_value, shift > 0 ? (usize)shift * 32 : 0);
+  com_bigint_lshift(&den, &b->_value, shift < 0 ? (usize)-shift * 32 : 0);
+  if (com_bigint_sign(&num) == com_math_NEGATIVE) {
+    com_bigint_negate(&num);
+  }
+  if (com_bigint_sign(&den) == com_math_NEGATIVE) {
+    com_bigint_negate(&den);
+  }
+
+  com_bigint_div_rem(&dest->_value, &rem, &num, &den, allocator);
+
+  // compare twice the remainder with the divisor to see how far along the
+  // last unit it was cut off
+  bool rest = !com_bigint_is_zero(&rem);
+  com_bigint_lshift(&rem, &rem, 1);
+  com_math_cmptype cmp = com_bigint_cmp(&den, &rem);
+  bool half = cmp != com_math_LESS;
+  rest = rest && cmp != com_math_EQUAL;
+  if (internal_round_away(mode, negative, half, rest,
+                          internal_bit(&dest->_value, 0))) {
+    com_bigint_add_i32(&dest->_value, &dest->_value, 1);
+  }
+  if (negative) {
+    com_bigint_negate(&dest->_value);
+  }
+  dest->_precision = prec;
+
+  com_bigint_destroy(&rem);
+  com_bigint_destroy(&den);
+  com_bigint_destroy(&num);
+}
+
+void com_bigdecimal_mul_pow10(com_bigdecimal *dest, const com_bigdecimal *a,
+                              i64 exp10, usize prec,
+                              com_bigdecimal_RoundingMode mode,
+                              com_allocator *allocator) {
+  com_assert_m(a != NULL, "a is null");
+  com_assert_m(dest != NULL, "dest is null");
+
+  u64 n = exp10 < 0 ? -(u64)exp10 : (u64)exp10;
+  // 10^19 is the largest power of 10 that fits in a u64
+  u64 small_pow10 = 1;
+  for (u64 i = 0; i < n && i < 19; i++) {
+    small_pow10 *= 10;
+  }
+
+  // 10^9 is the largest power of 10 that fits in an i32
+  if (exp10 >= 0 && n <= 9) {
+    // small scales are a single multiply by a word
+    com_bigint_mul_i32(&dest->_value, &a->_value, (i32)small_pow10);
+    dest->_precision = a->_precision;
+    com_bigdecimal_round(dest, prec, mode);
+    return;
+  }
+  if (exp10 < 0 && n <= 19) {
+    bool a_fits;
+    u64 a_small = internal_small_magnitude(&a->_value, &a_fits);
+    bool negative = com_bigint_sign(&a->_value) == com_math_NEGATIVE;
+    if (a_fits && internal_div_round_small(
+                      &dest->_value, a_small, small_pow10,
+                      (isize)prec - (isize)a->_precision, negative, mode)) {
+      dest->_precision = prec;
+      return;
+    }
+  }
+
+  com_bigdecimal pow10 = com_bigdecimal_create_inline(allocator);
+  com_bigdecimal_set_i64(&pow10, 1);
+  for (; n >= 9; n -= 9) {
+    com_bigint_mul_i32(&pow10._value, &pow10._value, 1000000000);
+  }
+  for (; n > 0; n--) {
+    com_bigint_mul_i32(&pow10._value, &pow10._value, 10);
+  }
+
+  if (exp10 >= 0) {
+    com_bigdecimal_mul(dest, a, &pow10, allocator);
+    com_bigdecimal_round(dest, prec, mode);
+  } else {
+    com_bigdecimal_div_round(dest, a, &pow10, prec, mode, allocator);
+  }
+  com_bigdecimal_destroy(&pow10);
+}
+
 bool com_bigdecimal_is_zero(const com_bigdecimal *a) {
   com_assert_m(a != NULL, "a is null");
   return com_bigint_is_zero(&a->_value);
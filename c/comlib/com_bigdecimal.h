@@ -11,6 +11,15 @@ typedef struct {
   com_bigint _value;
 } com_bigdecimal;
 
+// how to round a result that has more bits than its precision can hold
+// These are the rounding modes of the real rounding functions in hir.h.
+typedef enum {
+  com_bigdecimal_RNE, // round to nearest, with ties to even
+  com_bigdecimal_RTZ, // round towards zero
+  com_bigdecimal_RDN, // round down, towards negative infinity
+  com_bigdecimal_RUP, // round up, towards positive infinity
+} com_bigdecimal_RoundingMode;
+
 /// creates a bigdecimal from a magnitude and the sign
 /// REQUIRES: `magnitude` is a valid `value`
 /// GUARANTEES: returns a valid `com_biguint` using `value`
@@ -24,6 +33,13 @@ com_bigdecimal com_bigdecimal_from(com_bigint value);
 /// GUARANTEES: returns a valid `com_bigdecimal` with value 0 and sign 0
 com_bigdecimal com_bigdecimal_create(com_allocator_Handle h);
 
+/// creates a bigdecimal that holds small values inline, with value 0
+/// REQUIRES: `a` is a valid pointer to a `com_allocator`
+/// GUARANTEES: returns a valid `com_bigdecimal` with value 0 and sign 0
+/// GUARANTEES: no memory is allocated until the magnitude outgrows
+/// com_biguint_INLINE_LIMBS u32s
+com_bigdecimal com_bigdecimal_create_inline(com_allocator *a);
+
 /// gets the unscaled magnitude of bigdecimal
 /// REQUIRES: `a` is a valid com_bigdecimal
 /// REQUIRES: `dest` is a valid com_biguint
@@ -42,6 +58,16 @@ usize com_bigdecimal_get_precision(const com_bigdecimal* a);
 /// GUARANTEES: if `prec > a.precision` then no data is lost
 void com_bigdecimal_set_precision(com_bigdecimal *a, usize prec);
 
+/// sets the precision of a, rounding off any bits that no longer fit
+/// REQUIRES: `a` is a valid pointer to a valid com_bigdecimal
+/// REQUIRES: `prec` is the precision to set to
+/// GUARANTEES: `a.precision` is now `prec`
+/// GUARANTEES: if `prec >= a.precision` then no data is lost
+/// GUARANTEES: else `a` is rounded to a multiple of 2^(-32 * `prec`) as
+/// described by `mode`
+void com_bigdecimal_round(com_bigdecimal *a, usize prec,
+                          com_bigdecimal_RoundingMode mode);
+
 /// frees bigdecimal
 /// REQUIRES: `a` is a valid pointer to a `com_bigdecimal`
 /// GUARANTEES: all memory associated with `a` will be deallocated
@@ -53,9 +79,11 @@ void com_bigdecimal_destroy(com_bigdecimal *a);
 /// GUARANTEES: `dest` is set to the value of `a`
 void com_bigdecimal_set_i64(com_bigdecimal *dest, i64 a);
 
-/// returns the nearest value of a bigdecimal as an i64
+/// returns the value of a bigdecimal as an i64
 /// REQUIRES: `a` is a valid pointer to a valid `com_bigdecimal `
-/// GUARANTEES: `a` is no longer a
+/// GUARANTEES: returns `a` rounded towards zero
+/// GUARANTEES: if that is out of the range of an i64, returns the closest i64
+/// GUARANTEES: use `com_bigdecimal_round` first to round in other ways
 i64 com_bigdecimal_get_i64(const com_bigdecimal *a);
 
 /// returns true if the com_bigdecimal can be losslessly respresented as an i64
@@ -70,7 +98,9 @@ f64 com_bigdecimal_get_f64(const com_bigdecimal *a);
 
 /// sets `dest` to `a`
 /// REQUIRES: `dest` is a valid pointer to a valid `com_bigdecimal`
-/// GUARANTEES: `dest` is set to the value of `a`
+/// REQUIRES: `a` is finite
+/// GUARANTEES: `dest` is set to exactly the value of `a`
+/// GUARANTEES: `dest` has the least precision that can hold `a`
 void com_bigdecimal_set_f64(com_bigdecimal *dest, f64 a);
 
 ///  Copies the value of a bigdecimal to a bigdecimal
@@ -118,6 +148,34 @@ void com_bigdecimal_mul(com_bigdecimal *dest, const com_bigdecimal *a, const com
 void com_bigdecimal_div(com_bigdecimal *dest, const com_bigdecimal *a, const com_bigdecimal *b,
                     com_allocator *allocator);
 
+/// dest := a / b, to any precision
+/// REQUIRES: `a` is a valid pointer to a valid `com_bigdecimal`
+/// REQUIRES: `b` is a valid pointer to a valid `com_bigdecimal`
+/// REQUIRES: `b` is not zero
+/// REQUIRES: `dest` is a valid pointer to a valid `com_bigdecimal`
+/// REQUIRES: `allocator` is a valid `com_allocator`
+/// GUARANTEES: `dest` will be overwritten by `a` / `b`, rounded to a multiple
+/// of 2^(-32 * `prec`) as described by `mode`
+/// GUARANTEES: `dest` will have the precision `prec`
+/// GUARANTEES: does not allocate, beyond resizing `dest`, if the magnitudes of
+/// `a` and `b` fit in a u64 and the result fits in an i64
+void com_bigdecimal_div_round(com_bigdecimal *dest, const com_bigdecimal *a,
+                              const com_bigdecimal *b, usize prec,
+                              com_bigdecimal_RoundingMode mode,
+                              com_allocator *allocator);
+
+/// dest := a * 10^exp10
+/// REQUIRES: `a` is a valid pointer to a valid `com_bigdecimal`
+/// REQUIRES: `dest` is a valid pointer to a valid `com_bigdecimal`
+/// REQUIRES: `allocator` is a valid `com_allocator`
+/// GUARANTEES: `dest` will be overwritten by `a` * 10^`exp10`, rounded to a
+/// multiple of 2^(-32 * `prec`) as described by `mode`
+/// GUARANTEES: `dest` will have the precision `prec`
+void com_bigdecimal_mul_pow10(com_bigdecimal *dest, const com_bigdecimal *a,
+                              i64 exp10, usize prec,
+                              com_bigdecimal_RoundingMode mode,
+                              com_allocator *allocator);
+
 /* Special operators and comparison */
 
 // compares b with reference to a
@@ -10,6 +10,11 @@ com_bigint com_bigint_create(com_allocator_Handle h) {
   return (com_bigint){._negative = false, ._magnitude = com_biguint_create(h)};
 }
 
+com_bigint com_bigint_create_inline(com_allocator *a) {
+  return (com_bigint){._negative = false,
+                      ._magnitude = com_biguint_create_inline(a)};
+}
+
 void com_bigint_magnitude(com_biguint *dest, const com_bigint *a) {
   com_biguint_set(dest, &a->_magnitude);
 }
@@ -58,7 +63,11 @@ bool com_bigint_fits_i64(const com_bigint *a) {
 }
 
 f64 com_bigint_get_f64(const com_bigint *a) {
-  f64 magnitude = com_biguint_get_f64(&a->_magnitude);
+  return com_bigint_get_f64_exp2(a, 0);
+}
+
+f64 com_bigint_get_f64_exp2(const com_bigint *a, i64 exp2) {
+  f64 magnitude = com_biguint_get_f64_exp2(&a->_magnitude, exp2);
   if (a->_negative) {
     return -magnitude;
   } else {
@@ -172,12 +181,16 @@ void com_bigint_rem(com_bigint *dest, const com_bigint *a, const com_bigint *b,
 void com_bigint_div_rem(com_bigint *quotient, com_bigint *remainder,
                         const com_bigint *a, const com_bigint *b,
                         com_allocator *allocator) {
+  // read the signs first, as quotient or remainder may alias a or b
+  bool a_negative = a->_negative;
+  bool b_negative = b->_negative;
+
   // if one of them is negative but not the other, it is negative
   // if both of them are the same kind, then it is not negative
-  quotient->_negative = a->_negative != b->_negative;
+  quotient->_negative = a_negative != b_negative;
 
   // remainder (%) always takes the sign of the dividend
-  remainder->_negative = a->_negative;
+  remainder->_negative = a_negative;
 
   com_biguint_div_rem(&quotient->_magnitude, &remainder->_magnitude,
                       &a->_magnitude, &b->_magnitude, allocator);
@@ -232,9 +245,9 @@ void com_bigint_add_i32(com_bigint *dest, const com_bigint *a, i32 b) {
 }
 void com_bigint_sub_i32(com_bigint *dest, const com_bigint *a, i32 b) {
   if(b < 0) {
-    internal_add_u32(dest,a,(u32)b);
+    internal_add_u32(dest, a, (u32)(-(b +1)) + 1);
   } else {
-    internal_sub_u32(dest, a, (u32)(-(b +1)) + 1);
+    internal_sub_u32(dest, a, (u32)b);
   }
 }
 
@@ -322,9 +335,9 @@ com_math_cmptype com_bigint_cmp(const com_bigint *a, const com_bigint *b) {
     }
     case com_math_EQUAL: {
       if (a->_negative) {
-        return com_math_EQUAL;
+        return com_math_GREATER;
       } else {
-        return com_math_LESS;
+        return com_math_EQUAL;
       }
     }
     }
@@ -338,6 +351,28 @@ void com_bigint_negate(com_bigint *a) {
 }
 
 
+void com_bigint_get_digits(com_vec *digits, const com_bigint *a, u8 radix,
+                           com_allocator *allocator) {
+  com_assert_m(a != NULL, "a is null");
+  com_biguint_get_digits(digits, &a->_magnitude, radix, allocator);
+}
+
+bool com_bigint_from_str(com_bigint *dest, com_str str, u8 radix,
+                         com_allocator *allocator) {
+  com_assert_m(dest != NULL, "dest is null");
+  bool negative = false;
+  if (str.len > 0 && (str.data[0] == '-' || str.data[0] == '+')) {
+    negative = str.data[0] == '-';
+    str.data++;
+    str.len--;
+  }
+  if (!com_biguint_from_str(&dest->_magnitude, str, radix, allocator)) {
+    return false;
+  }
+  dest->_negative = negative;
+  return true;
+}
+
 usize com_bigint_len(const com_bigint *a) {
   return com_biguint_len(&a->_magnitude);
 }
@@ -378,11 +413,13 @@ void com_bigint_lshift(com_bigint *dest, const com_bigint *a,
                         const usize nbits) {
   com_assert_m(a != NULL, "a is null");
   com_assert_m(dest != NULL, "dest is null");
+  dest->_negative = a->_negative;
   com_biguint_lshift(&dest->_magnitude, &a->_magnitude, nbits);
 }
 void com_bigint_rshift(com_bigint *dest, const com_bigint *a,
                         const usize nbits) {
   com_assert_m(a != NULL, "a is null");
   com_assert_m(dest != NULL, "dest is null");
+  dest->_negative = a->_negative;
   com_biguint_rshift(&dest->_magnitude, &a->_magnitude, nbits);
 }
@@ -21,6 +21,13 @@ com_bigint com_bigint_from(com_biguint magnitude, bool negative);
 /// GUARANTEES: returns a valid `com_bigint` with value 0 and sign 0
 com_bigint com_bigint_create(com_allocator_Handle h);
 
+/// creates a bigint that holds small values inline, with value 0
+/// REQUIRES: `a` is a valid pointer to a `com_allocator`
+/// GUARANTEES: returns a valid `com_bigint` with value 0 and sign 0
+/// GUARANTEES: no memory is allocated until the magnitude outgrows
+/// com_biguint_INLINE_LIMBS u32s
+com_bigint com_bigint_create_inline(com_allocator *a);
+
 /// returns a pointer to the magnitude of bigint
 /// REQUIRES: `a` is a valid com_bigint
 /// REQUIRES: `dest` is a valid com_biguint
@@ -50,9 +57,16 @@ bool com_bigint_fits_i64(const com_bigint *a);
 
 ///  Returns the nearest value of a bigint as a f64
 /// REQUIRES: `a` is a valid pointer to a valid `com_bigint`
-/// GUARANTEES: returns the value of `f64` closest to the value of `a`
+/// GUARANTEES: returns the value of `f64` closest to the value of `a`, with
+/// ties rounded to even
 f64 com_bigint_get_f64(const com_bigint *a);
 
+///  Returns the nearest value of a bigint times a power of 2 as a f64
+/// REQUIRES: `a` is a valid pointer to a valid `com_bigint`
+/// GUARANTEES: returns the value of `f64` closest to `a` * 2^`exp2`, with
+/// ties rounded to even
+f64 com_bigint_get_f64_exp2(const com_bigint *a, i64 exp2);
+
 ///  Copies the value of a bigint to a bigint
 /// REQUIRES: `dest` is a valid pointer to a valid `com_bigint`
 /// GUARANTEES: the value of  `dest` is now equal to `val`
@@ -118,6 +132,7 @@ void com_bigint_or(com_bigint *dest, const com_bigint *a,
                     const com_bigint *b);
 void com_bigint_xor(com_bigint *dest, const com_bigint *a,
                      const com_bigint *b);
+// the shifts keep the sign, so rshift rounds the magnitude towards zero
 void com_bigint_lshift(com_bigint *dest, const com_bigint *a,
                         const usize nbits);
 void com_bigint_rshift(com_bigint *dest, const com_bigint *a,
@@ -157,6 +172,27 @@ bool com_bigint_is_zero(const com_bigint *a);
 /// GUARANTEES: if `a` != 0 the sign has been flipped
 void com_bigint_negate(com_bigint *a);
 
+/* Radix conversion: */
+
+/// Appends the base `radix` digits of the magnitude of `a` to `digits`
+/// REQUIRES: `digits` is a valid pointer to a valid vector of u8s
+/// REQUIRES: `a` is a valid pointer to a valid `com_bigint`
+/// REQUIRES: `radix` >= 2 && `radix` <= 36
+/// REQUIRES: `allocator` is a valid `com_allocator`
+/// GUARANTEES: behaves like `com_biguint_get_digits` on the magnitude of `a`
+void com_bigint_get_digits(com_vec *digits, const com_bigint *a, u8 radix,
+                           com_allocator *allocator);
+
+/// dest := the number written in base `radix` in `str`
+/// REQUIRES: `dest` is a valid pointer to a valid `com_bigint`
+/// REQUIRES: `str` is a valid com_str
+/// REQUIRES: `radix` >= 2 && `radix` <= 36
+/// REQUIRES: `allocator` is a valid `com_allocator`
+/// GUARANTEES: `str` may begin with a single '+' or '-'
+/// GUARANTEES: otherwise behaves like `com_biguint_from_str`
+bool com_bigint_from_str(com_bigint *dest, com_str str, u8 radix,
+                         com_allocator *allocator);
+
 /* Functions to inspect the layout of the bigint */
 
 /// Returns the number of u32 words in `a`
@@ -1,53 +1,129 @@
 #include "com_biguint.h"
 #include "com_assert.h"
+#include "com_fmath.h"
 #include "com_imath.h"
 #include "com_mem.h"
 
+// Limb storage
+// A biguint keeps its limbs in `_inline` until they no longer fit, at which
+// point they move into `_array` for good. Everything below reads and resizes
+// the limbs through these helpers instead of touching either field directly.
+
+// GUARANTEES: returns a pointer to the limbs of `a`
+// GUARANTEES: the pointer is valid until the next resize of `a`
+static u32 *internal_limbs(com_biguint *a) {
+  if (a->_heap) {
+    return com_vec_get(&a->_array, 0);
+  }
+  return a->_inline;
+}
+
+// GUARANTEES: returns a pointer to the limbs of `a`, which may not be written
+// GUARANTEES: the pointer is valid until the next resize of `a`
+static const u32 *internal_limbs_const(const com_biguint *a) {
+  if (a->_heap) {
+    return com_vec_get(&a->_array, 0);
+  }
+  return a->_inline;
+}
+
+// GUARANTEES: returns the number of limbs in `a`
+static usize internal_len(const com_biguint *a) {
+  if (a->_heap) {
+    return com_vec_len_m(&a->_array, u32);
+  }
+  return a->_inline_len;
+}
+
+// Sets the number of limbs in `a` to `len`, promoting it to the heap if the
+// limbs no longer fit inline
+// GUARANTEES: the first min(len, old len) limbs of `a` are preserved
+// GUARANTEES: the contents of any new limbs are undefined
+static void internal_set_len(com_biguint *a, usize len) {
+  if (a->_heap) {
+    com_vec_set_len_m(&a->_array, len, u32);
+  } else if (len <= com_biguint_INLINE_LIMBS) {
+    com_assert_m(len <= u8_max_m, "inline length does not fit in a u8");
+    a->_inline_len = (u8)len;
+  } else {
+    const com_allocator *allocator = a->_allocator;
+    com_vec array = com_vec_create(com_allocator_alloc(
+        allocator, (com_allocator_HandleData){
+                       .len = len * sizeof(u32),
+                       .flags = com_allocator_defaults(allocator) |
+                                com_allocator_NOLEAK |
+                                com_allocator_REALLOCABLE}));
+    com_vec_set_len_m(&array, len, u32);
+    com_mem_move(com_vec_get(&array, 0), a->_inline,
+                 a->_inline_len * sizeof(u32));
+    a->_array = array;
+    a->_heap = true;
+  }
+}
+
+// Appends `limb` as the new most significant limb of `a`
+static void internal_push(com_biguint *a, u32 limb) {
+  usize len = internal_len(a);
+  internal_set_len(a, len + 1);
+  internal_limbs(a)[len] = limb;
+}
+
 com_biguint com_biguint_create(com_allocator_Handle h) {
-  return (com_biguint){._array = com_vec_create(h)};
+  return (com_biguint){._heap = true, ._array = com_vec_create(h)};
 }
 
-void com_biguint_destroy(com_biguint *a) { com_vec_destroy(&a->_array); }
+com_biguint com_biguint_create_inline(com_allocator *a) {
+  return (com_biguint){._heap = false, ._inline_len = 0, ._allocator = a};
+}
+
+void com_biguint_destroy(com_biguint *a) {
+  if (a->_heap) {
+    com_vec_destroy(&a->_array);
+  }
+}
 
 void com_biguint_set(com_biguint *dest, const com_biguint *src) {
   com_assert_m(dest != NULL, "dest is null");
   com_assert_m(src != NULL, "src is null");
-  usize len = com_vec_length(&src->_array);
-  com_vec_set_len(&dest->_array, len);
-  com_mem_move(com_vec_get(&dest->_array, 0), com_vec_get(&src->_array, 0),
-               len);
+  if (dest == src) {
+    return;
+  }
+  usize len = internal_len(src);
+  internal_set_len(dest, len);
+  com_mem_move(internal_limbs(dest), internal_limbs_const(src),
+               len * sizeof(u32));
 }
 
 void com_biguint_set_u64(com_biguint *dest, u64 val) {
   com_assert_m(dest != NULL, "dest is null");
   // u64 means only 2 u32 s are needed in the vector
-  com_vec *v = &dest->_array;
   if (val == 0) {
-    com_vec_set_len_m(v, 0, u32);
+    internal_set_len(dest, 0);
   } else if (val <= u32_max_m) {
-    com_vec_set_len_m(v, 1, u32);
-    *com_vec_get_m(v, 0, u32) = val & 0x00000000FFFFFFFFu;
+    internal_set_len(dest, 1);
+    internal_limbs(dest)[0] = val & 0x00000000FFFFFFFFu;
   } else {
-    com_vec_set_len_m(v, 2, u32);
+    internal_set_len(dest, 2);
+    u32 *arr = internal_limbs(dest);
     // downcasting it will get rid of the upper 32 bits
-    *com_vec_get_m(v, 0, u32) = val & 0x00000000FFFFFFFFu;
+    arr[0] = val & 0x00000000FFFFFFFFu;
     // guaranteed to fit in 32 bits
-    *com_vec_get_m(v, 1, u32) = val >> 32;
+    arr[1] = (u32)(val >> 32);
   }
 }
 
 u64 com_biguint_get_u64(const com_biguint *a) {
   com_assert_m(a != NULL, "a is null");
 
-  switch (com_vec_len_m(&a->_array, u32)) {
+  switch (internal_len(a)) {
   case 0: {
     return 0;
   }
   case 1: {
-    return *com_vec_get_m(&a->_array, 0, u32);
+    return *internal_limbs_const(a);
   }
   case 2: {
-    u32 *arr = com_vec_get_m(&a->_array, 0, u32);
+    const u32 *arr = internal_limbs_const(a);
     return ((u64)arr[1] << (u64)32) + (u64)arr[0];
   }
   default: {
@@ -57,22 +133,106 @@ u64 com_biguint_get_u64(const com_biguint *a) {
 }
 
 f64 com_biguint_get_f64(const com_biguint *a) {
+  return com_biguint_get_f64_exp2(a, 0);
+}
+
+f64 com_biguint_get_f64_exp2(const com_biguint *a, i64 exp2) {
   com_assert_m(a != NULL, "a is null");
-  f64 ret = 0;
-  for (usize i = 0; i < com_vec_len_m(&a->_array, u32); i++) {
-    // this operation may be lossy because floating points can really only get
-    // so big
-    ret = ret * u32_max_m + *com_vec_get_m(&a->_array, i, u32);
+  const u32 *limbs = internal_limbs_const(a);
+  usize len = internal_len(a);
+  while (len > 0 && limbs[len - 1] == 0) {
+    len--;
   }
-  return ret;
+  if (len <= 2) {
+    u64 value = len == 0 ? 0 : limbs[0];
+    if (len == 2) {
+      value |= (u64)limbs[1] << 32;
+    }
+    return com_fmath_f64_from_u64_exp2(value, exp2, false);
+  }
+
+  // the top 64 significant bits, which span the top three limbs
+  u32 lz = (u32)__builtin_clz(limbs[len - 1]);
+  u64 top = ((u64)limbs[len - 1] << 32) | limbs[len - 2];
+  u32 low = limbs[len - 3];
+  u64 m = lz == 0 ? top : (top << lz) | (low >> (32 - lz));
+
+  // every bit below those only matters if it is nonzero
+  bool sticky = (low << lz) != 0;
+  for (usize i = 0; !sticky && i < len - 3; i++) {
+    sticky = limbs[i] != 0;
+  }
+  i64 dropped = (i64)(len - 2) * 32 - (i64)lz;
+  return com_fmath_f64_from_u64_exp2(m, exp2 + dropped, sticky);
 }
 
 bool com_biguint_fits_u64(const com_biguint *a) {
-  return com_vec_len_m(&a->_array, u32) <= 2;
+  return internal_len(a) <= 2;
+}
+
+// sets dest to the value of the `n` u64 words in `words`
+static void internal_set_words(com_biguint *dest, const u64 *words, usize n) {
+  com_assert_m(dest != NULL, "dest is null");
+  internal_set_len(dest, n * 2);
+  u32 *arr = internal_limbs(dest);
+  for (usize i = 0; i < n; i++) {
+    arr[2 * i] = words[i] & 0x00000000FFFFFFFFu;
+    arr[2 * i + 1] = (u32)(words[i] >> 32);
+  }
+  usize len = n * 2;
+  while (len > 0 && arr[len - 1] == 0) {
+    len--;
+  }
+  internal_set_len(dest, len);
+}
+
+// sets the `n` u64 words in `words` to the value of a, or to all ones if it
+// doesn't fit
+static void internal_get_words(const com_biguint *a, u64 *words, usize n) {
+  com_assert_m(a != NULL, "a is null");
+  usize len = internal_len(a);
+  const u32 *arr = internal_limbs_const(a);
+  for (usize i = 0; i < n; i++) {
+    if (len > n * 2) {
+      words[i] = u64_max_m;
+    } else {
+      u64 lo = 2 * i < len ? arr[2 * i] : 0;
+      u64 hi = 2 * i + 1 < len ? arr[2 * i + 1] : 0;
+      words[i] = (hi << 32) | lo;
+    }
+  }
+}
+
+void com_biguint_set_u128(com_biguint *dest, com_u128 val) {
+  internal_set_words(dest, val.words, 2);
+}
+
+com_u128 com_biguint_get_u128(const com_biguint *a) {
+  com_u128 ret;
+  internal_get_words(a, ret.words, 2);
+  return ret;
+}
+
+bool com_biguint_fits_u128(const com_biguint *a) {
+  return internal_len(a) <= 4;
+}
+
+void com_biguint_set_u256(com_biguint *dest, com_u256 val) {
+  internal_set_words(dest, val.words, 4);
+}
+
+com_u256 com_biguint_get_u256(const com_biguint *a) {
+  com_u256 ret;
+  internal_get_words(a, ret.words, 4);
+  return ret;
+}
+
+bool com_biguint_fits_u256(const com_biguint *a) {
+  return internal_len(a) <= 8;
 }
 
 bool com_biguint_is_zero(const com_biguint *a) {
-  return com_vec_length(&a->_array) == 0;
+  return internal_len(a) == 0;
 }
 
 // bitwise functions
@@ -82,6 +242,7 @@ bool com_biguint_is_zero(const com_biguint *a) {
 // REQUIRES: `a` is a valid pointer to `alen` u32s
 // REQUIRES: `b` is a valid pointer to `blen` u32s
 // REQUIRES: alen >= blen
+// REQUIRES: `dest` has been resized to `blen`, and `a` and `b` fetched after
 // GUARANTEES: `dest` will be set to the value of `a` & `b`
 static void internal_value_and(com_biguint *dest, const u32 *a, usize alen,
                                const u32 *b, usize blen) {
@@ -89,12 +250,11 @@ static void internal_value_and(com_biguint *dest, const u32 *a, usize alen,
   // algorithm is to loop through where both are valid and then trim off any
   // excess
 
-  // for now, we'll set the dest len to blen, as this is the largest it could
-  // possibly be length of dest
+  // blen is the largest the result could possibly be
   usize dest_len = blen;
+  com_assert_m(internal_len(dest) == dest_len, "dest must be blen long");
 
-  com_vec_set_len_m(&dest->_array, dest_len, u32);
-  u32 *dest_arr = com_vec_get(&dest->_array, 0);
+  u32 *dest_arr = internal_limbs(dest);
   for (usize i = 0; i < dest_len; i++) {
     dest_arr[i] = a[i] & b[i];
   }
@@ -115,7 +275,7 @@ static void internal_value_and(com_biguint *dest, const u32 *a, usize alen,
 
   // now actually remove zeros by truncating the vector
   // This is safe because zeros_len is always less than dest_len
-  com_vec_set_len_m(&dest->_array, dest_len - zeros_len, u32);
+  internal_set_len(dest, dest_len - zeros_len);
 }
 
 void com_biguint_and(com_biguint *dest, const com_biguint *a,
@@ -124,11 +284,14 @@ void com_biguint_and(com_biguint *dest, const com_biguint *a,
   com_assert_m(a != NULL, "a is null");
   com_assert_m(b != NULL, "b is null");
 
-  u32 *a_arr = com_vec_get(&a->_array, 0);
-  u32 *b_arr = com_vec_get(&b->_array, 0);
+  usize alen = internal_len(a);
+  usize blen = internal_len(b);
+
+  // resize dest first, as that may move the array of an operand it aliases
+  internal_set_len(dest, alen < blen ? alen : blen);
 
-  usize alen = com_vec_len_m(&a->_array, u32);
-  usize blen = com_vec_len_m(&b->_array, u32);
+  const u32 *a_arr = internal_limbs_const(a);
+  const u32 *b_arr = internal_limbs_const(b);
 
   if (blen > alen) {
     internal_value_and(dest, b_arr, blen, a_arr, alen);
@@ -137,14 +300,18 @@ void com_biguint_and(com_biguint *dest, const com_biguint *a,
   }
 }
 
+// sets dest to a | b
+// REQUIRES: alen >= blen
+// REQUIRES: `dest` has been resized to `alen`, and `a` and `b` fetched after
+// GUARANTEES: `dest` will be set to the value of `a` | `b`
 static void internal_value_or(com_biguint *dest, const u32 *a, usize alen,
                               const u32 *b, usize blen) {
   com_assert_m(alen >= blen, "alen isn't greater than blen");
 
   // the result is guaranteed to be exactly alen long
   usize dest_len = alen;
-  com_vec_set_len_m(&dest->_array, dest_len, u32);
-  u32 *dest_arr = com_vec_get(&dest->_array, 0);
+  com_assert_m(internal_len(dest) == dest_len, "dest must be alen long");
+  u32 *dest_arr = internal_limbs(dest);
 
   // for this part of the array, both a and b are defined
   for (usize i = 0; i < blen; i++) {
@@ -163,11 +330,14 @@ void com_biguint_or(com_biguint *dest, const com_biguint *a,
   com_assert_m(a != NULL, "a is null");
   com_assert_m(b != NULL, "b is null");
 
-  u32 *a_arr = com_vec_get(&a->_array, 0);
-  u32 *b_arr = com_vec_get(&b->_array, 0);
+  usize alen = internal_len(a);
+  usize blen = internal_len(b);
+
+  // resize dest first, as that may move the array of an operand it aliases
+  internal_set_len(dest, alen > blen ? alen : blen);
 
-  usize alen = com_vec_len_m(&a->_array, u32);
-  usize blen = com_vec_len_m(&b->_array, u32);
+  const u32 *a_arr = internal_limbs_const(a);
+  const u32 *b_arr = internal_limbs_const(b);
 
   if (blen > alen) {
     internal_value_or(dest, b_arr, blen, a_arr, alen);
@@ -176,22 +346,30 @@ void com_biguint_or(com_biguint *dest, const com_biguint *a,
   }
 }
 
+// sets dest to a ^ b
+// REQUIRES: alen >= blen
+// REQUIRES: `dest` has been resized to `alen`, and `a` and `b` fetched after
+// GUARANTEES: `dest` will be set to the value of `a` ^ `b`
 static void internal_value_xor(com_biguint *dest, const u32 *a, usize alen,
                                const u32 *b, usize blen) {
   com_assert_m(alen >= blen, "alen isn't greater than blen");
   // algorithm is to loop through where both are valid and then trim off any
   // excess
 
-  // for now, we'll set the dest len to blen, as this is the largest it could
-  // possibly be length of dest
-  usize dest_len = blen;
+  // alen is the largest the result could possibly be
+  usize dest_len = alen;
+  com_assert_m(internal_len(dest) == dest_len, "dest must be alen long");
 
-  com_vec_set_len_m(&dest->_array, dest_len, u32);
-  u32 *dest_arr = com_vec_get(&dest->_array, 0);
-  for (usize i = 0; i < dest_len; i++) {
+  u32 *dest_arr = internal_limbs(dest);
+  for (usize i = 0; i < blen; i++) {
     dest_arr[i] = a[i] ^ b[i];
   }
 
+  // for this part only a is defined
+  for (usize i = blen; i < dest_len; i++) {
+    dest_arr[i] = a[i];
+  }
+
   // first start at the end of the array and then count the number of zeros
   // going backwards
   usize zeros_len = 0;
@@ -208,7 +386,7 @@ static void internal_value_xor(com_biguint *dest, const u32 *a, usize alen,
 
   // now actually remove zeros by truncating the vector
   // This is safe because zeros_len is always less than dest_len
-  com_vec_set_len_m(&dest->_array, dest_len - zeros_len, u32);
+  internal_set_len(dest, dest_len - zeros_len);
 }
 
 void com_biguint_xor(com_biguint *dest, const com_biguint *a,
@@ -217,11 +395,14 @@ void com_biguint_xor(com_biguint *dest, const com_biguint *a,
   com_assert_m(a != NULL, "a is null");
   com_assert_m(b != NULL, "b is null");
 
-  u32 *a_arr = com_vec_get(&a->_array, 0);
-  u32 *b_arr = com_vec_get(&b->_array, 0);
+  usize alen = internal_len(a);
+  usize blen = internal_len(b);
+
+  // resize dest first, as that may move the array of an operand it aliases
+  internal_set_len(dest, alen > blen ? alen : blen);
 
-  usize alen = com_vec_len_m(&a->_array, u32);
-  usize blen = com_vec_len_m(&b->_array, u32);
+  const u32 *a_arr = internal_limbs_const(a);
+  const u32 *b_arr = internal_limbs_const(b);
 
   if (blen > alen) {
     internal_value_xor(dest, b_arr, blen, a_arr, alen);
@@ -236,10 +417,7 @@ void com_biguint_lshift(com_biguint *dest, const com_biguint *a,
   com_assert_m(dest != NULL, "dest is null");
   com_assert_m(a != NULL, "a is null");
 
-  com_vec *dvec = &dest->_array;
-  const com_vec *avec = &a->_array;
-
-  usize alen = com_vec_len_m(avec, u32);
+  usize alen = internal_len(a);
 
   // if a is zero exit fast
   if (alen == 0) {
@@ -247,40 +425,43 @@ void com_biguint_lshift(com_biguint *dest, const com_biguint *a,
     return;
   }
 
-  // in general, the plan is to go in reverse
-  // This enables in place mutation, should the user provide the same
-  // destination and operator
-
   usize words = bits / 32;
   u32 rbits = bits % 32;
 
-  // set dest length to a's length + words shifted
-  // (we'll add an extra one if it overflows later)
-  // since this is left shift we are increasing the size of the number
-  com_vec_set_len_m(dvec, com_vec_len_m(avec, u32) + words, u32);
-
-  // get the overflow from the last digit
-  u32 overflow = ((u64)*com_vec_get_m(avec, alen - 1, u32) << (u64)rbits) >> 32;
-  // handle final overflow if it exists
-  if (overflow != 0) {
-    *com_vec_push_m(dvec, u32) = overflow;
-  }
-
-  const u32 *a_arr = com_vec_get(avec, 0);
+  // since this is left shift we are increasing the size of the number:
+  // a's length + words shifted, and one more for the bits shifted out the top
+  usize dest_len = alen + words + 1;
 
-  // get array
-  u32 *dest_arr = com_vec_get(dvec, 0);
+  // resize dest first, as that may move the array of an operand it aliases
+  internal_set_len(dest, dest_len);
+  const u32 *a_arr = internal_limbs_const(a);
+  u32 *dest_arr = internal_limbs(dest);
 
-  // get normal
-  for (usize i = alen - 1; i > 0; i--) {
-    // must account for lower bytes being shifted into upper bytes
-    dest_arr[i + words] = (a_arr[i] << rbits) | (a_arr[i - 1] >> (32 - rbits));
+  // in general, the plan is to go in reverse
+  // This enables in place mutation, should the user provide the same
+  // destination and operator
+  if (rbits == 0) {
+    dest_arr[alen + words] = 0;
+    for (usize i = alen; i > 0; i--) {
+      dest_arr[i - 1 + words] = a_arr[i - 1];
+    }
+  } else {
+    dest_arr[alen + words] = a_arr[alen - 1] >> (32 - rbits);
+    for (usize i = alen - 1; i > 0; i--) {
+      // must account for lower bytes being shifted into upper bytes
+      dest_arr[i + words] =
+          (a_arr[i] << rbits) | (a_arr[i - 1] >> (32 - rbits));
+    }
+    dest_arr[words] = a_arr[0] << rbits;
   }
 
-  dest_arr[0] <<= rbits;
-
   // set first `word` bytes to zero
   com_mem_zero_arr_m(dest_arr, words, u32);
+
+  // drop the top limb if nothing was shifted into it
+  if (dest_arr[dest_len - 1] == 0) {
+    internal_set_len(dest, dest_len - 1);
+  }
 }
 
 void com_biguint_rshift(com_biguint *dest, const com_biguint *a,
@@ -288,109 +469,696 @@ void com_biguint_rshift(com_biguint *dest, const com_biguint *a,
   com_assert_m(dest != NULL, "dest is null");
   com_assert_m(a != NULL, "a is null");
 
-  com_vec *dvec = &dest->_array;
-  const com_vec *avec = &a->_array;
-
-  usize alen = com_vec_len_m(avec, u32);
-
-  // have to set it exactly large to avoid issues
-  // if aliasing
-  com_vec_set_len_m(dvec, alen, u32);
+  usize alen = internal_len(a);
 
   usize words = bits / 32;
   u32 rbits = bits % 32;
 
-  if (words > alen) {
+  if (words >= alen) {
     com_biguint_set_u64(dest, 0);
     return;
   }
 
-  const u32 *a_arr = com_vec_get(avec, 0);
-  u32 *dest_arr = com_vec_get(dvec, 0);
+  usize dest_len = alen - words;
+
+  // have to set it exactly large to avoid issues
+  // if aliasing
+  internal_set_len(dest, alen);
 
-  for (usize i = words; i < alen - 1; i++) {
-    // Handle bits from the next bytes shifting into place
-    dest_arr[i - words] = (a_arr[i] >> rbits) | (a_arr[i + 1] << (32 - rbits));
+  const u32 *a_arr = internal_limbs_const(a);
+  u32 *dest_arr = internal_limbs(dest);
+
+  // going forwards, we only ever write at or below the index we read from
+  for (usize i = 0; i + 1 < dest_len; i++) {
+    if (rbits == 0) {
+      dest_arr[i] = a_arr[i + words];
+    } else {
+      // Handle bits from the next bytes shifting into place
+      dest_arr[i] =
+          (a_arr[i + words] >> rbits) | (a_arr[i + words + 1] << (32 - rbits));
+    }
   }
 
   u32 last = a_arr[alen - 1] >> rbits;
+  dest_arr[dest_len - 1] = last;
   if (last != 0) {
-    dest_arr[alen - words - 1] = last;
-    com_vec_set_len_m(dvec, alen - words, u32);
+    internal_set_len(dest, dest_len);
   } else {
-    com_vec_set_len_m(dvec, alen - words - 1, u32);
+    internal_set_len(dest, dest_len - 1);
   }
 }
 
-// Adds together a and b into DEST
-// REQUIRES: `dest` is a pointer to a valid com_biguint
-// REQUIRES: `a` is a pointer to an array of at least `alen` u32s
-// REQUIRES: `b` is a pointer to an array of at least `blen` u32s
+// Limb kernels
+// These operate on raw little endian u32 arrays of a known length, which may
+// have leading zeros. They never allocate: anything they need beyond their
+// output comes from a `scratch` array sized by the caller.
+
+// operands with fewer limbs than this are multiplied by the schoolbook method
+#define KARATSUBA_THRESHOLD 32
+// operands with at least this many limbs are multiplied by Toom-3
+#define TOOM3_THRESHOLD 160
+
+// returns `len` less the number of leading zero limbs of `a`
+static usize internal_limbs_trimmed_len(const u32 *a, usize len) {
+  while (len > 0 && a[len - 1] == 0) {
+    len--;
+  }
+  return len;
+}
+
+// r[0..alen) = a + b, returns the carry out of the top limb
 // REQUIRES: alen >= blen
-// GUARANTEES: `dest` will contain the sum of a and b
-static void internal_value_add_u32_arr(com_biguint *dest, const u32 *a,
-                                       usize alen, const u32 *b, usize blen) {
-  com_assert_m(alen >= blen, "alen is less than blen");
-  // first we have to find the size of the result
-  // NOTE: Thanks to carrying, the result size could be 1 larger than this
-  // We guarantee that `alen` is the larger len
-  usize dest_len = alen;
+// GUARANTEES: `r` may be the same array as `a` or `b`
+static u32 internal_limbs_add(u32 *r, const u32 *a, usize alen, const u32 *b,
+                              usize blen) {
+  u64 carry = 0;
+  usize i = 0;
+  for (; i < blen; i++) {
+    carry += (u64)a[i] + b[i];
+    r[i] = (u32)carry;
+    carry >>= 32;
+  }
+  for (; i < alen; i++) {
+    carry += a[i];
+    r[i] = (u32)carry;
+    carry >>= 32;
+  }
+  return (u32)carry;
+}
+
+// r[0..alen) = a - b, returns the borrow out of the top limb
+// REQUIRES: alen >= blen
+// GUARANTEES: `r` may be the same array as `a` or `b`
+static u32 internal_limbs_sub(u32 *r, const u32 *a, usize alen, const u32 *b,
+                              usize blen) {
+  u64 borrow = 0;
+  usize i = 0;
+  for (; i < blen; i++) {
+    u64 diff = (u64)a[i] - b[i] - borrow;
+    r[i] = (u32)diff;
+    // a negative difference wraps around, setting the top bit
+    borrow = diff >> 63;
+  }
+  for (; i < alen; i++) {
+    u64 diff = (u64)a[i] - borrow;
+    r[i] = (u32)diff;
+    borrow = diff >> 63;
+  }
+  return (u32)borrow;
+}
 
-  // extend dest arr to new size
-  com_vec_set_len_m(&dest->_array, dest_len, u32);
+// r[0..rlen) += a, returns the carry out of the top limb
+// REQUIRES: rlen >= alen
+static u32 internal_limbs_add_to(u32 *r, usize rlen, const u32 *a,
+                                 usize alen) {
+  u32 carry = internal_limbs_add(r, r, alen, a, alen);
+  // the carry usually stops after a limb or two
+  for (usize i = alen; carry != 0 && i < rlen; i++) {
+    r[i]++;
+    carry = r[i] == 0;
+  }
+  return carry;
+}
 
-  // get destination array
-  u32 *dest_arr = com_vec_get_m(&dest->_array, 0, u32);
+// r[0..rlen) -= a, returns the borrow out of the top limb
+// REQUIRES: rlen >= alen
+static u32 internal_limbs_sub_from(u32 *r, usize rlen, const u32 *a,
+                                   usize alen) {
+  u32 borrow = internal_limbs_sub(r, r, alen, a, alen);
+  for (usize i = alen; borrow != 0 && i < rlen; i++) {
+    borrow = r[i] == 0;
+    r[i]--;
+  }
+  return borrow;
+}
 
-  // represents the amount to be carried after adding one word
-  u8 carry = 0;
+// r[0..alen) += a * b, returns the limb carried out of the top
+static u32 internal_limbs_addmul_1(u32 *r, const u32 *a, usize alen, u32 b) {
+  u64 carry = 0;
+  for (usize i = 0; i < alen; i++) {
+    // (2^32-1)^2 + 2 * (2^32-1) is exactly u64_max_m, so this can't overflow
+    carry += (u64)a[i] * b + r[i];
+    r[i] = (u32)carry;
+    carry >>= 32;
+  }
+  return (u32)carry;
+}
 
-  // procedure is:
-  // add together each word, if it overflows then we carry 1 over to the next
-  // word
+// a[0..n) = -a, in two's complement
+static void internal_limbs_negate(u32 *a, usize n) {
+  u64 carry = 1;
+  for (usize i = 0; i < n; i++) {
+    carry += (u32)~a[i];
+    a[i] = (u32)carry;
+    carry >>= 32;
+  }
+}
 
-  // in this for loop, a[i] and b[i] are both valid
-  for (usize i = 0; i < blen; i++) {
-    u64 aval = a[i];
-    u64 bval = b[i];
-    u64 tmp = aval + bval + carry;
-
-    if (tmp > u32_max_m) {
-      // if the value overflows the capacity of a u32
-      carry = 1;
-      dest_arr[i] = (u32)(tmp - u32_max_m);
+// r[0..n) = |a - b|, returns true if a < b
+// REQUIRES: alen <= n and blen <= n
+static bool internal_limbs_abs_diff(u32 *r, const u32 *a, usize alen,
+                                    const u32 *b, usize blen, usize n) {
+  u64 borrow = 0;
+  for (usize i = 0; i < n; i++) {
+    u64 diff = (u64)(i < alen ? a[i] : 0) - (i < blen ? b[i] : 0) - borrow;
+    r[i] = (u32)diff;
+    borrow = diff >> 63;
+  }
+  // a borrow out of the top means the difference wrapped around
+  if (borrow != 0) {
+    internal_limbs_negate(r, n);
+  }
+  return borrow != 0;
+}
+
+// a[0..n) >>= 1
+static void internal_limbs_rshift_1(u32 *a, usize n) {
+  for (usize i = 0; i + 1 < n; i++) {
+    a[i] = (a[i] >> 1) | (a[i + 1] << 31);
+  }
+  a[n - 1] >>= 1;
+}
+
+// a[0..n) /= 3
+// REQUIRES: `a` is a multiple of 3
+// Exact division needs no remainder, so each limb is multiplied by the
+// inverse of 3 mod 2^32 instead of divided (Jebelean's method).
+static void internal_limbs_divexact_3(u32 *a, usize n) {
+  const u32 inverse = 0xAAAAAAABu;
+  u32 borrow = 0;
+  for (usize i = 0; i < n; i++) {
+    u32 s = a[i];
+    u32 l = s - borrow;
+    borrow = l > s;
+    u32 q = l * inverse;
+    a[i] = q;
+    borrow += (u32)(((u64)q * 3) >> 32);
+  }
+}
+
+// r[0..alen+blen) = a * b, by the schoolbook method
+// REQUIRES: `r` does not overlap `a` or `b`
+static void internal_limbs_mul_basecase(u32 *r, const u32 *a, usize alen,
+                                        const u32 *b, usize blen) {
+  com_mem_zero_arr_m(r, alen, u32);
+  for (usize j = 0; j < blen; j++) {
+    r[alen + j] = internal_limbs_addmul_1(r + j, a, alen, b[j]);
+  }
+}
+
+// number of scratch limbs internal_limbs_mul_n needs for `n` limb operands
+static usize internal_limbs_mul_n_scratch(usize n) {
+  if (n < KARATSUBA_THRESHOLD) {
+    return 0;
+  }
+  if (n < TOOM3_THRESHOLD) {
+    usize hh = n - n / 2;
+    return 6 * hh + 1 + internal_limbs_mul_n_scratch(hh);
+  }
+  usize k = (n + 2) / 3;
+  usize w = 2 * k + 2;
+  usize children = internal_limbs_mul_n_scratch(k + 1);
+  usize low = internal_limbs_mul_n_scratch(k);
+  usize high = internal_limbs_mul_n_scratch(n - 2 * k);
+  children = children > low ? children : low;
+  children = children > high ? children : high;
+  return 6 * (k + 1) + 3 * w + children;
+}
+
+static void internal_limbs_mul_n(u32 *r, const u32 *a, const u32 *b, usize n,
+                                 u32 *scratch);
+
+// r[0..2n) = a * b, by Karatsuba's method
+// With a = a1*B^h + a0 and b = b1*B^h + b0, the middle term a0*b1 + a1*b0 is
+// a0*b0 + a1*b1 - (a0 - a1)*(b0 - b1), so three half size products are needed
+// instead of four. Taking the differences rather than the sums keeps every
+// operand at ceil(n/2) limbs.
+static void internal_limbs_mul_karatsuba(u32 *r, const u32 *a, const u32 *b,
+                                         usize n, u32 *scratch) {
+  usize h = n / 2;
+  usize hh = n - h;
+  const u32 *a0 = a;
+  const u32 *a1 = a + h;
+  const u32 *b0 = b;
+  const u32 *b1 = b + h;
+
+  u32 *da = scratch;
+  u32 *db = da + hh;
+  u32 *t = db + hh;
+  u32 *mid = t + 2 * hh;
+  u32 *next = mid + 2 * hh + 1;
+
+  bool a_negative = internal_limbs_abs_diff(da, a0, h, a1, hh, hh);
+  bool b_negative = internal_limbs_abs_diff(db, b0, h, b1, hh, hh);
+  internal_limbs_mul_n(t, da, db, hh, next);
+  internal_limbs_mul_n(r, a0, b0, h, next);
+  internal_limbs_mul_n(r + 2 * h, a1, b1, hh, next);
+
+  // mid = a0*b0 + a1*b1 -/+ |a0 - a1|*|b0 - b1|
+  mid[2 * hh] = internal_limbs_add(mid, r + 2 * h, 2 * hh, r, 2 * h);
+  u32 carry;
+  if (a_negative == b_negative) {
+    carry = internal_limbs_sub_from(mid, 2 * hh + 1, t, 2 * hh);
+  } else {
+    carry = internal_limbs_add_to(mid, 2 * hh + 1, t, 2 * hh);
+  }
+  com_assert_m(carry == 0, "karatsuba middle term out of range");
+
+  usize mid_len = internal_limbs_trimmed_len(mid, 2 * hh + 1);
+  carry = internal_limbs_add_to(r + h, 2 * n - h, mid, mid_len);
+  com_assert_m(carry == 0, "karatsuba product out of range");
+}
+
+// evaluates a Toom-3 split of `a` into k, k and m limbs at 1, -1 and 2
+// p1 = a0 + a1 + a2, pm1 = |a0 - a1 + a2|, p2 = a0 + 2*a1 + 4*a2
+// GUARANTEES: `p1`, `pm1` and `p2` are set to k + 1 limbs each
+// GUARANTEES: returns true if a0 - a1 + a2 is negative
+static bool internal_limbs_toom3_eval(u32 *p1, u32 *pm1, u32 *p2,
+                                      const u32 *a, usize k, usize m) {
+  const u32 *a0 = a;
+  const u32 *a1 = a + k;
+  const u32 *a2 = a + 2 * k;
+
+  p1[k] = internal_limbs_add(p1, a0, k, a2, m);
+  bool negative = internal_limbs_abs_diff(pm1, p1, k + 1, a1, k, k + 1);
+  internal_limbs_add_to(p1, k + 1, a1, k);
+
+  com_mem_move(p2, a0, k * sizeof(u32));
+  p2[k] = 0;
+  u32 carry = internal_limbs_addmul_1(p2, a1, k, 2);
+  internal_limbs_add_to(p2 + k, 1, &carry, 1);
+  carry = internal_limbs_addmul_1(p2, a2, m, 4);
+  internal_limbs_add_to(p2 + m, k + 1 - m, &carry, 1);
+  return negative;
+}
+
+// r[0..2n) = a * b, by Toom-3
+// The operands are split into 3 parts, making them polynomials of degree 2 in
+// B^k. Their product is a polynomial of degree 4, which is recovered from its
+// values at 0, 1, -1, 2 and infinity, using Bodrato's interpolation sequence.
+// This takes 5 products of a third the size, instead of 9.
+static void internal_limbs_mul_toom3(u32 *r, const u32 *a, const u32 *b,
+                                     usize n, u32 *scratch) {
+  usize k = (n + 2) / 3;
+  usize m = n - 2 * k;
+  // wide enough for every product and intermediate, with a sign limb
+  usize w = 2 * k + 2;
+
+  u32 *p1 = scratch;
+  u32 *pm1 = p1 + (k + 1);
+  u32 *p2 = pm1 + (k + 1);
+  u32 *q1 = p2 + (k + 1);
+  u32 *qm1 = q1 + (k + 1);
+  u32 *q2 = qm1 + (k + 1);
+  u32 *v1 = q2 + (k + 1);
+  u32 *vm1 = v1 + w;
+  u32 *v2 = vm1 + w;
+  u32 *next = v2 + w;
+
+  bool pm1_negative = internal_limbs_toom3_eval(p1, pm1, p2, a, k, m);
+  bool qm1_negative = internal_limbs_toom3_eval(q1, qm1, q2, b, k, m);
+
+  // v0 and vinf are written straight into their place in the result
+  u32 *v0 = r;
+  u32 *vinf = r + 4 * k;
+  internal_limbs_mul_n(v0, a, b, k, next);
+  internal_limbs_mul_n(vinf, a + 2 * k, b + 2 * k, m, next);
+  internal_limbs_mul_n(v1, p1, q1, k + 1, next);
+  internal_limbs_mul_n(vm1, pm1, qm1, k + 1, next);
+  internal_limbs_mul_n(v2, p2, q2, k + 1, next);
+  if (pm1_negative != qm1_negative) {
+    internal_limbs_negate(vm1, w);
+  }
+
+  // With c0..c4 the coefficients of the product, the arithmetic below wraps
+  // mod B^w, so vm1 may be negative, but every value it produces is positive.
+  // v2 = (v2 - vm1) / 3 = c1 + c2 + 3c3 + 5c4
+  internal_limbs_sub(v2, v2, w, vm1, w);
+  internal_limbs_divexact_3(v2, w);
+  // vm1 = (v1 - vm1) / 2 = c1 + c3
+  internal_limbs_sub(vm1, v1, w, vm1, w);
+  internal_limbs_rshift_1(vm1, w);
+  // v1 = v1 - v0 = c1 + c2 + c3 + c4
+  internal_limbs_sub_from(v1, w, v0, 2 * k);
+  // v2 = (v2 - v1) / 2 = c3 + 2c4
+  internal_limbs_sub(v2, v2, w, v1, w);
+  internal_limbs_rshift_1(v2, w);
+  // v1 = v1 - vm1 - vinf = c2
+  internal_limbs_sub(v1, v1, w, vm1, w);
+  internal_limbs_sub_from(v1, w, vinf, 2 * m);
+  // v2 = v2 - 2 * vinf = c3
+  internal_limbs_sub_from(v2, w, vinf, 2 * m);
+  internal_limbs_sub_from(v2, w, vinf, 2 * m);
+  // vm1 = vm1 - v2 = c1
+  internal_limbs_sub(vm1, vm1, w, v2, w);
+
+  // r = c0 + c1*B^k + c2*B^2k + c3*B^3k + c4*B^4k
+  com_mem_zero_arr_m(r + 2 * k, 2 * k, u32);
+  const u32 *coefficients[3] = {vm1, v1, v2};
+  for (usize i = 0; i < 3; i++) {
+    usize offset = (i + 1) * k;
+    usize len = internal_limbs_trimmed_len(coefficients[i], w);
+    com_assert_m(offset + len <= 2 * n, "toom-3 coefficient out of range");
+    u32 carry =
+        internal_limbs_add_to(r + offset, 2 * n - offset, coefficients[i], len);
+    com_assert_m(carry == 0, "toom-3 product out of range");
+  }
+}
+
+// r[0..2n) = a * b, picking the fastest algorithm for `n`
+// REQUIRES: `r` does not overlap `a`, `b` or `scratch`
+// REQUIRES: `scratch` has room for internal_limbs_mul_n_scratch(n) limbs
+static void internal_limbs_mul_n(u32 *r, const u32 *a, const u32 *b, usize n,
+                                 u32 *scratch) {
+  if (n < KARATSUBA_THRESHOLD) {
+    internal_limbs_mul_basecase(r, a, n, b, n);
+  } else if (n < TOOM3_THRESHOLD) {
+    internal_limbs_mul_karatsuba(r, a, b, n, scratch);
+  } else {
+    internal_limbs_mul_toom3(r, a, b, n, scratch);
+  }
+}
+
+// number of scratch limbs internal_limbs_mul needs
+static usize internal_limbs_mul_scratch(usize alen, usize blen) {
+  if (blen < KARATSUBA_THRESHOLD) {
+    return 0;
+  }
+  if (alen == blen) {
+    return internal_limbs_mul_n_scratch(blen);
+  }
+  return 3 * blen + internal_limbs_mul_n_scratch(blen);
+}
+
+// r[0..alen+blen) = a * b
+// An unbalanced product is split into blen limb chunks of a, each of which is
+// a balanced product with b.
+// REQUIRES: alen >= blen >= 1
+// REQUIRES: `r` does not overlap `a`, `b` or `scratch`
+// REQUIRES: `scratch` has room for internal_limbs_mul_scratch(alen, blen) limbs
+static void internal_limbs_mul(u32 *r, const u32 *a, usize alen, const u32 *b,
+                               usize blen, u32 *scratch) {
+  if (blen < KARATSUBA_THRESHOLD) {
+    internal_limbs_mul_basecase(r, a, alen, b, blen);
+    return;
+  }
+  if (alen == blen) {
+    internal_limbs_mul_n(r, a, b, blen, scratch);
+    return;
+  }
+
+  u32 *prod = scratch;
+  u32 *pad = prod + 2 * blen;
+  u32 *next = pad + blen;
+  for (usize i = 0; i < alen; i += blen) {
+    usize c = alen - i < blen ? alen - i : blen;
+    if (c == blen) {
+      internal_limbs_mul_n(prod, a + i, b, blen, next);
+    } else if (c < KARATSUBA_THRESHOLD) {
+      internal_limbs_mul_basecase(prod, b, blen, a + i, c);
     } else {
-      // if the value can fit in a u32
-      carry = 0;
-      dest_arr[i] = (u32)tmp;
+      // the last chunk is zero extended to blen limbs
+      com_mem_move(pad, a + i, c * sizeof(u32));
+      com_mem_zero_arr_m(pad + c, blen - c, u32);
+      internal_limbs_mul_n(prod, pad, b, blen, next);
+    }
+
+    // r holds i + blen limbs of the product so far
+    if (i == 0) {
+      com_mem_move(r, prod, (blen + c) * sizeof(u32));
+    } else {
+      com_mem_move(r + i + blen, prod + blen, c * sizeof(u32));
+      u32 carry = internal_limbs_add_to(r + i, blen + c, prod, blen);
+      com_assert_m(carry == 0, "chunked product out of range");
     }
   }
+}
 
-  // this is essentially the loop where we are finished adding,
-  // and are just handling any times where carrying the 1 forward will cause
-  // overflow and require another carry
-  // this also handles the part of a unaffected by the addition
+// r[0..n) -= a * b, returns the limb borrowed out of the top
+static u32 internal_limbs_submul_1(u32 *r, const u32 *a, usize n, u32 b) {
+  u64 borrow = 0;
+  for (usize i = 0; i < n; i++) {
+    u64 prod = (u64)a[i] * b + borrow;
+    u32 low = (u32)prod;
+    borrow = (prod >> 32) + (r[i] < low);
+    r[i] -= low;
+  }
+  return (u32)borrow;
+}
 
-  // in this for loop, only a[i] is valid
-  for (usize i = blen; i < alen; i++) {
-    u32 aval = a[i];
-    u64 tmp = aval + carry;
+// q[0..n) = a / b, returns a % b
+// GUARANTEES: `q` may be the same array as `a`
+static u32 internal_limbs_divmod_1(u32 *q, const u32 *a, usize n, u32 b) {
+  u64 rem = 0;
+  for (usize i = n; i > 0; i--) {
+    u64 num = (rem << 32) | a[i - 1];
+    q[i - 1] = (u32)(num / b);
+    rem = num % b;
+  }
+  return (u32)rem;
+}
 
-    if (tmp > u32_max_m) {
-      // if the value overflows the capacity of a u32
-      dest_arr[i] = (u32)(tmp - u32_max_m);
-      carry = 1;
-    } else {
-      // if the value can fit in a u32
-      dest_arr[i] = (u32)tmp;
-      carry = 0;
+// returns a % b
+static u32 internal_limbs_mod_1(const u32 *a, usize n, u32 b) {
+  u64 rem = 0;
+  for (usize i = n; i > 0; i--) {
+    rem = ((rem << 32) | a[i - 1]) % b;
+  }
+  return (u32)rem;
+}
+
+// q[0..alen-blen) = a / b, leaving a % b in a[0..blen), by Knuth's Algorithm D
+// Each quotient limb is estimated from the top two limbs of the remainder and
+// the top limb of b, which is normalized to have its high bit set so that the
+// estimate is at most 2 too large. The estimate is refined with the second
+// limb of b, which leaves a rare final correction after the multiply-subtract.
+// REQUIRES: alen >= blen >= 2, and the top bit of b is set
+// REQUIRES: `q` does not overlap `a` or `b`
+// GUARANTEES: returns the quotient limb above q[alen-blen-1], which is 0 or 1
+static u32 internal_limbs_div_qr_basecase(u32 *q, u32 *a, usize alen,
+                                          const u32 *b, usize blen) {
+  // the top blen limbs of a are less than 2b, so they hold b at most once
+  u32 qh = 0;
+  u32 *top = a + alen - blen;
+  usize i = blen;
+  while (i > 0 && top[i - 1] == b[i - 1]) {
+    i--;
+  }
+  if (i == 0 || top[i - 1] > b[i - 1]) {
+    internal_limbs_sub(top, top, blen, b, blen);
+    qh = 1;
+  }
+
+  const u64 base = (u64)1 << 32;
+  u32 btop = b[blen - 1];
+  u32 second = b[blen - 2];
+  for (usize j = alen - blen; j > 0; j--) {
+    u32 *window = a + (j - 1);
+    u64 num = ((u64)window[blen] << 32) | window[blen - 1];
+    u64 qhat = num / btop;
+    u64 rhat = num % btop;
+    while (qhat >= base ||
+           qhat * second > ((rhat << 32) | window[blen - 2])) {
+      qhat--;
+      rhat += btop;
+      if (rhat >= base) {
+        break;
+      }
+    }
+
+    u32 borrow = internal_limbs_submul_1(window, b, blen, (u32)qhat);
+    u32 high = window[blen];
+    window[blen] = high - borrow;
+    if (high < borrow) {
+      // the estimate was one too large, so add one b back
+      qhat--;
+      window[blen] += internal_limbs_add(window, window, blen, b, blen);
+    }
+    q[j - 1] = (u32)qhat;
+  }
+  return qh;
+}
+
+// quotients with fewer limbs than this are found by Algorithm D
+#define DIVIDE_CONQUER_THRESHOLD 64
+
+static usize internal_limbs_div_qr_n_scratch(usize n);
+
+// number of scratch limbs internal_limbs_div_qr_trunc needs
+static usize internal_limbs_div_qr_trunc_scratch(usize qn, usize dn) {
+  if (qn < DIVIDE_CONQUER_THRESHOLD) {
+    return 0;
+  }
+  usize scratch = internal_limbs_div_qr_n_scratch(qn);
+  if (qn < dn) {
+    usize lo = dn - qn;
+    usize mul = qn > lo ? internal_limbs_mul_scratch(qn, lo)
+                        : internal_limbs_mul_scratch(lo, qn);
+    scratch = scratch > dn + mul ? scratch : dn + mul;
+  }
+  return scratch;
+}
+
+// number of scratch limbs internal_limbs_div_qr_n needs
+static usize internal_limbs_div_qr_n_scratch(usize n) {
+  usize lo = n / 2;
+  usize high = internal_limbs_div_qr_trunc_scratch(n - lo, n);
+  usize low = internal_limbs_div_qr_trunc_scratch(lo, n);
+  return high > low ? high : low;
+}
+
+static u32 internal_limbs_div_qr_n(u32 *q, u32 *a, const u32 *b, usize n,
+                                   u32 *scratch);
+
+// q[0..qn) = a / b, leaving a % b in a[0..dn), where a has qn + dn limbs
+// The quotient is estimated by dividing the top 2qn limbs of a by the top qn
+// limbs of b, which can only overestimate it. What the low limbs of b
+// contribute is then subtracted from the remainder, adding b back while that
+// goes negative.
+// REQUIRES: dn >= qn >= 1, and the top bit of b is set
+// REQUIRES: `q` does not overlap `a`, `b` or `scratch`
+// REQUIRES: `scratch` has room for internal_limbs_div_qr_trunc_scratch(qn, dn)
+// GUARANTEES: returns the quotient limb above q[qn-1], which is 0 or 1
+static u32 internal_limbs_div_qr_trunc(u32 *q, u32 *a, usize qn, const u32 *b,
+                                       usize dn, u32 *scratch) {
+  if (qn < DIVIDE_CONQUER_THRESHOLD) {
+    return internal_limbs_div_qr_basecase(q, a, qn + dn, b, dn);
+  }
+
+  usize lo = dn - qn;
+  u32 qh = internal_limbs_div_qr_n(q, a + lo, b + lo, qn, scratch);
+  if (lo == 0) {
+    return qh;
+  }
+
+  // subtract q * the low limbs of b from the remainder
+  u32 *product = scratch;
+  if (qn > lo) {
+    internal_limbs_mul(product, q, qn, b, lo, product + dn);
+  } else {
+    internal_limbs_mul(product, b, lo, q, qn, product + dn);
+  }
+  u32 borrow = internal_limbs_sub(a, a, dn, product, dn);
+  if (qh != 0) {
+    borrow += internal_limbs_sub(a + qn, a + qn, lo, b, lo);
+  }
+
+  const u32 one = 1;
+  while (borrow != 0) {
+    qh -= internal_limbs_sub(q, q, qn, &one, 1);
+    borrow -= internal_limbs_add(a, a, dn, b, dn);
+  }
+  return qh;
+}
+
+// q[0..n) = a / b, leaving a % b in a[0..n), where a has 2n limbs
+// The quotient is found a half at a time, so the work is dominated by
+// multiplications of about n/2 limbs: O(M(n) log n) instead of O(n^2).
+// REQUIRES: n >= DIVIDE_CONQUER_THRESHOLD, and the top bit of b is set
+// REQUIRES: `q` does not overlap `a`, `b` or `scratch`
+// REQUIRES: `scratch` has room for internal_limbs_div_qr_n_scratch(n)
+// GUARANTEES: returns the quotient limb above q[n-1], which is 0 or 1
+static u32 internal_limbs_div_qr_n(u32 *q, u32 *a, const u32 *b, usize n,
+                                   u32 *scratch) {
+  usize lo = n / 2;
+  usize hi = n - lo;
+  u32 qh = internal_limbs_div_qr_trunc(q + lo, a + lo, hi, b, n, scratch);
+  // the remainder of the high half is less than b, so the low half fits
+  u32 ql = internal_limbs_div_qr_trunc(q, a, lo, b, n, scratch);
+  com_assert_m(ql == 0, "low quotient overflowed");
+  return qh;
+}
+
+// number of scratch limbs internal_limbs_divmod needs
+static usize internal_limbs_divmod_scratch(usize alen, usize blen) {
+  usize scratch = (alen + 1) + blen;
+  usize qn = alen + 1 - blen;
+  if (qn >= DIVIDE_CONQUER_THRESHOLD && blen >= DIVIDE_CONQUER_THRESHOLD) {
+    usize first = qn % blen == 0 ? blen : qn % blen;
+    usize block = internal_limbs_div_qr_trunc_scratch(blen, blen);
+    usize partial = internal_limbs_div_qr_trunc_scratch(first, blen);
+    scratch += block > partial ? block : partial;
+  }
+  return scratch;
+}
+
+// q[0..alen-blen+1) = a / b, r[0..blen) = a % b
+// Both operands are normalized so that the top bit of b is set. Long
+// quotients by long divisors are then found blen limbs at a time by the
+// divide and conquer method, and everything else by Algorithm D.
+// REQUIRES: alen >= blen >= 2, and the top limb of b is nonzero
+// REQUIRES: `q` and `r` don't overlap `a`, `b`, `scratch` or each other
+// REQUIRES: `scratch` has room for internal_limbs_divmod_scratch(alen, blen)
+static void internal_limbs_divmod(u32 *q, u32 *r, const u32 *a, usize alen,
+                                  const u32 *b, usize blen, u32 *scratch) {
+  u32 *an = scratch;
+  u32 *bn = an + alen + 1;
+  u32 *rest = bn + blen;
+
+  // shift both operands left until the top bit of b is set
+  u32 shift = (u32)__builtin_clz(b[blen - 1]);
+  if (shift == 0) {
+    com_mem_move(bn, b, blen * sizeof(u32));
+    com_mem_move(an, a, alen * sizeof(u32));
+    an[alen] = 0;
+  } else {
+    for (usize i = blen - 1; i > 0; i--) {
+      bn[i] = (b[i] << shift) | (b[i - 1] >> (32 - shift));
+    }
+    bn[0] = b[0] << shift;
+    an[alen] = a[alen - 1] >> (32 - shift);
+    for (usize i = alen - 1; i > 0; i--) {
+      an[i] = (a[i] << shift) | (a[i - 1] >> (32 - shift));
     }
+    an[0] = a[0] << shift;
   }
 
-  // in the last part, if we are still carrying, we need to extend the length
-  // of dest to handle that
+  // the top limb of an is below the top bit, so the top blen limbs of an are
+  // less than bn, and no quotient limb is lost off the top
+  usize qn = alen + 1 - blen;
+  u32 qh = 0;
+  if (qn < DIVIDE_CONQUER_THRESHOLD || blen < DIVIDE_CONQUER_THRESHOLD) {
+    qh = internal_limbs_div_qr_basecase(q, an, alen + 1, bn, blen);
+  } else {
+    // a partial block first, so that the rest are whole
+    usize i = qn % blen == 0 ? qn - blen : qn - qn % blen;
+    qh = internal_limbs_div_qr_trunc(q + i, an + i, qn - i, bn, blen, rest);
+    while (i > 0) {
+      i -= blen;
+      qh |= internal_limbs_div_qr_trunc(q + i, an + i, blen, bn, blen, rest);
+    }
+  }
+  com_assert_m(qh == 0, "quotient overflowed");
+
+  // the remainder is what's left, shifted back down
+  if (shift == 0) {
+    com_mem_move(r, an, blen * sizeof(u32));
+  } else {
+    for (usize i = 0; i + 1 < blen; i++) {
+      r[i] = (an[i] >> shift) | (an[i + 1] << (32 - shift));
+    }
+    r[blen - 1] = an[blen - 1] >> shift;
+  }
+}
+
+// Adds together a and b into DEST
+// REQUIRES: `dest` is a pointer to a valid com_biguint of length `alen`
+// REQUIRES: `a` is a pointer to an array of at least `alen` u32s
+// REQUIRES: `b` is a pointer to an array of at least `blen` u32s
+// REQUIRES: alen >= blen
+// REQUIRES: `a` and `b` were fetched after dest was resized, as resizing may
+// move the array of an operand dest aliases
+// GUARANTEES: `dest` will contain the sum of a and b
+static void internal_value_add_u32_arr(com_biguint *dest, const u32 *a,
+                                       usize alen, const u32 *b, usize blen) {
+  com_assert_m(alen >= blen, "alen is less than blen");
+  com_assert_m(internal_len(dest) == alen,
+               "dest must be alen long");
+  // the result is alen long, or one more if the top limb carries
+  u32 *dest_arr = internal_limbs(dest);
+  u32 carry = internal_limbs_add(dest_arr, a, alen, b, blen);
   if (carry != 0) {
-    *com_vec_push_m(&dest->_array, u32) = carry;
+    internal_push(dest, carry);
   }
 }
 
@@ -429,11 +1197,16 @@ static com_math_cmptype internal_value_cmp_u32_arr(const u32 *a, usize alen,
 com_math_cmptype com_biguint_cmp(const com_biguint *a, const com_biguint *b) {
   com_assert_m(a != NULL, "a is null");
   com_assert_m(b != NULL, "b is null");
-  usize alen = com_vec_len_m(&a->_array, u32);
-  usize blen = com_vec_len_m(&b->_array, u32);
+  usize alen = internal_len(a);
+  usize blen = internal_len(b);
+
+  if (alen <= 2 && blen <= 2) {
+    // small values compare as u64s
+    return com_biguint_cmp_u64(a, com_biguint_get_u64(b));
+  }
 
-  u32 *a_arr = com_vec_get_m(&a->_array, 0, u32);
-  u32 *b_arr = com_vec_get_m(&b->_array, 0, u32);
+  const u32 *a_arr = internal_limbs_const(a);
+  const u32 *b_arr = internal_limbs_const(b);
 
   return internal_value_cmp_u32_arr(a_arr, alen, b_arr, blen);
 }
@@ -455,120 +1228,45 @@ com_math_cmptype com_biguint_cmp_u64(const com_biguint *a, u64 b) {
 }
 
 // sets DEST to a - b
-// REQUIRES: `dest` is a pointer to a valid com_biguint
+// REQUIRES: `dest` is a pointer to a valid com_biguint of length `alen`
 // REQUIRES: `a` is a pointer to an array of at least `alen` u32s
 // REQUIRES: `b` is a pointer to an array of at least `blen` u32s
 // REQUIRES: alen >= blen
+// REQUIRES: `a` and `b` were fetched after dest was resized
 // REQUIRES: the value held by a is greater than the value held by b
 // GUARANTEES: `dest` will contain the difference of a and b
 static void internal_value_sub_u32_arr(com_biguint *dest, const u32 *a,
                                        usize alen, const u32 *b, usize blen) {
   com_assert_m(alen >= blen, "alen is less than blen");
-  com_assert_m(internal_value_cmp_u32_arr(a, alen, b, blen) != com_math_LESS,
+  com_assert_m(internal_value_cmp_u32_arr(a, alen, b, blen) != com_math_GREATER,
                "a < b");
-
-  // in general, it is critical to make sure that we account for the fact that
-  // dest could be aliased to a or b
-
-  // first we have to find the size of the result
-  // alen is the MAX width that our result could have, because
-  // We've already guaranteed that `alen` is the larger len,
-  // and also that a - b will always be less than or equal to a
-
-  // resize dest_vec to the new size, we will trim later if necessary
-  com_vec_set_len_m(&dest->_array, alen, u32);
-
-  u32 *dest_arr = com_vec_get_m(&dest->_array, 0, u32);
-
-  // represents the amount to be borrowed if necessary
-  u8 borrow = 0;
-
-  // procedure is:
-  // sub each word: a + next_word - b + borrow
-  // If it's greater than max length, then we didn't need the borrow, and
-  // subtract it before setting the word in the dest array
-  // Else, we did need the borrow, and set borrow to -1 so we can
-  // subtract it from the next word
-
-  // in this for loop, a[i] and b[i] are both valid
-  for (usize i = 0; i < blen; i++) {
-    u32 aval = a[i];
-    u32 bval = b[i];
-    u64 tmp = u32_max_m + aval - bval - borrow;
-
-    if (tmp > u32_max_m) {
-      // if the value overflows the capacity of a u32
-      // Means we didn't need the borrow
-      borrow = 0;
-      dest_arr[i] = (u32)(tmp - u32_max_m);
-    } else {
-      // if the value can fit in a u32
-      // Means we needed the borrow
-      borrow = 1;
-      dest_arr[i] = (u32)tmp;
-    }
-  }
-
-  // this is essentially the loop where we are finished subtracting,
-  // and are just handling any times where borrowing the forward will cause
-  // problems and require another carry
-  // It also handles the portion of `a` that is unaffected by the subtraction
-
-  // in this for loop, only a[i] is valid
-  for (usize i = blen; i < alen; i++) {
-    u32 aval = a[i];
-    u64 tmp = u32_max_m + aval - borrow;
-
-    if (tmp > u32_max_m) {
-      // if the value overflows the capacity of a u32
-      dest_arr[i] = (u32)(tmp - u32_max_m);
-      // means we didn't need to borrow
-      borrow = 0;
-    } else {
-      // if the value can fit in a u32
-      // Means we needed the borrow
-      dest_arr[i] = (u32)tmp;
-      borrow = 1;
-    }
-  }
-
+  com_assert_m(internal_len(dest) == alen,
+               "dest must be alen long");
+  // a - b <= a, so the result is at most alen long
+  u32 *dest_arr = internal_limbs(dest);
+  u32 borrow = internal_limbs_sub(dest_arr, a, alen, b, blen);
   com_assert_m(borrow == 0,
                "even after subtraction, we still need a borrow, means a < b");
-
-  // length of dest
-  usize dest_len = alen;
-
-  // first start at the end of the array and then count the number of zeros
-  // going backwards
-  usize zeros_len = 0;
-  for (usize i = dest_len; i > 0; i--) {
-    // here I is the index + 1 (did this to prevent overflow)
-
-    // note that i-1 can never overflow because i > 0 at all times in the loop
-    if (dest_arr[i - 1] == 0) {
-      zeros_len++;
-    } else {
-      break;
-    }
-  }
-
-  // now actually remove zeros by truncating the vector
-  // This is safe because zeros_len is always less than dest_len
-  com_vec_set_len_m(&dest->_array, dest_len - zeros_len, u32);
+  // remove the leading zeros left by the subtraction
+  internal_set_len(dest, internal_limbs_trimmed_len(dest_arr, alen));
 }
 
 void com_biguint_add_u32(com_biguint *dest, const com_biguint *a, u32 b) {
   com_assert_m(a != NULL, "a is null");
   com_assert_m(dest != NULL, "dest is null");
   if (b == 0) {
+    com_biguint_set(dest, a);
     return;
   }
-  usize a_len = com_vec_len_m(&a->_array, u32);
-  u32 *a_arr = com_vec_get_m(&a->_array, 0, u32);
-  if (a_len == 0) {
-    // if a_len is 0, then the value of a is zero, so we can just set it
-    com_biguint_set_u64(dest, b);
+  usize a_len = internal_len(a);
+  u64 sum;
+  if (a_len <= 2 && !__builtin_add_overflow(com_biguint_get_u64(a), b, &sum)) {
+    // small values are added as u64s
+    // this also handles a_len == 0, where we can just set it
+    com_biguint_set_u64(dest, sum);
   } else {
+    internal_set_len(dest, a_len);
+    const u32 *a_arr = internal_limbs_const(a);
     // we treat the `b` like a 1 length array
     internal_value_add_u32_arr(dest, a_arr, a_len, &b, 1u);
   }
@@ -578,18 +1276,20 @@ void com_biguint_sub_u32(com_biguint *dest, const com_biguint *a, u32 b) {
   com_assert_m(a != NULL, "a is null");
   com_assert_m(dest != NULL, "dest is null");
   if (b == 0) {
+    com_biguint_set(dest, a);
     return;
   }
-  usize a_len = com_vec_len_m(&a->_array, u32);
-  u32 *a_arr = com_vec_get_m(&a->_array, 0, u32);
+  usize a_len = internal_len(a);
   // we treat the `b` like a 1 length array
-  if (a_len == 0) {
-    // if a_len == 0, then it means a is zero.
+  if (a_len <= 2) {
+    // small values are subtracted as u64s
     // negative numbers are invalid because this is a uint
-    com_assert_m(b == 0,
-                 "trying to subtract a nonzero number from a zero biguint");
-    return;
+    com_assert_m(com_biguint_cmp_u64(a, b) != com_math_GREATER,
+                 "trying to subtract a larger number from a smaller biguint");
+    com_biguint_set_u64(dest, com_biguint_get_u64(a) - b);
   } else {
+    internal_set_len(dest, a_len);
+    const u32 *a_arr = internal_limbs_const(a);
     internal_value_sub_u32_arr(dest, a_arr, a_len, &b, 1u);
   }
 }
@@ -599,12 +1299,24 @@ void com_biguint_add(com_biguint *dest, const com_biguint *a,
   com_assert_m(a != NULL, "a is null");
   com_assert_m(b != NULL, "b is null");
   com_assert_m(dest != NULL, "dest is null");
-  usize alen = com_vec_len_m(&a->_array, u32);
-  usize blen = com_vec_len_m(&b->_array, u32);
+  usize alen = internal_len(a);
+  usize blen = internal_len(b);
+
+  u64 sum;
+  if (alen <= 2 && blen <= 2 &&
+      !__builtin_add_overflow(com_biguint_get_u64(a), com_biguint_get_u64(b),
+                              &sum)) {
+    // small values are added as u64s
+    com_biguint_set_u64(dest, sum);
+    return;
+  }
+
+  // grow dest first, as that may move the array of an operand it aliases
+  internal_set_len(dest, alen > blen ? alen : blen);
 
   // get a pointer to the beginning of the array
-  u32 *a_arr = com_vec_get_m(&a->_array, 0, u32);
-  u32 *b_arr = com_vec_get_m(&b->_array, 0, u32);
+  const u32 *a_arr = internal_limbs_const(a);
+  const u32 *b_arr = internal_limbs_const(b);
 
   // if alen >= blen, add normally
   // else flip order before calling interally
@@ -623,236 +1335,533 @@ void com_biguint_sub(com_biguint *dest, const com_biguint *a,
   com_assert_m(com_biguint_cmp(a, b) != com_math_GREATER,
                "b > a, subtraction would be invalid");
 
-  usize alen = com_vec_len_m(&a->_array, u32);
-  usize blen = com_vec_len_m(&b->_array, u32);
+  usize alen = internal_len(a);
+  usize blen = internal_len(b);
+
+  if (alen <= 2) {
+    // small values are subtracted as u64s
+    com_biguint_set_u64(dest, com_biguint_get_u64(a) - com_biguint_get_u64(b));
+    return;
+  }
+
+  // grow dest first, as that may move the array of an operand it aliases
+  internal_set_len(dest, alen);
 
   // get a pointer to the beginning of the array
-  u32 *a_arr = com_vec_get_m(&a->_array, 0, u32);
-  u32 *b_arr = com_vec_get_m(&b->_array, 0, u32);
+  const u32 *a_arr = internal_limbs_const(a);
+  const u32 *b_arr = internal_limbs_const(b);
 
   // this is safe because we know that if alen > blen, then a > b, because we
   // prohibit leading zeros
-  internal_value_add_u32_arr(dest, a_arr, alen, b_arr, blen);
+  internal_value_sub_u32_arr(dest, a_arr, alen, b_arr, blen);
 }
 
-// Sets dest to a * b
-// REQUIRES: `dest` is a valid pointer to a valid com_biguint
-// REQUIRES: `a` is a valid pointer at least `alen` u32s
-// GUARANTEES: dest will be set to a*b
-static void internal_value_mul_u32_arr_u32(com_biguint *dest, const u32 *a,
-                                           usize alen, u32 b) {
-  com_vec *dest_vec = &dest->_array;
-  // extend array to the size of alen
-  com_vec_set_len_m(dest_vec, alen, u32);
+void com_biguint_mul_u32(com_biguint *dest, const com_biguint *a, u32 b) {
+  com_assert_m(a != NULL, "a is null");
+  com_assert_m(dest != NULL, "dest is null");
 
-  u32 *dest_arr = com_vec_get_m(dest_vec, 0, u32);
+  usize alen = internal_len(a);
+  if (alen == 0 || b == 0) {
+    com_biguint_set_u64(dest, 0);
+    return;
+  }
+
+  // resize dest first, as that may move the array of an operand it aliases
+  // the product is at most one limb longer than a
+  internal_set_len(dest, alen + 1);
+  const u32 *a_arr = internal_limbs_const(a);
+  u32 *dest_arr = internal_limbs(dest);
 
   u32 carry = 0;
   for (usize i = 0; i < alen; i++) {
-    u64 aval = a[i];
+    u64 aval = a_arr[i];
     // this will never overflow since aval * b is promoted to u64 before adding
     // carry
     u64 tmp = aval * b + carry;
     // the upper half of u32
     // Represents the value that can't be fit into the current value
-    carry = tmp >> 32;
+    carry = (u32)(tmp >> 32);
     // push the lower half of tmp
     dest_arr[i] = tmp & 0x00000000FFFFFFFFu;
   }
 
-  // if we still have something to carry add it in
+  // if we still have something to carry keep it, else drop the top limb
   if (carry != 0) {
-    *com_vec_push_m(dest_vec, u32) = carry;
+    dest_arr[alen] = carry;
+  } else {
+    internal_set_len(dest, alen);
   }
 }
 
-void com_biguint_mul_u32(com_biguint *dest, const com_biguint *a, u32 b) {
+void com_biguint_mul(com_biguint *dest, const com_biguint *a,
+                     const com_biguint *b, com_allocator *allocator) {
   com_assert_m(a != NULL, "a is null");
+  com_assert_m(b != NULL, "b is null");
   com_assert_m(dest != NULL, "dest is null");
+  com_assert_m(allocator != NULL, "allocator is null");
 
-  internal_value_mul_u32_arr_u32(dest, com_vec_get_m(&a->_array, 0, u32),
-                                 com_vec_len_m(&a->_array, u32), b);
-}
+  // make a the longer operand
+  if (internal_len(a) < internal_len(b)) {
+    const com_biguint *tmp = a;
+    a = b;
+    b = tmp;
+  }
 
-// sets dest to a * b
-// REQUIRES: `dest` is a pointer to a valid com_biguint
-// REQUIRES: `a` is a pointer to an array of at least `alen` u32s
-// REQUIRES: `b` is a pointer to an array of at least `blen` u32s
-// REQUIRES: `tmp` is a temporary biguint that will be overwritten
-// REQUIRES: dest->_array._data MUST NOT overlap with a or b, as dest will be
-// modified before the end
-// GUARANTEES: dest will contain the product of a and b
-// GUARANTEES: tmp will be undefined
-static void internal_value_mul_u32_arr(com_biguint *dest, const u32 *a,
-                                       usize alen, const u32 *b, usize blen,
-                                       com_biguint *tmp) {
-  // algorithm is the same as normal multiplication
-  // Start with 0
-  // For each digit in b, multiply a by that digit of b, shift by the index and
-  // add it to the running total
-
-  // zero initialize dest, we will later add the result of each
-  // submultiplication to it
-  com_biguint_set_u64(dest, 0);
+  usize alen = internal_len(a);
+  usize blen = internal_len(b);
 
-  for (usize i = 0; i < blen; i++) {
+  if (blen == 0) {
+    com_biguint_set_u64(dest, 0);
+    return;
+  }
 
-    // we know ahead of time that the maximum size that this temp thing can be
-    // is alen + blen this variable represents the product of a with a single
-    // digit of b
+  u64 small;
+  if (alen <= 2 &&
+      !__builtin_mul_overflow(com_biguint_get_u64(a), com_biguint_get_u64(b),
+                              &small)) {
+    // small values are multiplied as u64s
+    com_biguint_set_u64(dest, small);
+    return;
+  }
 
-    // multiply
-    internal_value_mul_u32_arr_u32(tmp, a, alen, b[i]);
+  if (alen <= 4) {
+    // values that fit a u128 are multiplied as u256s, which can't overflow
+    com_u256 product;
+    com_u256_mul(&product, com_biguint_get_u256(a), com_biguint_get_u256(b));
+    com_biguint_set_u256(dest, product);
+    return;
+  }
 
-    // shift right by the current place, zero fill
-    usize len = sizeof(u32) * i;
-    com_mem_zero(com_vec_insert(&tmp->_array, 0, len), len);
+  // the product is alen + blen long, or one less
+  usize len = alen + blen;
+  usize scratch_len = internal_limbs_mul_scratch(alen, blen);
 
-    // add result to dest
-    com_biguint_add(dest, dest, tmp);
+  if (scratch_len == 0 && dest != a && dest != b) {
+    // small products are written straight into dest
+    internal_set_len(dest, len);
+    internal_limbs_mul_basecase(internal_limbs(dest), internal_limbs_const(a),
+                                alen, internal_limbs_const(b), blen);
+  } else {
+    // otherwise the product and the scratch space share one allocation
+    com_allocator_Handle h = com_allocator_alloc(
+        allocator,
+        (com_allocator_HandleData){.len = (len + scratch_len) * sizeof(u32),
+                                   .flags = com_allocator_defaults(allocator)});
+    com_assert_m(h.valid, "allocation failed");
+    u32 *product = com_allocator_handle_get(h);
+    internal_limbs_mul(product, internal_limbs_const(a), alen,
+                       internal_limbs_const(b), blen, product + len);
+    internal_set_len(dest, len);
+    com_mem_move(internal_limbs(dest), product, len * sizeof(u32));
+    com_allocator_dealloc(h);
   }
+
+  u32 *dest_arr = internal_limbs(dest);
+  internal_set_len(dest, internal_limbs_trimmed_len(dest_arr, len));
 }
 
-void com_biguint_mul(com_biguint *dest, const com_biguint *a,
-                     const com_biguint *b, com_allocator *allocator) {
+u32 com_biguint_div_rem_u32(com_biguint *quotient, const com_biguint *a,
+                            u32 b) {
+  com_assert_m(quotient != NULL, "quotient is null");
+  com_assert_m(a != NULL, "a is null");
+  com_assert_m(b != 0, "division by zero error");
+
+  usize alen = internal_len(a);
+  // the division runs from the top limb down, so it can be done in place
+  internal_set_len(quotient, alen);
+  u32 *q_arr = internal_limbs(quotient);
+  const u32 *a_arr = internal_limbs_const(a);
+  u32 rem = internal_limbs_divmod_1(q_arr, a_arr, alen, b);
+  internal_set_len(quotient, internal_limbs_trimmed_len(q_arr, alen));
+  return rem;
+}
+
+void com_biguint_div_u32(com_biguint *dest, const com_biguint *a, u32 b) {
+  com_biguint_div_rem_u32(dest, a, b);
+}
+
+// sets quotient to a / b and remainder to a % b, skipping either if NULL
+static void internal_biguint_div_rem(com_biguint *quotient,
+                                     com_biguint *remainder,
+                                     const com_biguint *a, const com_biguint *b,
+                                     com_allocator *allocator) {
   com_assert_m(a != NULL, "a is null");
   com_assert_m(b != NULL, "b is null");
-  com_assert_m(dest != NULL, "dest is null");
   com_assert_m(allocator != NULL, "allocator is null");
+  com_assert_m(!com_biguint_is_zero(b), "division by zero error");
+  com_assert_m(quotient == NULL || quotient != remainder,
+               "quotient and remainder are the same biguint");
 
-  usize alen = com_vec_len_m(&a->_array, u32);
-  usize blen = com_vec_len_m(&b->_array, u32);
+  usize alen = internal_len(a);
+  usize blen = internal_len(b);
 
-  // get a pointer to the beginning of the array
-  u32 *a_arr = com_vec_get_m(&a->_array, 0, u32);
-  u32 *b_arr = com_vec_get_m(&b->_array, 0, u32);
+  if (alen < blen) {
+    // b > a, so the quotient is 0 and the remainder is a
+    // remainder is set first, as quotient may alias a
+    if (remainder != NULL) {
+      com_biguint_set(remainder, a);
+    }
+    if (quotient != NULL) {
+      com_biguint_set_u64(quotient, 0);
+    }
+    return;
+  }
 
-  // allocate a tmp biguint
-  com_biguint tmp = com_biguint_create(com_allocator_alloc(
+  if (blen == 1) {
+    // a single limb divisor needs no normalization or scratch space
+    u32 divisor = *internal_limbs_const(b);
+    u32 rem;
+    if (quotient != NULL) {
+      rem = com_biguint_div_rem_u32(quotient, a, divisor);
+    } else {
+      rem = internal_limbs_mod_1(internal_limbs_const(a), alen, divisor);
+    }
+    if (remainder != NULL) {
+      com_biguint_set_u64(remainder, rem);
+    }
+    return;
+  }
+
+  if (alen <= 8) {
+    // values that fit a u256 are divided on the stack
+    com_u256 q;
+    com_u256 r;
+    com_u256_div_rem(&q, &r, com_biguint_get_u256(a), com_biguint_get_u256(b));
+    if (quotient != NULL) {
+      com_biguint_set_u256(quotient, q);
+    }
+    if (remainder != NULL) {
+      com_biguint_set_u256(remainder, r);
+    }
+    return;
+  }
+
+  // the quotient, the remainder and the scratch space share one allocation,
+  // so that the outputs may alias the inputs
+  usize qlen = alen - blen + 1;
+  usize scratch_len = internal_limbs_divmod_scratch(alen, blen);
+  com_allocator_Handle h = com_allocator_alloc(
       allocator, (com_allocator_HandleData){
-                     // technically could overflow, but won't because if alen
-                     // and blen are really that long,
-                     // then all the address space is already used up by those
-                     .len = alen + blen + 1,
-                     // we don't need to REALLOCABLE since the max len tmp could
-                     // go through is already covered by our len
-                     // we'll clean up at the end so we don't need NOLEAK
-                     .flags = com_allocator_defaults(allocator)}));
-
-  // if any of the arguments are aliased with dest, then we need to create a new
-  // dest
-  if (dest == b || dest == a) {
-    com_biguint newdest = com_biguint_create(com_allocator_alloc(
-        allocator, (com_allocator_HandleData){
-                       .len = alen + blen + 1,
-                       .flags = com_allocator_defaults(allocator)}));
-    internal_value_mul_u32_arr(&newdest, a_arr, alen, b_arr, blen, &tmp);
-    com_biguint_set(dest, &newdest);
-    // free newdest
-    com_biguint_destroy(&newdest);
-  } else {
-    // means that none of the arguments are aliased with each other
-    internal_value_mul_u32_arr(dest, a_arr, alen, b_arr, blen, &tmp);
+                     .len = (qlen + blen + scratch_len) * sizeof(u32),
+                     .flags = com_allocator_defaults(allocator)});
+  com_assert_m(h.valid, "allocation failed");
+  u32 *q_arr = com_allocator_handle_get(h);
+  u32 *r_arr = q_arr + qlen;
+  internal_limbs_divmod(q_arr, r_arr, internal_limbs_const(a), alen,
+                        internal_limbs_const(b), blen, r_arr + blen);
+
+  if (quotient != NULL) {
+    qlen = internal_limbs_trimmed_len(q_arr, qlen);
+    internal_set_len(quotient, qlen);
+    com_mem_move(internal_limbs(quotient), q_arr, qlen * sizeof(u32));
   }
+  if (remainder != NULL) {
+    usize rlen = internal_limbs_trimmed_len(r_arr, blen);
+    internal_set_len(remainder, rlen);
+    com_mem_move(internal_limbs(remainder), r_arr, rlen * sizeof(u32));
+  }
+  com_allocator_dealloc(h);
+}
 
-  // free tmp
-  com_biguint_destroy(&tmp);
+void com_biguint_div(com_biguint *dest, const com_biguint *a,
+                     const com_biguint *b, com_allocator *allocator) {
+  com_assert_m(dest != NULL, "dest is null");
+  internal_biguint_div_rem(dest, NULL, a, b, allocator);
 }
 
-void com_biguint_div_u32(attr_UNUSED com_biguint *dest, attr_UNUSED const com_biguint *a, attr_UNUSED u32 b){
-  // TODO
-  // Need to figure out way without memory allocation
+void com_biguint_div_rem(com_biguint *quotient, com_biguint *remainder,
+                         const com_biguint *a, const com_biguint *b,
+                         com_allocator *allocator) {
+  com_assert_m(quotient != NULL, "quotient is null");
+  com_assert_m(remainder != NULL, "remainder is null");
+  internal_biguint_div_rem(quotient, remainder, a, b, allocator);
 }
 
-#define new_bigint(a)                                                          \
-  com_biguint_create(com_allocator_alloc(                                      \
-      a, (com_allocator_HandleData){.len = 10,                                 \
-                                    .flags = com_allocator_defaults(a) |       \
-                                             com_allocator_REALLOCABLE}))
-// ALGORITHM FROM HERE
-// https://github.com/kokke/tiny-bignum-c/blob/master/bn.c
-void com_biguint_div(com_biguint *dest, const com_biguint *a,
+void com_biguint_rem(com_biguint *dest, const com_biguint *a,
                      const com_biguint *b, com_allocator *allocator) {
-  com_assert_m(a != NULL, "a is null");
-  com_assert_m(b != NULL, "b is null");
   com_assert_m(dest != NULL, "remainder is null");
-  com_assert_m(allocator != NULL, "allocator is null");
-  com_assert_m(!com_biguint_is_zero(b), "division by zero error");
+  internal_biguint_div_rem(NULL, dest, a, b, allocator);
+}
+
+// Radix conversion
+// Digits are converted a chunk at a time, where a chunk is as many digits as
+// fit in a limb. Numbers longer than a threshold are split in two around a
+// power base^(2^k) of the chunk base, so that the work is done by a few large
+// multiplications or divisions rather than a limb operation per digit. The
+// powers are squared into a cache as needed, once per conversion.
+// Power of two radices are just bits, so they skip all of this.
+
+// numbers shorter than this many limbs are converted chunk by chunk
+#define RADIX_DIVIDE_CONQUER_THRESHOLD 24
+
+typedef struct {
+  com_allocator *allocator;
+  u8 radix;
+  // number of digits in a chunk
+  usize chunk_digits;
+  // radix^chunk_digits
+  u32 chunk_base;
+  // powers[k] = chunk_base^(2^k), for k < powers_len
+  com_biguint powers[64];
+  usize powers_len;
+} internal_RadixPowers;
+
+static internal_RadixPowers internal_radix_powers_create(u8 radix,
+                                                         com_allocator *a) {
+  internal_RadixPowers p = {.allocator = a, .radix = radix};
+  u64 chunk_base = 1;
+  while (chunk_base * radix <= u32_max_m) {
+    chunk_base *= radix;
+    p.chunk_digits++;
+  }
+  p.chunk_base = (u32)chunk_base;
+  p.powers[0] = com_biguint_create_inline(a);
+  com_biguint_set_u64(&p.powers[0], chunk_base);
+  p.powers_len = 1;
+  return p;
+}
+
+static void internal_radix_powers_destroy(internal_RadixPowers *p) {
+  for (usize i = 0; i < p->powers_len; i++) {
+    com_biguint_destroy(&p->powers[i]);
+  }
+}
+
+// GUARANTEES: returns chunk_base^(2^k), valid until `p` is destroyed
+static const com_biguint *internal_radix_power(internal_RadixPowers *p,
+                                               usize k) {
+  while (p->powers_len <= k) {
+    com_biguint *next = &p->powers[p->powers_len];
+    *next = com_biguint_create_inline(p->allocator);
+    com_biguint_mul(next, next - 1, next - 1, p->allocator);
+    p->powers_len++;
+  }
+  return &p->powers[k];
+}
 
-  com_biguint current = new_bigint(allocator);
-  com_biguint denom = new_bigint(allocator);
-  com_biguint tmp = new_bigint(allocator);
+// writes exactly `len` digits of a to `digits`, most significant first
+// REQUIRES: a < radix^len
+// GUARANTEES: `a` is overwritten
+static void internal_biguint_get_digits(u8 *digits, usize len, com_biguint *a,
+                                        internal_RadixPowers *p) {
+  usize alen = internal_len(a);
+  if (alen < RADIX_DIVIDE_CONQUER_THRESHOLD) {
+    // peel off chunks from the bottom
+    usize i = len;
+    while (alen != 0) {
+      u32 chunk = com_biguint_div_rem_u32(a, a, p->chunk_base);
+      alen = internal_len(a);
+      for (usize j = 0; j < p->chunk_digits && i > 0; j++) {
+        digits[--i] = (u8)(chunk % p->radix);
+        chunk /= p->radix;
+      }
+    }
+    com_mem_zero_arr_m(digits, i, u8);
+    return;
+  }
 
-  com_biguint_set_u64(&current, 1); // int current = 1;
-  com_biguint_set(&denom, b);       // denom = b
-  com_biguint_set(&tmp, a);         // tmp   = a
+  // split around the largest power with at most half of a's limbs, which is
+  // then guaranteed to be at most a
+  // a square has at least 2n-1 limbs, so only squares that could fit are made
+  usize k = 0;
+  while (2 * (2 * internal_len(internal_radix_power(p, k)) - 1) <= alen + 1 &&
+         2 * internal_len(internal_radix_power(p, k + 1)) <= alen + 1) {
+    k++;
+  }
+  usize low_len = p->chunk_digits << k;
+
+  com_biguint high = com_biguint_create_inline(p->allocator);
+  com_biguint low = com_biguint_create_inline(p->allocator);
+  com_biguint_div_rem(&high, &low, a, internal_radix_power(p, k),
+                      p->allocator);
+  internal_biguint_get_digits(digits + len - low_len, low_len, &low, p);
+  internal_biguint_get_digits(digits, len - low_len, &high, p);
+  com_biguint_destroy(&high);
+  com_biguint_destroy(&low);
+}
 
-  while (com_biguint_cmp(a, &denom) != com_math_GREATER) // while (denom <= a)
-  {
-    com_biguint_lshift(&current, &current, 1); //   current <<= 1;
-    com_biguint_lshift(&denom, &denom, 1);     //   denom <<= 1;
+// sets dest to the number with `len` digits `digits`, most significant first
+static void internal_biguint_set_digits(com_biguint *dest, const u8 *digits,
+                                        usize len, internal_RadixPowers *p) {
+  if (len <= p->chunk_digits * RADIX_DIVIDE_CONQUER_THRESHOLD) {
+    com_biguint_set_u64(dest, 0);
+    // the first chunk takes up whatever doesn't divide evenly
+    usize chunk_len = len % p->chunk_digits;
+    if (chunk_len == 0) {
+      chunk_len = p->chunk_digits;
+    }
+    for (usize i = 0; i < len; i += chunk_len, chunk_len = p->chunk_digits) {
+      u32 chunk = 0;
+      u32 scale = 1;
+      for (usize j = 0; j < chunk_len; j++) {
+        chunk = chunk * p->radix + digits[i + j];
+        scale *= p->radix;
+      }
+      com_biguint_mul_u32(dest, dest, scale);
+      com_biguint_add_u32(dest, dest, chunk);
+    }
+    return;
   }
 
-  com_biguint_rshift(&current, &current, 1); //   current >>= 1;
-  com_biguint_rshift(&denom, &denom, 1);     //   denom >>= 1;
+  // split off the low chunk_digits*2^k digits, for the largest such k that
+  // leaves some high digits
+  usize k = 0;
+  while ((p->chunk_digits << (k + 1)) < len) {
+    k++;
+  }
+  usize low_len = p->chunk_digits << k;
+
+  com_biguint high = com_biguint_create_inline(p->allocator);
+  internal_biguint_set_digits(&high, digits, len - low_len, p);
+  internal_biguint_set_digits(dest, digits + len - low_len, low_len, p);
+  com_biguint_mul(&high, &high, internal_radix_power(p, k), p->allocator);
+  com_biguint_add(dest, dest, &high);
+  com_biguint_destroy(&high);
+}
+
+void com_biguint_set_digits(com_biguint *dest, const u8 *digits, usize len,
+                            u8 radix, com_allocator *allocator) {
+  com_assert_m(dest != NULL, "dest is null");
+  com_assert_m(len == 0 || digits != NULL, "digits is null");
+  com_assert_m(radix >= 2 && radix <= 36, "radix must be between 2 and 36");
+  com_assert_m(allocator != NULL, "allocator is null");
 
-  com_biguint_set_u64(dest, 0); // int answer = 0;
+  // leading zeros don't change the value, but would be converted anyway
+  while (len > 0 && digits[0] == 0) {
+    digits++;
+    len--;
+  }
 
-  while (!com_biguint_is_zero(&current)) // while (current != 0)
-  {
-    if (com_biguint_cmp(&denom, &tmp) !=
-        com_math_LESS) //   if (dividend >= denom)
-    {
-      com_biguint_sub(&tmp, &tmp, &denom);  //     dividend -= denom;
-      com_biguint_or(dest, &current, dest); //     answer |= current;
+  if ((radix & (radix - 1)) == 0) {
+    // each digit is just a group of bits
+    u32 bits = (u32)__builtin_ctz(radix);
+    usize nbits = len * bits;
+    internal_set_len(dest, (nbits + 31) / 32);
+    u32 *arr = internal_limbs(dest);
+    com_mem_zero_arr_m(arr, (nbits + 31) / 32, u32);
+    for (usize i = 0; i < len; i++) {
+      // digit i from the bottom starts at bit i*bits, and may straddle limbs
+      usize bit = i * bits;
+      u64 digit = (u64)digits[len - 1 - i] << (bit % 32);
+      arr[bit / 32] |= (u32)digit;
+      if ((digit >> 32) != 0) {
+        arr[bit / 32 + 1] |= (u32)(digit >> 32);
+      }
     }
-    com_biguint_rshift(&current, &current, 1); //   current >>= 1;
-    com_biguint_rshift(&denom, &denom, 1);     //   denom >>= 1;
-  }                                            // return answer;
+    // the top digit may not use all of its bits
+    internal_set_len(dest, internal_limbs_trimmed_len(arr, (nbits + 31) / 32));
+    return;
+  }
 
-  com_biguint_destroy(&current);
-  com_biguint_destroy(&denom);
-  com_biguint_destroy(&tmp);
+  internal_RadixPowers p = internal_radix_powers_create(radix, allocator);
+  internal_biguint_set_digits(dest, digits, len, &p);
+  internal_radix_powers_destroy(&p);
 }
 
-void com_biguint_div_rem(com_biguint *quotient, com_biguint *remainder,
-                         const com_biguint *a, const com_biguint *b,
-                         com_allocator *allocator) {
+void com_biguint_get_digits(com_vec *digits, const com_biguint *a, u8 radix,
+                            com_allocator *allocator) {
+  com_assert_m(digits != NULL, "digits is null");
   com_assert_m(a != NULL, "a is null");
-  com_assert_m(b != NULL, "b is null");
-  com_assert_m(quotient != NULL, "quotient is null");
-  com_assert_m(remainder != NULL, "remainder is null");
+  com_assert_m(radix >= 2 && radix <= 36, "radix must be between 2 and 36");
   com_assert_m(allocator != NULL, "allocator is null");
-  com_assert_m(!com_biguint_is_zero(b), "division by zero error");
 
-  com_biguint_div(quotient, a, b, allocator);
-  com_biguint_sub(remainder, a, quotient);
+  usize alen = internal_len(a);
+  if (alen == 0) {
+    *com_vec_push_m(digits, u8) = 0;
+    return;
+  }
+
+  if ((radix & (radix - 1)) == 0) {
+    // each digit is just a group of bits
+    u32 bits = (u32)__builtin_ctz(radix);
+    const u32 *arr = internal_limbs_const(a);
+    usize nbits = 32 * alen - (usize)__builtin_clz(arr[alen - 1]);
+    usize len = (nbits + bits - 1) / bits;
+    u8 *out = com_vec_push(digits, len);
+    for (usize i = 0; i < len; i++) {
+      usize bit = i * bits;
+      u64 window = arr[bit / 32];
+      if (bit / 32 + 1 < alen) {
+        window |= (u64)arr[bit / 32 + 1] << 32;
+      }
+      out[len - 1 - i] = (u8)((window >> (bit % 32)) & (radix - 1));
+    }
+    return;
+  }
+
+  internal_RadixPowers p = internal_radix_powers_create(radix, allocator);
+
+  // a limb never holds more than chunk_digits + 1 digits, so this is enough
+  usize bound = alen * (p.chunk_digits + 1);
+  usize start = com_vec_len_m(digits, u8);
+  com_vec_push(digits, bound);
+
+  com_biguint tmp = com_biguint_create_inline(allocator);
+  com_biguint_set(&tmp, a);
+  internal_biguint_get_digits(com_vec_get(digits, start), bound, &tmp, &p);
+  com_biguint_destroy(&tmp);
+  internal_radix_powers_destroy(&p);
+
+  // drop the zeros the bound left at the front
+  u8 *out = com_vec_get(digits, start);
+  usize zeros = 0;
+  while (out[zeros] == 0) {
+    zeros++;
+  }
+  com_mem_move(out, out + zeros, bound - zeros);
+  com_vec_set_len_m(digits, start + bound - zeros, u8);
 }
 
-void com_biguint_rem(com_biguint *dest, const com_biguint *a,
-                     const com_biguint *b, com_allocator *allocator) {
-  com_assert_m(a != NULL, "a is null");
-  com_assert_m(b != NULL, "b is null");
-  com_assert_m(dest != NULL, "remainder is null");
+bool com_biguint_from_str(com_biguint *dest, com_str str, u8 radix,
+                          com_allocator *allocator) {
+  com_assert_m(dest != NULL, "dest is null");
+  com_assert_m(radix >= 2 && radix <= 36, "radix must be between 2 and 36");
   com_assert_m(allocator != NULL, "allocator is null");
-  com_assert_m(!com_biguint_is_zero(b), "division by zero error");
 
-  // initially start with zero length but chan realloc later
-  com_biguint quotient = new_bigint(allocator);
+  if (str.len == 0) {
+    return false;
+  }
 
-  com_biguint_div_rem(&quotient, dest, a, b, allocator);
+  com_allocator_Handle h = com_allocator_alloc(
+      allocator,
+      (com_allocator_HandleData){.len = str.len,
+                                 .flags = com_allocator_defaults(allocator)});
+  com_assert_m(h.valid, "allocation failed");
+  u8 *digits = com_allocator_handle_get(h);
+
+  bool valid = true;
+  for (usize i = 0; i < str.len; i++) {
+    u8 c = str.data[i];
+    u8 digit = radix;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'z') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'Z') {
+      digit = c - 'A' + 10;
+    }
+    if (digit >= radix) {
+      valid = false;
+      break;
+    }
+    digits[i] = digit;
+  }
 
-  com_biguint_destroy(&quotient);
+  if (valid) {
+    com_biguint_set_digits(dest, digits, str.len, radix, allocator);
+  }
+  com_allocator_dealloc(h);
+  return valid;
 }
 
 usize com_biguint_len(const com_biguint *a) {
-  return com_vec_len_m(&a->_array, u32);
+  return internal_len(a);
 }
 
 u32 com_biguint_get_at(const com_biguint *a, usize i) {
-  return *com_vec_get_m(&a->_array, i, u32);
+  return internal_limbs_const(a)[i];
 }
 
 void com_biguint_set_at(com_biguint *a, usize i, u32 val) {
-  *com_vec_get_m(&a->_array, i, u32) = val;
+  internal_limbs(a)[i] = val;
 }
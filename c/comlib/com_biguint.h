@@ -5,15 +5,30 @@
 #include "com_define.h"
 #include "com_math.h"
 #include "com_vec.h"
+#include "com_wideint.h"
+
+// number of u32s that can be held without allocating
+#define com_biguint_INLINE_LIMBS 10
 
 // Data-holding structure: array of u32s 
 // the array is stored with the least significant words at the lower indices
 // little endian
+// Small values are held in the struct itself, and move to an allocated vector
+// the first time they outgrow it
 typedef struct {
-  // vector of u32s
+  // whether the limbs live in `_array` rather than `_inline`
+  bool _heap;
+  // number of u32s in `_inline`
+  u8 _inline_len;
+  // allocator used to create `_array` when `_inline` overflows
+  const com_allocator *_allocator;
+  // u32s
   // not permitted to have empty zeros in the front
   // This makes comparing magnitudes faster and memory usage down
-  com_vec _array;
+  union {
+    u32 _inline[com_biguint_INLINE_LIMBS];
+    com_vec _array;
+  };
 } com_biguint;
 
 // biguint creation
@@ -23,6 +38,14 @@ typedef struct {
 /// with GUARANTEES: returns a valid `com_biguint` with value 0
 com_biguint com_biguint_create(com_allocator_Handle h);
 
+///  creates a biguint that holds small values inline (default value is 0)
+/// REQUIRES: `a` is a valid pointer to a `com_allocator` that supports
+/// reallocable allocations
+/// GUARANTEES: returns a valid `com_biguint` with value 0
+/// GUARANTEES: no memory is allocated until the value outgrows
+/// com_biguint_INLINE_LIMBS u32s
+com_biguint com_biguint_create_inline(com_allocator *a);
+
 // biguint destruction
 
 ///  frees biguint
@@ -49,9 +72,49 @@ bool com_biguint_fits_u64(const com_biguint *a);
 
 ///  Returns the nearest value of a biguint as a f64
 /// REQUIRES: `a` is a valid pointer to a valid `com_biguint`
-/// GUARANTEES: returns the value of `f64` closest to the value of `a`
+/// GUARANTEES: returns the value of `f64` closest to the value of `a`, with
+/// ties rounded to even
+/// GUARANTEES: returns infinity if `a` is too large for an f64
 f64 com_biguint_get_f64(const com_biguint *a);
 
+///  Returns the nearest value of a biguint times a power of 2 as a f64
+/// REQUIRES: `a` is a valid pointer to a valid `com_biguint`
+/// GUARANTEES: returns the value of `f64` closest to `a` * 2^`exp2`, with
+/// ties rounded to even
+/// GUARANTEES: this rounds only once, so unlike scaling the result of
+/// `com_biguint_get_f64`, it is also correct for subnormal results
+f64 com_biguint_get_f64_exp2(const com_biguint *a, i64 exp2);
+
+///  Sets the value of a biguint to a u128
+/// REQUIRES: `dest` is a valid pointer to a valid `com_biguint`
+/// GUARANTEES: the value of  `dest` is now equal to `val`
+void com_biguint_set_u128(com_biguint *dest, com_u128 val);
+
+///  Returns the nearest value of a biguint as a u128
+/// REQUIRES: `a` is a valid pointer to a valid `com_biguint`
+/// GUARANTEES: returns the value of `com_u128` closest to the value of `a`
+com_u128 com_biguint_get_u128(const com_biguint *a);
+
+///  Returns if `a` can be losslessly represented as a u128
+/// REQUIRES: `a` is a valid pointer to a valid `com_biguint`
+/// GUARANTEES: returns `true` if the value of `a` is less than 2^128
+bool com_biguint_fits_u128(const com_biguint *a);
+
+///  Sets the value of a biguint to a u256
+/// REQUIRES: `dest` is a valid pointer to a valid `com_biguint`
+/// GUARANTEES: the value of  `dest` is now equal to `val`
+void com_biguint_set_u256(com_biguint *dest, com_u256 val);
+
+///  Returns the nearest value of a biguint as a u256
+/// REQUIRES: `a` is a valid pointer to a valid `com_biguint`
+/// GUARANTEES: returns the value of `com_u256` closest to the value of `a`
+com_u256 com_biguint_get_u256(const com_biguint *a);
+
+///  Returns if `a` can be losslessly represented as a u256
+/// REQUIRES: `a` is a valid pointer to a valid `com_biguint`
+/// GUARANTEES: returns `true` if the value of `a` is less than 2^256
+bool com_biguint_fits_u256(const com_biguint *a);
+
 ///  Copies the value of a biguint to a biguint
 /// REQUIRES: `dest` is a valid pointer to a valid `com_biguint`
 /// GUARANTEES: the value of  `dest` is now equal to `val`
@@ -82,6 +145,8 @@ void com_biguint_sub(com_biguint *dest, const com_biguint *a,
 /// REQUIRES: `dest` is a valid pointer to a valid `com_biguint`
 /// REQUIRES: `allocator` is a valid `com_allocator`
 /// GUARANTEES: `dest` will be overwritten by `a` * `b`
+/// GUARANTEES: does not allocate, beyond resizing `dest`, if `a` and `b` both
+/// fit in a u128
 void com_biguint_mul(com_biguint *dest, const com_biguint *a,
                      const com_biguint *b, com_allocator *allocator);
 /// dest := a / b
@@ -106,8 +171,12 @@ void com_biguint_rem(com_biguint *dest, const com_biguint *a,
 /// REQUIRES: `quotient` is a valid pointer to a valid `com_biguint`
 /// REQUIRES: `remainder` is a valid pointer to a valid `com_biguint`
 /// REQUIRES: `allocator` is a valid `com_allocator`
+/// REQUIRES: `quotient` and `remainder` are not the same `com_biguint`
 /// GUARANTEES: `quotient` will be overwritten by `a` / `b`
 /// GUARANTEES: `remainder` will be overwritten by `a` % `b`
+/// GUARANTEES: both are computed by a single long division
+/// GUARANTEES: none of the division functions allocate, beyond resizing their
+/// outputs, if `a` fits in a u256
 void com_biguint_div_rem(com_biguint *quotient, com_biguint *remainder,
                          const com_biguint *a, const com_biguint *b,
                          com_allocator *allocator);
@@ -138,10 +207,56 @@ void com_biguint_sub_u32(com_biguint *dest, const com_biguint *a, u32 b);
 void com_biguint_mul_u32(com_biguint *dest, const com_biguint *a, u32 b);
 void com_biguint_div_u32(com_biguint *dest, const com_biguint *a, u32 b);
 
+/// quotient := a / b, returns a % b
+/// REQUIRES: `quotient` is a valid pointer to a valid `com_biguint`
+/// REQUIRES: `a` is a valid pointer to a valid `com_biguint`
+/// REQUIRES: `b` != 0
+/// GUARANTEES: `quotient` will be overwritten by `a` / `b`
+/// GUARANTEES: `quotient` may be the same as `a`
+/// GUARANTEES: does not allocate, beyond resizing `quotient`
+u32 com_biguint_div_rem_u32(com_biguint *quotient, const com_biguint *a,
+                            u32 b);
+
 com_math_cmptype com_biguint_cmp_u64(const com_biguint *a, u64 b);
 
 bool com_biguint_is_zero(const com_biguint *a);
 
+/* Radix conversion: */
+
+/// dest := the number with the base `radix` digits `digits`
+/// REQUIRES: `dest` is a valid pointer to a valid `com_biguint`
+/// REQUIRES: `digits` is a pointer to `len` digits, most significant first
+/// REQUIRES: each digit is a value (not a character) less than `radix`
+/// REQUIRES: `radix` >= 2 && `radix` <= 36
+/// REQUIRES: `allocator` is a valid `com_allocator`
+/// GUARANTEES: `dest` will be overwritten by the value of `digits`
+/// GUARANTEES: runs in O(M(n) log n) time, for M(n) the cost of a multiply
+void com_biguint_set_digits(com_biguint *dest, const u8 *digits, usize len,
+                            u8 radix, com_allocator *allocator);
+
+/// Appends the base `radix` digits of `a` to `digits`
+/// REQUIRES: `digits` is a valid pointer to a valid vector of u8s
+/// REQUIRES: `a` is a valid pointer to a valid `com_biguint`
+/// REQUIRES: `radix` >= 2 && `radix` <= 36
+/// REQUIRES: `allocator` is a valid `com_allocator`
+/// GUARANTEES: the digits are values (not characters), most significant first
+/// GUARANTEES: there are no leading zeros, and zero is a single 0 digit
+/// GUARANTEES: runs in O(M(n) log n) time, for M(n) the cost of a multiply
+void com_biguint_get_digits(com_vec *digits, const com_biguint *a, u8 radix,
+                            com_allocator *allocator);
+
+/// dest := the number written in base `radix` in `str`
+/// REQUIRES: `dest` is a valid pointer to a valid `com_biguint`
+/// REQUIRES: `str` is a valid com_str
+/// REQUIRES: `radix` >= 2 && `radix` <= 36
+/// REQUIRES: `allocator` is a valid `com_allocator`
+/// GUARANTEES: digits past 9 may be upper or lower case letters
+/// GUARANTEES: if `str` is empty or holds any other character, returns false
+/// and leaves `dest` unchanged
+/// GUARANTEES: else returns true and `dest` is overwritten by the value
+bool com_biguint_from_str(com_biguint *dest, com_str str, u8 radix,
+                          com_allocator *allocator);
+
 /* Functions to inspect the layout of the bigint */
 
 /// Returns the number of u32 words in `a`
@@ -1,6 +1,7 @@
 #ifndef COM_FMATH_H
 #define COM_FMATH_H
 
+#include "com_allocator.h"
 #include "com_define.h"
 
 // library for floating point math
@@ -8,5 +9,78 @@
 f64 com_fmath_f64_pow(f64 base, f64 exp);
 f64 com_fmath_f64_pow_u8(f64 base, u8 exp);
 
-#endif 
+/// returns true if `a` is neither infinite nor NaN
+bool com_fmath_f64_is_finite(f64 a);
 
+/// Returns the f64 closest to `m` * 2^`exp2`, with ties rounded to even
+/// REQUIRES: `sticky` is true if the value to round is strictly between
+/// `m` * 2^`exp2` and (`m` + 1) * 2^`exp2`, because nonzero bits below `m`
+/// were dropped
+/// GUARANTEES: the result is correctly rounded, including to subnormals
+/// GUARANTEES: values too large for an f64 become infinity
+f64 com_fmath_f64_from_u64_exp2(u64 m, i64 exp2, bool sticky);
+
+/* Decimal to binary conversion */
+
+// the number of significant digits a com_fmath_Decimal keeps
+// Every value halfway between two adjacent f64s has at most 767 significant
+// digits, so the digits past this can never change how a number rounds, except
+// by whether any of them were nonzero.
+#define com_fmath_DECIMAL_DIGITS_m 800
+
+// A decimal number, built up one digit at a time by a parser
+// Its value is the integer made of `_digits`, times 10^`_exponent`.
+typedef struct {
+  // the first 19 significant digits, which always fit in a u64
+  u64 _mantissa;
+  i64 _exponent;
+  // number of significant digits held in `_digits`
+  usize _len;
+  // whether the decimal point has been pushed
+  bool _fractional;
+  // whether any digit after the first 19 significant ones was nonzero
+  bool _inexact;
+  // whether a nonzero digit was dropped because `_digits` was full
+  bool _truncated;
+  // digit values (not characters), most significant first
+  u8 _digits[com_fmath_DECIMAL_DIGITS_m];
+} com_fmath_Decimal;
+
+/// creates a decimal with the value 0
+/// GUARANTEES: returns a valid `com_fmath_Decimal` with the value 0
+com_fmath_Decimal com_fmath_decimal_create(void);
+
+/// appends a digit to the end of `d`
+/// REQUIRES: `d` is a valid pointer to a valid `com_fmath_Decimal`
+/// REQUIRES: `digit` is a value (not a character) less than 10
+/// GUARANTEES: before the point, `d` := `d` * 10 + `digit`
+/// GUARANTEES: after the point, `digit` is the next fractional digit of `d`
+void com_fmath_decimal_push_digit(com_fmath_Decimal *d, u8 digit);
+
+/// marks the decimal point at the end of `d`
+/// REQUIRES: `d` is a valid pointer to a valid `com_fmath_Decimal`
+/// REQUIRES: the point has not already been pushed to `d`
+/// GUARANTEES: every digit pushed after this is a fractional digit
+void com_fmath_decimal_push_point(com_fmath_Decimal *d);
+
+/// d := d * 10^exp10
+/// REQUIRES: `d` is a valid pointer to a valid `com_fmath_Decimal`
+/// GUARANTEES: the exponent saturates rather than overflowing
+void com_fmath_decimal_scale(com_fmath_Decimal *d, i64 exp10);
+
+/// returns true if `d` is zero
+/// REQUIRES: `d` is a valid pointer to a valid `com_fmath_Decimal`
+bool com_fmath_decimal_is_zero(const com_fmath_Decimal *d);
+
+/// Returns the f64 closest to `d`, with ties rounded to even
+/// REQUIRES: `d` is a valid pointer to a valid `com_fmath_Decimal`
+/// REQUIRES: `allocator` is a valid `com_allocator`
+/// GUARANTEES: the result is correctly rounded, regardless of the length of `d`
+/// GUARANTEES: values too large for an f64 become infinity, and values too
+/// small become 0
+/// GUARANTEES: only allocates when more than 19 significant digits are needed
+/// to decide how to round, which is very rare
+f64 com_fmath_decimal_get_f64(const com_fmath_Decimal *d,
+                              com_allocator *allocator);
+
+#endif
@@ -2,6 +2,8 @@
 #define COM_FORMAT
 
 #include "com_allocator.h"
+#include "com_bigint.h"
+#include "com_biguint.h"
 #include "com_define.h"
 #include "com_str.h"
 #include "com_writer.h"
@@ -59,12 +61,47 @@ typedef struct {
 void com_format_i64(com_writer *w, i64 data, com_format_FormatData fmtdata);
 void com_format_u64(com_writer *w, u64 data, com_format_FormatData fmtdata);
 
+///  Converts `data` to a string format with radix `radix` and then append to w
+/// REQUIRES: `w` is a valid pointer to a valid com_writer
+/// REQUIRES: `data` is a valid pointer to a valid `com_biguint`
+/// REQUIRES: `setting.radix` >= 2 && `setting.radix` <= 36
+/// REQUIRES: `allocator` is a valid pointer to a valid com_allocator
+/// GUARANTEES: will losslessly append data to `w`
+/// GUARANTEES: runs in O(M(n) log n) time, for M(n) the cost of a multiply
+void com_format_biguint(com_writer *w, const com_biguint *data,
+                        com_format_FormatData fmtdata,
+                        com_allocator *allocator);
+void com_format_bigint(com_writer *w, const com_bigint *data,
+                       com_format_FormatData fmtdata, com_allocator *allocator);
+
+// how to lay out a float, with `precision` in com_format_FormatData meaning:
 typedef enum {
+  // 1234.5678 or 0.001
+  // precision is the number of digits after the decimal point
+  // u32_max_m writes as many as needed, and no point if there are none
   com_format_FloatFixed,
+  // 1.2345678e+03 or 1e-03
+  // precision is the number of digits after the decimal point
+  // u32_max_m writes as many as needed, and no point if there are none
   com_format_FloatScientific,
+  // 1234.5678 or 0.001 or 1e+16 or 1.0
+  // precision is the maximum number of significant digits
+  // trailing zeros are dropped, but there is always a point or an exponent
+  // scientific notation is used for exponents below -4, or at least
+  // precision - 1 (or 16 for u32_max_m)
   com_format_FloatDefault,
 } com_format_FloatKind;
 
+///  Converts `data` to decimal and appends it to `w`
+/// REQUIRES: `w` is a valid pointer to a valid com_writer
+/// REQUIRES: `fmtdata` is a valid com_format_FormatData object
+/// GUARANTEES: with precision u32_max_m, writes the shortest decimal that
+/// reads back as `data`, and of those, the closest to `data`
+/// GUARANTEES: otherwise writes `data` correctly rounded (half to even) to
+/// `precision`, where any digits past the shortest decimal are zeros
+/// GUARANTEES: NaN is written as nan, and infinity as inf
+/// GUARANTEES: `radix` is ignored, and `upper` selects E over e
+/// GUARANTEES: does not allocate
 void com_format_f32(com_writer *w, f32 data, com_format_FormatData fmtdata,
                     com_format_FloatKind kind);
 void com_format_f64(com_writer *w, f64 data, com_format_FormatData fmtdata,
@@ -107,10 +144,10 @@ bool com_format_is_hex(u8 c);
 // GUARANTEES: returns a number 0-15
 u8 com_format_from_hex(u8 c);
 
-// REQUIRES: `c` is less than 16
+// REQUIRES: `c` is less than 36
 // GUARANTEES: returns digits '0'-'9' for numbers 0-9
-// GUARANTEES: for 10-15 and upper=true, returns A-F
-// GUARANTEES: for 10-15 and upper=false returns a-f
+// GUARANTEES: for 10-35 and upper=true, returns A-Z
+// GUARANTEES: for 10-35 and upper=false returns a-z
 u8 com_format_to_hex(u8 c, bool upper);
 
 #endif
@@ -130,3 +130,117 @@ u64 com_hash_sip(u64 seed, const com_str data) {
   // not really as secure as it could be, but good enough
   return SIP64(data.data, data.len, 0, seed);
 }
+
+//-----------------------------------------------------------------------------
+// wyhash final version 4.2
+// This is free and unencumbered software released into the public domain
+// under The Unlicense (http://unlicense.org/)
+// main repo: https://github.com/wangyi-fudan/wyhash
+// author: Wang Yi <godspeed_china@yeah.net>
+//-----------------------------------------------------------------------------
+
+static const u64 WY_SECRET[4] = {0x2d358dccaa6c78a5, 0x8bb84b93962eacc9,
+                                 0x4b33a62ed433d4a3, 0x4d5a2da51de1aa47};
+
+// 64x64 bit multiplication, leaving the low half in A and the high half in B
+static inline void WYMUM(u64 *A, u64 *B) {
+#if defined(__SIZEOF_INT128__)
+  __extension__ typedef unsigned __int128 u128;
+  u128 r = (u128)*A * *B;
+  *A = (u64)r;
+  *B = (u64)(r >> 64);
+#else
+  u64 ha = *A >> 32, hb = *B >> 32, la = (u32)*A, lb = (u32)*B;
+  u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  u64 t = rl + (rm0 << 32);
+  u64 c = t < rl;
+  u64 lo = t + (rm1 << 32);
+  c += lo < t;
+  *A = lo;
+  *B = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline u64 WYMIX(u64 A, u64 B) {
+  WYMUM(&A, &B);
+  return A ^ B;
+}
+
+// unaligned little endian reads
+static inline u64 WYR8(const u8 *p) {
+  u64 v;
+  __builtin_memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+static inline u64 WYR4(const u8 *p) {
+  u32 v;
+  __builtin_memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap32(v);
+#endif
+  return v;
+}
+
+// reads 1 to 3 bytes
+static inline u64 WYR3(const u8 *p, usize k) {
+  return (((u64)p[0]) << 16) | (((u64)p[k >> 1]) << 8) | p[k - 1];
+}
+
+u64 com_hash_wyhash(u64 seed, const com_str data) {
+  const u8 *p = data.data;
+  usize len = data.len;
+  seed ^= WYMIX(seed ^ WY_SECRET[0], WY_SECRET[1]);
+  u64 a;
+  u64 b;
+  if (len <= 16) {
+    // short keys are read with two to four overlapping loads
+    if (len >= 4) {
+      a = (WYR4(p) << 32) | WYR4(p + ((len >> 3) << 2));
+      b = (WYR4(p + len - 4) << 32) | WYR4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = WYR3(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    usize i = len;
+    if (i >= 48) {
+      u64 see1 = seed;
+      u64 see2 = seed;
+      do {
+        seed = WYMIX(WYR8(p) ^ WY_SECRET[1], WYR8(p + 8) ^ seed);
+        see1 = WYMIX(WYR8(p + 16) ^ WY_SECRET[2], WYR8(p + 24) ^ see1);
+        see2 = WYMIX(WYR8(p + 32) ^ WY_SECRET[3], WYR8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i >= 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = WYMIX(WYR8(p) ^ WY_SECRET[1], WYR8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = WYR8(p + i - 16);
+    b = WYR8(p + i - 8);
+  }
+  a ^= WY_SECRET[1];
+  b ^= seed;
+  WYMUM(&a, &b);
+  return WYMIX(a ^ WY_SECRET[0] ^ len, b ^ WY_SECRET[1]);
+}
+
+u64 com_hash_u64(u64 seed, u64 data) {
+  u64 x = data ^ seed;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccd;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53;
+  x ^= x >> 33;
+  return x;
+}
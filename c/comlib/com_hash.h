@@ -21,4 +21,22 @@ u64 com_hash_fnv1a(u64 seed, const com_str data);
 /// GUARANTEES: returns a u64 value based on a hash
 u64 com_hash_sip(u64 seed, const com_str data);
 
+/// Hashes str using wyhash (https://github.com/wangyi-fudan/wyhash)
+/// reads 8 bytes at a time, with a path for keys of 16 bytes or less that
+/// needs no loop, so it is much faster than both fnv1a and sip for short keys
+/// the seed is mixed in before any data, so a secret random seed makes the
+/// hash hard to attack, though it is not as proven as sip
+/// REQUIRES: `seed` is a seed for the hash function
+/// REQUIRES: `data` is a valid com_str
+/// GUARANTEES: returns a u64 value based on a hash
+u64 com_hash_wyhash(u64 seed, const com_str data);
+
+/// Hashes a single integer using the finalizer of MurmurHash3
+/// this is much faster than hashing the bytes of the integer, and every bit of
+/// the input affects every bit of the output, but it is not secure against DOS
+/// attacks
+/// REQUIRES: `seed` is a seed for the hash function
+/// GUARANTEES: returns a u64 value based on a hash
+u64 com_hash_u64(u64 seed, u64 data);
+
 #endif 
@@ -1,43 +1,631 @@
 #include "com_hashtable.h"
 #include "com_assert.h"
-#include "com_imath.h"
 #include "com_mem.h"
 #include "com_os_time.h"
 
-// represent how the hash table will scale up under load
-#define MIN_LOAD_FACTOR 0.1
-#define OPT_LOAD_FACTOR 0.2
-#define MAX_LOAD_FACTOR 0.6
+// control byte values, full slots hold a 7 bit tag with the high bit clear
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xFE
 
-// Initializes the memory pointed to as a table with given capacity
-com_hashtable com_hashtable_createSettings(com_allocator_Handle handle,
-                                           com_hashtable_Settings settings) {
+// the table grows once 7/8ths of the slots are full or deleted
+#define MAX_LOAD_NUMERATOR 7
+#define MAX_LOAD_DENOMINATOR 8
+
+// the table shrinks once fewer than 1/16th of the slots are full
+// shrinking leaves the table at most 7/16ths full, so an entry count
+// oscillating around either threshold doesn't resize back and forth
+#define MIN_LOAD_DENOMINATOR 16
+
+// groups of the old storage moved per set or remove during an incremental
+// resize
+// every resize leaves room for at least 3/8ths of the old capacity to be
+// inserted before the new storage fills up, so moving 2 groups (1/32nd of a
+// group per slot) per operation finishes long before that
+#define MIGRATE_GROUPS_PER_OP 2
+
+// number of keys hashed and prefetched together by the batch operations
+#define BATCH_WIDTH 16
+
+// bitmask with bit i set if the ith slot of a group matched
+typedef u16 GroupMask;
+
+#if defined(__SSE2__)
+typedef char internal_Group __attribute__((vector_size(16)));
+
+static internal_Group internal_group_load(const u8 *ctrl) {
+  internal_Group g;
+  __builtin_memcpy(&g, ctrl, sizeof(g));
+  return g;
+}
+
+static internal_Group internal_group_splat(u8 byte) {
+  char c = (char)byte;
+  return (internal_Group){c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c};
+}
+
+static GroupMask internal_group_match(const u8 *ctrl, u8 byte) {
+  internal_Group g = internal_group_load(ctrl);
+  internal_Group eq = (internal_Group)(g == internal_group_splat(byte));
+  return (GroupMask)__builtin_ia32_pmovmskb128(eq);
+}
+
+// empty and deleted are the only control bytes with the high bit set
+static GroupMask internal_group_match_empty_or_deleted(const u8 *ctrl) {
+  return (GroupMask)__builtin_ia32_pmovmskb128(internal_group_load(ctrl));
+}
+#else
+static GroupMask internal_group_match(const u8 *ctrl, u8 byte) {
+  GroupMask mask = 0;
+  for (usize i = 0; i < com_hashtable_GROUP_WIDTH; i++) {
+    mask |= (GroupMask)((ctrl[i] == byte) << i);
+  }
+  return mask;
+}
+
+static GroupMask internal_group_match_empty_or_deleted(const u8 *ctrl) {
+  GroupMask mask = 0;
+  for (usize i = 0; i < com_hashtable_GROUP_WIDTH; i++) {
+    mask |= (GroupMask)((ctrl[i] >> 7) << i);
+  }
+  return mask;
+}
+#endif
+
+static GroupMask internal_group_match_empty(const u8 *ctrl) {
+  return internal_group_match(ctrl, CTRL_EMPTY);
+}
+
+// the index of the lowest matching slot in a nonzero mask
+static usize internal_mask_first(GroupMask mask) {
+  return (usize)__builtin_ctz(mask);
+}
+
+// the high bits of the hash pick the group to start probing at
+static usize internal_h1(u64 hash) { return (usize)(hash >> 7); }
+
+// the low 7 bits of the hash are stored in the control byte
+static u8 internal_h2(u64 hash) { return (u8)(hash & 0x7F); }
+
+// how many bytes a table with `capacity` slots of `slot_size` takes up
+static usize internal_alloc_len(usize capacity, usize slot_size) {
+  return capacity * (1 + slot_size);
+}
+
+// max number of full and deleted slots a table with `capacity` slots can hold
+static usize internal_max_load(usize capacity) {
+  return capacity / MAX_LOAD_DENOMINATOR * MAX_LOAD_NUMERATOR;
+}
+
+// the largest capacity that fits in `len` bytes (may be 0)
+static usize internal_capacity_for_len(usize len, usize slot_size) {
+  usize groups = len / internal_alloc_len(com_hashtable_GROUP_WIDTH, slot_size);
+  if (groups == 0) {
+    return 0;
+  }
+  // round down to a power of two
+  usize pow2 = 1;
+  while (pow2 * 2 <= groups) {
+    pow2 *= 2;
+  }
+  return pow2 * com_hashtable_GROUP_WIDTH;
+}
+
+// the smallest capacity that can hold `len` entries without resizing
+static usize internal_capacity_for_entries(usize len) {
+  usize capacity = com_hashtable_GROUP_WIDTH;
+  while (internal_max_load(capacity) < len) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+// returns a fresh, empty storage of `capacity` slots in `handle`
+static com_hashtable_Storage internal_storage_init(com_allocator_Handle handle,
+                                                   usize capacity) {
+  u8 *base = com_allocator_handle_get(handle);
+  com_mem_set(base, capacity, CTRL_EMPTY);
+  // capacity is a multiple of 16, so the slots stay aligned
+  return (com_hashtable_Storage){._handle = handle,
+                                 ._ctrl = base,
+                                 ._slots = base + capacity,
+                                 ._capacity = capacity,
+                                 ._len = 0};
+}
 
-  com_assert_m(
-      !(settings.fixed_size &&
-        com_allocator_handle_query(handle).flags & com_allocator_REALLOCABLE),
-      "if the hashmap has variable size, then the handle provided "
-      "must support reallocation");
+// makes `storage` the storage new entries are inserted into
+static void internal_core_set_cur(com_hashtable_Core *c,
+                                  com_hashtable_Storage storage) {
+  c->_cur = storage;
+  c->_growth_left =
+      c->_fixed ? storage._capacity : internal_max_load(storage._capacity);
+}
+
+static com_hashtable_Core internal_core_create(com_allocator_Handle handle,
+                                               bool fixed, bool incremental,
+                                               usize slot_size) {
+  com_hashtable_Core c = (com_hashtable_Core){
+      ._migrating = false, ._fixed = fixed, ._incremental = incremental};
+  usize capacity = internal_capacity_for_len(
+      com_allocator_handle_query(handle).len, slot_size);
+  if (capacity == 0) {
+    com_assert_m(!fixed,
+                 "a fixed size hashtable needs room for at least one group");
+    capacity = com_hashtable_GROUP_WIDTH;
+    handle =
+        com_allocator_realloc(handle, internal_alloc_len(capacity, slot_size));
+    com_assert_m(handle.valid, "reallocation failed");
+  }
+  internal_core_set_cur(&c, internal_storage_init(handle, capacity));
+  return c;
+}
+
+static void internal_core_destroy(com_hashtable_Core *c) {
+  if (c->_migrating) {
+    com_allocator_dealloc(c->_old._handle);
+  }
+  com_allocator_dealloc(c->_cur._handle);
+}
+
+// number of entries in both storages
+static usize internal_core_len(const com_hashtable_Core *c) {
+  return c->_cur._len + (c->_migrating ? c->_old._len : 0);
+}
+
+static u64 internal_random_seed(void) {
+  return com_os_time_monotonic() + com_os_time_unix();
+}
+
+// Probe sequence over the groups of a storage
+// Groups are visited in triangular order (+1, +2, +3 ...), which reaches every
+// group exactly once when the number of groups is a power of two
+typedef struct {
+  usize mask;
+  usize group;
+  usize stride;
+} ProbeSeq;
+
+static ProbeSeq internal_probe_start(const com_hashtable_Storage *st,
+                                     u64 hash) {
+  usize mask = st->_capacity / com_hashtable_GROUP_WIDTH - 1;
+  return (ProbeSeq){
+      .mask = mask, .group = internal_h1(hash) & mask, .stride = 0};
+}
+
+// returns false once every group has been visited
+static bool internal_probe_next(ProbeSeq *seq) {
+  seq->stride++;
+  seq->group = (seq->group + seq->stride) & seq->mask;
+  return seq->stride <= seq->mask;
+}
+
+// the control bytes of the group the probe sequence is at
+static const u8 *internal_probe_ctrl(const com_hashtable_Storage *st,
+                                     const ProbeSeq *seq) {
+  return st->_ctrl + seq->group * com_hashtable_GROUP_WIDTH;
+}
+
+// the slot index of the lowest match of `mask` in the current group
+static usize internal_probe_slot(const ProbeSeq *seq, GroupMask mask) {
+  return seq->group * com_hashtable_GROUP_WIDTH + internal_mask_first(mask);
+}
 
-  const usize capacity =
-      com_allocator_handle_query(handle).len / sizeof(com_hashtable_Bucket);
+// returns false if a lookup that missed in the current group can stop
+static bool internal_probe_continue(const u8 *group, ProbeSeq *seq) {
+  // the key would have been placed in this group if it had been inserted
+  if (internal_group_match_empty(group) != 0) {
+    return false;
+  }
+  return internal_probe_next(seq);
+}
+
+#define NOT_FOUND usize_max_m
+
+// returns the first empty or deleted slot in the probe sequence of `hash`, or
+// NOT_FOUND if the storage is completely full
+static usize internal_find_insert_slot(const com_hashtable_Storage *st,
+                                       u64 hash) {
+  ProbeSeq seq = internal_probe_start(st, hash);
+  do {
+    GroupMask m =
+        internal_group_match_empty_or_deleted(internal_probe_ctrl(st, &seq));
+    if (m != 0) {
+      return internal_probe_slot(&seq, m);
+    }
+  } while (internal_probe_next(&seq));
+  return NOT_FOUND;
+}
+
+// marks an empty or deleted slot of `_cur` full, the caller writes the slot
+static void internal_mark_full(com_hashtable_Core *c, usize i, u64 hash) {
+  if (c->_cur._ctrl[i] == CTRL_EMPTY) {
+    c->_growth_left--;
+  }
+  c->_cur._ctrl[i] = internal_h2(hash);
+  c->_cur._len++;
+}
+
+// returns the hash of the key in `slot` of `table`
+typedef u64 (*internal_RehashFn)(const void *table, const u8 *slot);
+
+// moves the entries of the next group of `_old` into `_cur`
+// the moved slots are marked deleted, so that lookups of keys further along
+// the same probe sequence in `_old` still find them
+static void internal_core_migrate_group(com_hashtable_Core *c,
+                                        usize slot_size,
+                                        internal_RehashFn rehash,
+                                        const void *table) {
+  com_hashtable_Storage *old = &c->_old;
+  usize start = c->_migrate_group * com_hashtable_GROUP_WIDTH;
+  for (usize i = start; i < start + com_hashtable_GROUP_WIDTH; i++) {
+    if (old->_ctrl[i] < CTRL_EMPTY) {
+      const u8 *slot = old->_slots + i * slot_size;
+      u64 hash = rehash(table, slot);
+      usize j = internal_find_insert_slot(&c->_cur, hash);
+      com_assert_m(j != NOT_FOUND, "no room to migrate entry");
+      internal_mark_full(c, j, hash);
+      com_mem_move(c->_cur._slots + j * slot_size, slot, slot_size);
+      old->_ctrl[i] = CTRL_DELETED;
+      old->_len--;
+    }
+  }
+  c->_migrate_group++;
+
+  if (c->_migrate_group * com_hashtable_GROUP_WIDTH == old->_capacity) {
+    com_allocator_dealloc(old->_handle);
+    c->_migrating = false;
+  }
+}
+
+// moves up to `groups` groups of `_old` into `_cur`, if migrating
+static void internal_core_migrate(com_hashtable_Core *c, usize groups,
+                                  usize slot_size, internal_RehashFn rehash,
+                                  const void *table) {
+  for (usize g = 0; g < groups && c->_migrating; g++) {
+    internal_core_migrate_group(c, slot_size, rehash, table);
+  }
+}
+
+// moves every entry into a new allocation with `new_capacity` slots
+// this also clears out all deleted slots
+// if the table is incremental, only the allocation happens now, and the
+// entries are moved over the following sets and removes
+static void internal_core_resize(com_hashtable_Core *c, usize new_capacity,
+                                 usize slot_size, internal_RehashFn rehash,
+                                 const void *table) {
+  com_assert_m(!c->_migrating, "a resize is already in progress");
+  com_assert_m(c->_cur._len <= internal_max_load(new_capacity),
+               "new capacity is too small to fit all entries");
+
+  com_allocator_HandleData data = com_allocator_handle_query(c->_cur._handle);
+  com_allocator_Handle handle = com_allocator_alloc(
+      c->_cur._handle._allocator,
+      (com_allocator_HandleData){
+          .len = internal_alloc_len(new_capacity, slot_size),
+          .flags = data.flags});
+  com_assert_m(handle.valid, "allocation failed");
+
+  c->_old = c->_cur;
+  c->_migrate_group = 0;
+  c->_migrating = true;
+  internal_core_set_cur(c, internal_storage_init(handle, new_capacity));
+
+  if (!c->_incremental) {
+    internal_core_migrate(c, usize_max_m, slot_size, rehash, table);
+  }
+}
+
+// does the share of any resize in progress owed by a set or remove
+static void internal_core_step(com_hashtable_Core *c, usize slot_size,
+                               internal_RehashFn rehash, const void *table) {
+  internal_core_migrate(c, MIGRATE_GROUPS_PER_OP, slot_size, rehash, table);
+}
+
+// returns the slot to insert a key with `hash` into, which must not already be
+// in the table, resizing first if needed
+static usize internal_core_prepare_insert(com_hashtable_Core *c, u64 hash,
+                                          usize slot_size,
+                                          internal_RehashFn rehash,
+                                          const void *table) {
+  // if we aren't fixed, check if we need to resize and do so
+  if (!c->_fixed && c->_growth_left == 0) {
+    com_assert_m(!c->_migrating, "resize fell behind insertions");
+    // if deleted slots are using up most of the space, reclaiming them is
+    // enough, otherwise grow
+    usize len = c->_cur._len;
+    usize capacity = internal_capacity_for_entries(len + 1);
+    if (capacity < c->_cur._capacity) {
+      capacity = c->_cur._capacity;
+    } else if (capacity == c->_cur._capacity &&
+               len + 1 > internal_max_load(c->_cur._capacity) / 2) {
+      capacity *= 2;
+    }
+    internal_core_resize(c, capacity, slot_size, rehash, table);
+  }
+
+  usize i = internal_find_insert_slot(&c->_cur, hash);
+  // a fixed table can fill every slot, after which it is out of memory
+  com_assert_m(i != NOT_FOUND, "hashmap is out of memory");
+  internal_mark_full(c, i, hash);
+  return i;
+}
+
+// empties the full slot `i` of `st`, which is either `_cur` or `_old`
+static void internal_storage_erase(com_hashtable_Core *c,
+                                   com_hashtable_Storage *st, usize i) {
+  // If the group still has an empty slot, no probe sequence has ever passed
+  // through it, so the slot can become empty again. Otherwise a tombstone is
+  // needed to keep later lookups probing past this group.
+  const u8 *group =
+      st->_ctrl + i / com_hashtable_GROUP_WIDTH * com_hashtable_GROUP_WIDTH;
+  if (internal_group_match_empty(group) != 0) {
+    st->_ctrl[i] = CTRL_EMPTY;
+    if (st == &c->_cur) {
+      c->_growth_left++;
+    }
+  } else {
+    st->_ctrl[i] = CTRL_DELETED;
+  }
+  st->_len--;
+}
+
+// shrinks the table if it has become mostly empty
+static void internal_core_maybe_shrink(com_hashtable_Core *c, usize slot_size,
+                                       internal_RehashFn rehash,
+                                       const void *table) {
+  usize capacity = c->_cur._capacity;
+  if (c->_fixed || c->_migrating || capacity == com_hashtable_GROUP_WIDTH ||
+      c->_cur._len >= capacity / MIN_LOAD_DENOMINATOR) {
+    return;
+  }
+  // an incremental table halves at a time, so that inserts can't outpace the
+  // migration of a large storage into a small one
+  usize new_capacity = c->_incremental
+                           ? capacity / 2
+                           : internal_capacity_for_entries(c->_cur._len) * 2;
+  internal_core_resize(c, new_capacity, slot_size, rehash, table);
+}
+
+// returns the index of the slot of `st` holding `key`, or NOT_FOUND
+typedef usize (*internal_FindFn)(const com_hashtable_Storage *st,
+                                 const void *key, u64 hash);
+
+// where a key is stored, `storage` is NULL if the key is not in the table
+typedef struct {
+  const com_hashtable_Storage *storage;
+  usize index;
+} internal_Location;
+
+// looks for a key in `_cur`, then in `_old` if it hasn't been moved yet
+static internal_Location internal_core_locate(const com_hashtable_Core *c,
+                                              internal_FindFn find,
+                                              const void *key, u64 hash) {
+  usize i = find(&c->_cur, key, hash);
+  if (i != NOT_FOUND) {
+    return (internal_Location){.storage = &c->_cur, .index = i};
+  }
+  if (c->_migrating) {
+    i = find(&c->_old, key, hash);
+    if (i != NOT_FOUND) {
+      return (internal_Location){.storage = &c->_old, .index = i};
+    }
+  }
+  return (internal_Location){.storage = NULL};
+}
+
+// the slot of `loc` in a table with slots of `slot_size`
+static u8 *internal_location_slot(internal_Location loc, usize slot_size) {
+  return loc.storage->_slots + loc.index * slot_size;
+}
+
+// returns the slot to write a key with `hash` into, inserting it if it isn't
+// found
+static u8 *internal_core_upsert(com_hashtable_Core *c, internal_FindFn find,
+                                const void *key, u64 hash, usize slot_size,
+                                internal_RehashFn rehash, const void *table) {
+  internal_core_step(c, slot_size, rehash, table);
+  internal_Location loc = internal_core_locate(c, find, key, hash);
+  if (loc.storage == NULL) {
+    usize i = internal_core_prepare_insert(c, hash, slot_size, rehash, table);
+    return c->_cur._slots + i * slot_size;
+  }
+  return internal_location_slot(loc, slot_size);
+}
+
+// looks for a key after doing the share of any resize owed by a remove
+static internal_Location
+internal_core_locate_for_remove(com_hashtable_Core *c, internal_FindFn find,
+                                const void *key, u64 hash, usize slot_size,
+                                internal_RehashFn rehash, const void *table) {
+  internal_core_step(c, slot_size, rehash, table);
+  return internal_core_locate(c, find, key, hash);
+}
+
+// empties the slot at `loc`, then shrinks the table if it is mostly empty
+static void internal_core_erase(com_hashtable_Core *c, internal_Location loc,
+                                usize slot_size, internal_RehashFn rehash,
+                                const void *table) {
+  com_hashtable_Storage *st = loc.storage == &c->_cur ? &c->_cur : &c->_old;
+  internal_storage_erase(c, st, loc.index);
+  internal_core_maybe_shrink(c, slot_size, rehash, table);
+}
+
+// returns the hash of key `i` of a batch
+typedef u64 (*internal_BatchHashFn)(const void *batch, usize i);
+// performs the operation of a batch on key `i`, which has hash `hash`
+typedef void (*internal_BatchApplyFn)(void *batch, usize i, u64 hash);
+
+// prefetches the control bytes of the home group of each of the `len` hashes
+static void internal_core_prefetch_ctrl(const com_hashtable_Core *c,
+                                        const u64 *hashes, usize len) {
+  for (usize i = 0; i < len; i++) {
+    ProbeSeq seq = internal_probe_start(&c->_cur, hashes[i]);
+    __builtin_prefetch(internal_probe_ctrl(&c->_cur, &seq));
+  }
+}
+
+// prefetches the first slot of the home group whose tag matches, for each of
+// the `len` hashes
+static void internal_core_prefetch_slots(const com_hashtable_Core *c,
+                                         const u64 *hashes, usize len,
+                                         usize slot_size) {
+  for (usize i = 0; i < len; i++) {
+    ProbeSeq seq = internal_probe_start(&c->_cur, hashes[i]);
+    GroupMask m = internal_group_match(internal_probe_ctrl(&c->_cur, &seq),
+                                       internal_h2(hashes[i]));
+    if (m != 0) {
+      usize slot = internal_probe_slot(&seq, m);
+      __builtin_prefetch(c->_cur._slots + slot * slot_size);
+    }
+  }
+}
+
+// performs an operation on `len` keys, hiding the latency of cache misses
+// The keys are handled in chunks of BATCH_WIDTH. Every key of a chunk is
+// hashed and has its control bytes fetched, then has the slot its tag matches
+// fetched, before any of them are probed, so the misses of the whole chunk
+// are outstanding at once instead of being taken one by one.
+// The core is reread for every chunk, so `apply` may resize the table.
+static void internal_core_batch(const com_hashtable_Core *c, usize len,
+                                usize slot_size, internal_BatchHashFn hash,
+                                internal_BatchApplyFn apply, void *batch) {
+  u64 hashes[BATCH_WIDTH];
+  for (usize start = 0; start < len; start += BATCH_WIDTH) {
+    usize n = len - start < BATCH_WIDTH ? len - start : BATCH_WIDTH;
+    for (usize i = 0; i < n; i++) {
+      hashes[i] = hash(batch, start + i);
+    }
+    internal_core_prefetch_ctrl(c, hashes, n);
+    internal_core_prefetch_slots(c, hashes, n, slot_size);
+    for (usize i = 0; i < n; i++) {
+      apply(batch, start + i, hashes[i]);
+    }
+  }
+}
+
+// empties `_cur` without resizing it, dropping any resize in progress
+static void internal_core_clear(com_hashtable_Core *c) {
+  if (c->_migrating) {
+    com_allocator_dealloc(c->_old._handle);
+    c->_migrating = false;
+  }
+  com_mem_set(c->_cur._ctrl, c->_cur._capacity, CTRL_EMPTY);
+  c->_cur._len = 0;
+  internal_core_set_cur(c, c->_cur);
+}
+
+// com_str keyed table
+// An unordered table stores com_hashtable_Slots in the core. An ordered table
+// appends com_hashtable_Entries to `_entries`, and stores their indexes in the
+// core, which is rebuilt whenever removed entries are compacted away.
+
+static com_hashtable_Entry *internal_entry(const com_hashtable *ht, usize i) {
+  return com_vec_get_m(&ht->_entries, i, com_hashtable_Entry);
+}
+
+static usize internal_entries_len(const com_hashtable *ht) {
+  return com_vec_len_m(&ht->_entries, com_hashtable_Entry);
+}
+
+static usize internal_str_slot_size(const com_hashtable *ht) {
+  return ht->_ordered ? sizeof(usize) : sizeof(com_hashtable_Slot);
+}
+
+static u64 internal_str_rehash(const void *table, const u8 *slot) {
+  const com_hashtable *ht = table;
+  if (ht->_ordered) {
+    return internal_entry(ht, *(const usize *)slot)->_hash;
+  }
+  return ht->_hasher(ht->_seed, ((const com_hashtable_Slot *)slot)->_key);
+}
+
+static usize internal_str_find(const com_hashtable_Storage *st,
+                               const void *keyp, u64 hash) {
+  const com_str key = *(const com_str *)keyp;
+  const com_hashtable_Slot *slots = (const com_hashtable_Slot *)st->_slots;
+  u8 tag = internal_h2(hash);
+  ProbeSeq seq = internal_probe_start(st, hash);
+  const u8 *group;
+  do {
+    group = internal_probe_ctrl(st, &seq);
+    for (GroupMask m = internal_group_match(group, tag); m != 0; m &= m - 1) {
+      usize i = internal_probe_slot(&seq, m);
+      if (com_str_equal(slots[i]._key, key)) {
+        return i;
+      }
+    }
+  } while (internal_probe_continue(group, &seq));
+  return NOT_FOUND;
+}
+
+// the key of a lookup in an ordered table
+typedef struct {
+  com_str key;
+  const com_hashtable *table;
+} internal_OrderedKey;
+
+static usize internal_ordered_find(const com_hashtable_Storage *st,
+                                   const void *keyp, u64 hash) {
+  const internal_OrderedKey *key = keyp;
+  const usize *slots = (const usize *)st->_slots;
+  u8 tag = internal_h2(hash);
+  ProbeSeq seq = internal_probe_start(st, hash);
+  const u8 *group;
+  do {
+    group = internal_probe_ctrl(st, &seq);
+    for (GroupMask m = internal_group_match(group, tag); m != 0; m &= m - 1) {
+      usize i = internal_probe_slot(&seq, m);
+      // comparing the full hash first avoids most string comparisons
+      const com_hashtable_Entry *e = internal_entry(key->table, slots[i]);
+      if (e->_hash == hash && com_str_equal(e->_key, key->key)) {
+        return i;
+      }
+    }
+  } while (internal_probe_continue(group, &seq));
+  return NOT_FOUND;
+}
+
+// looks for `key` in the core of `ht`
+static internal_Location internal_str_locate(const com_hashtable *ht,
+                                             const com_str key, u64 hash) {
+  if (ht->_ordered) {
+    internal_OrderedKey k = {.key = key, .table = ht};
+    return internal_core_locate(&ht->_core, internal_ordered_find, &k, hash);
+  }
+  return internal_core_locate(&ht->_core, internal_str_find, &key, hash);
+}
 
-  return (com_hashtable){
+// the value stored at `loc`
+static void **internal_str_value(const com_hashtable *ht,
+                                 internal_Location loc) {
+  if (ht->_ordered) {
+    usize *slot = (usize *)loc.storage->_slots + loc.index;
+    return &internal_entry(ht, *slot)->_value;
+  }
+  return &((com_hashtable_Slot *)loc.storage->_slots + loc.index)->_value;
+}
+
+com_hashtable com_hashtable_createSettings(com_allocator_Handle handle,
+                                           com_hashtable_Settings settings) {
+  com_assert_m(!(settings.ordered && settings.fixed_size),
+               "an ordered hashtable can't have a fixed size");
+  com_hashtable ht = (com_hashtable){
       ._hasher = settings.hasher,
-      ._seed = settings.randomly_generate_seed
-                   ? com_os_time_monotonic() + com_os_time_unix()
-                   : settings.seed,
-      ._buckets = com_allocator_handle_get(handle),
-      ._buckets_capacity = capacity,
-      ._buckets_handle = handle,
-      ._buckets_used = 0,
-      // an empty hashmap cannot yet be shrunk
-      ._buckets_shrink_threshold = 0,
-      // the load factor = used/capacity
-      ._buckets_expand_threshold = (usize)(MAX_LOAD_FACTOR * (double)capacity),
-      // any color will do
-      ._resize_color = com_hashtable_RED,
-      ._fixed = settings.fixed_size};
+      ._seed = settings.randomly_generate_seed ? internal_random_seed()
+                                               : settings.seed,
+      ._ordered = settings.ordered,
+      ._removed = 0};
+  if (settings.ordered) {
+    const com_allocator *a = handle._allocator;
+    ht._entries = com_vec_create(com_allocator_alloc(
+        a, (com_allocator_HandleData){
+               .len = com_hashtable_GROUP_WIDTH * sizeof(com_hashtable_Entry),
+               .flags = com_allocator_defaults(a) | com_allocator_NOLEAK |
+                        com_allocator_REALLOCABLE}));
+  }
+  ht._core = internal_core_create(handle, settings.fixed_size,
+                                  settings.incremental_resize,
+                                  internal_str_slot_size(&ht));
+  return ht;
 }
 
 // Creates table with default initial capacity
@@ -47,269 +635,663 @@ com_hashtable com_hashtable_create(com_allocator_Handle handle) {
 
 void com_hashtable_destroy(com_hashtable *ht) {
   // free memory
-  com_allocator_dealloc(ht->_buckets_handle);
+  internal_core_destroy(&ht->_core);
+  if (ht->_ordered) {
+    com_vec_destroy(&ht->_entries);
+  }
 }
 
-static bool internal_key_eq(const com_hashtable_Key a,
-                            const com_hashtable_Key b) {
-  return a._hash_cache == b._hash_cache && com_str_equal(a._key, b._key);
+usize com_hashtable_len(const com_hashtable *ht) {
+  return internal_core_len(&ht->_core);
 }
 
-static com_hashtable_ResizeColor invert_color(com_hashtable_ResizeColor c) {
-  if (c == com_hashtable_RED) {
-    return com_hashtable_BLUE;
-  } else {
-    return com_hashtable_RED;
-  }
-}
-
-/// inserts Key `key` into the `buckets` vector following robin hood hashing
-/// rules
-/// REQUIRES: `buckets` is a valid pointer to at least `bckts_len`
-/// `com_hashtable_Bucket`s
-/// REQUIRES: `key` is a valid `com_hashtable_Key`
-/// REQUIRES: `buckets_used_ptr` is a valid pointer to the number of buckets in
-/// use before adding this one
-/// REQUIRES: `resize_color` is the current color of the hashmap;
-/// GUARANTEES: returns true if a new pair was created, and false if otherwise
-static bool internal_hashtable_set(com_hashtable_Bucket *buckets,
-                                   usize bckts_len, const com_hashtable_Key key,
-                                   void *value,
-                                   com_hashtable_ResizeColor resize_color) {
-  // this is the current key to insert
-  com_hashtable_KeyValuePair current_pair = (com_hashtable_KeyValuePair){
-      ._key = key,
-      ._value = value,
-      ._probe_count = 0,
-  };
-
-  while (true) {
-    // we use linear probing
-    com_hashtable_Bucket *b =
-        &buckets[(key._hash_cache + current_pair._probe_count) % bckts_len];
-
-    if (b->_initialized) {
-      if (internal_key_eq(current_pair._key, b->_pair._key)) {
-        // this means that the keys match and we can just set the value
-        b->_pair._value = value;
-        b->_resize_color = resize_color;
-
-        return false;
-      } else if (b->_pair._probe_count < current_pair._probe_count ||
-                 b->_resize_color != resize_color) {
-        // this means that we can do the robin hood swap
-        // we put the key we're currently searching for in this spot
-        // and then start looking for a place to put the old key that used to
-        // occupy this slot
-
-        // do the swap
-        com_hashtable_KeyValuePair tmp = current_pair;
-        current_pair = b->_pair;
-        b->_pair = tmp;
-        b->_resize_color = resize_color;
-      } else {
-        // this means that we keep looking
-        current_pair._probe_count++;
-
-        // assertion to see if we're obviously stuck
-        com_assert_m(current_pair._probe_count < bckts_len,
-                     "all buckets in hashmap are full");
+static void internal_str_set(com_hashtable *ht, const com_str key, u64 hash,
+                             void *value) {
+  if (!ht->_ordered) {
+    u8 *slot = internal_core_upsert(&ht->_core, internal_str_find, &key, hash,
+                                    sizeof(com_hashtable_Slot),
+                                    internal_str_rehash, ht);
+    *(com_hashtable_Slot *)slot =
+        (com_hashtable_Slot){._key = key, ._value = value};
+    return;
+  }
+
+  internal_core_step(&ht->_core, sizeof(usize), internal_str_rehash, ht);
+  internal_Location loc = internal_str_locate(ht, key, hash);
+  if (loc.storage != NULL) {
+    // an existing key keeps its place in the order
+    *internal_str_value(ht, loc) = value;
+    return;
+  }
+  usize i = internal_core_prepare_insert(&ht->_core, hash, sizeof(usize),
+                                         internal_str_rehash, ht);
+  ((usize *)ht->_core._cur._slots)[i] = internal_entries_len(ht);
+  *com_vec_push_m(&ht->_entries, com_hashtable_Entry) = (com_hashtable_Entry){
+      ._key = key, ._value = value, ._hash = hash, ._removed = false};
+}
+
+void com_hashtable_set(com_hashtable *ht, const com_str key, void *value) {
+  internal_str_set(ht, key, ht->_hasher(ht->_seed, key), value);
+}
+
+static com_hashtable_Result internal_str_get(const com_hashtable *ht,
+                                             const com_str key, u64 hash) {
+  internal_Location loc = internal_str_locate(ht, key, hash);
+  if (loc.storage == NULL) {
+    return (com_hashtable_Result){.valid = false};
+  }
+  return (com_hashtable_Result){.valid = true,
+                                .value = *internal_str_value(ht, loc)};
+}
+
+com_hashtable_Result com_hashtable_get(const com_hashtable *ht,
+                                       const com_str key) {
+  return internal_str_get(ht, key, ht->_hasher(ht->_seed, key));
+}
+
+// the arguments of a batch operation on a com_str keyed table
+typedef struct {
+  const com_hashtable *table;
+  // the same table, only set if the batch writes to it
+  com_hashtable *mutable_table;
+  const com_str *keys;
+  void *const *values;
+  com_hashtable_Result *results;
+} internal_StrBatch;
+
+static u64 internal_str_batch_hash(const void *batch, usize i) {
+  const internal_StrBatch *b = batch;
+  return b->table->_hasher(b->table->_seed, b->keys[i]);
+}
+
+static void internal_str_batch_get(void *batch, usize i, u64 hash) {
+  internal_StrBatch *b = batch;
+  b->results[i] = internal_str_get(b->table, b->keys[i], hash);
+}
+
+static void internal_str_batch_set(void *batch, usize i, u64 hash) {
+  internal_StrBatch *b = batch;
+  internal_str_set(b->mutable_table, b->keys[i], hash, b->values[i]);
+}
+
+void com_hashtable_get_batch(const com_hashtable *ht, const com_str *keys,
+                             com_hashtable_Result *results, usize len) {
+  internal_StrBatch b = {.table = ht,
+                         .mutable_table = NULL,
+                         .keys = keys,
+                         .results = results};
+  internal_core_batch(&ht->_core, len, internal_str_slot_size(ht),
+                      internal_str_batch_hash, internal_str_batch_get, &b);
+}
+
+void com_hashtable_set_batch(com_hashtable *ht, const com_str *keys,
+                             void *const *values, usize len) {
+  internal_StrBatch b = {
+      .table = ht, .mutable_table = ht, .keys = keys, .values = values};
+  internal_core_batch(&ht->_core, len, internal_str_slot_size(ht),
+                      internal_str_batch_hash, internal_str_batch_set, &b);
+}
+
+// once at least half of `_entries` have been removed, moves the remaining
+// entries to the front and rebuilds the index around their new positions
+// the rebuild is O(entries), but it takes as many removes to trigger again
+static void internal_ordered_compact(com_hashtable *ht) {
+  usize len = internal_entries_len(ht);
+  if (ht->_removed < com_hashtable_GROUP_WIDTH || ht->_removed * 2 < len) {
+    return;
+  }
+  usize kept = 0;
+  for (usize i = 0; i < len; i++) {
+    com_hashtable_Entry *e = internal_entry(ht, i);
+    if (!e->_removed) {
+      *internal_entry(ht, kept) = *e;
+      kept++;
+    }
+  }
+  com_vec_set_len_m(&ht->_entries, kept, com_hashtable_Entry);
+  ht->_removed = 0;
+
+  // `_cur` was sized to hold every live entry, so they all fit back in it
+  com_hashtable_Core *c = &ht->_core;
+  internal_core_clear(c);
+  for (usize i = 0; i < kept; i++) {
+    u64 hash = internal_entry(ht, i)->_hash;
+    usize j = internal_find_insert_slot(&c->_cur, hash);
+    internal_mark_full(c, j, hash);
+    ((usize *)c->_cur._slots)[j] = i;
+  }
+}
+
+com_hashtable_Result com_hashtable_remove(com_hashtable *ht,
+                                          const com_str key) {
+  usize slot_size = internal_str_slot_size(ht);
+  internal_core_step(&ht->_core, slot_size, internal_str_rehash, ht);
+  internal_Location loc =
+      internal_str_locate(ht, key, ht->_hasher(ht->_seed, key));
+  if (loc.storage == NULL) {
+    return (com_hashtable_Result){.valid = false};
+  }
+  com_hashtable_Result ret = (com_hashtable_Result){
+      .valid = true, .value = *internal_str_value(ht, loc)};
+  if (ht->_ordered) {
+    internal_entry(ht, *((usize *)loc.storage->_slots + loc.index))
+        ->_removed = true;
+    ht->_removed++;
+  }
+  internal_core_erase(&ht->_core, loc, slot_size, internal_str_rehash, ht);
+  if (ht->_ordered) {
+    internal_ordered_compact(ht);
+  }
+  return ret;
+}
+
+com_hashtable_Iter com_hashtable_iter(const com_hashtable *ht) {
+  return (com_hashtable_Iter){._table = ht, ._index = 0};
+}
+
+com_hashtable_IterResult com_hashtable_iter_next(com_hashtable_Iter *iter) {
+  const com_hashtable *ht = iter->_table;
+  if (ht->_ordered) {
+    // the entries are dense, so this is a linear scan
+    while (iter->_index < internal_entries_len(ht)) {
+      const com_hashtable_Entry *e = internal_entry(ht, iter->_index);
+      iter->_index++;
+      if (!e->_removed) {
+        return (com_hashtable_IterResult){
+            .valid = true, .key = e->_key, .value = e->_value};
       }
+    }
+    return (com_hashtable_IterResult){.valid = false};
+  }
+
+  // visit the slots of `_old` that haven't been moved yet, then `_cur`
+  const com_hashtable_Core *c = &ht->_core;
+  usize old_capacity = c->_migrating ? c->_old._capacity : 0;
+  while (iter->_index < old_capacity + c->_cur._capacity) {
+    usize i = iter->_index;
+    iter->_index++;
+    const com_hashtable_Storage *st = &c->_cur;
+    if (i < old_capacity) {
+      st = &c->_old;
     } else {
-      // if this bucket was not initialized, it means we found an unoccupied
-      // slot and we can insert the key here
-      b->_initialized = true;
-      b->_resize_color = resize_color;
-      b->_pair = current_pair;
-      return true;
+      i -= old_capacity;
+    }
+    if (st->_ctrl[i] < CTRL_EMPTY) {
+      const com_hashtable_Slot *slot =
+          (const com_hashtable_Slot *)st->_slots + i;
+      return (com_hashtable_IterResult){
+          .valid = true, .key = slot->_key, .value = slot->_value};
     }
   }
+  return (com_hashtable_IterResult){.valid = false};
 }
 
-static void internal_hashtable_resize(com_hashtable *ht, usize new_capacity) {
-  // check that new size is not too small
-  com_assert_m(ht->_buckets_used < new_capacity,
-               "new capacity is too small to fit all entries");
+// u64 keyed table
+
+static u64 internal_u64_rehash(const void *table, const u8 *slot) {
+  const com_hashtable_U64 *ht = table;
+  return com_hash_u64(ht->_seed, ((const com_hashtable_U64Slot *)slot)->_key);
+}
 
-  com_allocator_Handle handle = ht->_buckets_handle;
-  com_hashtable_Bucket *buckets = ht->_buckets;
-  const usize old_capacity = ht->_buckets_capacity;
-  const usize old_used = ht->_buckets_used;
-
-  // if we're expanding the buffer then we have to grow it first
-  if (new_capacity > old_capacity) {
-    // realloc if we're expanding the array
-    com_allocator_Handle ret = com_allocator_realloc(handle, new_capacity);
-    com_assert_m(ret.valid, "reallocation failed");
-    handle = ret;
-    buckets = com_allocator_handle_get(ret);
-  }
-
-  const com_hashtable_ResizeColor old_color = ht->_resize_color;
-  const com_hashtable_ResizeColor new_color = invert_color(old_color);
-
-  for (usize i = 0; i < old_capacity; i++) {
-    com_hashtable_Bucket *b = &buckets[i];
-    if (b->_initialized && b->_resize_color == old_color) {
-      b->_initialized = false;
-      internal_hashtable_set(
-          buckets,         // buckets array
-          new_capacity,    // we use new capacity so it can distribute evenly
-          b->_pair._key,   // clone key
-          b->_pair._value, // clone value
-          new_color // we give it the new color so that it knows to displace old
-                    // colors that it may encounter
-      );
+static usize internal_u64_find(const com_hashtable_Storage *st,
+                               const void *keyp, u64 hash) {
+  const u64 key = *(const u64 *)keyp;
+  const com_hashtable_U64Slot *slots =
+      (const com_hashtable_U64Slot *)st->_slots;
+  u8 tag = internal_h2(hash);
+  ProbeSeq seq = internal_probe_start(st, hash);
+  const u8 *group;
+  do {
+    group = internal_probe_ctrl(st, &seq);
+    for (GroupMask m = internal_group_match(group, tag); m != 0; m &= m - 1) {
+      usize i = internal_probe_slot(&seq, m);
+      if (slots[i]._key == key) {
+        return i;
+      }
     }
+  } while (internal_probe_continue(group, &seq));
+  return NOT_FOUND;
+}
+
+com_hashtable_U64
+com_hashtable_u64_createSettings(com_allocator_Handle handle,
+                                 com_hashtable_IntSettings settings) {
+  return (com_hashtable_U64){
+      ._seed = settings.randomly_generate_seed ? internal_random_seed()
+                                               : settings.seed,
+      ._core = internal_core_create(handle, settings.fixed_size,
+                                    settings.incremental_resize,
+                                    sizeof(com_hashtable_U64Slot))};
+}
+
+com_hashtable_U64 com_hashtable_u64_create(com_allocator_Handle handle) {
+  return com_hashtable_u64_createSettings(handle,
+                                          com_hashtable_INT_DEFAULT_SETTINGS);
+}
+
+void com_hashtable_u64_destroy(com_hashtable_U64 *ht) {
+  internal_core_destroy(&ht->_core);
+}
+
+usize com_hashtable_u64_len(const com_hashtable_U64 *ht) {
+  return internal_core_len(&ht->_core);
+}
+
+static void internal_u64_set(com_hashtable_U64 *ht, u64 key, u64 hash,
+                             void *value) {
+  u8 *slot = internal_core_upsert(&ht->_core, internal_u64_find, &key, hash,
+                                  sizeof(com_hashtable_U64Slot),
+                                  internal_u64_rehash, ht);
+  *(com_hashtable_U64Slot *)slot =
+      (com_hashtable_U64Slot){._key = key, ._value = value};
+}
+
+void com_hashtable_u64_set(com_hashtable_U64 *ht, u64 key, void *value) {
+  internal_u64_set(ht, key, com_hash_u64(ht->_seed, key), value);
+}
+
+static com_hashtable_U64Slot *internal_u64_slot(internal_Location loc) {
+  return (com_hashtable_U64Slot *)loc.storage->_slots + loc.index;
+}
+
+static com_hashtable_Result internal_u64_get(const com_hashtable_U64 *ht,
+                                             u64 key, u64 hash) {
+  internal_Location loc =
+      internal_core_locate(&ht->_core, internal_u64_find, &key, hash);
+  if (loc.storage == NULL) {
+    return (com_hashtable_Result){.valid = false};
   }
+  return (com_hashtable_Result){.valid = true,
+                                .value = internal_u64_slot(loc)->_value};
+}
+
+com_hashtable_Result com_hashtable_u64_get(const com_hashtable_U64 *ht,
+                                           u64 key) {
+  return internal_u64_get(ht, key, com_hash_u64(ht->_seed, key));
+}
+
+// the arguments of a batch operation on a u64 keyed table
+typedef struct {
+  const com_hashtable_U64 *table;
+  // the same table, only set if the batch writes to it
+  com_hashtable_U64 *mutable_table;
+  const u64 *keys;
+  void *const *values;
+  com_hashtable_Result *results;
+} internal_U64Batch;
+
+static u64 internal_u64_batch_hash(const void *batch, usize i) {
+  const internal_U64Batch *b = batch;
+  return com_hash_u64(b->table->_seed, b->keys[i]);
+}
+
+static void internal_u64_batch_get(void *batch, usize i, u64 hash) {
+  internal_U64Batch *b = batch;
+  b->results[i] = internal_u64_get(b->table, b->keys[i], hash);
+}
+
+static void internal_u64_batch_set(void *batch, usize i, u64 hash) {
+  internal_U64Batch *b = batch;
+  internal_u64_set(b->mutable_table, b->keys[i], hash, b->values[i]);
+}
+
+void com_hashtable_u64_get_batch(const com_hashtable_U64 *ht, const u64 *keys,
+                                 com_hashtable_Result *results, usize len) {
+  internal_U64Batch b = {.table = ht,
+                         .mutable_table = NULL,
+                         .keys = keys,
+                         .results = results};
+  internal_core_batch(&ht->_core, len, sizeof(com_hashtable_U64Slot),
+                      internal_u64_batch_hash, internal_u64_batch_get, &b);
+}
 
-  // if we're shrinking the buffer we can shrink it now that we've safely moved
-  // everything within the boundary
-  if (new_capacity < old_capacity) {
-    // realloc if we're shrinking the array
-    com_allocator_Handle ret = com_allocator_realloc(handle, new_capacity);
-    com_assert_m(ret.valid, "reallocation failed");
-    handle = ret;
-    buckets = com_allocator_handle_get(ret);
+void com_hashtable_u64_set_batch(com_hashtable_U64 *ht, const u64 *keys,
+                                 void *const *values, usize len) {
+  internal_U64Batch b = {
+      .table = ht, .mutable_table = ht, .keys = keys, .values = values};
+  internal_core_batch(&ht->_core, len, sizeof(com_hashtable_U64Slot),
+                      internal_u64_batch_hash, internal_u64_batch_set, &b);
+}
+
+com_hashtable_Result com_hashtable_u64_remove(com_hashtable_U64 *ht,
+                                              u64 key) {
+  internal_Location loc = internal_core_locate_for_remove(
+      &ht->_core, internal_u64_find, &key, com_hash_u64(ht->_seed, key),
+      sizeof(com_hashtable_U64Slot), internal_u64_rehash, ht);
+  if (loc.storage == NULL) {
+    return (com_hashtable_Result){.valid = false};
   }
+  com_hashtable_Result ret = (com_hashtable_Result){
+      .valid = true, .value = internal_u64_slot(loc)->_value};
+  internal_core_erase(&ht->_core, loc, sizeof(com_hashtable_U64Slot),
+                      internal_u64_rehash, ht);
+  return ret;
+}
+
+// pointer keyed table, stored as a u64 keyed table
 
-  // update all changed fields
-  ht->_buckets_handle = handle;
-  ht->_buckets = buckets;
-  ht->_buckets_capacity = new_capacity;
-  ht->_buckets_used = old_used;
-  ht->_buckets_expand_threshold =
-      (usize)(MAX_LOAD_FACTOR * (double)new_capacity);
-  ht->_buckets_shrink_threshold =
-      (usize)(MIN_LOAD_FACTOR * (double)new_capacity);
-  ht->_resize_color = new_color;
+com_hashtable_Ptr
+com_hashtable_ptr_createSettings(com_allocator_Handle handle,
+                                 com_hashtable_IntSettings settings) {
+  return (com_hashtable_Ptr){
+      ._table = com_hashtable_u64_createSettings(handle, settings)};
 }
 
-void com_hashtable_set(com_hashtable *ht, const com_str key, void *value) {
+com_hashtable_Ptr com_hashtable_ptr_create(com_allocator_Handle handle) {
+  return com_hashtable_ptr_createSettings(handle,
+                                          com_hashtable_INT_DEFAULT_SETTINGS);
+}
 
-  // if ht is fixed and we would have to insert another key and we are out of
-  // space throw an error
-  com_assert_m(!(ht->_fixed && ht->_buckets_used == ht->_buckets_capacity &&
-                 !com_hashtable_get(ht, key).valid),
-               "hashmap is out of memory");
+void com_hashtable_ptr_destroy(com_hashtable_Ptr *ht) {
+  com_hashtable_u64_destroy(&ht->_table);
+}
 
-  // if we aren't fixed, check if we need to resize and do so
-  if (!ht->_fixed) {
-    if (ht->_buckets_used + 1 > ht->_buckets_expand_threshold) {
-      internal_hashtable_resize(
-          ht, (usize)((double)(ht->_buckets_used + 1) / OPT_LOAD_FACTOR));
+usize com_hashtable_ptr_len(const com_hashtable_Ptr *ht) {
+  return com_hashtable_u64_len(&ht->_table);
+}
+
+void com_hashtable_ptr_set(com_hashtable_Ptr *ht, const void *key,
+                           void *value) {
+  com_hashtable_u64_set(&ht->_table, (usize)key, value);
+}
+
+com_hashtable_Result com_hashtable_ptr_get(const com_hashtable_Ptr *ht,
+                                           const void *key) {
+  return com_hashtable_u64_get(&ht->_table, (usize)key);
+}
+
+com_hashtable_Result com_hashtable_ptr_remove(com_hashtable_Ptr *ht,
+                                              const void *key) {
+  return com_hashtable_u64_remove(&ht->_table, (usize)key);
+}
+
+// concurrent table
+
+// The storage of a shard, followed in the same allocation by its control
+// bytes and slots
+// Only `storage._len` is written while lookups may be reading, the rest is
+// either written before the storage is published or only read by writers.
+typedef struct {
+  com_hashtable_Storage storage;
+  // how many empty slots may still be filled before the shard must resize
+  usize growth_left;
+  // the storage retired before this one
+  void *retired_next;
+} internal_ConcurrentStorage;
+
+// the storage header, rounded up so the control bytes stay group aligned
+#define CONCURRENT_HEADER_LEN                                                  \
+  ((sizeof(internal_ConcurrentStorage) + com_hashtable_GROUP_WIDTH - 1) /      \
+   com_hashtable_GROUP_WIDTH * com_hashtable_GROUP_WIDTH)
+
+static void internal_spin_lock(u32 *lock) {
+  while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE) != 0) {
+    // wait without writing, so the cache line isn't bounced between cores
+    while (__atomic_load_n(lock, __ATOMIC_RELAXED) != 0) {
+#if defined(__SSE2__)
+      __builtin_ia32_pause();
+#endif
     }
   }
+}
 
-  com_hashtable_Key keyobj = (com_hashtable_Key){
-      ._key = key, ._hash_cache = ht->_hasher(ht->_seed, key)};
+static void internal_spin_unlock(u32 *lock) {
+  __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
 
-  bool newcreated = internal_hashtable_set(ht->_buckets, ht->_buckets_capacity,
-                                           keyobj, value, ht->_resize_color);
+// the low bits of the hash pick the tag and the group, so the high bits pick
+// the shard
+static com_hashtable_ConcurrentShard *
+internal_concurrent_shard(const com_hashtable_Concurrent *ct, u64 hash) {
+  return &ct->_shared
+              ->_shards[(usize)(hash >> 56) % com_hashtable_CONCURRENT_SHARDS];
+}
 
-  if (newcreated) {
-    ht->_buckets_used++;
+// allocates an empty storage with `capacity` slots
+static internal_ConcurrentStorage *
+internal_concurrent_alloc(const com_hashtable_Concurrent *ct, usize capacity) {
+  u32 *alloc_lock = &ct->_shared->_alloc_lock;
+  internal_spin_lock(alloc_lock);
+  com_allocator_HandleData data = com_allocator_handle_query(ct->_handle);
+  com_allocator_Handle handle = com_allocator_alloc(
+      ct->_handle._allocator,
+      (com_allocator_HandleData){
+          .len = CONCURRENT_HEADER_LEN +
+                 internal_alloc_len(capacity, sizeof(com_hashtable_Slot)),
+          .flags = data.flags});
+  com_assert_m(handle.valid, "allocation failed");
+  u8 *base = com_allocator_handle_get(handle);
+  internal_spin_unlock(alloc_lock);
+
+  u8 *ctrl = base + CONCURRENT_HEADER_LEN;
+  com_mem_set(ctrl, capacity, CTRL_EMPTY);
+  internal_ConcurrentStorage *cs = (internal_ConcurrentStorage *)base;
+  *cs = (internal_ConcurrentStorage){
+      .storage = {._handle = handle,
+                  ._ctrl = ctrl,
+                  ._slots = ctrl + capacity,
+                  ._capacity = capacity,
+                  ._len = 0},
+      .growth_left = internal_max_load(capacity),
+      .retired_next = NULL};
+  return cs;
+}
+
+static com_hashtable_Slot *
+internal_concurrent_slots(const internal_ConcurrentStorage *cs) {
+  return (com_hashtable_Slot *)cs->storage._slots;
+}
+
+// copies the control bytes of a group that writers may be modifying
+// group starts are 8 byte aligned, so this takes two atomic loads
+static void internal_concurrent_load_group(const u8 *ctrl, u8 *out) {
+  for (usize w = 0; w < com_hashtable_GROUP_WIDTH / sizeof(u64); w++) {
+    u64 word = __atomic_load_n((const u64 *)ctrl + w, __ATOMIC_RELAXED);
+    __builtin_memcpy(out + w * sizeof(u64), &word, sizeof(u64));
   }
 }
 
-com_hashtable_Result com_hashtable_get(const com_hashtable *ht,
-                                       const com_str key) {
-  const com_hashtable_Key keyobj = (com_hashtable_Key){
-      ._key = key, ._hash_cache = ht->_hasher(ht->_seed, key)};
-
-  usize probe_count = 0;
-  while (true) {
-    // we use linear probing
-    usize i = keyobj._hash_cache + probe_count;
-    com_hashtable_Bucket *b = &ht->_buckets[i % ht->_buckets_capacity];
-
-    // if we encounter an uninitialized value we can end our search since
-    // the linear probing pattern we use always places the key-value pair in the
-    // first uninitialized bucket
-    if (!b->_initialized) {
-      return (com_hashtable_Result){.valid = false};
-    } else {
-      if (internal_key_eq(keyobj, b->_pair._key)) {
-        return (com_hashtable_Result){.valid = true, .value = b->_pair._value};
-      } else {
-        probe_count++;
-        // if we've checked all spaces (possible only on a fully filled hashmap)
-        if (probe_count < ht->_buckets_capacity) {
-          return (com_hashtable_Result){.valid = false};
-        }
+// returns the index of the slot of `cs` holding `key`, or NOT_FOUND
+// safe to call while a writer is modifying `cs`
+static usize internal_concurrent_find(const internal_ConcurrentStorage *cs,
+                                      const com_str key, u64 hash) {
+  const com_hashtable_Storage *st = &cs->storage;
+  const com_hashtable_Slot *slots = internal_concurrent_slots(cs);
+  u8 tag = internal_h2(hash);
+  ProbeSeq seq = internal_probe_start(st, hash);
+  u8 group[com_hashtable_GROUP_WIDTH];
+  do {
+    internal_concurrent_load_group(internal_probe_ctrl(st, &seq), group);
+    for (GroupMask m = internal_group_match(group, tag); m != 0; m &= m - 1) {
+      usize i = internal_probe_slot(&seq, m);
+      // the group was read without synchronizing, so make sure the slot has
+      // been published before reading its key
+      if (__atomic_load_n(&st->_ctrl[i], __ATOMIC_ACQUIRE) == tag &&
+          com_str_equal(slots[i]._key, key)) {
+        return i;
       }
     }
+  } while (internal_probe_continue(group, &seq));
+  return NOT_FOUND;
+}
+
+// returns the first empty slot in the probe sequence of `hash`
+// deleted slots are never refilled, as a lookup may still be reading the key
+static usize
+internal_concurrent_find_empty(const internal_ConcurrentStorage *cs,
+                               u64 hash) {
+  ProbeSeq seq = internal_probe_start(&cs->storage, hash);
+  do {
+    GroupMask m =
+        internal_group_match_empty(internal_probe_ctrl(&cs->storage, &seq));
+    if (m != 0) {
+      return internal_probe_slot(&seq, m);
+    }
+  } while (internal_probe_next(&seq));
+  return NOT_FOUND;
+}
+
+// fills an empty slot of an unpublished storage, or of a published storage
+// with the shard locked
+static void internal_concurrent_insert_at(internal_ConcurrentStorage *cs,
+                                          usize i, u64 hash, const com_str key,
+                                          void *value) {
+  internal_concurrent_slots(cs)[i] =
+      (com_hashtable_Slot){._key = key, ._value = value};
+  cs->growth_left--;
+  // publish the slot after its contents
+  __atomic_store_n(&cs->storage._ctrl[i], internal_h2(hash), __ATOMIC_RELEASE);
+  __atomic_fetch_add(&cs->storage._len, 1, __ATOMIC_RELAXED);
+}
+
+// replaces the storage of a locked shard with a larger one, or one without
+// deleted slots, and returns it
+// the old storage is kept until destroy, as lookups may still be reading it
+static internal_ConcurrentStorage *
+internal_concurrent_resize(const com_hashtable_Concurrent *ct,
+                           com_hashtable_ConcurrentShard *shard,
+                           internal_ConcurrentStorage *old) {
+  usize len = old->storage._len;
+  usize capacity = internal_capacity_for_entries(len + 1);
+  if (capacity < old->storage._capacity) {
+    capacity = old->storage._capacity;
+  } else if (capacity == old->storage._capacity &&
+             len + 1 > internal_max_load(capacity) / 2) {
+    capacity *= 2;
   }
+
+  internal_ConcurrentStorage *cs = internal_concurrent_alloc(ct, capacity);
+  const com_hashtable_Slot *slots = internal_concurrent_slots(old);
+  for (usize i = 0; i < old->storage._capacity; i++) {
+    if (old->storage._ctrl[i] < CTRL_EMPTY) {
+      u64 hash = ct->_hasher(ct->_seed, slots[i]._key);
+      usize j = internal_concurrent_find_empty(cs, hash);
+      internal_concurrent_insert_at(cs, j, hash, slots[i]._key,
+                                    slots[i]._value);
+    }
+  }
+
+  old->retired_next = shard->_retired;
+  shard->_retired = old;
+  __atomic_store_n(&shard->_storage, cs, __ATOMIC_RELEASE);
+  return cs;
 }
 
-static com_hashtable_Result
-internal_hashtable_remove(com_hashtable_Bucket *buckets, usize buckets_capacity,
-                          const com_hashtable_Key key) {
-  usize probe_count = 0;
-  while (true) {
-    // we use linear probing
-    usize i = key._hash_cache + probe_count;
-    com_hashtable_Bucket *b = &buckets[i % buckets_capacity];
+com_hashtable_Concurrent
+com_hashtable_concurrent_createSettings(com_allocator_Handle handle,
+                                        com_hashtable_Settings settings) {
+  com_assert_m(!settings.fixed_size,
+               "a concurrent hashtable can't have a fixed size");
+  if (com_allocator_handle_query(handle).len <
+      sizeof(com_hashtable_ConcurrentShared)) {
+    handle =
+        com_allocator_realloc(handle, sizeof(com_hashtable_ConcurrentShared));
+    com_assert_m(handle.valid, "reallocation failed");
+  }
 
-    // if we encounter an uninitialized value we can end our search since
-    // the linear probing pattern we use always places the key-value pair in the
-    // first uninitialized bucket
-    if (!b->_initialized) {
-      return (com_hashtable_Result){.valid = false};
-    } else {
-      if (internal_key_eq(key, b->_pair._key)) {
-        // save the value
-        com_hashtable_Result ret =
-            (com_hashtable_Result){.valid = true, .value = b->_pair._value};
-
-        // deinitialize this bucket
-        b->_initialized = false;
-
-        while (true) {
-          // get the previous and current bucket
-          com_hashtable_Bucket *prev = &buckets[i % buckets_capacity];
-          com_hashtable_Bucket *current = &buckets[(i + 1) % buckets_capacity];
-          if (!current->_initialized || current->_pair._probe_count == 0) {
-            // if the next bucket isn't initialized  or has a zero probe cout
-            // then we've hit the end of the probing sequence and  can exit
-            break;
-          } else {
-            // otherwise it's part of the probing sequence and we can move it
-            // back one slot while decrementing the probe count
-            *prev = *current;
-            prev->_pair._probe_count--;
-            i++;
-          }
-        }
-
-        return ret;
-      } else {
-        probe_count++;
-        // if we've checked all spaces (possible only on a fully filled hashmap)
-        if (probe_count < buckets_capacity) {
-          return (com_hashtable_Result){.valid = false};
-        }
-      }
+  com_hashtable_Concurrent ct = (com_hashtable_Concurrent){
+      ._hasher = settings.hasher,
+      ._seed = settings.randomly_generate_seed ? internal_random_seed()
+                                               : settings.seed,
+      ._handle = handle,
+      ._shared = com_allocator_handle_get(handle)};
+  ct._shared->_alloc_lock = 0;
+  for (usize i = 0; i < com_hashtable_CONCURRENT_SHARDS; i++) {
+    ct._shared->_shards[i] = (com_hashtable_ConcurrentShard){
+        ._lock = 0,
+        ._storage = internal_concurrent_alloc(&ct, com_hashtable_GROUP_WIDTH),
+        ._retired = NULL};
+  }
+  return ct;
+}
+
+com_hashtable_Concurrent
+com_hashtable_concurrent_create(com_allocator_Handle handle) {
+  return com_hashtable_concurrent_createSettings(
+      handle, com_hashtable_DEFAULT_SETTINGS);
+}
+
+void com_hashtable_concurrent_destroy(com_hashtable_Concurrent *ct) {
+  for (usize i = 0; i < com_hashtable_CONCURRENT_SHARDS; i++) {
+    com_hashtable_ConcurrentShard *shard = &ct->_shared->_shards[i];
+    internal_ConcurrentStorage *cs = shard->_storage;
+    com_allocator_dealloc(cs->storage._handle);
+    while (shard->_retired != NULL) {
+      cs = shard->_retired;
+      shard->_retired = cs->retired_next;
+      com_allocator_dealloc(cs->storage._handle);
     }
   }
+  com_allocator_dealloc(ct->_handle);
 }
 
-com_hashtable_Result com_hashtable_remove(com_hashtable *ht,
-                                          const com_str key) {
-  const com_hashtable_Key keyobj = (com_hashtable_Key){
-      ._key = key, ._hash_cache = ht->_hasher(ht->_seed, key)};
-  com_hashtable_Result ret =
-      internal_hashtable_remove(ht->_buckets, ht->_buckets_capacity, keyobj);
-
-  // update metadata
-  if (ret.valid) {
-    // means we managed to take one out
-    ht->_buckets_used--;
-
-    if (!ht->_fixed && ht->_buckets_used < ht->_buckets_shrink_threshold) {
-      internal_hashtable_resize(
-          ht, (usize)((double)ht->_buckets_used / OPT_LOAD_FACTOR));
+usize com_hashtable_concurrent_len(const com_hashtable_Concurrent *ct) {
+  usize len = 0;
+  for (usize i = 0; i < com_hashtable_CONCURRENT_SHARDS; i++) {
+    internal_ConcurrentStorage *cs =
+        __atomic_load_n(&ct->_shared->_shards[i]._storage, __ATOMIC_ACQUIRE);
+    len += __atomic_load_n(&cs->storage._len, __ATOMIC_RELAXED);
+  }
+  return len;
+}
+
+void com_hashtable_concurrent_set(com_hashtable_Concurrent *ct,
+                                  const com_str key, void *value) {
+  u64 hash = ct->_hasher(ct->_seed, key);
+  com_hashtable_ConcurrentShard *shard = internal_concurrent_shard(ct, hash);
+  internal_spin_lock(&shard->_lock);
+
+  // only writers replace the storage, and they hold the lock
+  internal_ConcurrentStorage *cs = shard->_storage;
+  usize i = internal_concurrent_find(cs, key, hash);
+  if (i != NOT_FOUND) {
+    __atomic_store_n(&internal_concurrent_slots(cs)[i]._value, value,
+                     __ATOMIC_RELEASE);
+  } else {
+    if (cs->growth_left == 0) {
+      cs = internal_concurrent_resize(ct, shard, cs);
     }
+    internal_concurrent_insert_at(cs, internal_concurrent_find_empty(cs, hash),
+                                  hash, key, value);
   }
+
+  internal_spin_unlock(&shard->_lock);
+}
+
+com_hashtable_Result
+com_hashtable_concurrent_get(const com_hashtable_Concurrent *ct,
+                             const com_str key) {
+  u64 hash = ct->_hasher(ct->_seed, key);
+  const internal_ConcurrentStorage *cs = __atomic_load_n(
+      &internal_concurrent_shard(ct, hash)->_storage, __ATOMIC_ACQUIRE);
+  usize i = internal_concurrent_find(cs, key, hash);
+  if (i == NOT_FOUND) {
+    return (com_hashtable_Result){.valid = false};
+  }
+  return (com_hashtable_Result){
+      .valid = true,
+      .value = __atomic_load_n(&internal_concurrent_slots(cs)[i]._value,
+                               __ATOMIC_ACQUIRE)};
+}
+
+com_hashtable_Result
+com_hashtable_concurrent_remove(com_hashtable_Concurrent *ct,
+                                const com_str key) {
+  u64 hash = ct->_hasher(ct->_seed, key);
+  com_hashtable_ConcurrentShard *shard = internal_concurrent_shard(ct, hash);
+  internal_spin_lock(&shard->_lock);
+
+  internal_ConcurrentStorage *cs = shard->_storage;
+  com_hashtable_Result ret = (com_hashtable_Result){.valid = false};
+  usize i = internal_concurrent_find(cs, key, hash);
+  if (i != NOT_FOUND) {
+    ret = (com_hashtable_Result){
+        .valid = true, .value = internal_concurrent_slots(cs)[i]._value};
+    // always a tombstone, so the slot isn't refilled while being read
+    __atomic_store_n(&cs->storage._ctrl[i], CTRL_DELETED, __ATOMIC_RELEASE);
+    __atomic_fetch_sub(&cs->storage._len, 1, __ATOMIC_RELAXED);
+  }
+
+  internal_spin_unlock(&shard->_lock);
   return ret;
 }
@@ -1,47 +1,87 @@
 #ifndef COM_HASHTABLE_H
 #define COM_HASHTABLE_H
 
-// somewhat fast robin hood open addressing linear probing hashtable
-// hashmap owns keys but only stores a pointer to the value
+// open addressing hashtable with one control byte per slot
+// slots are probed a group at a time: the control bytes of a group are
+// compared against the tag of the hash at once (with SSE2 where available), so
+// only slots whose tag matches need their key compared
+// hashmap stores the key as provided (without copying it) and a pointer to the
+// value
 
 #include "com_allocator.h"
 #include "com_define.h"
 #include "com_hash.h"
 #include "com_str.h"
+#include "com_vec.h"
+
+// number of slots whose control bytes are scanned together
+#define com_hashtable_GROUP_WIDTH 16
 
 typedef struct {
   bool valid;
   void *value;
 } com_hashtable_Result;
 
-// the key, a cache of its hash and a handle for the memory allocated for it
 typedef struct {
-  u64 _hash_cache;
   com_str _key;
-} com_hashtable_Key;
+  // pointer to the value
+  void *_value;
+} com_hashtable_Slot;
 
 typedef struct {
-  com_hashtable_Key _key;
+  u64 _key;
   // pointer to the value
   void *_value;
+} com_hashtable_U64Slot;
+
+// One allocation of control bytes and slots
+// Do not manually modify
+typedef struct {
+  // memory allocation for `_ctrl` and `_slots`
+  com_allocator_Handle _handle;
+
+  // one control byte per slot: empty, deleted, or the low 7 bits of the hash
+  // of the key in the slot
+  u8 *_ctrl;
+  // where the key value pairs are stored, each slot is the same size
+  u8 *_slots;
+  // number of slots, a power of two multiple of com_hashtable_GROUP_WIDTH
+  usize _capacity;
+  // how many slots are currently full
+  usize _len;
+} com_hashtable_Storage;
+
+// Storage and probing state shared by every kind of hashtable
+// Do not manually modify
+typedef struct {
+  // where new entries are inserted
+  com_hashtable_Storage _cur;
+  // how many empty slots of `_cur` may still be filled before we must resize
+  usize _growth_left;
 
-  // how many probes were necessary to create this
-  usize _probe_count;
-} com_hashtable_KeyValuePair;
+  // if an incremental resize is in progress
+  bool _migrating;
+  // while migrating, the storage whose entries are being moved to `_cur`
+  com_hashtable_Storage _old;
+  // while migrating, the index of the next group of `_old` to move
+  usize _migrate_group;
 
-// the color is used when resizing the table in place
-// it ensures that we don't waste time checking if elements are in the right
-// place
-typedef enum {
-  com_hashtable_RED,
-  com_hashtable_BLUE,
-} com_hashtable_ResizeColor;
+  // if we're allowed to expand or shrink the hashmap
+  bool _fixed;
+  // if resizes are spread across later operations
+  bool _incremental;
+} com_hashtable_Core;
 
+// an entry of an ordered table
 typedef struct {
-  bool _initialized;
-  com_hashtable_ResizeColor _resize_color;
-  com_hashtable_KeyValuePair _pair;
-} com_hashtable_Bucket;
+  com_str _key;
+  // pointer to the value
+  void *_value;
+  // hash of the key, so the index can be rebuilt without rehashing
+  u64 _hash;
+  // if the entry has been removed, and is waiting to be compacted away
+  bool _removed;
+} com_hashtable_Entry;
 
 // Do not manually modify
 typedef struct {
@@ -51,35 +91,38 @@ typedef struct {
   // the seed for this particular table hasher
   u64 _seed;
 
-  // memory allocation for `_buckets`
-  com_allocator_Handle _buckets_handle;
-
-  // where the key value pairs are stored
-  com_hashtable_Bucket *_buckets;
-  // how many buckets are avaliable in `_buckets`
-  usize _buckets_capacity;
-  // how many buckets are currently initialized
-  usize _buckets_used;
-
-  // the number of buckets used above which we must expand
-  usize _buckets_expand_threshold;
-
-  // the number of buckets used below which we must shrink
-  usize _buckets_shrink_threshold;
+  // the slots are com_hashtable_Slot, or if the table is ordered, the usize
+  // index of an entry in `_entries`
+  com_hashtable_Core _core;
 
-  // current resizing color (will swap everytime the buckets are resized)
-  com_hashtable_ResizeColor _resize_color;
-
-  // if we're allowed to expand or shrink the hashmap
-  bool _fixed;
+  // if entries are kept in insertion order
+  bool _ordered;
+  // Vector<com_hashtable_Entry> in insertion order, only used if ordered
+  com_vec _entries;
+  // how many entries of `_entries` have been removed
+  usize _removed;
 } com_hashtable;
 
 typedef struct {
   // if the hashtable is allowed to expand
   bool fixed_size;
 
+  // if resizing should move a few entries per set or remove, instead of all
+  // entries at once
+  // this bounds the worst case time of every operation, at the cost of lookups
+  // having to check two tables while a resize is in progress
+  bool incremental_resize;
+
+  // if iteration should visit the KV pairs in the order they were first
+  // inserted
+  // the pairs are then stored densely apart from the table, which makes
+  // iteration fast and deterministic, at the cost of an indirection per lookup
+  bool ordered;
+
   // hasher function to use
-  // sip is reccomended for security from DOS, although fnv1a may be faster
+  // sip is reccomended for security from DOS, although wyhash (with a random
+  // seed) is much faster on short keys, and fnv1a may be faster still on keys
+  // of a few bytes
   com_hash_fn hasher;
 
   // whether to randomly generate the seed for the hasher fn
@@ -92,10 +135,16 @@ typedef struct {
 
 #define com_hashtable_DEFAULT_SETTINGS                                         \
   ((com_hashtable_Settings){.fixed_size = false,                               \
+                            .incremental_resize = false,                       \
+                            .ordered = false,                                  \
                             .hasher = com_hash_sip,                            \
                             .randomly_generate_seed = true,                    \
                             .seed = 1})
 
+// number of bytes of memory a table needs per slot
+// useful for sizing the handle of a fixed size table
+#define com_hashtable_SLOT_BYTES (1 + sizeof(com_hashtable_Slot))
+
 // Creates a hashtable using memory allocated from `a` with default capacity
 /// REQUIRES: `a` is a valid pointer to an allocator with REALLOCABLE supported
 /// GUARANTEES: returns a valid com_hashtable
@@ -104,7 +153,11 @@ com_hashtable com_hashtable_create(com_allocator_Handle handle);
 // Creates a hashtable using memory allocated from `a` with a settings
 /// REQUIRES: `a` is a valid pointer to an allocator
 /// REQUIRES: `settings` is a valid com_hashtable_settings
+/// REQUIRES: if `settings.fixed_size` is set, `handle` has room for at least
+/// com_hashtable_GROUP_WIDTH slots
 /// GUARANTEES: returns a valid com_hashtable adhering to the settings provided
+/// GUARANTEES: if the table may grow, new memory is allocated from the
+/// allocator of `handle`, with the same flags as `handle`
 com_hashtable com_hashtable_createSettings(com_allocator_Handle handle,
                                            com_hashtable_Settings settings);
 
@@ -117,36 +170,328 @@ void com_hashtable_destroy(com_hashtable *table);
 
 // Adds or inserts a new K V pair to the hashtable
 /// REQUIRES: `table` is a valid pointer to a com_hashtable
-/// REQUIRES: `key` is a valid com_str
+/// REQUIRES: `key` is a valid com_str that outlives its KV pair
 /// REQUIRES: `value` is a pointer (does not have to be valid)
-/// GUARANTEES: if a KV pair with `key` doesn't exist, a KV pair will be
-/// created, and the value of `key` will be copied GUARANTEES: if not, the value
-/// of `key` will not by copied
 /// GUARANTEES: if a KV pair with `key` doesn't exist, a new entry in the hash
-/// table will be created GUARANTEES: if not, the KV pair with key `key` will
-/// have its value erased
+/// table will be created
+/// GUARANTEES: if not, the KV pair with key `key` will have its value replaced
 void com_hashtable_set(com_hashtable *hashtable, const com_str key,
                        void *value);
 
 // out of the KV Pair with key `key`, returns a the value if it exists
 /// REQUIRES: `table` is a valid pointer to a com_hashtable
-/// REQUIRES: `key` is a valid pointer to `keylen` bytes of memory
-/// REQUIRES: `keylen` is greater than 0
-/// REQUIRES: `value` is a valid pointer to `valuelen` bytes of memory
+/// REQUIRES: `key` is a valid com_str
 /// GUARANTEES: returns the pointer stored in the KV pair or a .valid=false
-/// GUARANTEES: this pointer is valid until the next operation on `table`
 com_hashtable_Result com_hashtable_get(const com_hashtable *table,
                                        const com_str key);
 
+// looks up `len` keys at once, which is faster than separate gets when the
+// table doesn't fit in cache, as the memory accesses of the keys overlap
+/// REQUIRES: `table` is a valid pointer to a com_hashtable
+/// REQUIRES: `keys` is a valid pointer to `len` valid com_strs
+/// REQUIRES: `results` is a valid pointer to room for `len` results
+/// GUARANTEES: `results[i]` is what com_hashtable_get would return for
+/// `keys[i]`
+void com_hashtable_get_batch(const com_hashtable *table, const com_str *keys,
+                             com_hashtable_Result *results, usize len);
+
+// sets `len` KV pairs at once, overlapping their memory accesses
+/// REQUIRES: `table` is a valid pointer to a com_hashtable
+/// REQUIRES: `keys` is a valid pointer to `len` valid com_strs that outlive
+/// their KV pairs
+/// REQUIRES: `values` is a valid pointer to `len` pointers
+/// GUARANTEES: the same as calling com_hashtable_set on each pair in order
+void com_hashtable_set_batch(com_hashtable *table, const com_str *keys,
+                             void *const *values, usize len);
+
 // deletes the KV pair with key `key` from `table`
 /// REQUIRES: `table` is a valid pointer to a com_hashtable.
-/// REQUIRES: `key` is a valid pointer to `keylen` bytes
-/// REQUIRES: `keylen` is greater than 0
-/// REQUIRES: a KV pair with key `key` exists
-/// GUARANTEES: memory for the key and the value will be deallocated
+/// REQUIRES: `key` is a valid com_str
 /// GUARANTEES: there are no KV pairs with key `key`
 /// GUARANTEES: returns the pointer stored in the KV pair or a .valid=false
 com_hashtable_Result com_hashtable_remove(com_hashtable *table,
                                           const com_str key);
 
+// returns the number of KV pairs in `table`
+/// REQUIRES: `table` is a valid pointer to a com_hashtable
+usize com_hashtable_len(const com_hashtable *table);
+
+typedef struct {
+  bool valid;
+  com_str key;
+  void *value;
+} com_hashtable_IterResult;
+
+// Do not manually modify
+typedef struct {
+  const com_hashtable *_table;
+  // the next entry, or the next slot of the old storage and then of the
+  // current storage
+  usize _index;
+} com_hashtable_Iter;
+
+// Creates an iterator over the KV pairs of `table`
+// ordered tables are iterated in insertion order, others in an order that
+// depends on the seed and the history of the table
+/// REQUIRES: `table` is a valid pointer to a com_hashtable
+/// GUARANTEES: returns a com_hashtable_Iter that is valid until `table` is
+/// next modified
+com_hashtable_Iter com_hashtable_iter(const com_hashtable *table);
+
+// returns the next KV pair, or .valid=false once all of them have been visited
+/// REQUIRES: `iter` is a valid pointer to a valid com_hashtable_Iter
+com_hashtable_IterResult com_hashtable_iter_next(com_hashtable_Iter *iter);
+
+// Hashtables keyed by integers and pointers
+// The keys are hashed with com_hash_u64 instead of a com_str hasher, and
+// compared with a single comparison. Keys are stored in the table.
+// u32 keys (interned symbols, node ids...) should use the u64 table, as the
+// slot is padded to the same size either way.
+
+// Do not manually modify
+typedef struct {
+  // the seed for com_hash_u64
+  u64 _seed;
+
+  // the slots are com_hashtable_U64Slot
+  com_hashtable_Core _core;
+} com_hashtable_U64;
+
+// Do not manually modify
+typedef struct {
+  // the pointer keys are stored as u64
+  com_hashtable_U64 _table;
+} com_hashtable_Ptr;
+
+typedef struct {
+  // if the hashtable is allowed to expand
+  bool fixed_size;
+
+  // if resizing should move a few entries per set or remove, instead of all
+  // entries at once
+  bool incremental_resize;
+
+  // whether to randomly generate the seed for the hasher fn
+  bool randomly_generate_seed;
+
+  // seed for the hasher function
+  // ignored if randomly_generate_seed is true
+  u64 seed;
+} com_hashtable_IntSettings;
+
+#define com_hashtable_INT_DEFAULT_SETTINGS                                     \
+  ((com_hashtable_IntSettings){.fixed_size = false,                            \
+                               .incremental_resize = false,                    \
+                               .randomly_generate_seed = true,                 \
+                               .seed = 1})
+
+// number of bytes of memory an integer or pointer keyed table needs per slot
+#define com_hashtable_U64_SLOT_BYTES (1 + sizeof(com_hashtable_U64Slot))
+
+// Creates a u64 keyed hashtable using memory allocated from `a`
+/// REQUIRES: `a` is a valid pointer to an allocator with REALLOCABLE supported
+/// GUARANTEES: returns a valid com_hashtable_U64
+com_hashtable_U64 com_hashtable_u64_create(com_allocator_Handle handle);
+
+// Creates a u64 keyed hashtable using memory allocated from `a` with settings
+/// REQUIRES: `a` is a valid pointer to an allocator
+/// REQUIRES: `settings` is a valid com_hashtable_IntSettings
+/// REQUIRES: if `settings.fixed_size` is set, `handle` has room for at least
+/// com_hashtable_GROUP_WIDTH slots
+/// GUARANTEES: returns a valid com_hashtable_U64 adhering to the settings
+com_hashtable_U64
+com_hashtable_u64_createSettings(com_allocator_Handle handle,
+                                 com_hashtable_IntSettings settings);
+
+// frees all memory associated with this hashtable
+/// REQUIRES: `table` is a pointer to a valid com_hashtable_U64
+/// GUARANTEES: `table` is no longer valid
+void com_hashtable_u64_destroy(com_hashtable_U64 *table);
+
+// Adds or inserts a new K V pair to the hashtable
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_U64
+/// REQUIRES: `value` is a pointer (does not have to be valid)
+/// GUARANTEES: the KV pair with key `key` has value `value`
+void com_hashtable_u64_set(com_hashtable_U64 *table, u64 key, void *value);
+
+// out of the KV Pair with key `key`, returns a the value if it exists
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_U64
+/// GUARANTEES: returns the pointer stored in the KV pair or a .valid=false
+com_hashtable_Result com_hashtable_u64_get(const com_hashtable_U64 *table,
+                                           u64 key);
+
+// looks up `len` keys at once, overlapping their memory accesses
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_U64
+/// REQUIRES: `keys` is a valid pointer to `len` keys
+/// REQUIRES: `results` is a valid pointer to room for `len` results
+/// GUARANTEES: `results[i]` is what com_hashtable_u64_get would return for
+/// `keys[i]`
+void com_hashtable_u64_get_batch(const com_hashtable_U64 *table,
+                                 const u64 *keys,
+                                 com_hashtable_Result *results, usize len);
+
+// sets `len` KV pairs at once, overlapping their memory accesses
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_U64
+/// REQUIRES: `keys` is a valid pointer to `len` keys
+/// REQUIRES: `values` is a valid pointer to `len` pointers
+/// GUARANTEES: the same as calling com_hashtable_u64_set on each pair in order
+void com_hashtable_u64_set_batch(com_hashtable_U64 *table, const u64 *keys,
+                                 void *const *values, usize len);
+
+// deletes the KV pair with key `key` from `table`
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_U64
+/// GUARANTEES: there are no KV pairs with key `key`
+/// GUARANTEES: returns the pointer stored in the KV pair or a .valid=false
+com_hashtable_Result com_hashtable_u64_remove(com_hashtable_U64 *table,
+                                              u64 key);
+
+// returns the number of KV pairs in `table`
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_U64
+usize com_hashtable_u64_len(const com_hashtable_U64 *table);
+
+// Creates a pointer keyed hashtable using memory allocated from `a`
+/// REQUIRES: `a` is a valid pointer to an allocator with REALLOCABLE supported
+/// GUARANTEES: returns a valid com_hashtable_Ptr
+com_hashtable_Ptr com_hashtable_ptr_create(com_allocator_Handle handle);
+
+// Creates a pointer keyed hashtable using memory allocated from `a` with
+// settings
+/// REQUIRES: `a` is a valid pointer to an allocator
+/// REQUIRES: `settings` is a valid com_hashtable_IntSettings
+/// REQUIRES: if `settings.fixed_size` is set, `handle` has room for at least
+/// com_hashtable_GROUP_WIDTH slots
+/// GUARANTEES: returns a valid com_hashtable_Ptr adhering to the settings
+com_hashtable_Ptr
+com_hashtable_ptr_createSettings(com_allocator_Handle handle,
+                                 com_hashtable_IntSettings settings);
+
+// frees all memory associated with this hashtable
+/// REQUIRES: `table` is a pointer to a valid com_hashtable_Ptr
+/// GUARANTEES: `table` is no longer valid
+void com_hashtable_ptr_destroy(com_hashtable_Ptr *table);
+
+// Adds or inserts a new K V pair to the hashtable
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_Ptr
+/// REQUIRES: `key` and `value` are pointers (do not have to be valid)
+/// GUARANTEES: the KV pair with key `key` has value `value`
+void com_hashtable_ptr_set(com_hashtable_Ptr *table, const void *key,
+                           void *value);
+
+// out of the KV Pair with key `key`, returns a the value if it exists
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_Ptr
+/// GUARANTEES: returns the pointer stored in the KV pair or a .valid=false
+com_hashtable_Result com_hashtable_ptr_get(const com_hashtable_Ptr *table,
+                                           const void *key);
+
+// deletes the KV pair with key `key` from `table`
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_Ptr
+/// GUARANTEES: there are no KV pairs with key `key`
+/// GUARANTEES: returns the pointer stored in the KV pair or a .valid=false
+com_hashtable_Result com_hashtable_ptr_remove(com_hashtable_Ptr *table,
+                                              const void *key);
+
+// returns the number of KV pairs in `table`
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_Ptr
+usize com_hashtable_ptr_len(const com_hashtable_Ptr *table);
+
+// Concurrent hashtable keyed by com_str
+// Lookups take no locks, and may run at the same time as each other and as
+// writes from other threads. Writes lock one of com_hashtable_CONCURRENT_SHARDS
+// shards, picked by the hash of the key, so writes of different keys rarely
+// wait on each other.
+// Slots are never reused, and storage replaced by a resize is kept until the
+// table is destroyed, so a lookup never sees a key being overwritten or memory
+// being freed. Removed slots are reclaimed by the next resize, and a table
+// never shrinks, which suits interners and symbol tables that mostly grow.
+// The table must not be moved while it is shared.
+
+// number of independently locked parts of a concurrent table
+#define com_hashtable_CONCURRENT_SHARDS 16
+
+// Do not manually modify
+typedef struct {
+  // spinlock held by writers to this shard
+  u32 _lock;
+  // the storage lookups read, replaced when resized
+  void *_storage;
+  // linked list of storage replaced by resizes
+  void *_retired;
+} com_hashtable_ConcurrentShard;
+
+// Do not manually modify
+typedef struct {
+  // spinlock held while calling the allocator, which needn't be thread safe
+  u32 _alloc_lock;
+  com_hashtable_ConcurrentShard _shards[com_hashtable_CONCURRENT_SHARDS];
+} com_hashtable_ConcurrentShared;
+
+// Do not manually modify
+typedef struct {
+  // hasher fn
+  com_hash_fn _hasher;
+
+  // the seed for this particular table hasher
+  u64 _seed;
+
+  // memory allocation for `_shared`
+  com_allocator_Handle _handle;
+
+  // state shared between threads
+  com_hashtable_ConcurrentShared *_shared;
+} com_hashtable_Concurrent;
+
+// Creates a concurrent hashtable using memory allocated from `a`
+/// REQUIRES: `a` is a valid pointer to an allocator with REALLOCABLE supported
+/// GUARANTEES: returns a valid com_hashtable_Concurrent
+com_hashtable_Concurrent
+com_hashtable_concurrent_create(com_allocator_Handle handle);
+
+// Creates a concurrent hashtable using memory allocated from `a` with settings
+/// REQUIRES: `a` is a valid pointer to an allocator with REALLOCABLE supported
+/// REQUIRES: `settings` is a valid com_hashtable_settings
+/// REQUIRES: `settings.fixed_size` is false
+/// GUARANTEES: returns a valid com_hashtable_Concurrent adhering to the
+/// settings provided, except `incremental_resize`, which is ignored
+com_hashtable_Concurrent
+com_hashtable_concurrent_createSettings(com_allocator_Handle handle,
+                                        com_hashtable_Settings settings);
+
+// frees all memory associated with this hashtable
+/// REQUIRES: `table` is a pointer to a valid com_hashtable_Concurrent
+/// REQUIRES: no other thread is using `table`
+/// GUARANTEES: `table` is no longer valid
+void com_hashtable_concurrent_destroy(com_hashtable_Concurrent *table);
+
+// Adds or inserts a new K V pair to the hashtable
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_Concurrent
+/// REQUIRES: `key` is a valid com_str that outlives `table`
+/// REQUIRES: `value` is a pointer (does not have to be valid)
+/// GUARANTEES: the KV pair with key `key` has value `value`
+/// GUARANTEES: a lookup that sees `value` also sees all writes made by this
+/// thread before the set
+void com_hashtable_concurrent_set(com_hashtable_Concurrent *table,
+                                  const com_str key, void *value);
+
+// out of the KV Pair with key `key`, returns a the value if it exists
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_Concurrent
+/// REQUIRES: `key` is a valid com_str
+/// GUARANTEES: returns the pointer stored in the KV pair or a .valid=false
+com_hashtable_Result
+com_hashtable_concurrent_get(const com_hashtable_Concurrent *table,
+                             const com_str key);
+
+// deletes the KV pair with key `key` from `table`
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_Concurrent
+/// REQUIRES: `key` is a valid com_str
+/// GUARANTEES: there are no KV pairs with key `key`
+/// GUARANTEES: returns the pointer stored in the KV pair or a .valid=false
+com_hashtable_Result
+com_hashtable_concurrent_remove(com_hashtable_Concurrent *table,
+                                const com_str key);
+
+// returns the number of KV pairs in `table`
+// if other threads are writing, the count may already be out of date
+/// REQUIRES: `table` is a valid pointer to a com_hashtable_Concurrent
+usize com_hashtable_concurrent_len(const com_hashtable_Concurrent *table);
+
 #endif
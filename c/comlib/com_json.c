@@ -2,7 +2,9 @@
 #include "com_assert.h"
 #include "com_fmath.h"
 #include "com_format.h"
+#include "com_mem.h"
 #include "com_scan.h"
+#include "com_strcopy.h"
 #include "com_writer_null.h"
 #include "com_writer_vec.h"
 
@@ -13,228 +15,285 @@ static void com_json_emitStr(com_writer *writer, com_str str) {
   com_writer_append_u8(writer, '\"');
 }
 
-static void com_json_emitElem(com_writer *writer, com_json_Elem *j);
+com_json_Writer com_json_writerCreate(com_writer *writer) {
+  return (com_json_Writer){._writer = writer, ._needs_comma = false, ._depth = 0};
+}
+
+// writes the separator that must come before the next key or value
+static void com_json_emitSeparator(com_json_Writer *w) {
+  if (w->_needs_comma) {
+    com_writer_append_u8(w->_writer, ',');
+  }
+}
+
+void com_json_beginObj(com_json_Writer *w) {
+  com_json_emitSeparator(w);
+  com_writer_append_u8(w->_writer, '{');
+  w->_needs_comma = false;
+  w->_depth++;
+}
+
+void com_json_endObj(com_json_Writer *w) {
+  com_assert_m(w->_depth > 0, "no open object to end");
+  com_writer_append_u8(w->_writer, '}');
+  w->_needs_comma = true;
+  w->_depth--;
+}
+
+void com_json_beginArray(com_json_Writer *w) {
+  com_json_emitSeparator(w);
+  com_writer_append_u8(w->_writer, '[');
+  w->_needs_comma = false;
+  w->_depth++;
+}
+
+void com_json_endArray(com_json_Writer *w) {
+  com_assert_m(w->_depth > 0, "no open array to end");
+  com_writer_append_u8(w->_writer, ']');
+  w->_needs_comma = true;
+  w->_depth--;
+}
+
+void com_json_key(com_json_Writer *w, com_str key) {
+  com_json_emitSeparator(w);
+  com_json_emitStr(w->_writer, key);
+  com_writer_append_u8(w->_writer, ':');
+  w->_needs_comma = false;
+}
 
-static void com_json_emitProp(com_writer *writer, com_json_Prop *prop) {
-  com_json_emitStr(writer, prop->key);
-  com_writer_append_u8(writer, ':');
-  com_json_emitElem(writer, &prop->value);
+void com_json_writeNull(com_json_Writer *w) {
+  com_json_emitSeparator(w);
+  com_writer_append_str(w->_writer, com_str_lit_m("null"));
+  w->_needs_comma = true;
 }
 
-static void com_json_emitElem(com_writer *writer, com_json_Elem *j) {
+void com_json_writeBool(com_json_Writer *w, bool value) {
+  com_json_emitSeparator(w);
+  com_writer_append_str(w->_writer, value ? com_str_lit_m("true")
+                                          : com_str_lit_m("false"));
+  w->_needs_comma = true;
+}
+
+void com_json_writeInt(com_json_Writer *w, i64 value) {
+  com_json_emitSeparator(w);
+  com_format_i64(w->_writer, value, com_format_DEFAULT_SETTING);
+  w->_needs_comma = true;
+}
+
+void com_json_writeUint(com_json_Writer *w, u64 value) {
+  com_json_emitSeparator(w);
+  com_format_u64(w->_writer, value, com_format_DEFAULT_SETTING);
+  w->_needs_comma = true;
+}
+
+void com_json_writeFloat(com_json_Writer *w, f64 value) {
+  // JSON has no infinities or NaNs
+  if (!com_fmath_f64_is_finite(value)) {
+    com_json_writeNull(w);
+    return;
+  }
+  com_json_emitSeparator(w);
+  // the shortest form that reads back as the same value
+  com_format_FormatData fmtdata = com_format_DEFAULT_SETTING;
+  fmtdata.precision = u32_max_m;
+  fmtdata.upper = false;
+  com_format_f64(w->_writer, value, fmtdata, com_format_FloatDefault);
+  w->_needs_comma = true;
+}
+
+void com_json_writeStr(com_json_Writer *w, com_str value) {
+  com_json_emitSeparator(w);
+  com_json_emitStr(w->_writer, value);
+  w->_needs_comma = true;
+}
+
+void com_json_writeElem(com_json_Writer *w, com_json_Elem *j) {
   switch (j->kind) {
   case com_json_INVALID: {
     com_assert_m(j->kind != com_json_INVALID, "invalid elem type");
     break;
   }
   case com_json_NULL: {
-    com_writer_append_str(writer, com_str_lit_m("null"));
+    com_json_writeNull(w);
     break;
   }
   case com_json_STR: {
-    com_json_emitStr(writer, j->string);
+    com_json_writeStr(w, j->string);
     break;
   }
   case com_json_BOOL: {
-    com_writer_append_str(writer, j->bool_member ? com_str_lit_m("true")
-                                                 : com_str_lit_m("false"));
+    com_json_writeBool(w, j->bool_member);
     break;
   }
   case com_json_INT: {
-    com_format_i64(writer, j->int_member, com_format_DEFAULT_SETTING);
+    com_json_writeInt(w, j->int_member);
     break;
   }
   case com_json_UINT: {
-    com_format_u64(writer, j->uint_member, com_format_DEFAULT_SETTING);
+    com_json_writeUint(w, j->uint_member);
     break;
   }
   case com_json_FLOAT: {
-    com_format_f64(writer, j->float_member, com_format_DEFAULT_SETTING,
-                   com_format_FloatDefault);
+    com_json_writeFloat(w, j->float_member);
     break;
   }
   case com_json_ARRAY: {
-    com_writer_append_u8(writer, '[');
+    com_json_beginArray(w);
     for (usize i = 0; i < j->array.length; i++) {
-      com_json_emitElem(writer, &j->array.values[i]);
-      // if we are not on the ultimate element of the lsit
-      if (i + 1 != j->array.length) {
-        com_writer_append_u8(writer, ',');
-      }
+      com_json_writeElem(w, &j->array.values[i]);
     }
-    com_writer_append_u8(writer, ']');
+    com_json_endArray(w);
     break;
   }
   case com_json_OBJ: {
-    com_writer_append_u8(writer, '{');
+    com_json_beginObj(w);
     for (usize i = 0; i < j->object.length; i++) {
-      com_json_emitProp(writer, &j->object.props[i]);
-      if (i + 1 != j->object.length) {
-        com_writer_append_u8(writer, ',');
-      }
+      com_json_key(w, j->object.props[i].key);
+      com_json_writeElem(w, &j->object.props[i].value);
     }
-    com_writer_append_u8(writer, '}');
+    com_json_endObj(w);
     break;
   }
   }
 }
 
 void com_json_serialize(com_json_Elem *elem, com_writer *writer) {
-  com_json_emitElem(writer, elem);
+  com_json_Writer w = com_json_writerCreate(writer);
+  com_json_writeElem(&w, elem);
 }
 
-static com_json_Elem
-com_json_certain_parseNumberElem(com_reader *reader, com_vec *diagnostics,
-                                 attr_UNUSED com_allocator *a) {
-
-  bool negative = false;
-  com_reader_ReadU8Result ret = com_reader_peek_u8(reader, 1);
-  if (ret.valid) {
-    if (ret.value == '-') {
-      negative = true;
-      com_reader_drop_u8(reader);
-    }
-  } else {
-    com_assert_unreachable_m("expected a negative or a number, not EOF");
-  }
-
-  i64 integer_value = 0;
-  bool has_fractional_component;
+// Consumes the digits at the head of the reader
+// If `decimal` is not NULL, pushes each digit into it
+// If `integer` is not NULL, also accumulates the digits into it, setting
+// *overflow if they don't fit in a u64
+// Returns false and logs an error if there are no digits
+static bool com_json_parseDigits(com_reader *reader, com_vec *diagnostics,
+                                 com_fmath_Decimal *decimal, u64 *integer,
+                                 bool *overflow) {
+  com_loc_Span sp = com_reader_peek_span_u8(reader);
+  bool has_digit = false;
   while (true) {
-    ret = com_reader_peek_u8(reader, 1);
-    com_loc_Span sp = com_reader_peek_span_u8(reader);
-    if (ret.valid) {
-      u8 c = ret.value;
-      if (com_format_is_digit(c)) {
-        integer_value = integer_value * 10 + c - 10;
-        com_reader_drop_u8(reader);
-      } else if (c == '.') {
-        has_fractional_component = true;
-        com_reader_drop_u8(reader);
-        break;
-      } else {
-        has_fractional_component = false;
-        break;
-      }
-    } else {
-      *com_vec_push_m(diagnostics, com_json_Error) =
-          com_json_error_m(com_json_ElemEof, sp);
-      return com_json_invalid_m;
+    com_reader_ReadU8Result ret = com_reader_peek_u8(reader, 1);
+    if (!ret.valid || !com_format_is_digit(ret.value)) {
+      break;
+    }
+    u8 digit = ret.value - (u8)'0';
+    if (decimal != NULL) {
+      com_fmath_decimal_push_digit(decimal, digit);
+    }
+    if (integer != NULL && !*overflow) {
+      *overflow = __builtin_mul_overflow(*integer, 10, integer) ||
+                  __builtin_add_overflow(*integer, digit, integer);
     }
+    has_digit = true;
+    com_reader_drop_u8(reader);
   }
 
-  f64 fractional_component = 0;
-  if (has_fractional_component) {
-    f64 place = 1;
-
-    while (true) {
-      com_loc_Span sp = com_reader_peek_span_u8(reader);
-      ret = com_reader_peek_u8(reader, 1);
-      if (ret.valid) {
-        u8 c = ret.value;
-        if (com_format_is_digit(c)) {
-          place *= 10;
-          fractional_component += (c - '0') / place;
-          com_reader_drop_u8(reader);
-        } else {
-          break;
-        }
+  if (!has_digit) {
+    *com_vec_push_m(diagnostics, com_json_Error) =
+        com_json_error_m(com_json_NumExpectedDigit, sp);
+  }
+  return has_digit;
+}
 
-      } else {
-        *com_vec_push_m(diagnostics, com_json_Error) =
-            com_json_error_m(com_json_ElemEof, sp);
-        return com_json_invalid_m;
+// Returns the element for a parsed number
+// If `is_integer`, the number is `integer_value`, otherwise it is `decimal`
+static com_json_Elem com_json_numberElem(bool negative, bool is_integer,
+                                         u64 integer_value,
+                                         const com_fmath_Decimal *decimal,
+                                         com_allocator *a) {
+  if (is_integer) {
+    if (negative) {
+      // -2^63 is the one negative integer whose magnitude isn't an i64
+      if (integer_value == 0) {
+        return com_json_int_m(0);
+      } else if (integer_value - 1 <= i64_max_m) {
+        return com_json_int_m(-(i64)(integer_value - 1) - 1);
       }
+    } else if (integer_value <= i64_max_m) {
+      return com_json_int_m((i64)integer_value);
+    } else {
+      return com_json_uint_m(integer_value);
     }
   }
 
-  typedef enum {
-    NoExponent,
-    PositiveExponent,
-    NegativeExponent,
-  } ExponentState;
+  // means we have to be floating point
+  f64 num = com_fmath_decimal_get_f64(decimal, a);
+  if (negative) {
+    num = -num;
+  }
+  return com_json_float_m(num);
+}
 
-  ExponentState exponentState;
+// Parses a number as described by https://tools.ietf.org/html/rfc7159#section-6
+// Integers that fit are returned as com_json_INT (or com_json_UINT if they are
+// too large for an i64), and everything else as a correctly rounded
+// com_json_FLOAT
+static com_json_Elem
+com_json_certain_parseNumberElem(com_reader *reader, com_vec *diagnostics,
+                                 com_allocator *a) {
+  com_fmath_Decimal decimal = com_fmath_decimal_create();
 
-  ret = com_reader_peek_u8(reader, 1);
+  bool negative = false;
+  com_reader_ReadU8Result ret = com_reader_peek_u8(reader, 1);
   if (ret.valid) {
-    u8 c = ret.value;
-    if (c == 'E' || c == 'e') {
+    if (ret.value == '-') {
+      negative = true;
       com_reader_drop_u8(reader);
-      com_loc_Span sp = com_reader_peek_span_u8(reader);
-      ret = com_reader_peek_u8(reader, 1);
-      if (ret.valid) {
-        switch (ret.value) {
-        case '+': {
-          exponentState = PositiveExponent;
-          com_reader_drop_u8(reader);
-          break;
-        }
-        case '-': {
-          exponentState = NegativeExponent;
-          com_reader_drop_u8(reader);
-          break;
-        }
-        default: {
-          exponentState = PositiveExponent;
-          break;
-        }
-        }
-      } else {
-        *com_vec_push_m(diagnostics, com_json_Error) =
-            com_json_error_m(com_json_ElemEof, sp);
-        return com_json_invalid_m;
-      }
-    } else {
-      exponentState = NoExponent;
     }
   } else {
-    exponentState = NoExponent;
+    com_assert_unreachable_m("expected a negative or a number, not EOF");
   }
 
-  u32 exponential_integer = 0;
-  if (exponentState != NoExponent) {
-    while (true) {
-      com_loc_Span sp = com_reader_peek_span_u8(reader);
-      ret = com_reader_read_u8(reader);
-      if (ret.valid) {
-        u8 c = ret.value;
-        if (com_format_is_digit(c)) {
-          exponential_integer = exponential_integer * 10 + (c - (u8)'0');
-          com_reader_drop_u8(reader);
-        } else {
-          break;
-        }
-      } else {
-        *com_vec_push_m(diagnostics, com_json_Error) =
-            com_json_error_m(com_json_ElemEof, sp);
-        return com_json_invalid_m;
-      }
+  // the integer part is also kept exactly, in case this is an integer
+  u64 integer_value = 0;
+  bool integer_overflow = false;
+  if (!com_json_parseDigits(reader, diagnostics, &decimal, &integer_value,
+                            &integer_overflow)) {
+    return com_json_invalid_m;
+  }
+
+  bool has_fractional_component = false;
+  ret = com_reader_peek_u8(reader, 1);
+  if (ret.valid && ret.value == '.') {
+    has_fractional_component = true;
+    com_reader_drop_u8(reader);
+    com_fmath_decimal_push_point(&decimal);
+    if (!com_json_parseDigits(reader, diagnostics, &decimal, NULL, NULL)) {
+      return com_json_invalid_m;
     }
   }
 
-  if (has_fractional_component || (exponentState != NoExponent)) {
-    // means we have to be floating point
-    f64 num = (f64)integer_value + fractional_component;
+  bool has_exponent = false;
+  ret = com_reader_peek_u8(reader, 1);
+  if (ret.valid && (ret.value == 'E' || ret.value == 'e')) {
+    has_exponent = true;
+    com_reader_drop_u8(reader);
 
-    if (exponentState != NoExponent) {
-      f64 exponent = exponential_integer;
-      if (exponentState == NegativeExponent) {
-        exponent = -exponent;
-      }
-      num = com_fmath_f64_pow(num, exponent);
+    bool negative_exponent = false;
+    ret = com_reader_peek_u8(reader, 1);
+    if (ret.valid && (ret.value == '+' || ret.value == '-')) {
+      negative_exponent = ret.value == '-';
+      com_reader_drop_u8(reader);
     }
 
-    if (negative) {
-      num = -num;
+    // any exponent too large for an i64 is far out of range of an f64 anyway
+    u64 exponent = 0;
+    bool exponent_overflow = false;
+    if (!com_json_parseDigits(reader, diagnostics, NULL, &exponent,
+                              &exponent_overflow)) {
+      return com_json_invalid_m;
     }
-    return com_json_float_m(num);
-  } else {
-    if (negative) {
-      integer_value = -integer_value;
+    if (exponent_overflow || exponent > i64_max_m) {
+      exponent = i64_max_m;
     }
-    return com_json_int_m(integer_value);
+    com_fmath_decimal_scale(&decimal, negative_exponent ? -(i64)exponent
+                                                        : (i64)exponent);
   }
+
+  return com_json_numberElem(
+      negative, !has_fractional_component && !has_exponent && !integer_overflow,
+      integer_value, &decimal, a);
 }
 
 static com_json_Elem
@@ -301,99 +360,11 @@ com_json_certain_parseLiteralElem(com_reader *reader, com_vec *diagnostics,
     return com_json_invalid_m;
   }
 }
-static com_json_Prop com_json_parseProp(com_reader *l, com_vec *diagnostics,
-                                        com_allocator *a);
-
-static com_json_Elem com_json_certain_parseArrayElem(com_reader *l,
-                                                     com_vec *diagnostics,
-                                                     com_allocator *a) {
-  {
-    com_reader_ReadU8Result ret = com_reader_read_u8(l);
-    com_assert_m(ret.valid && ret.value == '[', "expected [");
-  }
-
-  // vector of elements
-  com_vec elems = com_vec_create(com_allocator_alloc(
-      a, (com_allocator_HandleData){.flags = com_allocator_defaults(a) |
-                                             com_allocator_NOLEAK |
-                                             com_allocator_REALLOCABLE,
-                                    .len = 12}));
-
-  typedef enum {
-    ArrayParseStart,
-    ArrayParseExpectCommaOrEnd,
-    ArrayParseExpectElem,
-  } ArrayParseState;
-
-  ArrayParseState state = ArrayParseStart;
-
-  while (true) {
-    switch (state) {
-    case ArrayParseStart: {
-      com_scan_skip_whitespace(l);
-      com_loc_Span sp = com_reader_peek_span_u8(l);
-      com_reader_ReadU8Result ret = com_reader_peek_u8(l, 1);
-      if (!ret.valid) {
-        *com_vec_push_m(diagnostics, com_json_Error) =
-            com_json_error_m(com_json_ArrayExpectedJsonElem, sp);
-        return com_json_invalid_m;
-      }
-      if (ret.value == ']') {
-        com_reader_drop_u8(l);
-        goto CLEANUP;
-      } else {
-        state = ArrayParseExpectElem;
-      }
-      break;
-    }
-    case ArrayParseExpectCommaOrEnd: {
-      com_scan_skip_whitespace(l);
-
-      com_loc_Span sp = com_reader_peek_span_u8(l);
-      com_reader_ReadU8Result ret = com_reader_peek_u8(l, 1);
-      if (!ret.valid) {
-        *com_vec_push_m(diagnostics, com_json_Error) =
-            com_json_error_m(com_json_ArrayExpectedRightBracket, sp);
-        return com_json_invalid_m;
-      }
-      switch (ret.value) {
-      case ',': {
-        com_reader_drop_u8(l);
-        state = ArrayParseExpectElem;
-        break;
-      }
-      case ']': {
-        com_reader_drop_u8(l);
-        goto CLEANUP;
-      }
-      default: {
-        // emit error
-        *com_vec_push_m(diagnostics, com_json_Error) =
-            com_json_error_m(com_json_ArrayExpectedRightBracket, sp);
-        // drop char
-        com_reader_drop_u8(l);
-        break;
-      }
-      }
-      break;
-    }
-    case ArrayParseExpectElem: {
-      *com_vec_push_m(&elems, com_json_Elem) =
-          com_json_parseElem(l, diagnostics, a);
-      state = ArrayParseExpectCommaOrEnd;
-      break;
-    }
-    }
-  }
-
-CLEANUP:;
-  usize len = com_vec_len_m(&elems, com_json_Elem);
-  return com_json_array_m(com_vec_release(&elems), len);
-}
 
-static com_str_mut certain_internal_str_parse(com_reader *l,
-                                              com_vec *diagnostics,
-                                              com_allocator *a) {
+// Parses a string at the head of the reader, appending its unescaped contents
+// to `buffer`
+static void com_json_certain_parseStrInto(com_reader *l, com_vec *diagnostics,
+                                          com_vec *buffer) {
   // note that we don't want to read the first quote
   {
     com_reader_ReadU8Result ret = com_reader_read_u8(l);
@@ -402,34 +373,21 @@ static com_str_mut certain_internal_str_parse(com_reader *l,
 
   // parse into vec writer until we get a success or a read error log errors
   // along the way
-
-  // create vector writer
-  com_vec vec = com_vec_create(com_allocator_alloc(
-      a, (com_allocator_HandleData){
-             .flags = com_allocator_defaults(a) | com_allocator_NOLEAK |
-                      com_allocator_REALLOCABLE,
-             // let's just go with 12 for now as initial capacity
-             .len = 12}));
-  com_writer writer = com_writer_vec_create(&vec);
+  com_writer writer = com_writer_vec_create(buffer);
 
   while (true) {
     com_scan_CheckedStrResult ret =
         com_scan_checked_str_until(&writer, l, '"');
     switch (ret.result) {
     case com_scan_CheckedStrSuccessful: {
-      // We're finished, we can deallocate writer and release vec into a string
-      // that we return as an element
       com_writer_destroy(&writer);
-      return com_vec_to_str(&vec);
+      return;
     }
     case com_scan_CheckedStrReadFailed: {
-      // deallocate resources
       com_writer_destroy(&writer);
-      // give error
       *com_vec_push_m(diagnostics, com_json_Error) =
           com_json_error_m(com_json_StrExpectedDoubleQuote, ret.span);
-      // return invalid
-      return com_vec_to_str(&vec);
+      return;
     }
     case com_scan_CheckedStrInvalidControlChar: {
       *com_vec_push_m(diagnostics, com_json_Error) =
@@ -445,184 +403,1157 @@ static com_str_mut certain_internal_str_parse(com_reader *l,
   }
 }
 
-static com_json_Elem com_json_certain_parseStrElem(com_reader *reader,
-                                                   com_vec *diagnostics,
-                                                   com_allocator *a) {
-  return com_json_str_m(
-      com_str_demut(certain_internal_str_parse(reader, diagnostics, a)));
+static com_vec com_json_scratchVec(com_allocator *a, usize len) {
+  return com_vec_create(com_allocator_alloc(
+      a, (com_allocator_HandleData){.len = len,
+                                    .flags = com_allocator_defaults(a) |
+                                             com_allocator_NOLEAK |
+                                             com_allocator_REALLOCABLE}));
 }
 
-static com_json_Prop com_json_parseProp(com_reader *l, com_vec *diagnostics,
-                                        com_allocator *a) {
-  com_scan_skip_whitespace(l);
-  com_loc_Span quotespan = com_reader_peek_span_u8(l);
-  com_reader_ReadU8Result ret = com_reader_peek_u8(l, 1);
+/* Tree building */
 
-  // short circuit prevents issues
-  if (!(ret.valid && ret.value == '\"')) {
-    *com_vec_push_m(diagnostics, com_json_Error) =
-        com_json_error_m(com_json_PropExpectedDoubleQuote, quotespan);
-    return com_json_prop_m(com_str_lit_m(""), com_json_invalid_m);
-  }
+// an array or object whose children are still being built
+typedef struct {
+  bool is_object;
+  // where its children start on the element or property stack
+  usize start;
+  // the key of the property currently being built, if it is an object
+  com_str key;
+} com_json_BuildFrame;
 
-  com_str key = com_str_demut(certain_internal_str_parse(l, diagnostics, a));
+// Builds a tree from its values and containers, given in document order
+// The children of every open container are kept on shared stacks, so that
+// each array and object is allocated exactly once, when it is closed.
+typedef struct {
+  com_vec frames;
+  com_vec elems;
+  com_vec props;
+  // allocates the finished arrays and objects
+  com_allocator *a;
+} com_json_Builder;
 
-  // resync up to colon
-  com_scan_skip_whitespace(l);
+// the stacks are allocated from `scratch`, and freed when the builder is
+static com_json_Builder com_json_builderCreate(com_allocator *scratch,
+                                               com_allocator *a) {
+  return (com_json_Builder){
+      .frames = com_json_scratchVec(scratch, 16 * sizeof(com_json_BuildFrame)),
+      .elems = com_json_scratchVec(scratch, 64 * sizeof(com_json_Elem)),
+      .props = com_json_scratchVec(scratch, 64 * sizeof(com_json_Prop)),
+      .a = a};
+}
 
-  com_loc_Span colonspan = com_reader_peek_span_u8(l);
-  ret = com_reader_peek_u8(l, 1);
+static void com_json_builderDestroy(com_json_Builder *b) {
+  com_vec_destroy(&b->frames);
+  com_vec_destroy(&b->elems);
+  com_vec_destroy(&b->props);
+}
 
-  if (!ret.valid) {
-    *com_vec_push_m(diagnostics, com_json_Error) =
-        com_json_error_m(com_json_PropExpectedColon, colonspan);
-    return com_json_prop_m(key, com_json_invalid_m);
+static usize com_json_builderDepth(const com_json_Builder *b) {
+  return com_vec_len_m(&b->frames, com_json_BuildFrame);
+}
+
+// the innermost open container
+static com_json_BuildFrame *com_json_builderTop(com_json_Builder *b) {
+  usize depth = com_json_builderDepth(b);
+  com_assert_m(depth > 0, "no open container");
+  return com_vec_get_m(&b->frames, depth - 1, com_json_BuildFrame);
+}
+
+// opens a new container inside the innermost one
+static void com_json_builderOpen(com_json_Builder *b, bool is_object) {
+  *com_vec_push_m(&b->frames, com_json_BuildFrame) = (com_json_BuildFrame){
+      .is_object = is_object,
+      .start = is_object ? com_vec_len_m(&b->props, com_json_Prop)
+                         : com_vec_len_m(&b->elems, com_json_Elem),
+      .key = com_str_lit_m("")};
+}
+
+// adds a finished value to the innermost container
+// Returns false if there is no container, so `value` is the whole document
+static bool com_json_builderAppend(com_json_Builder *b, com_json_Elem value) {
+  if (com_json_builderDepth(b) == 0) {
+    return false;
+  }
+  com_json_BuildFrame *top = com_json_builderTop(b);
+  if (top->is_object) {
+    *com_vec_push_m(&b->props, com_json_Prop) =
+        com_json_prop_m(top->key, value);
+  } else {
+    *com_vec_push_m(&b->elems, com_json_Elem) = value;
   }
+  return true;
+}
 
-  if (ret.value != ':') {
-    *com_vec_push_m(diagnostics, com_json_Error) =
-        com_json_error_m(com_json_PropExpectedDoubleQuote, colonspan);
-    // must sync to a colon in order to be robust
-    com_writer nw = com_writer_null();
-    // zoom up to and accept colon
-    com_scan_until(&nw, l, ':');
+// moves the children of the innermost container into a new allocation
+// Returns the finished container
+static com_json_Elem com_json_builderClose(com_json_Builder *b) {
+  com_json_BuildFrame frame;
+  com_vec_pop_m(&b->frames, &frame, com_json_BuildFrame);
+
+  com_vec *stack = frame.is_object ? &b->props : &b->elems;
+  usize size = frame.is_object ? sizeof(com_json_Prop) : sizeof(com_json_Elem);
+  usize len = com_vec_length(stack) / size - frame.start;
+
+  void *children = NULL;
+  if (len > 0) {
+    com_allocator_Handle h = com_allocator_alloc(
+        b->a, (com_allocator_HandleData){.len = len * size,
+                                         .flags = com_allocator_defaults(b->a) |
+                                                  com_allocator_NOLEAK});
+    com_assert_m(h.valid, "allocation failed");
+    children = com_allocator_handle_get(h);
+    __builtin_memcpy(children, com_vec_get(stack, frame.start * size),
+                     len * size);
+    com_vec_set_len(stack, frame.start * size);
   }
 
-  com_json_Elem value = com_json_parseElem(l, diagnostics, a);
-  return com_json_prop_m(key, value);
+  return frame.is_object ? com_json_obj_m(children, len)
+                         : com_json_array_m(children, len);
 }
 
-static com_json_Elem com_json_certain_parseObjectElem(com_reader *l,
-                                                      com_vec *diagnostics,
-                                                      com_allocator *a) {
-  {
-    com_reader_ReadU8Result ret = com_reader_read_u8(l);
-    com_assert_m(ret.valid && (ret.value == '{'), "expected {'");
+// closes every open container around `value`, which failed to parse
+// Returns the whole document
+static com_json_Elem com_json_builderUnwind(com_json_Builder *b,
+                                            com_json_Elem value) {
+  while (com_json_builderAppend(b, value)) {
+    value = com_json_builderClose(b);
   }
+  return value;
+}
 
-  // vector of properties
-  com_vec props = com_vec_create(com_allocator_alloc(
-      a, (com_allocator_HandleData){.len = 0,
-                                    .flags = com_allocator_defaults(a) |
-                                             com_allocator_REALLOCABLE |
-                                             com_allocator_NOLEAK}));
+/* Event reader */
 
-  typedef enum {
-    ObjectParseStart,
-    ObjectParseExpectCommaOrEnd,
-    ObjectParseExpectProp,
-  } ObjectParseState;
+// the string buffer is only emptied once it grows past this many bytes, since
+// emptying a com_vec may shrink it, which would mean reallocating it for
+// nearly every string
+#define EVENT_BUFFER_RESET_LEN 4096
+
+com_json_EventReader com_json_eventReaderCreate(com_reader *reader,
+                                                com_vec *diagnostics,
+                                                com_allocator *allocator) {
+  com_assert_m(com_reader_flags(reader) & com_reader_BUFFERED,
+               "reader is not buffered");
+  return (com_json_EventReader){
+      ._reader = reader,
+      ._diagnostics = diagnostics,
+      ._allocator = allocator,
+      ._containers = com_json_scratchVec(allocator, 16),
+      ._state = com_json_EventReaderValue,
+      ._buffer = com_json_scratchVec(allocator, 64)};
+}
+
+void com_json_eventReaderDestroy(com_json_EventReader *r) {
+  com_vec_destroy(&r->_containers);
+  com_vec_destroy(&r->_buffer);
+}
+
+usize com_json_eventReaderDepth(const com_json_EventReader *r) {
+  return com_vec_len_m(&r->_containers, bool);
+}
+
+// returns true if the innermost open container is an object
+static bool com_json_eventInObject(const com_json_EventReader *r) {
+  return *com_vec_get_m(&r->_containers, com_json_eventReaderDepth(r) - 1,
+                        bool);
+}
+
+// the state after a value has been read
+static com_json_EventReaderState
+com_json_eventAfterValue(const com_json_EventReader *r) {
+  return com_json_eventReaderDepth(r) == 0 ? com_json_EventReaderValue
+                                           : com_json_EventReaderCommaOrEnd;
+}
+
+static void com_json_eventError(com_json_EventReader *r,
+                                com_json_ErrorKind kind, com_loc_Span span) {
+  *com_vec_push_m(r->_diagnostics, com_json_Error) =
+      com_json_error_m(kind, span);
+}
+
+// Parses the string at the head of the reader into the reader's buffer
+static com_str com_json_eventStr(com_json_EventReader *r) {
+  if (com_vec_length(&r->_buffer) > EVENT_BUFFER_RESET_LEN) {
+    com_vec_set_len(&r->_buffer, 0);
+  }
+  usize start = com_vec_length(&r->_buffer);
+  com_json_certain_parseStrInto(r->_reader, r->_diagnostics, &r->_buffer);
+  return (com_str){.data = com_vec_get(&r->_buffer, start),
+                   .len = com_vec_length(&r->_buffer) - start};
+}
 
-  ObjectParseState state = ObjectParseStart;
+// Returns the event for a value, given where it started
+static com_json_Event com_json_eventValue(com_json_EventReader *r,
+                                          com_loc_LnCol start,
+                                          com_json_Elem value) {
+  r->_state = com_json_eventAfterValue(r);
+  return (com_json_Event){
+      .kind = com_json_EventValue,
+      .value = value,
+      .span = com_loc_span_m(start, com_reader_position(r->_reader))};
+}
 
+// pops the innermost container, returning the event that ends it
+static com_json_Event com_json_eventEnd(com_json_EventReader *r,
+                                        com_loc_LnCol start) {
+  bool is_object;
+  com_vec_pop_m(&r->_containers, &is_object, bool);
+  if (r->_state != com_json_EventReaderUnwind) {
+    r->_state = com_json_eventAfterValue(r);
+  }
+  return (com_json_Event){
+      .kind = is_object ? com_json_EventEndObj : com_json_EventEndArray,
+      .span = com_loc_span_m(start, com_reader_position(r->_reader))};
+}
+
+// Each state skips whitespace, then either returns an event, or moves to a
+// new state and loops. Errors are logged and recovered from, dropping bytes
+// where needed to make progress. If the reader ends with containers still
+// open, an end event is returned for each of them, so that begin and end
+// events always match.
+com_json_Event com_json_nextEvent(com_json_EventReader *r) {
+  com_reader *l = r->_reader;
   while (true) {
-    switch (state) {
-    case ObjectParseStart: {
-      com_scan_skip_whitespace(l);
-      com_loc_Span sp = com_reader_peek_span_u8(l);
-      com_reader_ReadU8Result ret = com_reader_peek_u8(l, 1);
+    com_scan_skip_whitespace(l);
+    com_loc_Span sp = com_reader_peek_span_u8(l);
+    com_reader_ReadU8Result ret = com_reader_peek_u8(l, 1);
+
+    switch (r->_state) {
+    case com_json_EventReaderValue: {
       if (!ret.valid) {
-        *com_vec_push_m(diagnostics, com_json_Error) =
-            com_json_error_m(com_json_ObjectExpectedProp, sp);
-        return com_json_invalid_m;
+        if (com_json_eventReaderDepth(r) == 0) {
+          return (com_json_Event){.kind = com_json_EventEof, .span = sp};
+        }
+        com_json_eventError(r, com_json_ElemEof, sp);
+        r->_state = com_json_EventReaderUnwind;
+        return (com_json_Event){.kind = com_json_EventValue,
+                                .value = com_json_invalid_m,
+                                .span = sp};
       }
-      if (ret.value == '}') {
+
+      switch (ret.value) {
+      case '[':
+      case '{': {
+        bool is_object = ret.value == '{';
         com_reader_drop_u8(l);
-        goto CLEANUP;
+        *com_vec_push_m(&r->_containers, bool) = is_object;
+        r->_state = is_object ? com_json_EventReaderObjectStart
+                              : com_json_EventReaderArrayStart;
+        return (com_json_Event){.kind = is_object ? com_json_EventBeginObj
+                                                  : com_json_EventBeginArray,
+                                .span = sp};
+      }
+      case '\"': {
+        com_str str = com_json_eventStr(r);
+        return com_json_eventValue(r, sp.start, com_json_str_m(str));
+      }
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+      case '-': {
+        com_json_Elem value = com_json_certain_parseNumberElem(
+            l, r->_diagnostics, r->_allocator);
+        return com_json_eventValue(r, sp.start, value);
+      }
+      case 't':
+      case 'f':
+      case 'n': {
+        com_json_Elem value = com_json_certain_parseLiteralElem(
+            l, r->_diagnostics, r->_allocator);
+        return com_json_eventValue(r, sp.start, value);
+      }
+      default: {
+        com_json_eventError(r, com_json_ElemUnknownCharacter, sp);
+        // a closing bracket is left to end its container
+        if (com_json_eventReaderDepth(r) == 0 ||
+            (ret.value != ']' && ret.value != '}')) {
+          com_reader_drop_u8(l);
+        }
+        return com_json_eventValue(r, sp.start, com_json_invalid_m);
+      }
+      }
+    }
+    case com_json_EventReaderArrayStart: {
+      if (!ret.valid) {
+        com_json_eventError(r, com_json_ArrayExpectedJsonElem, sp);
+        r->_state = com_json_EventReaderUnwind;
+      } else if (ret.value == ']') {
+        com_reader_drop_u8(l);
+        return com_json_eventEnd(r, sp.start);
       } else {
-        state = ObjectParseExpectProp;
+        r->_state = com_json_EventReaderValue;
       }
       break;
     }
-    case ObjectParseExpectProp: {
-      *com_vec_push_m(&props, com_json_Prop) =
-          com_json_parseProp(l, diagnostics, a);
-      state = ObjectParseExpectCommaOrEnd;
+    case com_json_EventReaderObjectStart: {
+      if (!ret.valid) {
+        com_json_eventError(r, com_json_ObjectExpectedProp, sp);
+        r->_state = com_json_EventReaderUnwind;
+      } else if (ret.value == '}') {
+        com_reader_drop_u8(l);
+        return com_json_eventEnd(r, sp.start);
+      } else {
+        r->_state = com_json_EventReaderKey;
+      }
       break;
     }
-    case ObjectParseExpectCommaOrEnd: {
-      com_scan_skip_whitespace(l);
-      com_loc_Span sp = com_reader_peek_span_u8(l);
-      com_reader_ReadU8Result ret = com_reader_peek_u8(l, 1);
+    case com_json_EventReaderKey: {
       if (!ret.valid) {
-        *com_vec_push_m(diagnostics, com_json_Error) =
-            com_json_error_m(com_json_ObjectExpectedRightBrace, sp);
-        return com_json_invalid_m;
+        com_json_eventError(r, com_json_PropExpectedDoubleQuote, sp);
+        r->_state = com_json_EventReaderUnwind;
+        break;
       }
-      switch (ret.value) {
-      case ',': {
+      if (ret.value != '\"') {
+        com_json_eventError(r, com_json_PropExpectedDoubleQuote, sp);
+        // after a trailing comma, the object can still end
+        if (ret.value == '}') {
+          com_reader_drop_u8(l);
+          return com_json_eventEnd(r, sp.start);
+        }
         com_reader_drop_u8(l);
-        state = ObjectParseExpectCommaOrEnd;
         break;
       }
-      case '}': {
+
+      com_str key = com_json_eventStr(r);
+      com_loc_Span keyspan =
+          com_loc_span_m(sp.start, com_reader_position(l));
+
+      // a missing colon is logged, but the value is still read
+      com_scan_skip_whitespace(l);
+      com_loc_Span colonspan = com_reader_peek_span_u8(l);
+      ret = com_reader_peek_u8(l, 1);
+      if (ret.valid && ret.value == ':') {
         com_reader_drop_u8(l);
-        goto CLEANUP;
+      } else {
+        com_json_eventError(r, com_json_PropExpectedColon, colonspan);
       }
-      default: {
-        // emit error
-        *com_vec_push_m(diagnostics, com_json_Error) =
-            com_json_error_m(com_json_ObjectExpectedRightBrace, sp);
-        // drop char
+      r->_state = com_json_EventReaderValue;
+      return (com_json_Event){
+          .kind = com_json_EventKey, .key = key, .span = keyspan};
+    }
+    case com_json_EventReaderCommaOrEnd: {
+      bool in_object = com_json_eventInObject(r);
+      com_json_ErrorKind kind = in_object ? com_json_ObjectExpectedRightBrace
+                                          : com_json_ArrayExpectedRightBracket;
+      if (!ret.valid) {
+        com_json_eventError(r, kind, sp);
+        r->_state = com_json_EventReaderUnwind;
+      } else if (ret.value == ',') {
+        com_reader_drop_u8(l);
+        r->_state = in_object ? com_json_EventReaderKey
+                              : com_json_EventReaderValue;
+      } else if (ret.value == (in_object ? '}' : ']')) {
+        com_reader_drop_u8(l);
+        return com_json_eventEnd(r, sp.start);
+      } else {
+        com_json_eventError(r, kind, sp);
         com_reader_drop_u8(l);
-        break;
-      }
       }
       break;
     }
+    case com_json_EventReaderUnwind: {
+      if (com_json_eventReaderDepth(r) == 0) {
+        r->_state = com_json_EventReaderValue;
+        break;
+      }
+      return com_json_eventEnd(r, sp.start);
     }
+    }
+  }
+}
+
+/* DOM building on top of the event reader */
+
+// returns a copy of `str` that outlives the event it came from
+static com_str com_json_copyStr(com_str str, com_allocator *a) {
+  if (str.len == 0) {
+    return com_str_lit_m("");
   }
-CLEANUP:;
-  usize len = com_vec_len_m(&props, com_json_Prop);
-  return com_json_obj_m(com_vec_release(&props), len);
+  return com_str_demut(com_strcopy_noleak(str, a));
 }
 
 com_json_Elem com_json_parseElem(com_reader *l, com_vec *diagnostics,
                                  com_allocator *a) {
-  com_assert_m(com_reader_flags(l) & com_reader_BUFFERED,
-               "reader is not buffered");
-  com_scan_skip_whitespace(l);
+  com_json_EventReader r = com_json_eventReaderCreate(l, diagnostics, a);
+  com_json_Builder b = com_json_builderCreate(a, a);
 
-  com_loc_Span sp = com_reader_peek_span_u8(l);
-  com_reader_ReadU8Result ret = com_reader_peek_u8(l, 1);
-  if (!ret.valid) {
-    *com_vec_push_m(diagnostics, com_json_Error) =
-        com_json_error_m(com_json_ElemEof, sp);
+  com_json_Elem elem;
+  while (true) {
+    com_json_Event e = com_json_nextEvent(&r);
+    switch (e.kind) {
+    case com_json_EventBeginObj:
+    case com_json_EventBeginArray: {
+      com_json_builderOpen(&b, e.kind == com_json_EventBeginObj);
+      continue;
+    }
+    case com_json_EventKey: {
+      com_json_builderTop(&b)->key = com_json_copyStr(e.key, a);
+      continue;
+    }
+    case com_json_EventValue: {
+      elem = e.value;
+      if (elem.kind == com_json_STR) {
+        elem.string = com_json_copyStr(elem.string, a);
+      }
+      break;
+    }
+    case com_json_EventEndObj:
+    case com_json_EventEndArray: {
+      elem = com_json_builderClose(&b);
+      break;
+    }
+    case com_json_EventEof: {
+      // only possible before the first event, since parsing stops after the
+      // outermost value
+      com_json_eventError(&r, com_json_ElemEof, e.span);
+      elem = com_json_invalid_m;
+      goto CLEANUP;
+    }
+    }
+
+    if (!com_json_builderAppend(&b, elem)) {
+      goto CLEANUP;
+    }
+  }
+
+CLEANUP:
+  com_json_builderDestroy(&b);
+  com_json_eventReaderDestroy(&r);
+  return elem;
+}
+
+/* Indexed parsing of a whole buffer */
+
+// A buffer held entirely in memory is parsed in two stages, in the style of
+// simdjson.
+//
+// Stage 1 loads a block of 64 bytes at a time, and classifies all of them at
+// once into bitmasks (with SSE2 where available). Bit arithmetic on those masks
+// finds which quotes are escaped and which bytes are inside strings, without a
+// branch per byte. The offset of every structural character, quote, and first
+// byte of a number or literal outside a string is written to an index.
+//
+// Stage 2 walks the index, passing values to a com_json_Builder. It knows
+// where every string ends before reading it, so it can copy runs of bytes
+// without escapes in one go.
+
+// number of bytes classified together by stage 1
+#define BLOCK_LEN 64
+
+// bitmasks with bit i set if byte i of a block belongs to each class
+typedef struct {
+  u64 backslash;
+  u64 quote;
+  u64 whitespace;
+  // one of {}[]:,
+  u64 op;
+} com_json_BlockMasks;
+
+#if defined(__SSE2__)
+typedef char com_json_Lane __attribute__((vector_size(16)));
+
+static com_json_Lane com_json_laneSplat(u8 byte) {
+  char c = (char)byte;
+  return (com_json_Lane){c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c};
+}
+
+static u64 com_json_laneMask(com_json_Lane matches) {
+  return (u16)__builtin_ia32_pmovmskb128(matches);
+}
+
+static com_json_BlockMasks com_json_classifyBlock(const u8 *block) {
+  com_json_BlockMasks m = {0};
+  for (usize i = 0; i < BLOCK_LEN; i += sizeof(com_json_Lane)) {
+    com_json_Lane v;
+    __builtin_memcpy(&v, block + i, sizeof(v));
+    // setting bit 5 turns [ into { and ] into }
+    com_json_Lane folded = v | com_json_laneSplat(0x20);
+    com_json_Lane op = (com_json_Lane)((folded == com_json_laneSplat('{')) |
+                                       (folded == com_json_laneSplat('}')) |
+                                       (v == com_json_laneSplat(',')) |
+                                       (v == com_json_laneSplat(':')));
+    com_json_Lane ws = (com_json_Lane)((v == com_json_laneSplat(' ')) |
+                                       (v == com_json_laneSplat('\t')) |
+                                       (v == com_json_laneSplat('\n')) |
+                                       (v == com_json_laneSplat('\r')));
+    m.backslash |= com_json_laneMask((com_json_Lane)(
+                       v == com_json_laneSplat('\\')))
+                   << i;
+    m.quote |= com_json_laneMask((com_json_Lane)(v == com_json_laneSplat('"')))
+               << i;
+    m.whitespace |= com_json_laneMask(ws) << i;
+    m.op |= com_json_laneMask(op) << i;
+  }
+  return m;
+}
+#else
+static com_json_BlockMasks com_json_classifyBlock(const u8 *block) {
+  com_json_BlockMasks m = {0};
+  for (usize i = 0; i < BLOCK_LEN; i++) {
+    u64 bit = (u64)1 << i;
+    switch (block[i]) {
+    case '\\': {
+      m.backslash |= bit;
+      break;
+    }
+    case '"': {
+      m.quote |= bit;
+      break;
+    }
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r': {
+      m.whitespace |= bit;
+      break;
+    }
+    case '{':
+    case '}':
+    case '[':
+    case ']':
+    case ':':
+    case ',': {
+      m.op |= bit;
+      break;
+    }
+    }
+  }
+  return m;
+}
+#endif
+
+// Returns the bytes escaped by a backslash, which are the ones following an odd
+// length run of backslashes
+// *carry is 1 if the first byte of the next block is escaped
+static u64 com_json_findEscaped(u64 backslash, u64 *carry) {
+  const u64 even_bits = 0x5555555555555555;
+  const u64 odd_bits = ~even_bits;
+  u64 starts = backslash & ~(backslash << 1);
+  // a run continuing from the last block has already had its parity flipped
+  u64 even_start_mask = even_bits ^ *carry;
+  u64 even_starts = starts & even_start_mask;
+  u64 odd_starts = starts & ~even_start_mask;
+  // adding the start of a run carries past its end
+  u64 even_carries = backslash + even_starts;
+  u64 odd_carries;
+  bool ends_odd = __builtin_add_overflow(backslash, odd_starts, &odd_carries);
+  odd_carries |= *carry;
+  *carry = ends_odd;
+  u64 even_ends = even_carries & ~backslash;
+  u64 odd_ends = odd_carries & ~backslash;
+  // a run has odd length if it starts and ends on bits of different parity
+  return (even_ends & odd_bits) | (odd_ends & even_bits);
+}
+
+// Returns a mask where bit i is the xor of bits 0 through i of `x`
+static u64 com_json_prefixXor(u64 x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+// Stage 1: writes the offset of each structural byte of `source` to `index`
+// Both the opening and closing quote of every string are structural, so if
+// the source ends inside a string, its opening quote is the last offset.
+// Returns the number of offsets written
+static usize com_json_buildIndex(com_str source, com_vec *index) {
+  u64 escaped_carry = 0;
+  // all ones if the last block ended inside a string
+  u64 in_string_carry = 0;
+  // 1 if the last block ended with part of a number or literal
+  u64 scalar_carry = 0;
+
+  usize count = 0;
+  for (usize base = 0; base < source.len; base += BLOCK_LEN) {
+    const u8 *block = source.data + base;
+    u8 padded[BLOCK_LEN];
+    if (source.len - base < BLOCK_LEN) {
+      // whitespace at the end can't change the meaning of the last block
+      com_mem_set(padded, BLOCK_LEN, ' ');
+      com_mem_move(padded, block, source.len - base);
+      block = padded;
+    }
+
+    com_json_BlockMasks m = com_json_classifyBlock(block);
+    u64 quote = m.quote & ~com_json_findEscaped(m.backslash, &escaped_carry);
+    // includes opening quotes, but not closing ones
+    u64 in_string = com_json_prefixXor(quote) ^ in_string_carry;
+    in_string_carry = 0 - (in_string >> 63);
+
+    // anything else outside a string is part of a number or literal
+    u64 scalar = ~(m.op | m.whitespace | quote | in_string);
+    u64 scalar_start = scalar & ~((scalar << 1) | scalar_carry);
+    scalar_carry = scalar >> 63;
+
+    u64 structural = (m.op & ~in_string) | quote | scalar_start;
+
+    // make room for the worst case, where every byte is structural
+    if (count + BLOCK_LEN > com_vec_len_m(index, usize)) {
+      com_vec_set_len_m(index, 2 * (count + BLOCK_LEN), usize);
+    }
+    usize *offsets = com_vec_get_m(index, 0, usize);
+    while (structural != 0) {
+      offsets[count++] = base + (usize)__builtin_ctzll(structural);
+      structural &= structural - 1;
+    }
+  }
+
+  return count;
+}
+
+// Converts byte offsets in the source to lines and columns, for diagnostics
+// Offsets are almost always asked for in increasing order, so it resumes
+// counting from the last one asked for.
+typedef struct {
+  com_str source;
+  usize offset;
+  com_loc_LnCol loc;
+} com_json_Locator;
+
+static com_loc_LnCol com_json_locate(com_json_Locator *l, usize offset) {
+  if (offset < l->offset) {
+    l->offset = 0;
+    l->loc = com_loc_lncol_m(com_loc_ln_m(1), com_loc_col_m(1));
+  }
+  for (; l->offset < offset; l->offset++) {
+    if (l->source.data[l->offset] == '\n') {
+      l->loc = com_loc_lncol_m(com_loc_ln_m(l->loc.ln.val + 1),
+                               com_loc_col_m(1));
+    } else {
+      l->loc = com_loc_lncol_m(l->loc.ln, com_loc_col_m(l->loc.col.val + 1));
+    }
+  }
+  return l->loc;
+}
+
+typedef struct {
+  com_str source;
+  const usize *index;
+  usize count;
+  com_json_Locator locator;
+  com_vec *diagnostics;
+  // allocates memory that is freed before parsing finishes
+  com_allocator *scratch;
+  // allocates the DOM
+  com_allocator *a;
+  // whether strings without escapes may point into `source` instead of being
+  // copied
+  bool views;
+} com_json_IndexParser;
+
+// logs an error spanning the bytes [start, end)
+static void com_json_indexError(com_json_IndexParser *p,
+                                com_json_ErrorKind kind, usize start,
+                                usize end) {
+  com_loc_LnCol startloc = com_json_locate(&p->locator, start);
+  com_loc_LnCol endloc = com_json_locate(&p->locator, end);
+  *com_vec_push_m(p->diagnostics, com_json_Error) =
+      com_json_error_m(kind, com_loc_span_m(startloc, endloc));
+}
+
+// writes the UTF-8 encoding of `code_point` to `dest`
+// Returns the number of bytes written, which is at most 4
+static usize com_json_encodeUtf8(u8 *dest, u32 code_point) {
+  if (code_point <= 0x7F) {
+    dest[0] = (u8)code_point;
+    return 1;
+  } else if (code_point <= 0x7FF) {
+    dest[0] = (u8)(0xC0 | (code_point >> 6));
+    dest[1] = (u8)(0x80 | (code_point & 0x3F));
+    return 2;
+  } else if (code_point <= 0xFFFF) {
+    dest[0] = (u8)(0xE0 | (code_point >> 12));
+    dest[1] = (u8)(0x80 | ((code_point >> 6) & 0x3F));
+    dest[2] = (u8)(0x80 | (code_point & 0x3F));
+    return 3;
+  } else {
+    dest[0] = (u8)(0xF0 | (code_point >> 18));
+    dest[1] = (u8)(0x80 | ((code_point >> 12) & 0x3F));
+    dest[2] = (u8)(0x80 | ((code_point >> 6) & 0x3F));
+    dest[3] = (u8)(0x80 | (code_point & 0x3F));
+    return 4;
+  }
+}
+
+// reads the 4 hex digits of a \u escape starting at `*i`, advancing past them
+// Returns false, and leaves *i after the first invalid digit, if there is one
+static bool com_json_readHex4(com_str raw, usize *i, u32 *code_point) {
+  *code_point = 0;
+  for (usize n = 0; n < 4; n++) {
+    if (*i == raw.len) {
+      return false;
+    }
+    u8 digit = raw.data[(*i)++];
+    if (!com_format_is_hex(digit)) {
+      return false;
+    }
+    *code_point = *code_point * 16 + com_format_from_hex(digit);
+  }
+  return true;
+}
+
+// Returns a copy of the string whose quotes are at `open` and `close`, with its
+// escapes replaced by the characters they stand for
+// If `p->views`, a string with no escapes is returned as it is in the source.
+// `close` is the end of the source if the string is never closed
+static com_str com_json_indexStr(com_json_IndexParser *p, usize open,
+                                 usize close) {
+  if (close == p->source.len) {
+    com_json_indexError(p, com_json_StrExpectedDoubleQuote, open, close);
+  }
+
+  com_str raw = {.data = p->source.data + open + 1, .len = close - open - 1};
+  if (raw.len == 0) {
+    return com_str_lit_m("");
+  }
+  if (p->views && __builtin_memchr(raw.data, '\\', raw.len) == NULL) {
+    return raw;
+  }
+
+  // an escape is never shorter than what it stands for, so this is enough room
+  com_allocator_Handle h = com_allocator_alloc(
+      p->a, (com_allocator_HandleData){.len = raw.len,
+                                       .flags = com_allocator_defaults(p->a) |
+                                                com_allocator_NOLEAK});
+  com_assert_m(h.valid, "allocation failed");
+  u8 *dest = com_allocator_handle_get(h);
+  usize len = 0;
+
+  usize i = 0;
+  while (i < raw.len) {
+    // copy the run of bytes up to the next escape in one go
+    usize run = i;
+    while (run < raw.len && raw.data[run] != '\\') {
+      run++;
+    }
+    __builtin_memcpy(dest + len, raw.data + i, run - i);
+    len += run - i;
+    i = run;
+    // the string is unclosed if this backslash escapes the end of the source
+    if (i + 1 >= raw.len) {
+      break;
+    }
+
+    usize escape = i;
+    u8 c = raw.data[i + 1];
+    i += 2;
+    switch (c) {
+    case '"':
+    case '/':
+    case '\\': {
+      dest[len++] = c;
+      break;
+    }
+    case 'b': {
+      dest[len++] = '\b';
+      break;
+    }
+    case 'f': {
+      dest[len++] = '\f';
+      break;
+    }
+    case 'n': {
+      dest[len++] = '\n';
+      break;
+    }
+    case 'r': {
+      dest[len++] = '\r';
+      break;
+    }
+    case 't': {
+      dest[len++] = '\t';
+      break;
+    }
+    case 'u': {
+      u32 code_point;
+      if (!com_json_readHex4(raw, &i, &code_point)) {
+        com_json_indexError(p, com_json_StrInvalidUnicodeSpecifier,
+                            open + 1 + escape, open + 1 + i);
+        break;
+      }
+      // a high surrogate followed by a low one encodes a single code point
+      usize low_start = i;
+      u32 low;
+      if (code_point >= 0xD800 && code_point <= 0xDBFF && i + 1 < raw.len &&
+          raw.data[i] == '\\' && raw.data[i + 1] == 'u') {
+        i += 2;
+        if (com_json_readHex4(raw, &i, &low) && low >= 0xDC00 &&
+            low <= 0xDFFF) {
+          code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+        } else {
+          // leave the second escape to be read on its own
+          i = low_start;
+        }
+      }
+      len += com_json_encodeUtf8(dest + len, code_point);
+      break;
+    }
+    default: {
+      com_json_indexError(p, com_json_StrInvalidControlChar, open + 1 + escape,
+                          open + 1 + i);
+      break;
+    }
+    }
+  }
+
+  return (com_str){.data = dest, .len = len};
+}
+
+// Consumes the digits starting at `*i`, in the same way as
+// com_json_parseDigits
+static bool com_json_indexDigits(com_json_IndexParser *p, usize *i,
+                                 com_fmath_Decimal *decimal, u64 *integer,
+                                 bool *overflow) {
+  usize start = *i;
+  while (*i < p->source.len && com_format_is_digit(p->source.data[*i])) {
+    u8 digit = p->source.data[*i] - (u8)'0';
+    if (decimal != NULL) {
+      com_fmath_decimal_push_digit(decimal, digit);
+    }
+    if (integer != NULL && !*overflow) {
+      *overflow = __builtin_mul_overflow(*integer, 10, integer) ||
+                  __builtin_add_overflow(*integer, digit, integer);
+    }
+    (*i)++;
+  }
+
+  if (*i == start) {
+    com_json_indexError(p, com_json_NumExpectedDigit, start,
+                        start < p->source.len ? start + 1 : start);
+    return false;
+  }
+  return true;
+}
+
+// Parses the number starting at `*i`, in the same way as
+// com_json_certain_parseNumberElem, and advances `*i` past it
+static com_json_Elem com_json_indexNumber(com_json_IndexParser *p, usize *i) {
+  com_str s = p->source;
+  com_fmath_Decimal decimal = com_fmath_decimal_create();
+
+  bool negative = s.data[*i] == '-';
+  if (negative) {
+    (*i)++;
+  }
+
+  u64 integer_value = 0;
+  bool integer_overflow = false;
+  if (!com_json_indexDigits(p, i, &decimal, &integer_value,
+                            &integer_overflow)) {
     return com_json_invalid_m;
   }
 
-  switch (ret.value) {
-  case '0':
-  case '1':
-  case '2':
-  case '3':
-  case '4':
-  case '5':
-  case '6':
-  case '7':
-  case '8':
-  case '9':
-  case '-': {
-    return com_json_certain_parseNumberElem(l, diagnostics, a);
+  bool has_fractional_component = false;
+  if (*i < s.len && s.data[*i] == '.') {
+    has_fractional_component = true;
+    (*i)++;
+    com_fmath_decimal_push_point(&decimal);
+    if (!com_json_indexDigits(p, i, &decimal, NULL, NULL)) {
+      return com_json_invalid_m;
+    }
   }
-  case 't':
-  case 'f':
-  case 'n': {
-    return com_json_certain_parseLiteralElem(l, diagnostics, a);
+
+  bool has_exponent = false;
+  if (*i < s.len && (s.data[*i] == 'E' || s.data[*i] == 'e')) {
+    has_exponent = true;
+    (*i)++;
+
+    bool negative_exponent = false;
+    if (*i < s.len && (s.data[*i] == '+' || s.data[*i] == '-')) {
+      negative_exponent = s.data[*i] == '-';
+      (*i)++;
+    }
+
+    u64 exponent = 0;
+    bool exponent_overflow = false;
+    if (!com_json_indexDigits(p, i, NULL, &exponent, &exponent_overflow)) {
+      return com_json_invalid_m;
+    }
+    if (exponent_overflow || exponent > i64_max_m) {
+      exponent = i64_max_m;
+    }
+    com_fmath_decimal_scale(&decimal, negative_exponent ? -(i64)exponent
+                                                        : (i64)exponent);
   }
-  case '\"': {
-    return com_json_certain_parseStrElem(l, diagnostics, a);
+
+  return com_json_numberElem(
+      negative, !has_fractional_component && !has_exponent && !integer_overflow,
+      integer_value, &decimal, p->scratch);
+}
+
+// Parses the literal starting at `*i`, in the same way as
+// com_json_certain_parseLiteralElem, and advances `*i` past it
+static com_json_Elem com_json_indexLiteral(com_json_IndexParser *p, usize *i) {
+  usize start = *i;
+  while (*i < p->source.len && com_format_is_alphanumeric(p->source.data[*i])) {
+    (*i)++;
   }
-  case '[': {
-    return com_json_certain_parseArrayElem(l, diagnostics, a);
+
+  com_str data_str = {.data = p->source.data + start, .len = *i - start};
+  if (com_str_equal(data_str, com_str_lit_m("null"))) {
+    return com_json_null_m;
+  } else if (com_str_equal(data_str, com_str_lit_m("true"))) {
+    return com_json_bool_m(true);
+  } else if (com_str_equal(data_str, com_str_lit_m("false"))) {
+    return com_json_bool_m(false);
+  } else {
+    com_json_indexError(p, com_json_MalformedLiteral, start, *i);
+    return com_json_invalid_m;
   }
-  case '{': {
-    return com_json_certain_parseObjectElem(l, diagnostics, a);
+}
+
+// returns true if `c` can't be part of a number or literal
+static bool com_json_endsScalar(u8 c) {
+  switch (c) {
+  case ' ':
+  case '\t':
+  case '\n':
+  case '\r':
+  case '{':
+  case '}':
+  case '[':
+  case ']':
+  case ':':
+  case ',':
+  case '"': {
+    return true;
   }
   default: {
-    *com_vec_push_m(diagnostics, com_json_Error) =
-        com_json_error_m(com_json_ElemUnknownCharacter, sp);
-    return com_json_invalid_m;
+    return false;
   }
   }
 }
+
+// Stage 2: builds the tree from the index
+static com_json_Elem com_json_indexParse(com_json_IndexParser *p) {
+  com_json_Builder b = com_json_builderCreate(p->scratch, p->a);
+
+  typedef enum {
+    IndexParseValue,
+    IndexParseArrayStart,
+    IndexParseObjectStart,
+    IndexParseProp,
+    IndexParseCommaOrEnd,
+  } IndexParseState;
+
+  const u8 *data = p->source.data;
+  usize end = p->source.len;
+  // position in the index
+  usize k = 0;
+  IndexParseState state = IndexParseValue;
+  com_json_Elem value;
+
+  while (true) {
+    switch (state) {
+    case IndexParseValue: {
+      if (k == p->count) {
+        com_json_indexError(p, com_json_ElemEof, end, end);
+        goto ERROR;
+      }
+      usize i = p->index[k++];
+      switch (data[i]) {
+      case '[':
+      case '{': {
+        bool is_object = data[i] == '{';
+        com_json_builderOpen(&b, is_object);
+        state = is_object ? IndexParseObjectStart : IndexParseArrayStart;
+        continue;
+      }
+      case '"': {
+        usize close = k < p->count ? p->index[k++] : end;
+        value = com_json_str_m(com_json_indexStr(p, i, close));
+        break;
+      }
+      case '-':
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9': {
+        value = com_json_indexNumber(p, &i);
+        break;
+      }
+      case 't':
+      case 'f':
+      case 'n': {
+        value = com_json_indexLiteral(p, &i);
+        break;
+      }
+      default: {
+        com_json_indexError(p, com_json_ElemUnknownCharacter, i, i + 1);
+        goto ERROR;
+      }
+      }
+      if (com_json_builderDepth(&b) == 0) {
+        goto CLEANUP;
+      }
+      // a number or literal may run into bytes that can't follow it
+      if (i < end && !com_json_endsScalar(data[i])) {
+        com_json_indexError(p,
+                            com_json_builderTop(&b)->is_object
+                                ? com_json_ObjectExpectedRightBrace
+                                : com_json_ArrayExpectedRightBracket,
+                            i, i + 1);
+        goto UNWIND;
+      }
+      com_json_builderAppend(&b, value);
+      state = IndexParseCommaOrEnd;
+      break;
+    }
+    case IndexParseArrayStart: {
+      if (k == p->count) {
+        com_json_indexError(p, com_json_ArrayExpectedJsonElem, end, end);
+        goto CLOSE;
+      }
+      if (data[p->index[k]] == ']') {
+        k++;
+        value = com_json_builderClose(&b);
+        if (!com_json_builderAppend(&b, value)) {
+          goto CLEANUP;
+        }
+        state = IndexParseCommaOrEnd;
+      } else {
+        state = IndexParseValue;
+      }
+      break;
+    }
+    case IndexParseObjectStart: {
+      if (k == p->count) {
+        com_json_indexError(p, com_json_ObjectExpectedProp, end, end);
+        goto CLOSE;
+      }
+      if (data[p->index[k]] == '}') {
+        k++;
+        value = com_json_builderClose(&b);
+        if (!com_json_builderAppend(&b, value)) {
+          goto CLEANUP;
+        }
+        state = IndexParseCommaOrEnd;
+      } else {
+        state = IndexParseProp;
+      }
+      break;
+    }
+    case IndexParseProp: {
+      usize i = k < p->count ? p->index[k] : end;
+      if (i == end || data[i] != '"') {
+        com_json_indexError(p, com_json_PropExpectedDoubleQuote, i,
+                            i < end ? i + 1 : i);
+        goto CLOSE;
+      }
+      usize close = k + 1 < p->count ? p->index[k + 1] : end;
+      k += 2;
+      com_json_BuildFrame *top = com_json_builderTop(&b);
+      top->key = com_json_indexStr(p, i, close);
+
+      usize colon = k < p->count ? p->index[k] : end;
+      if (colon == end || data[colon] != ':') {
+        com_json_indexError(p, com_json_PropExpectedColon, colon,
+                            colon < end ? colon + 1 : colon);
+        goto CLOSE;
+      }
+      k++;
+      state = IndexParseValue;
+      break;
+    }
+    case IndexParseCommaOrEnd: {
+      com_json_BuildFrame *top = com_json_builderTop(&b);
+      com_json_ErrorKind kind = top->is_object
+                                    ? com_json_ObjectExpectedRightBrace
+                                    : com_json_ArrayExpectedRightBracket;
+      usize i = k < p->count ? p->index[k] : end;
+      if (i == end) {
+        com_json_indexError(p, kind, end, end);
+        goto CLOSE;
+      }
+      u8 c = data[i];
+      if (c == ',') {
+        k++;
+        state = top->is_object ? IndexParseProp : IndexParseValue;
+      } else if (c == (top->is_object ? '}' : ']')) {
+        k++;
+        value = com_json_builderClose(&b);
+        if (!com_json_builderAppend(&b, value)) {
+          goto CLEANUP;
+        }
+      } else {
+        com_json_indexError(p, kind, i, i + 1);
+        goto CLOSE;
+      }
+      break;
+    }
+    }
+  }
+
+  // a value failed to parse
+ERROR:
+  value = com_json_invalid_m;
+  goto UNWIND;
+  // the innermost container failed to parse
+CLOSE:
+  value = com_json_builderClose(&b);
+UNWIND:
+  value = com_json_builderUnwind(&b, value);
+
+CLEANUP:
+  com_json_builderDestroy(&b);
+  return value;
+}
+
+// parses `source` with temporary memory from `scratch`, and allocates the DOM
+// from `a`
+static com_json_Elem com_json_indexParseBuffer(com_str source,
+                                               com_vec *diagnostics,
+                                               com_allocator *scratch,
+                                               com_allocator *a, bool views) {
+  com_vec index = com_json_scratchVec(scratch, BLOCK_LEN * sizeof(usize));
+  usize count = com_json_buildIndex(source, &index);
+
+  com_json_IndexParser p = {
+      .source = source,
+      .index = com_vec_get_m(&index, 0, usize),
+      .count = count,
+      .locator = {.source = source,
+                  .offset = 0,
+                  .loc = com_loc_lncol_m(com_loc_ln_m(1), com_loc_col_m(1))},
+      .diagnostics = diagnostics,
+      .scratch = scratch,
+      .a = a,
+      .views = views};
+  com_json_Elem elem = com_json_indexParse(&p);
+  com_vec_destroy(&index);
+  return elem;
+}
+
+com_json_Elem com_json_parseBuffer(com_str source, com_vec *diagnostics,
+                                   com_allocator *allocator) {
+  return com_json_indexParseBuffer(source, diagnostics, allocator, allocator,
+                                   false);
+}
+
+void com_json_parseDocument(com_json_Document *doc, com_str source,
+                            com_vec *diagnostics, com_allocator *allocator) {
+  doc->_arena = com_allocator_arena(allocator, &doc->_backing);
+  doc->root = com_json_indexParseBuffer(source, diagnostics, allocator,
+                                        &doc->_arena, true);
+}
+
+void com_json_documentDestroy(com_json_Document *doc) {
+  com_allocator_destroy(&doc->_arena);
+}
@@ -1,6 +1,7 @@
 #ifndef COM_JSON_H
 #define COM_JSON_H
 
+#include "com_allocator_arena.h"
 #include "com_bigdecimal.h"
 #include "com_bigint.h"
 #include "com_define.h"
@@ -81,6 +82,7 @@ typedef enum {
   com_json_StrInvalidControlChar,
   com_json_StrInvalidUnicodeSpecifier,
   com_json_NumExponentExpectedSign,
+  com_json_NumExpectedDigit,
   com_json_ArrayExpectedRightBracket,
   com_json_ArrayExpectedJsonElem,
   com_json_ObjectExpectedRightBrace,
@@ -100,8 +102,196 @@ typedef struct {
 // serializes json to a writer (100% static no allocator needed)
 void com_json_serialize(com_json_Elem *elem, com_writer *writer);
 
+// Streaming JSON writer
+// Emits JSON directly to a com_writer as it is produced, without building a
+// com_json_Elem first. Commas and colons are inserted automatically.
+typedef struct {
+  com_writer *_writer;
+  // whether a comma must be written before the next key or value
+  bool _needs_comma;
+  // number of currently open objects and arrays
+  usize _depth;
+} com_json_Writer;
+
+/// REQUIRES: `writer` is a valid pointer to a valid `com_writer`
+/// GUARANTEES: returns a `com_json_Writer` that writes one value to `writer`
+com_json_Writer com_json_writerCreate(com_writer *writer);
+
+/// REQUIRES: `w` is a valid pointer to a valid `com_json_Writer`
+/// REQUIRES: the writer is expecting a value
+/// GUARANTEES: opens a new object, which then expects a key or its end
+void com_json_beginObj(com_json_Writer *w);
+
+/// REQUIRES: `w` is a valid pointer to a valid `com_json_Writer`
+/// REQUIRES: the innermost open value is an object, and is expecting a key
+/// GUARANTEES: closes the innermost object
+void com_json_endObj(com_json_Writer *w);
+
+/// REQUIRES: `w` is a valid pointer to a valid `com_json_Writer`
+/// REQUIRES: the writer is expecting a value
+/// GUARANTEES: opens a new array, which then expects a value or its end
+void com_json_beginArray(com_json_Writer *w);
+
+/// REQUIRES: `w` is a valid pointer to a valid `com_json_Writer`
+/// REQUIRES: the innermost open value is an array
+/// GUARANTEES: closes the innermost array
+void com_json_endArray(com_json_Writer *w);
+
+/// REQUIRES: `w` is a valid pointer to a valid `com_json_Writer`
+/// REQUIRES: the innermost open value is an object, and is expecting a key
+/// GUARANTEES: writes `key`, after which the writer expects its value
+void com_json_key(com_json_Writer *w, com_str key);
+
+/// Each of these writes a single value
+/// REQUIRES: `w` is a valid pointer to a valid `com_json_Writer`
+/// REQUIRES: the writer is expecting a value
+/// GUARANTEES: com_json_writeFloat writes infinities and NaNs as null, since
+/// JSON cannot represent them
+void com_json_writeNull(com_json_Writer *w);
+void com_json_writeBool(com_json_Writer *w, bool value);
+void com_json_writeInt(com_json_Writer *w, i64 value);
+void com_json_writeUint(com_json_Writer *w, u64 value);
+void com_json_writeFloat(com_json_Writer *w, f64 value);
+void com_json_writeStr(com_json_Writer *w, com_str value);
+/// REQUIRES: `elem` is a valid pointer to a valid `com_json_Elem`
+void com_json_writeElem(com_json_Writer *w, com_json_Elem *elem);
+
+// Streaming JSON reader
+// Reads JSON from a com_reader one event at a time, without building a
+// com_json_Elem for the whole document. Memory use is bounded by the nesting
+// depth and the length of the longest string, not the size of the document.
+// After each top level value it reads the next one, if there is one, so it
+// can also read a stream of values, such as line delimited JSON.
+typedef enum {
+  com_json_EventBeginObj,
+  com_json_EventEndObj,
+  com_json_EventBeginArray,
+  com_json_EventEndArray,
+  // the key of a property, whose value is the next event
+  com_json_EventKey,
+  // a value that is not an array or object
+  com_json_EventValue,
+  // the reader has ended after a complete top level value
+  com_json_EventEof,
+} com_json_EventKind;
+
+typedef struct {
+  com_json_EventKind kind;
+  // only valid for com_json_EventKey, and only until the next event is read
+  com_str key;
+  // only valid for com_json_EventValue
+  // If it is a string, the string is only valid until the next event is read.
+  com_json_Elem value;
+  com_loc_Span span;
+} com_json_Event;
+
+// what a com_json_EventReader expects to read next
+typedef enum {
+  com_json_EventReaderValue,
+  // the first element of an array, or its end
+  com_json_EventReaderArrayStart,
+  // the first key of an object, or its end
+  com_json_EventReaderObjectStart,
+  com_json_EventReaderKey,
+  com_json_EventReaderCommaOrEnd,
+  // the reader ended early, so every open container is being ended
+  com_json_EventReaderUnwind,
+} com_json_EventReaderState;
+
+typedef struct {
+  com_reader *_reader;
+  com_vec *_diagnostics;
+  com_allocator *_allocator;
+  // one bool per open container, which is true if it is an object
+  com_vec _containers;
+  com_json_EventReaderState _state;
+  // holds the text of the last key or string value read
+  com_vec _buffer;
+} com_json_EventReader;
+
+/// REQUIRES: `reader` is a valid pointer to a valid buffered `com_reader`
+/// REQUIRES: `diagnostics` is a valid pointer to a valid `com_vec` of
+/// `com_json_Error`
+/// REQUIRES: `allocator` is a valid pointer to a `com_allocator` supporting
+/// com_allocator_NOLEAK and com_allocator_REALLOCABLE
+/// GUARANTEES: returns a `com_json_EventReader` that reads from `reader`
+com_json_EventReader com_json_eventReaderCreate(com_reader *reader,
+                                                com_vec *diagnostics,
+                                                com_allocator *allocator);
+
+/// REQUIRES: `r` is a valid pointer to a valid `com_json_EventReader`
+/// GUARANTEES: `r` is no longer valid, and the memory it held is released
+/// GUARANTEES: the underlying `com_reader` is not destroyed
+void com_json_eventReaderDestroy(com_json_EventReader *r);
+
+/// reads the next event
+/// REQUIRES: `r` is a valid pointer to a valid `com_json_EventReader`
+/// GUARANTEES: consumes no more of the reader than the event needs, so
+/// nothing after a top level value is read until the next call
+/// GUARANTEES: errors are pushed to the diagnostics, and recovered from
+/// GUARANTEES: every begin event is matched by an end event, even if the reader
+/// ends first
+com_json_Event com_json_nextEvent(com_json_EventReader *r);
+
+/// REQUIRES: `r` is a valid pointer to a valid `com_json_EventReader`
+/// GUARANTEES: returns the number of arrays and objects currently open
+usize com_json_eventReaderDepth(const com_json_EventReader *r);
+
 // converts an inputstream into a json DOM
+// reads a single value with a com_json_EventReader, and builds its DOM
 com_json_Elem com_json_parseElem(com_reader *reader, com_vec *diagnostics,
                                  com_allocator *allocator);
 
+/// converts a JSON document held entirely in memory into a json DOM
+/// Much faster than com_json_parseElem on large inputs, since it classifies
+/// 64 bytes at a time (with SSE2 where available) to find where each string,
+/// number, literal and structural character is before building the tree.
+/// REQUIRES: `source` is a valid `com_str`
+/// REQUIRES: `diagnostics` is a valid pointer to a valid `com_vec` of
+/// `com_json_Error`
+/// REQUIRES: `allocator` is a valid pointer to a `com_allocator` supporting
+/// com_allocator_NOLEAK
+/// GUARANTEES: returns the first value in `source`, which is the same tree
+/// com_json_parseElem would return when reading `source`
+/// GUARANTEES: unlike com_json_parseElem, stops at the first syntax error,
+/// leaving the value that failed as invalid inside whatever was already parsed
+/// GUARANTEES: a \u escape of a surrogate pair is decoded to one code point,
+/// as com_json_parseElem does
+/// GUARANTEES: the returned DOM does not refer to `source`
+com_json_Elem com_json_parseBuffer(com_str source, com_vec *diagnostics,
+                                   com_allocator *allocator);
+
+// A DOM parsed from an in-memory buffer, which owns all of its memory
+// Its arrays, objects and escaped strings are allocated from an arena, and its
+// strings without escapes point into the source buffer, so parsing it copies
+// as little as possible and destroying it frees everything at once.
+typedef struct {
+  com_json_Elem root;
+  com_allocator_arena_Backing _backing;
+  com_allocator _arena;
+} com_json_Document;
+
+/// parses a JSON document held entirely in memory, as com_json_parseBuffer does
+/// REQUIRES: `doc` is a valid pointer
+/// REQUIRES: `doc` is stored at the same address until it is destroyed
+/// REQUIRES: `source` is a valid `com_str`, which is not modified or freed
+/// until `doc` is destroyed
+/// REQUIRES: `diagnostics` is a valid pointer to a valid `com_vec` of
+/// `com_json_Error`
+/// REQUIRES: `allocator` is a valid pointer to a `com_allocator` supporting
+/// com_allocator_NOLEAK and com_allocator_REALLOCABLE
+/// REQUIRES: `allocator` outlives `doc`
+/// GUARANTEES: `doc->root` is the tree com_json_parseBuffer would return
+/// GUARANTEES: strings in `doc->root` may refer to `source`
+/// GUARANTEES: the memory used only while parsing is returned to `allocator`
+/// before this returns
+void com_json_parseDocument(com_json_Document *doc, com_str source,
+                            com_vec *diagnostics, com_allocator *allocator);
+
+/// frees all the memory held by `doc`
+/// REQUIRES: `doc` is a valid pointer to a `com_json_Document` which has not
+/// been destroyed
+/// GUARANTEES: every value and string in `doc->root` is invalidated
+void com_json_documentDestroy(com_json_Document *doc);
+
 #endif
@@ -12,6 +12,7 @@ static com_loc_LnCol lex_incrementCol(com_loc_LnCol position) {
 }
 
 typedef struct {
+  com_allocator_Handle handle;
   com_queue queue;
   com_reader *reader;
   com_loc_LnCol loc;
@@ -109,16 +110,25 @@ static u64 attr_NORETURN internal_query_fn(attr_UNUSED const com_reader *w) {
 static void internal_destroy_fn(com_reader *w) {
   BufferBacking *b = w->_backing;
   com_queue_destroy(&b->queue);
+  com_allocator_dealloc(b->handle);
   w->_valid = false;
 }
 
 com_reader com_reader_buffered(com_reader *r, com_allocator *a) {
-  BufferBacking *b = com_allocator_handle_get(com_allocator_alloc(
+  return com_reader_buffered_at(
+      r, a, com_loc_lncol_m(com_loc_ln_m(1), com_loc_col_m(1)));
+}
+
+com_reader com_reader_buffered_at(com_reader *r, com_allocator *a,
+                                  com_loc_LnCol start) {
+  com_allocator_Handle h = com_allocator_alloc(
       a, (com_allocator_HandleData){.len = sizeof(BufferBacking),
-                                    .flags = com_allocator_defaults(a)}));
+                                    .flags = com_allocator_defaults(a)});
+  BufferBacking *b = com_allocator_handle_get(h);
 
   *b = (BufferBacking){
-      .loc = com_loc_lncol_m(com_loc_ln_m(1), com_loc_col_m(1)),
+      .handle = h,
+      .loc = start,
       .reader = r,
       .queue = com_queue_create(com_vec_create(com_allocator_alloc(
           a, (com_allocator_HandleData){.len = 10,
@@ -12,5 +12,12 @@
 // REQUIRES: `a` is a valid pointer to a valid com_allocator
 com_reader com_reader_buffered(com_reader* r, com_allocator *a);
 
+// creates a new com_bufreader whose reported position begins at `start`
+// this is used to resume reading partway through a source whose position is already known
+// REQUIRES: `r` is a valid pointer to a valid com_reader
+// REQUIRES: `a` is a valid pointer to a valid com_allocator
+// GUARANTEES: the first byte read from `r` will be reported at `start`
+com_reader com_reader_buffered_at(com_reader* r, com_allocator *a, com_loc_LnCol start);
+
 #endif
 
@@ -46,6 +46,29 @@ com_scan_UntilResult com_scan_until(com_writer *destination, com_reader *source,
   return (com_scan_UntilResult){.successful = false};
 }
 
+// Returns the low surrogate that the next 6 characters of `reader` escape, or
+// 0 if they don't escape one
+static u32 internal_peek_low_surrogate(com_reader *reader) {
+  if (!(com_reader_flags(reader) & com_reader_BUFFERED)) {
+    return 0;
+  }
+  com_reader_ReadU8Result backslash = com_reader_peek_u8(reader, 1);
+  com_reader_ReadU8Result u = com_reader_peek_u8(reader, 2);
+  if (!backslash.valid || backslash.value != '\\' || !u.valid ||
+      u.value != 'u') {
+    return 0;
+  }
+  u32 code_point = 0;
+  for (usize i = 3; i <= 6; i++) {
+    com_reader_ReadU8Result digit = com_reader_peek_u8(reader, i);
+    if (!digit.valid || !com_format_is_hex(digit.value)) {
+      return 0;
+    }
+    code_point = code_point * 16 + com_format_from_hex(digit.value);
+  }
+  return code_point >= 0xDC00 && code_point <= 0xDFFF ? code_point : 0;
+}
+
 com_scan_CheckedStrResult
 com_scan_checked_str_until(com_writer *destination, com_reader *reader, u8 terminator) {
 
@@ -169,7 +192,18 @@ com_scan_checked_str_until(com_writer *destination, com_reader *reader, u8 termi
         }
 
         u8 value = com_format_from_hex(digit);
-        code_point += code_point * 16 + value;
+        code_point = code_point * 16 + value;
+      }
+      // a high surrogate followed by a low one encodes a single code point
+      // Anything else after a high surrogate is read on its own.
+      if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+        u32 low = internal_peek_low_surrogate(reader);
+        if (low != 0) {
+          for (usize i = 0; i < 6; i++) {
+            com_reader_drop_u8(reader);
+          }
+          code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+        }
       }
       com_format_append_utf_codepoint(destination, code_point);
       state = StringParserText;
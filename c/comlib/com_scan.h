@@ -47,6 +47,8 @@ typedef struct {
 /// REQUIRES: `source` is a valid pointer to a valid com_reader
 /// GUARANTEES: will read "characters" from reader until an unescaped `terminator` char is encountered
 /// GUARANTEES: will write the unescaped string to destination
+/// GUARANTEES: if `source` supports com_reader_BUFFERED, a \u escape of a
+/// surrogate pair is written as one code point
 /// GUARANTEES: will not write `terminator` into the destination
 /// GUARANTEES: if a syntax error is encountered, will immediately halt reading
 /// GUARANTEES: this operation is not atomic
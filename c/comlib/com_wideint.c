@@ -0,0 +1,508 @@
+#include "com_wideint.h"
+#include "com_assert.h"
+
+// the widest type, in u64 words
+#define MAX_WORDS 4
+
+// Word arithmetic
+// All operations work on arrays of `n` u64 words, least significant first, and
+// are instantiated for each width at the bottom of the file. Results are built
+// in a temporary before being written out, so `r` may alias the operands.
+
+// returns the low half of a * b, and sets *hi to the high half
+static u64 internal_mul_64(u64 a, u64 b, u64 *hi) {
+#if defined(__SIZEOF_INT128__)
+  __extension__ typedef unsigned __int128 u128;
+  u128 r = (u128)a * b;
+  *hi = (u64)(r >> 64);
+  return (u64)r;
+#else
+  u64 ha = a >> 32, hb = b >> 32, la = (u32)a, lb = (u32)b;
+  u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  u64 t = rl + (rm0 << 32);
+  u64 c = t < rl;
+  u64 lo = t + (rm1 << 32);
+  c += lo < t;
+  *hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+  return lo;
+#endif
+}
+
+// returns (hi:lo) / d, and sets *rem to (hi:lo) % d
+// REQUIRES: hi < d
+static u64 internal_div_128_64(u64 hi, u64 lo, u64 d, u64 *rem) {
+  if (hi == 0) {
+    // a native division is much cheaper than the double word one
+    *rem = lo % d;
+    return lo / d;
+  }
+#if defined(__SIZEOF_INT128__)
+  __extension__ typedef unsigned __int128 u128;
+  u128 n = ((u128)hi << 64) | lo;
+  *rem = (u64)(n % d);
+  return (u64)(n / d);
+#else
+  // restoring division, one bit at a time
+  u64 q = 0;
+  for (usize i = 0; i < 64; i++) {
+    bool top = hi >> 63;
+    hi = (hi << 1) | (lo >> 63);
+    lo <<= 1;
+    q <<= 1;
+    if (top || hi >= d) {
+      hi -= d;
+      q |= 1;
+    }
+  }
+  *rem = hi;
+  return q;
+#endif
+}
+
+static void internal_copy(u64 *r, const u64 *a, usize n) {
+  for (usize i = 0; i < n; i++) {
+    r[i] = a[i];
+  }
+}
+
+static bool internal_is_zero(const u64 *a, usize n) {
+  for (usize i = 0; i < n; i++) {
+    if (a[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// returns the number of bits needed to hold `a`, 0 for 0
+static usize internal_bit_len(const u64 *a, usize n) {
+  for (usize i = n; i-- > 0;) {
+    if (a[i] != 0) {
+      return i * 64 + 64 - (usize)__builtin_clzll(a[i]);
+    }
+  }
+  return 0;
+}
+
+// returns the number of trailing zero bits in `a`
+// REQUIRES: `a` != 0
+static usize internal_trailing_zeros(const u64 *a, usize n) {
+  usize i = 0;
+  while (i < n && a[i] == 0) {
+    i++;
+  }
+  com_assert_m(i < n, "a is zero");
+  return i * 64 + (usize)__builtin_ctzll(a[i]);
+}
+
+static com_math_cmptype internal_cmp(const u64 *a, const u64 *b, usize n) {
+  for (usize i = n; i-- > 0;) {
+    if (b[i] > a[i]) {
+      return com_math_GREATER;
+    } else if (b[i] < a[i]) {
+      return com_math_LESS;
+    }
+  }
+  return com_math_EQUAL;
+}
+
+// r := a + b, returns the carry out
+static bool internal_add(u64 *r, const u64 *a, const u64 *b, usize n) {
+  bool carry = false;
+  for (usize i = 0; i < n; i++) {
+    u64 s;
+    bool c1 = __builtin_add_overflow(a[i], b[i], &s);
+    bool c2 = __builtin_add_overflow(s, (u64)carry, &r[i]);
+    carry = c1 || c2;
+  }
+  return carry;
+}
+
+// r := a - b, returns the borrow out
+static bool internal_sub(u64 *r, const u64 *a, const u64 *b, usize n) {
+  bool borrow = false;
+  for (usize i = 0; i < n; i++) {
+    u64 d;
+    bool b1 = __builtin_sub_overflow(a[i], b[i], &d);
+    bool b2 = __builtin_sub_overflow(d, (u64)borrow, &r[i]);
+    borrow = b1 || b2;
+  }
+  return borrow;
+}
+
+// r := -a
+static void internal_negate(u64 *r, const u64 *a, usize n) {
+  bool carry = true;
+  for (usize i = 0; i < n; i++) {
+    r[i] = ~a[i] + carry;
+    carry = carry && r[i] == 0;
+  }
+}
+
+// r := a * b, returns true if any bits of the product did not fit
+static bool internal_mul(u64 *r, const u64 *a, const u64 *b, usize n) {
+  u64 t[MAX_WORDS] = {0};
+  bool overflow = false;
+  for (usize i = 0; i < n; i++) {
+    if (a[i] == 0) {
+      continue;
+    }
+    // a[i] * b[j] + carry + t[i + j] always fits in two words
+    u64 carry = 0;
+    for (usize j = 0; j < n; j++) {
+      u64 hi;
+      u64 lo = internal_mul_64(a[i], b[j], &hi);
+      lo += carry;
+      hi += lo < carry;
+      if (i + j < n) {
+        t[i + j] += lo;
+        hi += t[i + j] < lo;
+      } else {
+        overflow = overflow || lo != 0;
+      }
+      carry = hi;
+    }
+    overflow = overflow || carry != 0;
+  }
+  internal_copy(r, t, n);
+  return overflow;
+}
+
+// r := a << shift, returns true if a set bit was shifted out
+static bool internal_shl(u64 *r, const u64 *a, usize n, usize shift) {
+  usize bits = n * 64;
+  usize len = internal_bit_len(a, n);
+  bool lost = len != 0 && (shift >= bits || len > bits - shift);
+
+  u64 t[MAX_WORDS] = {0};
+  if (shift < bits) {
+    usize ws = shift / 64;
+    usize bs = shift % 64;
+    for (usize i = ws; i < n; i++) {
+      t[i] = a[i - ws] << bs;
+      if (bs != 0 && i > ws) {
+        t[i] |= a[i - ws - 1] >> (64 - bs);
+      }
+    }
+  }
+  internal_copy(r, t, n);
+  return lost;
+}
+
+// r := a >> shift, filling the vacated top bits with `fill`
+// REQUIRES: `fill` is 0 or u64_max_m
+// returns true if a set bit was shifted out
+static bool internal_shr(u64 *r, const u64 *a, usize n, usize shift,
+                         u64 fill) {
+  usize bits = n * 64;
+  bool lost = !internal_is_zero(a, n) && internal_trailing_zeros(a, n) < shift;
+
+  u64 t[MAX_WORDS];
+  if (shift >= bits) {
+    for (usize i = 0; i < n; i++) {
+      t[i] = fill;
+    }
+  } else {
+    usize ws = shift / 64;
+    usize bs = shift % 64;
+    for (usize i = 0; i < n; i++) {
+      u64 lo = i + ws < n ? a[i + ws] : fill;
+      u64 hi = i + ws + 1 < n ? a[i + ws + 1] : fill;
+      t[i] = bs == 0 ? lo : (lo >> bs) | (hi << (64 - bs));
+    }
+  }
+  internal_copy(r, t, n);
+  return lost;
+}
+
+// Knuth's Algorithm D (TAOCP Vol. 2, 4.3.1), with u64 words as digits
+// sets q to the `an - bn + 1` words of a / b, and r to the `bn` words of a % b
+// REQUIRES: `a` is `an` words long, `b` is `bn` words long
+// REQUIRES: the top word of `b` is nonzero, `bn` >= 2, `an` >= `bn`
+static void internal_div_rem_knuth(u64 *q, u64 *r, const u64 *a, usize an,
+                                   const u64 *b, usize bn) {
+  // normalize, so that the top bit of the divisor is set
+  usize s = (usize)__builtin_clzll(b[bn - 1]);
+  u64 vn[MAX_WORDS];
+  u64 un[MAX_WORDS + 1];
+  for (usize i = bn - 1; i > 0; i--) {
+    vn[i] = (b[i] << s) | (s == 0 ? 0 : b[i - 1] >> (64 - s));
+  }
+  vn[0] = b[0] << s;
+  un[an] = s == 0 ? 0 : a[an - 1] >> (64 - s);
+  for (usize i = an - 1; i > 0; i--) {
+    un[i] = (a[i] << s) | (s == 0 ? 0 : a[i - 1] >> (64 - s));
+  }
+  un[0] = a[0] << s;
+
+  for (usize j = an - bn + 1; j-- > 0;) {
+    // estimate the quotient word from the top two words of the remainder
+    // un[j + bn] <= vn[bn - 1] always holds here
+    u64 qhat;
+    u64 rhat;
+    bool rhat_overflow;
+    if (un[j + bn] == vn[bn - 1]) {
+      qhat = u64_max_m;
+      rhat_overflow =
+          __builtin_add_overflow(un[j + bn - 1], vn[bn - 1], &rhat);
+    } else {
+      qhat = internal_div_128_64(un[j + bn], un[j + bn - 1], vn[bn - 1],
+                                 &rhat);
+      rhat_overflow = false;
+    }
+    // refine it with the next word, after which it is at most 1 too large
+    while (!rhat_overflow) {
+      u64 phi;
+      u64 plo = internal_mul_64(qhat, vn[bn - 2], &phi);
+      if (phi < rhat || (phi == rhat && plo <= un[j + bn - 2])) {
+        break;
+      }
+      qhat--;
+      rhat_overflow = __builtin_add_overflow(rhat, vn[bn - 1], &rhat);
+    }
+
+    // un[j..j + bn] -= qhat * vn
+    u64 carry = 0;
+    bool borrow = false;
+    for (usize i = 0; i <= bn; i++) {
+      u64 phi = 0;
+      u64 plo = i < bn ? internal_mul_64(qhat, vn[i], &phi) : 0;
+      plo += carry;
+      phi += plo < carry;
+      carry = phi;
+      bool b1 = __builtin_sub_overflow(un[i + j], plo, &un[i + j]);
+      bool b2 = __builtin_sub_overflow(un[i + j], (u64)borrow, &un[i + j]);
+      borrow = b1 || b2;
+    }
+    if (borrow) {
+      // the estimate was 1 too large, so add one divisor back
+      qhat--;
+      bool c = false;
+      for (usize i = 0; i < bn; i++) {
+        u64 t;
+        bool c1 = __builtin_add_overflow(un[i + j], vn[i], &t);
+        bool c2 = __builtin_add_overflow(t, (u64)c, &un[i + j]);
+        c = c1 || c2;
+      }
+      un[j + bn] += c;
+    }
+    q[j] = qhat;
+  }
+
+  // denormalize the remainder
+  for (usize i = 0; i < bn; i++) {
+    r[i] = (un[i] >> s) | (s == 0 ? 0 : un[i + 1] << (64 - s));
+  }
+}
+
+// q := a / b, r := a % b, skipping either if NULL
+// REQUIRES: `b` != 0
+static void internal_div_rem(u64 *q, u64 *r, const u64 *a, const u64 *b,
+                             usize n) {
+  usize abits = internal_bit_len(a, n);
+  usize bbits = internal_bit_len(b, n);
+  com_assert_m(bbits != 0, "division by zero error");
+
+  u64 quot[MAX_WORDS] = {0};
+  u64 rem[MAX_WORDS] = {0};
+  if (abits < bbits) {
+    // b > a, so the quotient is 0 and the remainder is a
+    internal_copy(rem, a, n);
+  } else if (bbits <= 64) {
+    // a single word divisor goes a word at a time
+    u64 rem0 = 0;
+    for (usize i = (abits + 63) / 64; i-- > 0;) {
+      quot[i] = internal_div_128_64(rem0, a[i], b[0], &rem0);
+    }
+    rem[0] = rem0;
+  } else {
+    internal_div_rem_knuth(quot, rem, a, (abits + 63) / 64, b,
+                           (bbits + 63) / 64);
+  }
+  if (q != NULL) {
+    internal_copy(q, quot, n);
+  }
+  if (r != NULL) {
+    internal_copy(r, rem, n);
+  }
+}
+
+static bool internal_is_negative(const u64 *a, usize n) {
+  return a[n - 1] >> 63;
+}
+
+// sets r to |a|, and returns whether a was negative
+static bool internal_abs(u64 *r, const u64 *a, usize n) {
+  bool negative = internal_is_negative(a, n);
+  if (negative) {
+    internal_negate(r, a, n);
+  } else {
+    internal_copy(r, a, n);
+  }
+  return negative;
+}
+
+// the signed operations work on magnitudes, which fit an unsigned value even
+// for the most negative value, and then check the result is in range
+static bool internal_mul_signed(u64 *r, const u64 *a, const u64 *b, usize n) {
+  u64 ma[MAX_WORDS];
+  u64 mb[MAX_WORDS];
+  bool negative = internal_abs(ma, a, n) != internal_abs(mb, b, n);
+  u64 p[MAX_WORDS];
+  bool overflow = internal_mul(p, ma, mb, n);
+  if (!overflow && internal_is_negative(p, n)) {
+    // only the most negative value has its top bit set in magnitude form
+    overflow = !negative || internal_trailing_zeros(p, n) != n * 64 - 1;
+  }
+  if (negative) {
+    internal_negate(r, p, n);
+  } else {
+    internal_copy(r, p, n);
+  }
+  return overflow;
+}
+
+static bool internal_div_rem_signed(u64 *q, u64 *r, const u64 *a,
+                                    const u64 *b, usize n) {
+  u64 ma[MAX_WORDS];
+  u64 mb[MAX_WORDS];
+  bool a_negative = internal_abs(ma, a, n);
+  bool b_negative = internal_abs(mb, b, n);
+  u64 quot[MAX_WORDS];
+  u64 rem[MAX_WORDS];
+  internal_div_rem(quot, rem, ma, mb, n);
+  // a positive quotient with its top bit set can only be MIN / -1
+  bool overflow = a_negative == b_negative && internal_is_negative(quot, n);
+  if (a_negative != b_negative) {
+    internal_negate(quot, quot, n);
+  }
+  if (a_negative) {
+    internal_negate(rem, rem, n);
+  }
+  if (q != NULL) {
+    internal_copy(q, quot, n);
+  }
+  if (r != NULL) {
+    internal_copy(r, rem, n);
+  }
+  return overflow;
+}
+
+static com_math_cmptype internal_cmp_signed(const u64 *a, const u64 *b,
+                                            usize n) {
+  bool a_negative = internal_is_negative(a, n);
+  bool b_negative = internal_is_negative(b, n);
+  if (a_negative != b_negative) {
+    return a_negative ? com_math_GREATER : com_math_LESS;
+  }
+  // two's complement values of the same sign order like unsigned values
+  return internal_cmp(a, b, n);
+}
+
+#define GEN_TYPE_DEFS(w_type_m, n_m)                                           \
+  com_##w_type_m com_##w_type_m##_from_u64(u64 a) {                            \
+    return (com_##w_type_m){.words = {a}};                                     \
+  }                                                                            \
+  bool com_##w_type_m##_fits_u64(com_##w_type_m a) {                           \
+    return internal_bit_len(a.words, n_m) <= 64;                               \
+  }                                                                            \
+  bool com_##w_type_m##_is_zero(com_##w_type_m a) {                            \
+    return internal_is_zero(a.words, n_m);                                     \
+  }                                                                            \
+  com_math_cmptype com_##w_type_m##_cmp(com_##w_type_m a, com_##w_type_m b) {  \
+    return internal_cmp(a.words, b.words, n_m);                                \
+  }                                                                            \
+  bool com_##w_type_m##_add(com_##w_type_m *dest, com_##w_type_m a,            \
+                            com_##w_type_m b) {                                \
+    com_assert_m(dest != NULL, "dest is null");                                \
+    return internal_add(dest->words, a.words, b.words, n_m);                   \
+  }                                                                            \
+  bool com_##w_type_m##_sub(com_##w_type_m *dest, com_##w_type_m a,            \
+                            com_##w_type_m b) {                                \
+    com_assert_m(dest != NULL, "dest is null");                                \
+    return internal_sub(dest->words, a.words, b.words, n_m);                   \
+  }                                                                            \
+  bool com_##w_type_m##_mul(com_##w_type_m *dest, com_##w_type_m a,            \
+                            com_##w_type_m b) {                                \
+    com_assert_m(dest != NULL, "dest is null");                                \
+    return internal_mul(dest->words, a.words, b.words, n_m);                   \
+  }                                                                            \
+  bool com_##w_type_m##_shl(com_##w_type_m *dest, com_##w_type_m a,            \
+                            usize n) {                                         \
+    com_assert_m(dest != NULL, "dest is null");                                \
+    return internal_shl(dest->words, a.words, n_m, n);                         \
+  }                                                                            \
+  bool com_##w_type_m##_shr(com_##w_type_m *dest, com_##w_type_m a,            \
+                            usize n) {                                         \
+    com_assert_m(dest != NULL, "dest is null");                                \
+    return internal_shr(dest->words, a.words, n_m, n, 0);                      \
+  }                                                                            \
+  void com_##w_type_m##_div_rem(com_##w_type_m *quotient,                      \
+                                com_##w_type_m *remainder, com_##w_type_m a,   \
+                                com_##w_type_m b) {                            \
+    internal_div_rem(quotient == NULL ? NULL : quotient->words,                \
+                     remainder == NULL ? NULL : remainder->words, a.words,     \
+                     b.words, n_m);                                            \
+  }                                                                            \
+  com_##w_type_m com_##w_type_m##_rol(com_##w_type_m a, usize n) {             \
+    n %= n_m * 64;                                                             \
+    com_##w_type_m hi, lo;                                                     \
+    internal_shl(hi.words, a.words, n_m, n);                                   \
+    internal_shr(lo.words, a.words, n_m, n_m * 64 - n, 0);                     \
+    for (usize i = 0; i < n_m; i++) {                                          \
+      hi.words[i] |= lo.words[i];                                              \
+    }                                                                          \
+    return hi;                                                                 \
+  }                                                                            \
+  com_##w_type_m com_##w_type_m##_ror(com_##w_type_m a, usize n) {             \
+    return com_##w_type_m##_rol(a, n_m * 64 - n % (n_m * 64));                 \
+  }                                                                            \
+  bool com_##w_type_m##_is_negative(com_##w_type_m a) {                        \
+    return internal_is_negative(a.words, n_m);                                 \
+  }                                                                            \
+  com_##w_type_m com_##w_type_m##_negate(com_##w_type_m a) {                   \
+    internal_negate(a.words, a.words, n_m);                                    \
+    return a;                                                                  \
+  }                                                                            \
+  bool com_##w_type_m##_add_signed(com_##w_type_m *dest, com_##w_type_m a,     \
+                                   com_##w_type_m b) {                         \
+    com_assert_m(dest != NULL, "dest is null");                                \
+    bool a_negative = internal_is_negative(a.words, n_m);                      \
+    bool b_negative = internal_is_negative(b.words, n_m);                      \
+    internal_add(dest->words, a.words, b.words, n_m);                          \
+    return a_negative == b_negative &&                                         \
+           internal_is_negative(dest->words, n_m) != a_negative;               \
+  }                                                                            \
+  bool com_##w_type_m##_sub_signed(com_##w_type_m *dest, com_##w_type_m a,     \
+                                   com_##w_type_m b) {                         \
+    com_assert_m(dest != NULL, "dest is null");                                \
+    bool a_negative = internal_is_negative(a.words, n_m);                      \
+    bool b_negative = internal_is_negative(b.words, n_m);                      \
+    internal_sub(dest->words, a.words, b.words, n_m);                          \
+    return a_negative != b_negative &&                                         \
+           internal_is_negative(dest->words, n_m) != a_negative;               \
+  }                                                                            \
+  bool com_##w_type_m##_mul_signed(com_##w_type_m *dest, com_##w_type_m a,     \
+                                   com_##w_type_m b) {                         \
+    com_assert_m(dest != NULL, "dest is null");                                \
+    return internal_mul_signed(dest->words, a.words, b.words, n_m);            \
+  }                                                                            \
+  bool com_##w_type_m##_div_rem_signed(com_##w_type_m *quotient,               \
+                                       com_##w_type_m *remainder,              \
+                                       com_##w_type_m a, com_##w_type_m b) {   \
+    return internal_div_rem_signed(                                            \
+        quotient == NULL ? NULL : quotient->words,                             \
+        remainder == NULL ? NULL : remainder->words, a.words, b.words, n_m);   \
+  }                                                                            \
+  com_##w_type_m com_##w_type_m##_sar(com_##w_type_m a, usize n) {             \
+    u64 fill = internal_is_negative(a.words, n_m) ? u64_max_m : 0;             \
+    internal_shr(a.words, a.words, n_m, n, fill);                              \
+    return a;                                                                  \
+  }                                                                            \
+  com_math_cmptype com_##w_type_m##_cmp_signed(com_##w_type_m a,               \
+                                               com_##w_type_m b) {             \
+    return internal_cmp_signed(a.words, b.words, n_m);                         \
+  }
+
+GEN_TYPE_DEFS(u128, 2)
+GEN_TYPE_DEFS(u256, 4)
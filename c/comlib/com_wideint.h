@@ -0,0 +1,93 @@
+#ifndef COM_WIDEINT_H
+#define COM_WIDEINT_H
+
+// fixed size integers wider than a machine word
+// They live entirely on the stack, so arithmetic on them never allocates.
+// Every operation that can lose bits reports it through its return value, in
+// the same way as __builtin_add_overflow, and still writes the wrapped result.
+
+#include "com_define.h"
+#include "com_math.h"
+
+// the words are stored with the least significant word at the lowest index
+typedef struct {
+  u64 words[2];
+} com_u128;
+
+typedef struct {
+  u64 words[4];
+} com_u256;
+
+// For each width N, where com_uN is com_u128 or com_u256:
+//
+// com_uN_from_u64(a): returns `a` zero extended to N bits
+// com_uN_fits_u64(a): returns true if the value of `a` is at most u64_max_m
+// com_uN_is_zero(a): returns true if `a` is 0
+// com_uN_cmp(a, b): compares `b` with reference to `a`, like com_biguint_cmp
+//
+// Unsigned operations, which return true if the result overflowed:
+// com_uN_add(dest, a, b): *dest := a + b mod 2^N
+// com_uN_sub(dest, a, b): *dest := a - b mod 2^N, overflows if b > a
+// com_uN_mul(dest, a, b): *dest := a * b mod 2^N
+// com_uN_shl(dest, a, n): *dest := a << n, overflows if a set bit is lost
+// com_uN_shr(dest, a, n): *dest := a >> n, overflows if a set bit is lost
+// com_uN_div_rem(quotient, remainder, a, b):
+//   REQUIRES: `b` != 0, `quotient` and `remainder` may be NULL
+//   *quotient := a / b, *remainder := a % b, never overflows
+//
+// Rotations, which cannot overflow:
+// com_uN_rol(a, n): returns `a` rotated left by n mod N bits
+// com_uN_ror(a, n): returns `a` rotated right by n mod N bits
+//
+// Signed operations, treating the bits as N bit two's complement:
+// com_uN_is_negative(a): returns true if the top bit of `a` is set
+// com_uN_negate(a): returns -a mod 2^N
+// com_uN_add_signed(dest, a, b): like add, overflows outside the signed range
+// com_uN_sub_signed(dest, a, b): like sub, overflows outside the signed range
+// com_uN_mul_signed(dest, a, b): like mul, overflows outside the signed range
+// com_uN_div_rem_signed(quotient, remainder, a, b):
+//   REQUIRES: `b` != 0, `quotient` and `remainder` may be NULL
+//   rounds the quotient towards zero, and the remainder takes the sign of `a`
+//   overflows only when dividing the most negative value by -1
+// com_uN_sar(a, n): returns `a` shifted right by n, copying the sign bit
+// com_uN_cmp_signed(a, b): compares `b` with reference to `a`
+
+#define DEFINE_TYPE(w_type_m)                                                  \
+  com_##w_type_m com_##w_type_m##_from_u64(u64 a);                             \
+  bool com_##w_type_m##_fits_u64(com_##w_type_m a);                            \
+  bool com_##w_type_m##_is_zero(com_##w_type_m a);                             \
+  com_math_cmptype com_##w_type_m##_cmp(com_##w_type_m a, com_##w_type_m b);   \
+  bool com_##w_type_m##_add(com_##w_type_m *dest, com_##w_type_m a,            \
+                            com_##w_type_m b);                                 \
+  bool com_##w_type_m##_sub(com_##w_type_m *dest, com_##w_type_m a,            \
+                            com_##w_type_m b);                                 \
+  bool com_##w_type_m##_mul(com_##w_type_m *dest, com_##w_type_m a,            \
+                            com_##w_type_m b);                                 \
+  bool com_##w_type_m##_shl(com_##w_type_m *dest, com_##w_type_m a, usize n);  \
+  bool com_##w_type_m##_shr(com_##w_type_m *dest, com_##w_type_m a, usize n);  \
+  void com_##w_type_m##_div_rem(com_##w_type_m *quotient,                      \
+                                com_##w_type_m *remainder, com_##w_type_m a,   \
+                                com_##w_type_m b);                             \
+  com_##w_type_m com_##w_type_m##_rol(com_##w_type_m a, usize n);              \
+  com_##w_type_m com_##w_type_m##_ror(com_##w_type_m a, usize n);              \
+  bool com_##w_type_m##_is_negative(com_##w_type_m a);                         \
+  com_##w_type_m com_##w_type_m##_negate(com_##w_type_m a);                    \
+  bool com_##w_type_m##_add_signed(com_##w_type_m *dest, com_##w_type_m a,     \
+                                   com_##w_type_m b);                          \
+  bool com_##w_type_m##_sub_signed(com_##w_type_m *dest, com_##w_type_m a,     \
+                                   com_##w_type_m b);                          \
+  bool com_##w_type_m##_mul_signed(com_##w_type_m *dest, com_##w_type_m a,     \
+                                   com_##w_type_m b);                          \
+  bool com_##w_type_m##_div_rem_signed(com_##w_type_m *quotient,               \
+                                       com_##w_type_m *remainder,              \
+                                       com_##w_type_m a, com_##w_type_m b);    \
+  com_##w_type_m com_##w_type_m##_sar(com_##w_type_m a, usize n);              \
+  com_math_cmptype com_##w_type_m##_cmp_signed(com_##w_type_m a,               \
+                                               com_##w_type_m b);
+
+DEFINE_TYPE(u128)
+DEFINE_TYPE(u256)
+
+#undef DEFINE_TYPE
+
+#endif
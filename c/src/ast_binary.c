@@ -0,0 +1,390 @@
+#include "ast_binary.h"
+
+#include "com_allocator.h"
+#include "com_assert.h"
+#include "com_bigdecimal.h"
+#include "com_bigint.h"
+#include "com_mem.h"
+#include "com_vec.h"
+#include "com_writer.h"
+
+#include "diagnostic.h"
+
+typedef struct {
+  com_allocator *a;
+  // Vector<u32>
+  com_vec roots;
+  // Vector<ast_BinNode>
+  com_vec nodes;
+  // Vector<ast_BinMetadata>
+  com_vec metadata;
+  // Vector<u32>
+  com_vec words;
+  // Vector<u8>
+  com_vec strings;
+} BinBuilder;
+
+static com_vec bin_vec_create(com_allocator *a) {
+  return com_vec_create(com_allocator_alloc(
+      a, (com_allocator_HandleData){.len = 64,
+                                    .flags = com_allocator_defaults(a) |
+                                             com_allocator_NOLEAK |
+                                             com_allocator_REALLOCABLE}));
+}
+
+static u32 bin_u32(usize val) {
+  com_assert_m(val < u32_max_m, "value is too large for the binary format");
+  return (u32)val;
+}
+
+static ast_BinSpan bin_span(com_loc_Span span) {
+  return (ast_BinSpan){.start_ln = bin_u32(span.start.ln.val),
+                       .start_col = bin_u32(span.start.col.val),
+                       .end_ln = bin_u32(span.end.ln.val),
+                       .end_col = bin_u32(span.end.col.val)};
+}
+
+// appends the string to the string table and returns its offset
+static u32 bin_string(BinBuilder *b, com_str str) {
+  u32 offset = bin_u32(com_vec_len_m(&b->strings, u8));
+  com_mem_move(com_vec_push(&b->strings, str.len), str.data, str.len);
+  return offset;
+}
+
+static ast_BinNode *bin_push(BinBuilder *b, ast_BinNodeKind node_kind, u8 kind,
+                             com_loc_Span span, u32 *index) {
+  *index = bin_u32(com_vec_len_m(&b->nodes, ast_BinNode));
+  ast_BinNode *node = com_vec_push_m(&b->nodes, ast_BinNode);
+  *node = (ast_BinNode){.span = bin_span(span),
+                        .node_kind = (u8)node_kind,
+                        .kind = kind,
+                        .data = {ast_BIN_NONE, ast_BIN_NONE, ast_BIN_NONE}};
+  return node;
+}
+
+static u32 bin_Identifier(BinBuilder *b, ast_Identifier *identifier) {
+  u32 name_offset = 0;
+  u32 name_len = 0;
+  if (identifier->kind == ast_IK_Identifier) {
+    name_offset = bin_string(b, identifier->id.name);
+    name_len = bin_u32(identifier->id.name.len);
+  }
+  u32 index;
+  ast_BinNode *node = bin_push(b, ast_BNK_Identifier, (u8)identifier->kind,
+                               identifier->span, &index);
+  node->data[0] = name_offset;
+  node->data[1] = name_len;
+  return index;
+}
+
+static u32 bin_Label(BinBuilder *b, ast_Label *label) {
+  u32 label_offset = 0;
+  u32 label_len = 0;
+  if (label->kind == ast_LK_Label) {
+    label_offset = bin_string(b, label->label.label);
+    label_len = bin_u32(label->label.label.len);
+  }
+  u32 index;
+  ast_BinNode *node =
+      bin_push(b, ast_BNK_Label, (u8)label->kind, label->span, &index);
+  node->data[0] = label_offset;
+  node->data[1] = label_len;
+  return index;
+}
+
+static u32 bin_Expr(BinBuilder *b, ast_Expr *expr) {
+  if (expr == NULL) {
+    return ast_BIN_NONE;
+  }
+
+  // children are written before their parent, so the node is pushed last
+  u32 data[3] = {ast_BIN_NONE, ast_BIN_NONE, ast_BIN_NONE};
+  u8 aux = 0;
+
+  switch (expr->kind) {
+  case ast_EK_None:
+  case ast_EK_Nil:
+  case ast_EK_NilType:
+  case ast_EK_NeverType:
+  case ast_EK_BindIgnore:
+  case ast_EK_BindSplat: {
+    break;
+  }
+  case ast_EK_Bool: {
+    aux = expr->boolLiteral.value;
+    break;
+  }
+  case ast_EK_Int: {
+    com_bigint *v = &expr->intLiteral.value;
+    aux = com_bigint_sign(v) == com_math_NEGATIVE;
+    data[0] = bin_u32(com_vec_len_m(&b->words, u32));
+    data[1] = bin_u32(com_bigint_len(v));
+    for (usize i = 0; i < com_bigint_len(v); i++) {
+      *com_vec_push_m(&b->words, u32) = com_bigint_get_at(v, i);
+    }
+    break;
+  }
+  case ast_EK_Real: {
+    com_bigdecimal *v = &expr->realLiteral.value;
+    aux = com_bigdecimal_sign(v) == com_math_NEGATIVE;
+    data[0] = bin_u32(com_vec_len_m(&b->words, u32));
+    data[1] = bin_u32(com_bigdecimal_len(v));
+    data[2] = bin_u32(com_bigdecimal_get_precision(v));
+    for (usize i = 0; i < com_bigdecimal_len(v); i++) {
+      *com_vec_push_m(&b->words, u32) = com_bigdecimal_get_at(v, i);
+    }
+    break;
+  }
+  case ast_EK_String: {
+    aux = (u8)expr->stringLiteral.kind;
+    data[0] = bin_string(b, expr->stringLiteral.value);
+    data[1] = bin_u32(expr->stringLiteral.value.len);
+    break;
+  }
+  case ast_EK_Struct: {
+    data[0] = bin_Expr(b, expr->structLiteral.expr);
+    break;
+  }
+  case ast_EK_Loop: {
+    data[0] = bin_Expr(b, expr->loop.body);
+    break;
+  }
+  case ast_EK_Val: {
+    data[0] = bin_Expr(b, expr->val.val);
+    break;
+  }
+  case ast_EK_Pat: {
+    data[0] = bin_Expr(b, expr->pat.pat);
+    break;
+  }
+  case ast_EK_Label: {
+    data[0] = bin_Label(b, expr->label.label);
+    data[1] = bin_Expr(b, expr->label.val);
+    break;
+  }
+  case ast_EK_Reference: {
+    data[0] = bin_Identifier(b, expr->reference.reference);
+    break;
+  }
+  case ast_EK_BinaryOp: {
+    aux = (u8)expr->binaryOp.op;
+    data[0] = bin_Expr(b, expr->binaryOp.left_operand);
+    data[1] = bin_Expr(b, expr->binaryOp.right_operand);
+    break;
+  }
+  case ast_EK_Ret: {
+    data[0] = bin_Expr(b, expr->ret.expr);
+    data[1] = bin_Label(b, expr->ret.label);
+    break;
+  }
+  case ast_EK_CaseOf: {
+    data[0] = bin_Expr(b, expr->caseof.expr);
+    data[1] = bin_Expr(b, expr->caseof.cases);
+    break;
+  }
+  case ast_EK_IfThen: {
+    data[0] = bin_Expr(b, expr->ifthen.expr);
+    data[1] = bin_Expr(b, expr->ifthen.then_expr);
+    data[2] = bin_Expr(b, expr->ifthen.else_expr);
+    break;
+  }
+  case ast_EK_Group: {
+    data[0] = bin_Expr(b, expr->group.expr);
+    break;
+  }
+  case ast_EK_Defer: {
+    data[0] = bin_Label(b, expr->defer.label);
+    data[1] = bin_Expr(b, expr->defer.val);
+    break;
+  }
+  case ast_EK_Bind: {
+    data[0] = bin_Identifier(b, expr->bind.bind);
+    break;
+  }
+  }
+
+  u32 metadata_index = bin_u32(com_vec_len_m(&b->metadata, ast_BinMetadata));
+  for (usize i = 0; i < expr->common.metadata_len; i++) {
+    ast_Metadata m = expr->common.metadata[i];
+    u32 data_offset = bin_string(b, m.data);
+    *com_vec_push_m(&b->metadata, ast_BinMetadata) =
+        (ast_BinMetadata){.span = bin_span(m.span),
+                          .data_offset = data_offset,
+                          .data_len = bin_u32(m.data.len),
+                          .significant = m.significant};
+  }
+
+  u32 index;
+  ast_BinNode *node =
+      bin_push(b, ast_BNK_Expr, (u8)expr->kind, expr->common.span, &index);
+  node->aux = aux;
+  node->metadata_index = metadata_index;
+  node->metadata_len = bin_u32(expr->common.metadata_len);
+  node->data[0] = data[0];
+  node->data[1] = data[1];
+  node->data[2] = data[2];
+  return index;
+}
+
+static usize bin_align(usize offset) { return (offset + 7) & ~(usize)7; }
+
+// lays out a section at `*offset` and advances it past the section
+static ast_BinSection bin_section(usize *offset, usize len, usize elem_size) {
+  ast_BinSection section = {.offset = *offset, .len = len};
+  *offset = bin_align(*offset + len * elem_size);
+  return section;
+}
+
+// writes the bytes of `vec`, followed by padding up to the next section
+static void bin_emit(com_writer *writer, com_vec *vec) {
+  usize len = com_vec_len_m(vec, u8);
+  com_writer_append_str(
+      writer, (com_str){.data = com_vec_get_m(vec, 0, u8), .len = len});
+  for (usize i = len; i < bin_align(len); i++) {
+    com_writer_append_u8(writer, 0);
+  }
+}
+
+void ast_binWrite(ast_Expr *const *roots, usize roots_len, com_allocator *a,
+                  com_writer *writer) {
+  BinBuilder b = {.a = a,
+                  .roots = bin_vec_create(a),
+                  .nodes = bin_vec_create(a),
+                  .metadata = bin_vec_create(a),
+                  .words = bin_vec_create(a),
+                  .strings = bin_vec_create(a)};
+
+  for (usize i = 0; i < roots_len; i++) {
+    u32 root = bin_Expr(&b, roots[i]);
+    *com_vec_push_m(&b.roots, u32) = root;
+  }
+
+  usize offset = bin_align(sizeof(ast_BinHeader));
+  ast_BinHeader header = {
+      .magic = ast_BIN_MAGIC,
+      .version = ast_BIN_VERSION,
+      .byte_order = ast_BIN_BYTE_ORDER,
+      ._reserved = 0,
+  };
+  header.roots =
+      bin_section(&offset, com_vec_len_m(&b.roots, u32), sizeof(u32));
+  header.nodes = bin_section(&offset, com_vec_len_m(&b.nodes, ast_BinNode),
+                             sizeof(ast_BinNode));
+  header.metadata =
+      bin_section(&offset, com_vec_len_m(&b.metadata, ast_BinMetadata),
+                  sizeof(ast_BinMetadata));
+  header.words =
+      bin_section(&offset, com_vec_len_m(&b.words, u32), sizeof(u32));
+  header.strings =
+      bin_section(&offset, com_vec_len_m(&b.strings, u8), sizeof(u8));
+
+  com_writer_append_str(writer, (com_str){.data = (const u8 *)&header,
+                                          .len = sizeof(ast_BinHeader)});
+  for (usize i = sizeof(ast_BinHeader); i < bin_align(sizeof(ast_BinHeader));
+       i++) {
+    com_writer_append_u8(writer, 0);
+  }
+  bin_emit(writer, &b.roots);
+  bin_emit(writer, &b.nodes);
+  bin_emit(writer, &b.metadata);
+  bin_emit(writer, &b.words);
+  bin_emit(writer, &b.strings);
+
+  com_vec_destroy(&b.roots);
+  com_vec_destroy(&b.nodes);
+  com_vec_destroy(&b.metadata);
+  com_vec_destroy(&b.words);
+  com_vec_destroy(&b.strings);
+}
+
+void ast_binStream(ast_Constructor *parser, com_allocator *a,
+                   com_writer *writer) {
+  // Vector<ast_Expr*>
+  com_vec roots = bin_vec_create(a);
+  while (true) {
+    DiagnosticLogger dlogger = dlogger_create(a);
+    bool eof = ast_eof(parser, &dlogger);
+    if (!eof) {
+      *com_vec_push_m(&roots, ast_Expr *) = ast_parseExpr(&dlogger, parser);
+    }
+    dlogger_destroy(&dlogger);
+    if (eof) {
+      break;
+    }
+  }
+
+  ast_binWrite(com_vec_get_m(&roots, 0, ast_Expr *),
+               com_vec_len_m(&roots, ast_Expr *), a, writer);
+  com_vec_destroy(&roots);
+}
+
+// checks that a section of `len` elements of `elem_size` fits in the data
+static bool bin_section_ok(ast_BinSection section, usize elem_size,
+                           usize data_len) {
+  return section.offset % 8 == 0 && section.offset <= data_len &&
+         section.len <= (data_len - section.offset) / elem_size;
+}
+
+ast_BinLoadResult ast_binLoad(com_str data) {
+  ast_BinLoadResult invalid = {.valid = false};
+  if (data.len < sizeof(ast_BinHeader) || (usize)data.data % 8 != 0) {
+    return invalid;
+  }
+  const ast_BinHeader *header = (const ast_BinHeader *)data.data;
+  const u8 magic[] = ast_BIN_MAGIC;
+  if (!com_str_equal((com_str){.data = header->magic, .len = sizeof(magic)},
+                     (com_str){.data = magic, .len = sizeof(magic)}) ||
+      header->version != ast_BIN_VERSION ||
+      header->byte_order != ast_BIN_BYTE_ORDER) {
+    return invalid;
+  }
+  if (!bin_section_ok(header->roots, sizeof(u32), data.len) ||
+      !bin_section_ok(header->nodes, sizeof(ast_BinNode), data.len) ||
+      !bin_section_ok(header->metadata, sizeof(ast_BinMetadata), data.len) ||
+      !bin_section_ok(header->words, sizeof(u32), data.len) ||
+      !bin_section_ok(header->strings, sizeof(u8), data.len)) {
+    return invalid;
+  }
+  return (ast_BinLoadResult){
+      .valid = true,
+      .value = (ast_BinView){._base = data.data, ._header = header}};
+}
+
+usize ast_binRootsLen(const ast_BinView *view) {
+  return view->_header->roots.len;
+}
+
+u32 ast_binRoot(const ast_BinView *view, usize i) {
+  com_assert_m(i < view->_header->roots.len, "root index out of bounds");
+  const u32 *roots = (const u32 *)(view->_base + view->_header->roots.offset);
+  return roots[i];
+}
+
+const ast_BinNode *ast_binNode(const ast_BinView *view, u32 i) {
+  com_assert_m(i < view->_header->nodes.len, "node index out of bounds");
+  const ast_BinNode *nodes =
+      (const ast_BinNode *)(view->_base + view->_header->nodes.offset);
+  return &nodes[i];
+}
+
+const ast_BinMetadata *ast_binMetadata(const ast_BinView *view, u32 i) {
+  com_assert_m(i < view->_header->metadata.len, "metadata index out of bounds");
+  const ast_BinMetadata *metadata =
+      (const ast_BinMetadata *)(view->_base + view->_header->metadata.offset);
+  return &metadata[i];
+}
+
+const u32 *ast_binWords(const ast_BinView *view, u32 i, u32 len) {
+  com_assert_m((u64)i + len <= view->_header->words.len,
+               "words out of bounds");
+  const u32 *words = (const u32 *)(view->_base + view->_header->words.offset);
+  return &words[i];
+}
+
+com_str ast_binString(const ast_BinView *view, u32 offset, u32 len) {
+  com_assert_m((u64)offset + len <= view->_header->strings.len,
+               "string out of bounds");
+  return (com_str){
+      .data = view->_base + view->_header->strings.offset + offset,
+      .len = len};
+}
@@ -0,0 +1,162 @@
+#ifndef AST_BINARY_H
+#define AST_BINARY_H
+
+#include "ast.h"
+
+#include "com_allocator.h"
+#include "com_define.h"
+#include "com_str.h"
+#include "com_writer.h"
+#include "tokens_to_ast.h"
+
+// Compact binary encoding of the ast.
+//
+// The file is laid out as a header followed by sections. Every section begins
+// on an 8 byte boundary, and contains a packed array of fixed size records, so
+// a loaded file can be used in place (for example straight out of mmap)
+// without decoding each node.
+//
+// Nodes are written children first, and refer to their children, metadata,
+// bigint words, and strings by index. The byte order of the writer is recorded
+// in the header, and files with a different byte order are rejected.
+
+// initializer for the first 4 bytes of every file, which are "ACNB" in ASCII
+#define ast_BIN_MAGIC {0x41, 0x43, 0x4E, 0x42}
+#define ast_BIN_VERSION 1
+#define ast_BIN_BYTE_ORDER 0x01020304u
+// index used when a node has no child in that position
+#define ast_BIN_NONE u32_max_m
+
+typedef struct {
+  // offset in bytes from the beginning of the file
+  u64 offset;
+  // number of records in the section
+  u64 len;
+} ast_BinSection;
+
+typedef struct {
+  u8 magic[4];
+  u32 version;
+  u32 byte_order;
+  u32 _reserved;
+  // u32 indexes of the top level expressions
+  ast_BinSection roots;
+  // ast_BinNode
+  ast_BinSection nodes;
+  // ast_BinMetadata
+  ast_BinSection metadata;
+  // u32 words of bigints and bigdecimals, least significant first
+  ast_BinSection words;
+  // u8 bytes of all strings
+  ast_BinSection strings;
+} ast_BinHeader;
+
+typedef struct {
+  u32 start_ln;
+  u32 start_col;
+  u32 end_ln;
+  u32 end_col;
+} ast_BinSpan;
+
+typedef enum {
+  ast_BNK_Expr,
+  ast_BNK_Identifier,
+  ast_BNK_Label,
+} ast_BinNodeKind;
+
+// The meaning of `aux` and `data` depends on the kind of node:
+// Identifier, Label: data = {string offset, string len}
+// Bool: aux = value
+// String: aux = tk_StringLiteralKind, data = {string offset, string len}
+// Int: aux = negative, data = {word index, word count}
+// Real: aux = negative, data = {word index, word count, precision}
+// Every other expression: data = node indexes of the fields of the matching
+// ast_Expr union member in declaration order, with aux = ast_ExprBinaryOpKind
+// for binary operations
+typedef struct {
+  ast_BinSpan span;
+  // ast_BinNodeKind
+  u8 node_kind;
+  // ast_ExprKind, ast_IdentifierKind, or ast_LabelKind
+  u8 kind;
+  u8 aux;
+  u8 _reserved;
+  // range of the node's metadata in the metadata section
+  u32 metadata_index;
+  u32 metadata_len;
+  u32 data[3];
+} ast_BinNode;
+
+typedef struct {
+  ast_BinSpan span;
+  u32 data_offset;
+  u32 data_len;
+  u32 significant;
+} ast_BinMetadata;
+
+typedef struct {
+  const u8 *_base;
+  const ast_BinHeader *_header;
+} ast_BinView;
+
+typedef struct {
+  bool valid;
+  ast_BinView value;
+} ast_BinLoadResult;
+
+/// writes `roots` and all of their children to `writer`
+/// REQUIRES: `roots` is a valid pointer to `roots_len` valid `ast_Expr` pointers
+/// REQUIRES: `a` is a valid pointer to a valid `com_allocator`
+/// REQUIRES: `writer` is a valid pointer to a valid `com_writer`
+/// GUARANTEES: the bytes written can be loaded with `ast_binLoad`
+/// GUARANTEES: temporary memory is allocated from `a` and freed before returning
+void ast_binWrite(ast_Expr *const *roots, usize roots_len, com_allocator *a,
+                  com_writer *writer);
+
+/// parses every expression in `parser` and writes them to `writer`
+/// REQUIRES: `parser` is a valid pointer to a valid `ast_Constructor`
+/// REQUIRES: `a` is a valid pointer to a valid `com_allocator`
+/// REQUIRES: `writer` is a valid pointer to a valid `com_writer`
+/// GUARANTEES: the bytes written can be loaded with `ast_binLoad`
+void ast_binStream(ast_Constructor *parser, com_allocator *a,
+                   com_writer *writer);
+
+/// checks the header and the section bounds of `data`
+/// REQUIRES: `data` is a valid com_str whose data is 8 byte aligned
+/// REQUIRES: the nodes in `data` were written by `ast_binWrite`
+/// GUARANTEES: if `data` has a valid header, returns .valid=true and .value=a
+/// view that reads directly from `data`
+/// GUARANTEES: otherwise returns .valid=false
+/// GUARANTEES: does not allocate or read any records
+ast_BinLoadResult ast_binLoad(com_str data);
+
+/// REQUIRES: `view` is a valid pointer to a valid `ast_BinView`
+/// GUARANTEES: returns the number of top level expressions
+usize ast_binRootsLen(const ast_BinView *view);
+
+/// REQUIRES: `view` is a valid pointer to a valid `ast_BinView`
+/// REQUIRES: `i` < `ast_binRootsLen(view)`
+/// GUARANTEES: returns the node index of the `i`th top level expression
+u32 ast_binRoot(const ast_BinView *view, usize i);
+
+/// REQUIRES: `view` is a valid pointer to a valid `ast_BinView`
+/// REQUIRES: `i` is a valid node index in `view`
+/// GUARANTEES: returns a pointer to the node, valid as long as the loaded data
+const ast_BinNode *ast_binNode(const ast_BinView *view, u32 i);
+
+/// REQUIRES: `view` is a valid pointer to a valid `ast_BinView`
+/// REQUIRES: `i` is a valid metadata index in `view`
+/// GUARANTEES: returns a pointer to the metadata, valid as long as the loaded data
+const ast_BinMetadata *ast_binMetadata(const ast_BinView *view, u32 i);
+
+/// REQUIRES: `view` is a valid pointer to a valid `ast_BinView`
+/// REQUIRES: `i` and `len` describe a range in the word section
+/// GUARANTEES: returns a pointer to the `len` words beginning at `i`
+const u32 *ast_binWords(const ast_BinView *view, u32 i, u32 len);
+
+/// REQUIRES: `view` is a valid pointer to a valid `ast_BinView`
+/// REQUIRES: `offset` and `len` describe a range in the string section
+/// GUARANTEES: returns a com_str pointing into the loaded data
+com_str ast_binString(const ast_BinView *view, u32 offset, u32 len);
+
+#endif
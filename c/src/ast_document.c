@@ -0,0 +1,450 @@
+#include "ast_document.h"
+
+#include "com_allocator.h"
+#include "com_assert.h"
+#include "com_loc.h"
+#include "com_mem.h"
+#include "com_reader_buffered.h"
+#include "com_reader_str.h"
+#include "com_vec.h"
+
+#include "tokens_to_ast.h"
+
+// a byte offset into the source along with its position
+typedef struct {
+  usize offset;
+  com_loc_LnCol loc;
+} Cursor;
+
+// maps positions at or after `old_end` in the old text to the new text
+typedef struct {
+  com_loc_LnCol old_end;
+  com_loc_LnCol new_end;
+  isize delta_offset;
+} Shift;
+
+static com_vec internal_vec_create(com_allocator *a, usize len) {
+  return com_vec_create(com_allocator_alloc(
+      a, (com_allocator_HandleData){.len = len,
+                                    .flags = com_allocator_defaults(a) |
+                                             com_allocator_NOLEAK |
+                                             com_allocator_REALLOCABLE}));
+}
+
+static bool internal_lncol_less(com_loc_LnCol a, com_loc_LnCol b) {
+  return a.ln.val < b.ln.val || (a.ln.val == b.ln.val && a.col.val < b.col.val);
+}
+
+static com_loc_LnCol internal_step(com_loc_LnCol loc, u8 c) {
+  if (c == '\n') {
+    return com_loc_lncol_m(com_loc_ln_m(loc.ln.val + 1), com_loc_col_m(1));
+  } else {
+    return com_loc_lncol_m(loc.ln, com_loc_col_m(loc.col.val + 1));
+  }
+}
+
+// moves `c` forward through `source` until it reaches `target`
+// positions past the end of a line are clamped to that line's newline
+static void internal_advance(com_str source, Cursor *c, com_loc_LnCol target) {
+  while (c->offset < source.len && internal_lncol_less(c->loc, target)) {
+    u8 b = source.data[c->offset];
+    if (b == '\n' && c->loc.ln.val == target.ln.val) {
+      break;
+    }
+    c->loc = internal_step(c->loc, b);
+    c->offset++;
+  }
+}
+
+static com_loc_LnCol internal_shift_lncol(const Shift *s, com_loc_LnCol p) {
+  if (p.ln.val == s->old_end.ln.val) {
+    return com_loc_lncol_m(
+        s->new_end.ln,
+        com_loc_col_m(s->new_end.col.val + (p.col.val - s->old_end.col.val)));
+  } else {
+    return com_loc_lncol_m(
+        com_loc_ln_m(p.ln.val + s->new_end.ln.val - s->old_end.ln.val), p.col);
+  }
+}
+
+static com_loc_Span internal_shift_span(const Shift *s, com_loc_Span span) {
+  return com_loc_span_m(internal_shift_lncol(s, span.start),
+                        internal_shift_lncol(s, span.end));
+}
+
+static void internal_shift_common(const Shift *s, ast_Common *common) {
+  common->span = internal_shift_span(s, common->span);
+  for (usize i = 0; i < common->metadata_len; i++) {
+    common->metadata[i].span = internal_shift_span(s, common->metadata[i].span);
+  }
+}
+
+static void internal_shift_expr(const Shift *s, ast_Expr *expr) {
+  if (expr == NULL) {
+    return;
+  }
+  internal_shift_common(s, &expr->common);
+  switch (expr->kind) {
+  case ast_EK_None:
+  case ast_EK_Nil:
+  case ast_EK_NilType:
+  case ast_EK_NeverType:
+  case ast_EK_Int:
+  case ast_EK_Bool:
+  case ast_EK_Real:
+  case ast_EK_String:
+  case ast_EK_BindIgnore:
+  case ast_EK_BindSplat: {
+    break;
+  }
+  case ast_EK_Bind: {
+    expr->bind.bind->span = internal_shift_span(s, expr->bind.bind->span);
+    break;
+  }
+  case ast_EK_Reference: {
+    expr->reference.reference->span =
+        internal_shift_span(s, expr->reference.reference->span);
+    break;
+  }
+  case ast_EK_Struct: {
+    internal_shift_expr(s, expr->structLiteral.expr);
+    break;
+  }
+  case ast_EK_Loop: {
+    internal_shift_expr(s, expr->loop.body);
+    break;
+  }
+  case ast_EK_Val: {
+    internal_shift_expr(s, expr->val.val);
+    break;
+  }
+  case ast_EK_Pat: {
+    internal_shift_expr(s, expr->pat.pat);
+    break;
+  }
+  case ast_EK_Label: {
+    expr->label.label->span = internal_shift_span(s, expr->label.label->span);
+    internal_shift_expr(s, expr->label.val);
+    break;
+  }
+  case ast_EK_Defer: {
+    expr->defer.label->span = internal_shift_span(s, expr->defer.label->span);
+    internal_shift_expr(s, expr->defer.val);
+    break;
+  }
+  case ast_EK_Ret: {
+    expr->ret.label->span = internal_shift_span(s, expr->ret.label->span);
+    internal_shift_expr(s, expr->ret.expr);
+    break;
+  }
+  case ast_EK_BinaryOp: {
+    internal_shift_expr(s, expr->binaryOp.left_operand);
+    internal_shift_expr(s, expr->binaryOp.right_operand);
+    break;
+  }
+  case ast_EK_CaseOf: {
+    internal_shift_expr(s, expr->caseof.expr);
+    internal_shift_expr(s, expr->caseof.cases);
+    break;
+  }
+  case ast_EK_IfThen: {
+    internal_shift_expr(s, expr->ifthen.expr);
+    internal_shift_expr(s, expr->ifthen.then_expr);
+    internal_shift_expr(s, expr->ifthen.else_expr);
+    break;
+  }
+  case ast_EK_Group: {
+    internal_shift_expr(s, expr->group.expr);
+    break;
+  }
+  }
+}
+
+static void internal_shift_statement(const Shift *s, ast_Statement *stmt) {
+  stmt->_start_offset = (usize)((isize)stmt->_start_offset + s->delta_offset);
+  stmt->_end_offset = (usize)((isize)stmt->_end_offset + s->delta_offset);
+  stmt->_lookahead_end =
+      (usize)((isize)stmt->_lookahead_end + s->delta_offset);
+
+  // if no lines were added or removed, only the line the edit ended on moves
+  if (s->old_end.ln.val == s->new_end.ln.val &&
+      stmt->extent.start.ln.val > s->old_end.ln.val) {
+    return;
+  }
+
+  stmt->extent = internal_shift_span(s, stmt->extent);
+  internal_shift_expr(s, stmt->expr);
+  if (stmt->separated) {
+    internal_shift_common(s, &stmt->separator);
+  }
+  const com_vec *entries[2] = {dlogger_diagnostics(&stmt->diagnostics),
+                               dlogger_children(&stmt->diagnostics)};
+  for (usize v = 0; v < 2; v++) {
+    for (usize i = 0; i < com_vec_len_m(entries[v], DiagnosticEntry); i++) {
+      DiagnosticEntry *de = com_vec_get_m(entries[v], i, DiagnosticEntry);
+      de->span = internal_shift_span(s, de->span);
+    }
+  }
+}
+
+// relinks the sequence nodes of every statement from `start` onwards
+static void internal_link(ast_Document *doc, usize start) {
+  usize len = com_vec_len_m(&doc->_statements, ast_Statement);
+  for (usize i = start; i < len; i++) {
+    ast_Statement *stmt = com_vec_get_m(&doc->_statements, i, ast_Statement);
+    if (i == 0 ||
+        !com_vec_get_m(&doc->_statements, i - 1, ast_Statement)->separated) {
+      stmt->sequence = stmt->expr;
+      continue;
+    }
+    ast_Statement *prev = com_vec_get_m(&doc->_statements, i - 1, ast_Statement);
+
+    // reuse the node if we already own one
+    ast_Expr *seq = stmt->sequence;
+    if (seq == NULL || seq == stmt->expr) {
+      seq = com_allocator_handle_get(com_allocator_alloc(
+          doc->_a, (com_allocator_HandleData){
+                       .len = sizeof(ast_Expr),
+                       .flags = com_allocator_defaults(doc->_a) |
+                                com_allocator_NOLEAK}));
+    }
+    seq->kind = ast_EK_BinaryOp;
+    seq->binaryOp.op = ast_EBOK_Sequence;
+    seq->binaryOp.left_operand = prev->sequence;
+    seq->binaryOp.right_operand = stmt->expr;
+    seq->common.metadata = prev->separator.metadata;
+    seq->common.metadata_len = prev->separator.metadata_len;
+    seq->common.span = com_loc_span_m(prev->sequence->common.span.start,
+                                      stmt->expr->common.span.end);
+    stmt->sequence = seq;
+  }
+}
+
+// the number of tokens the parser had lexed past the statement before
+// `old[i]` when `old[i]` began
+static usize internal_old_lookahead(com_vec *old, usize i) {
+  return i == 0 ? 0 : com_vec_get_m(old, i - 1, ast_Statement)->_lookahead;
+}
+
+// parses statements into `doc` starting at `from`, until the end of the text,
+// or until a statement boundary lines up with an old statement at or after
+// `old[resync_from]`. Returns the index of the old statement that parsing
+// resynchronized with, or the length of old if it never did
+// The statement before `from` had already lexed `lookahead` tokens past it,
+// and their diagnostics were logged with it, so they are lexed again here
+// without logging anything.
+static usize internal_parse(ast_Document *doc, Cursor from, bool separated,
+                            usize lookahead, com_vec *old, usize resync_from,
+                            const Shift *s, usize resync_offset) {
+  usize old_len = com_vec_len_m(old, ast_Statement);
+
+  com_str source = ast_documentSource(doc);
+
+  com_reader_str_backing backing;
+  com_reader sr = com_reader_str_create(&source, from.offset, &backing);
+  com_reader br = com_reader_buffered_at(&sr, doc->_a, from.loc);
+  ast_Constructor parser = ast_create(&br, doc->_a);
+
+  if (lookahead > 0) {
+    DiagnosticLogger discarded = dlogger_create(doc->_a);
+    ast_peekNthSpan(&parser, &discarded, lookahead);
+    dlogger_destroy(&discarded);
+  }
+
+  Cursor cursor = from;
+  usize j = resync_from;
+
+  while (true) {
+    DiagnosticLogger dlogger = dlogger_create(doc->_a);
+
+    // a `;` requires another statement, even at eof
+    if (!separated && ast_eof(&parser, &dlogger)) {
+      dlogger_destroy(&dlogger);
+      j = old_len;
+      break;
+    }
+
+    Cursor start = cursor;
+    internal_advance(source, &start, ast_peekSpan(&parser, &dlogger).start);
+
+    // once we are past the edit, try to line up with an old statement
+    // The parser must also have lexed the same tokens ahead as it had there,
+    // so that every later token logs its diagnostics in the same statement
+    if (start.offset >= resync_offset) {
+      usize old_offset = (usize)((isize)start.offset - s->delta_offset);
+      while (j < old_len &&
+             com_vec_get_m(old, j, ast_Statement)->_start_offset < old_offset) {
+        j++;
+      }
+      if (j < old_len &&
+          com_vec_get_m(old, j, ast_Statement)->_start_offset == old_offset &&
+          (j == 0 ? false
+                  : com_vec_get_m(old, j - 1, ast_Statement)->separated) ==
+              separated &&
+          internal_old_lookahead(old, j) == lookahead) {
+        dlogger_destroy(&dlogger);
+        break;
+      }
+    }
+
+    ast_Statement stmt = {0};
+    stmt.expr = ast_parseSequenceable(&dlogger, &parser);
+    stmt.separated =
+        ast_parseSequenceSeparator(&dlogger, &parser, &stmt.separator);
+    // recovering from an error may consume tokens past the end of the
+    // expression's span, so the statement ends where the next token begins
+    Cursor end = start;
+    internal_advance(source, &end,
+                     stmt.separated ? stmt.separator.span.end
+                                    : ast_peekSpan(&parser, &dlogger).start);
+    stmt.diagnostics = dlogger;
+
+    stmt.extent = com_loc_span_m(start.loc, end.loc);
+    stmt._start_offset = start.offset;
+    stmt._end_offset = end.offset;
+
+    // these tokens have all been lexed already, so nothing is logged
+    stmt._lookahead = ast_lookaheadLen(&parser);
+    Cursor lookahead_end = end;
+    if (stmt._lookahead > 0) {
+      internal_advance(
+          source, &lookahead_end,
+          ast_peekNthSpan(&parser, &stmt.diagnostics, stmt._lookahead).end);
+    }
+    stmt._lookahead_end = lookahead_end.offset;
+    *com_vec_push_m(&doc->_statements, ast_Statement) = stmt;
+
+    cursor = end;
+    separated = stmt.separated;
+    lookahead = stmt._lookahead;
+  }
+
+  ast_destroy(&parser);
+  com_reader_destroy(&br);
+  com_reader_destroy(&sr);
+  return j;
+}
+
+ast_Document ast_documentCreate(com_str source, com_allocator *a) {
+  ast_Document doc = {
+      ._a = a,
+      ._source = internal_vec_create(a, source.len + 1),
+      ._statements = internal_vec_create(a, sizeof(ast_Statement) * 4),
+  };
+  com_mem_move(com_vec_push(&doc._source, source.len), source.data,
+               source.len);
+
+  com_vec none = internal_vec_create(a, sizeof(ast_Statement));
+  Shift s = {0};
+  internal_parse(
+      &doc,
+      (Cursor){.offset = 0,
+               .loc = com_loc_lncol_m(com_loc_ln_m(1), com_loc_col_m(1))},
+      false, 0, &none, 0, &s, source.len + 1);
+  com_vec_destroy(&none);
+
+  internal_link(&doc, 0);
+  return doc;
+}
+
+void ast_documentEdit(ast_Document *doc, ast_Edit edit) {
+  com_vec old = doc->_statements;
+  usize old_len = com_vec_len_m(&old, ast_Statement);
+  com_str source = ast_documentSource(doc);
+
+  // find the byte range of the edit, scanning from the closest statement
+  Cursor start = {.offset = 0,
+                  .loc = com_loc_lncol_m(com_loc_ln_m(1), com_loc_col_m(1))};
+  for (usize i = old_len; i > 0; i--) {
+    ast_Statement *stmt = com_vec_get_m(&old, i - 1, ast_Statement);
+    if (!internal_lncol_less(edit.span.start, stmt->extent.start)) {
+      start = (Cursor){.offset = stmt->_start_offset, .loc = stmt->extent.start};
+      break;
+    }
+  }
+  internal_advance(source, &start, edit.span.start);
+  Cursor end = start;
+  internal_advance(source, &end, edit.span.end);
+
+  // the first statement that has to be reparsed is the first one whose parse
+  // lexed the edited text. A statement may have looked ahead past its end to
+  // see where it ended, so that is where it stopped lexing
+  usize k = 0;
+  while (k < old_len &&
+         com_vec_get_m(&old, k, ast_Statement)->_lookahead_end <
+             start.offset) {
+    k++;
+  }
+
+  // splice the new text into the source
+  com_vec_remove(&doc->_source, NULL, start.offset, end.offset - start.offset);
+  com_mem_move(com_vec_insert(&doc->_source, start.offset, edit.text.len),
+               edit.text.data, edit.text.len);
+
+  Cursor new_end = start;
+  for (usize i = 0; i < edit.text.len; i++) {
+    new_end.loc = internal_step(new_end.loc, edit.text.data[i]);
+  }
+  Shift s = {.old_end = end.loc,
+             .new_end = new_end.loc,
+             .delta_offset = (isize)edit.text.len -
+                             (isize)(end.offset - start.offset)};
+
+  // keep every statement before k
+  doc->_statements =
+      internal_vec_create(doc->_a, sizeof(ast_Statement) * (old_len + 1));
+  for (usize i = 0; i < k; i++) {
+    *com_vec_push_m(&doc->_statements, ast_Statement) =
+        *com_vec_get_m(&old, i, ast_Statement);
+  }
+
+  Cursor from = {.offset = 0,
+                 .loc = com_loc_lncol_m(com_loc_ln_m(1), com_loc_col_m(1))};
+  bool separated = false;
+  if (k > 0) {
+    ast_Statement *prev = com_vec_get_m(&old, k - 1, ast_Statement);
+    from = (Cursor){.offset = prev->_end_offset, .loc = prev->extent.end};
+    separated = prev->separated;
+  }
+
+  usize j =
+      internal_parse(doc, from, separated, internal_old_lookahead(&old, k),
+                     &old, k, &s, start.offset + edit.text.len);
+
+  // statements in between were replaced
+  for (usize i = k; i < j; i++) {
+    dlogger_destroy(&com_vec_get_m(&old, i, ast_Statement)->diagnostics);
+  }
+
+  // statements after the resynchronization point are moved into place
+  for (usize i = j; i < old_len; i++) {
+    ast_Statement *stmt = com_vec_push_m(&doc->_statements, ast_Statement);
+    *stmt = *com_vec_get_m(&old, i, ast_Statement);
+    internal_shift_statement(&s, stmt);
+  }
+  com_vec_destroy(&old);
+
+  internal_link(doc, k);
+}
+
+com_str ast_documentSource(const ast_Document *doc) {
+  return (com_str){.data = com_vec_get_m(&doc->_source, 0, u8),
+                   .len = com_vec_len_m(&doc->_source, u8)};
+}
+
+usize ast_documentLen(const ast_Document *doc) {
+  return com_vec_len_m(&doc->_statements, ast_Statement);
+}
+
+ast_Statement *ast_documentGet(ast_Document *doc, usize i) {
+  com_assert_m(i < ast_documentLen(doc), "statement index out of bounds");
+  return com_vec_get_m(&doc->_statements, i, ast_Statement);
+}
+
+void ast_documentDestroy(ast_Document *doc) {
+  for (usize i = 0; i < ast_documentLen(doc); i++) {
+    dlogger_destroy(&ast_documentGet(doc, i)->diagnostics);
+  }
+  com_vec_destroy(&doc->_statements);
+  com_vec_destroy(&doc->_source);
+}
@@ -0,0 +1,103 @@
+#ifndef AST_DOCUMENT_H
+#define AST_DOCUMENT_H
+
+#include "ast.h"
+
+#include "com_allocator.h"
+#include "com_define.h"
+#include "com_loc.h"
+#include "com_str.h"
+#include "com_vec.h"
+#include "diagnostic.h"
+
+// An ast_Document keeps the source text of a file together with its parsed
+// statements so that edits can be applied without reparsing the whole file.
+//
+// A statement is one element of a top level `;` separated sequence. The
+// statements before an edit are kept as is, unless the parser looked ahead
+// into the edited text while parsing them. Only the text from there up to the
+// next statement boundary that lines up with the old parse is relexed and
+// reparsed. Statements after that point are reused with their spans shifted.
+
+typedef struct {
+  // the span in the current text that will be replaced
+  com_loc_Span span;
+  // the text that will be inserted in its place
+  com_str text;
+} ast_Edit;
+
+typedef struct {
+  // the sequenceable expression
+  ast_Expr *expr;
+  // the ast_EBOK_Sequence node that has `expr` as its right operand, or `expr`
+  // itself if this statement begins a top level expression.
+  // If `separated` is false, this is the complete top level expression
+  ast_Expr *sequence;
+  // whether this statement was followed by a `;`
+  bool separated;
+  // span of the `;` and the metadata before it (only valid if `separated`)
+  ast_Common separator;
+  // the text this statement was parsed from, including its leading metadata
+  // and trailing separator
+  com_loc_Span extent;
+  // diagnostics generated while parsing this statement
+  DiagnosticLogger diagnostics;
+  // byte offsets of `extent` into the source
+  usize _start_offset;
+  usize _end_offset;
+  // number of tokens after `extent` that the parser had already lexed when
+  // this statement ended. Their lexer diagnostics are in `diagnostics` of this
+  // or an earlier statement
+  usize _lookahead;
+  // byte offset of the end of the last of those tokens, or `_end_offset` if
+  // there are none
+  usize _lookahead_end;
+} ast_Statement;
+
+typedef struct {
+  com_allocator *_a;
+  // Vector<u8> of source text
+  com_vec _source;
+  // Vector<ast_Statement> in source order
+  com_vec _statements;
+} ast_Document;
+
+/// parses `source` into a new document
+/// REQUIRES: `a` is a valid pointer to a valid `com_allocator`
+/// REQUIRES: `source` is a valid `com_str`
+/// GUARANTEES: returns a valid `ast_Document` holding a copy of `source`
+/// GUARANTEES: all memory for the document's ast will be allocated from `a`
+ast_Document ast_documentCreate(com_str source, com_allocator *a);
+
+/// replaces `edit.span` of the current text with `edit.text` and reparses
+/// REQUIRES: `doc` is a valid pointer to a valid `ast_Document`
+/// REQUIRES: `edit.span` is ordered, and is a span within the current text
+/// GUARANTEES: the statements of `doc` are identical to those that parsing the
+/// whole new text would produce
+/// GUARANTEES: statements that did not need to be reparsed keep their
+/// `ast_Expr` pointers
+/// GUARANTEES: all pointers to `ast_Statement`s in `doc` are invalidated
+void ast_documentEdit(ast_Document *doc, ast_Edit edit);
+
+/// returns the current text of the document
+/// REQUIRES: `doc` is a valid pointer to a valid `ast_Document`
+/// GUARANTEES: the returned str is valid until the next edit
+com_str ast_documentSource(const ast_Document *doc);
+
+/// returns how many statements the document contains
+/// REQUIRES: `doc` is a valid pointer to a valid `ast_Document`
+usize ast_documentLen(const ast_Document *doc);
+
+/// returns the `i`th statement of the document
+/// REQUIRES: `doc` is a valid pointer to a valid `ast_Document`
+/// REQUIRES: `i` < `ast_documentLen(doc)`
+/// GUARANTEES: the returned pointer is valid until the next edit
+ast_Statement *ast_documentGet(ast_Document *doc, usize i);
+
+/// frees the memory held by the document
+/// REQUIRES: `doc` is a valid pointer to a valid `ast_Document`
+/// GUARANTEES: `doc` is no longer a valid `ast_Document`
+/// GUARANTEES: ast nodes remain owned by the allocator that created them
+void ast_documentDestroy(ast_Document *doc);
+
+#endif
@@ -4,7 +4,6 @@
 #include "com_assert.h"
 #include "com_imath.h"
 #include "com_mem.h"
-#include "com_strcopy.h"
 #include "com_vec.h"
 #include "com_writer.h"
 
@@ -91,19 +90,8 @@ static LabelStackElement *LabelStack_getLabel(LabelStack *ls, ast_Label *label,
     }
 
     // if we get over here it means that the provided label didn't have a match
-    Diagnostic *hint = dlogger_append(dl, false);
-    *hint = (Diagnostic){.span = label->span,
-                         .severity = DSK_Hint,
-                         .message = com_str_demut(com_strcopy_noleak(
-                             label->label.label, dlogger_alloc(dl))),
-                         .children_len = 0};
-
-    *dlogger_append(dl, true) = (Diagnostic){
-        .span = label->span,
-        .severity = DSK_Error,
-        .message = com_str_lit_m("could not find label name in scope"),
-        .children = hint,
-        .children_len = 1};
+    u32 d = dlogger_append(dl, DK_LabelNotFound, label->span);
+    dlogger_appendChild(dl, d, DK_Hint, label->span, &label->label.label, 1);
 
     return NULL;
   }
@@ -142,11 +130,8 @@ static hir_Expr *hir_createIntLiteralExpr(const ast_Expr *from,
   hir_Expr *obj = hir_alloc_obj_m(a, hir_Expr);
   obj->from = from;
   obj->kind = hir_EK_Int;
-  obj->intLiteral.value = com_bigint_create(com_allocator_alloc(
-      a, (com_allocator_HandleData){.len = 8,
-                                    .flags = com_allocator_defaults(a) |
-                                             com_allocator_NOLEAK |
-                                             com_allocator_REALLOCABLE}));
+  // an i64 always fits inline
+  obj->intLiteral.value = com_bigint_create_inline(a);
   com_bigint_set_i64(&obj->intLiteral.value, lit);
   return obj;
 }
@@ -238,27 +223,15 @@ static hir_Expr *hir_translateExpr(const ast_Expr *vep, LabelStack *ls,
     return hir_noneExpr(vep, a);
   }
   case ast_EK_Bind: {
-    *dlogger_append(diagnostics, true) = (Diagnostic){
-        .span = vep->common.span,
-        .severity = DSK_Error,
-        .message = com_str_lit_m("bind is only valid in a pattern"),
-        .children_len = 0};
+    dlogger_append(diagnostics, DK_BindOutsidePattern, vep->common.span);
     return hir_noneExpr(vep, a);
   }
   case ast_EK_BindIgnore: {
-    *dlogger_append(diagnostics, true) = (Diagnostic){
-        .span = vep->common.span,
-        .severity = DSK_Error,
-        .message = com_str_lit_m("bind ignore is only valid in a pattern"),
-        .children_len = 0};
+    dlogger_append(diagnostics, DK_BindIgnoreOutsidePattern, vep->common.span);
     return hir_noneExpr(vep, a);
   }
   case ast_EK_BindSplat: {
-    *dlogger_append(diagnostics, true) = (Diagnostic){
-        .span = vep->common.span,
-        .severity = DSK_Error,
-        .message = com_str_lit_m("bind splat is only valid in a pattern"),
-        .children_len = 0};
+    dlogger_append(diagnostics, DK_BindSplatOutsidePattern, vep->common.span);
     return hir_noneExpr(vep, a);
   }
   case ast_EK_Nil: {
@@ -326,11 +299,7 @@ static hir_Expr *hir_translateExpr(const ast_Expr *vep, LabelStack *ls,
     return obj;
   }
   case ast_EK_Val: {
-    *dlogger_append(diagnostics, true) = (Diagnostic){
-        .span = vep->common.span,
-        .severity = DSK_Error,
-        .message = com_str_lit_m("val expr is only valid in a pattern"),
-        .children_len = 0};
+    dlogger_append(diagnostics, DK_ValOutsidePattern, vep->common.span);
     return hir_noneExpr(vep, a);
   }
   case ast_EK_Label: {
@@ -467,11 +436,8 @@ static hir_Expr *hir_translateExpr(const ast_Expr *vep, LabelStack *ls,
             current->binaryOp.right_operand;
       } else {
         // is neither
-        *dlogger_append(diagnostics, true) =
-            (Diagnostic){.span = current->common.span,
-                         .severity = DSK_Error,
-                         .message = com_str_lit_m("expected a case option"),
-                         .children_len = 0};
+        dlogger_append(diagnostics, DK_ExpectedCaseOption,
+                       current->common.span);
       }
     }
     // now destroy the optstack
@@ -491,21 +457,12 @@ static hir_Expr *hir_translateExpr(const ast_Expr *vep, LabelStack *ls,
       return hir_noneExpr(vep, a);
     }
     case ast_EBOK_As: {
-      *dlogger_append(diagnostics, true) = (Diagnostic){
-          .span = vep->common.span,
-          .severity = DSK_Error,
-          .message = com_str_lit_m("as operator is only valid in a pattern"),
-          .children_len = 0};
+      dlogger_append(diagnostics, DK_AsOutsidePattern, vep->common.span);
       return hir_noneExpr(vep, a);
     }
     // Type coercion
     case ast_EBOK_Constrain: {
-      *dlogger_append(diagnostics, true) =
-          (Diagnostic){.span = vep->common.span,
-                       .severity = DSK_Error,
-                       .message = com_str_lit_m(
-                           "constrain operator is only valid in a pattern"),
-                       .children_len = 0};
+      dlogger_append(diagnostics, DK_ConstrainOutsidePattern, vep->common.span);
       return hir_noneExpr(vep, a);
     }
     // Function definition
@@ -521,12 +478,7 @@ static hir_Expr *hir_translateExpr(const ast_Expr *vep, LabelStack *ls,
     }
     // CaseOption
     case ast_EBOK_CaseOption: {
-      *dlogger_append(diagnostics, true) = (Diagnostic){
-          .span = vep->common.span,
-          .severity = DSK_Error,
-          .message = com_str_lit_m(
-              "case option operator is only valid in a case context"),
-          .children_len = 0};
+      dlogger_append(diagnostics, DK_CaseOptionOutsideCase, vep->common.span);
       return hir_noneExpr(vep, a);
     }
     // Function call
@@ -703,22 +655,16 @@ static hir_Expr *hir_translateExpr(const ast_Expr *vep, LabelStack *ls,
     case ast_EBOK_ModuleAccess: {
       // ensure that the right operand is an identifier
       if (vep->binaryOp.right_operand->kind != ast_EK_Reference) {
-        *dlogger_append(diagnostics, true) =
-            (Diagnostic){.span = vep->binaryOp.right_operand->common.span,
-                         .severity = DSK_Error,
-                         .message = com_str_lit_m("expected an identifier"),
-                         .children_len = 0};
+        dlogger_append(diagnostics, DK_ExpectedIdentifier,
+                       vep->binaryOp.right_operand->common.span);
         return hir_noneExpr(vep, a);
       }
 
       switch (vep->binaryOp.right_operand->reference.reference->kind) {
       case ast_IK_None: {
         // ensure that identifier is valid
-        *dlogger_append(diagnostics, true) = (Diagnostic){
-            .span = vep->binaryOp.right_operand->reference.reference->span,
-            .severity = DSK_Error,
-            .message = com_str_lit_m("identifier must be valid"),
-            .children_len = 0};
+        dlogger_append(diagnostics, DK_InvalidIdentifier,
+                       vep->binaryOp.right_operand->reference.reference->span);
         return hir_noneExpr(vep, a);
       }
       case ast_IK_Identifier: {
@@ -823,12 +769,7 @@ static hir_Pat *hir_translatePat(const ast_Expr *vep, LabelStack *ls,
       // ensure the binding is valid
       if (vep->binaryOp.right_operand->kind != ast_EK_Bind ||
           vep->binaryOp.right_operand->bind.bind->kind != ast_IK_Identifier) {
-        *dlogger_append(diagnostics, true) =
-            (Diagnostic){.span = vep->common.span,
-                         .severity = DSK_Error,
-                         .message = com_str_lit_m(
-                             "Right hand side of as must be a valid binding"),
-                         .children_len = 0};
+        dlogger_append(diagnostics, DK_AsExpectedBinding, vep->common.span);
         return hir_nonePat(vep, a);
       }
       hir_Pat *obj = hir_alloc_obj_m(a, hir_Pat);
@@ -986,11 +927,7 @@ static hir_Pat *hir_translatePat(const ast_Expr *vep, LabelStack *ls,
     case ast_EBOK_Assign:
     // Sequence
     case ast_EBOK_Sequence: {
-      *dlogger_append(diagnostics, true) = (Diagnostic){
-          .span = vep->common.span,
-          .severity = DSK_Error,
-          .message = com_str_lit_m("operator not permitted in pattern"),
-          .children_len = 0};
+      dlogger_append(diagnostics, DK_OperatorInPattern, vep->common.span);
       return hir_nonePat(vep, a);
     }
     }
@@ -1077,11 +1014,8 @@ static hir_Pat *hir_translatePat(const ast_Expr *vep, LabelStack *ls,
         tail->andPat.fst = oldtail;
         tail->structEntry.pattern = obj;
       } else {
-        *dlogger_append(diagnostics, true) =
-            (Diagnostic){.span = current->common.span,
-                         .severity = DSK_Error,
-                         .message = com_str_lit_m("only assigns are permitted in a struct pattern"),
-                         .children_len = 0};
+        dlogger_append(diagnostics, DK_StructPatternExpectedAssign,
+                       current->common.span);
       }
     }
 
@@ -1107,11 +1041,7 @@ static hir_Pat *hir_translatePat(const ast_Expr *vep, LabelStack *ls,
   case ast_EK_IfThen:
   case ast_EK_CaseOf:
   case ast_EK_Pat: {
-    *dlogger_append(diagnostics, true) = (Diagnostic){
-        .span = vep->common.span,
-        .severity = DSK_Error,
-        .message = com_str_lit_m("expression not permitted in pattern"),
-        .children_len = 0};
+    dlogger_append(diagnostics, DK_ExprInPattern, vep->common.span);
     return hir_nonePat(vep, a);
   }
   }
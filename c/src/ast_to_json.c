@@ -1,13 +1,16 @@
 #include "ast_to_json.h"
 
 #include "com_allocator.h"
+#include "com_format.h"
 #include "com_imath.h"
 #include "com_json.h"
 #include "com_loc.h"
 #include "com_vec.h"
 #include "com_writer.h"
+#include "com_writer_vec.h"
 
 #include "ast.h"
+#include "constants.h"
 #include "token.h"
 
 // utility method to create a vector
@@ -18,146 +21,147 @@
                                              com_allocator_NOLEAK |            \
                                              com_allocator_REALLOCABLE}))
 
-#define push_prop_m(obj) com_vec_push_m(obj, com_json_Prop)
-#define push_elem_m(obj) com_vec_push_m(obj, com_json_Elem)
+#define key_m(w, str) com_json_key((w), com_str_lit_m(str))
 
-#define mkprop_m(str, val) com_json_prop_m(com_str_lit_m(str), (val))
-
-static com_json_Elem print_objectify(com_vec *props) {
-  usize len = com_vec_len_m(props, com_json_Prop);
-  com_json_Prop *ptrs = com_vec_release(props);
-  return com_json_obj_m(ptrs, len);
-}
-
-static com_json_Elem print_arrayify(com_vec *elems) {
-  usize len = com_vec_len_m(elems, com_json_Elem);
-  com_json_Elem *ptrs = com_vec_release(elems);
-  return com_json_array_m(ptrs, len);
+static void print_LnCol(com_json_Writer *w, com_loc_LnCol lncol) {
+  com_json_beginObj(w);
+  key_m(w, "kind");
+  com_json_writeStr(w, com_str_lit_m("lncol"));
+  key_m(w, "ln");
+  com_json_writeUint(w, lncol.ln.val);
+  key_m(w, "col");
+  com_json_writeUint(w, lncol.col.val);
+  com_json_endObj(w);
 }
 
-static com_json_Elem print_LnCol(com_loc_LnCol lncol, com_allocator *a) {
-  com_vec obj = print_vec_create_m(a);
-  *push_prop_m(&obj) = mkprop_m("kind", com_json_str_m(com_str_lit_m("lncol")));
-  *push_prop_m(&obj) = mkprop_m("ln", com_json_uint_m(lncol.ln.val));
-  *push_prop_m(&obj) = mkprop_m("col", com_json_uint_m(lncol.col.val));
-  return print_objectify(&obj);
+static void print_Span(com_json_Writer *w, com_loc_Span span) {
+  com_json_beginObj(w);
+  key_m(w, "kind");
+  com_json_writeStr(w, com_str_lit_m("span"));
+  key_m(w, "start");
+  print_LnCol(w, span.start);
+  key_m(w, "end");
+  print_LnCol(w, span.end);
+  com_json_endObj(w);
 }
 
-static com_json_Elem print_Span(com_loc_Span span, com_allocator *a) {
-  com_vec obj = print_vec_create_m(a);
-  *push_prop_m(&obj) = mkprop_m("kind", com_json_str_m(com_str_lit_m("span")));
-  *push_prop_m(&obj) = mkprop_m("start", print_LnCol(span.start, a));
-  *push_prop_m(&obj) = mkprop_m("end", print_LnCol(span.end, a));
-  return print_objectify(&obj);
+// not inlined, to keep its locals out of the frame of the recursive print_Expr
+static attr_NOINLINE void print_bigint(com_json_Writer *w, com_allocator *a,
+                                       com_bigint *bigint) {
+  com_json_beginObj(w);
+  key_m(w, "kind");
+  com_json_writeStr(w, com_str_lit_m("bigint"));
+  // written in decimal, as a string so that no precision is lost
+  key_m(w, "value");
+  com_vec decimal = print_vec_create_m(a);
+  com_writer decimal_writer = com_writer_vec_create(&decimal);
+  com_format_bigint(&decimal_writer, bigint, com_format_DEFAULT_SETTING, a);
+  com_writer_destroy(&decimal_writer);
+  com_json_writeStr(w, com_str_demut(com_vec_to_str(&decimal)));
+  com_vec_destroy(&decimal);
+  com_json_endObj(w);
 }
 
-static com_json_Elem print_bigint(com_bigint bigint, com_allocator *a) {
-  com_vec obj = print_vec_create_m(a);
-  *push_prop_m(&obj) =
-      mkprop_m("kind", com_json_str_m(com_str_lit_m("bigint")));
-  com_vec words = print_vec_create_m(a);
-  for (usize i = 0; i < com_bigint_len(&bigint); i++) {
-    *push_elem_m(&words) = com_json_uint_m(com_bigint_get_at(&bigint, i));
+static void print_bigdecimal(com_json_Writer *w, com_bigdecimal *bigdecimal) {
+  com_json_beginObj(w);
+  key_m(w, "kind");
+  com_json_writeStr(w, com_str_lit_m("bigdecimal"));
+  key_m(w, "negative");
+  com_json_writeBool(w, com_bigdecimal_sign(bigdecimal) == com_math_NEGATIVE);
+  key_m(w, "words");
+  com_json_beginArray(w);
+  for (usize i = 0; i < com_bigdecimal_len(bigdecimal); i++) {
+    com_json_writeUint(w, com_bigdecimal_get_at(bigdecimal, i));
   }
-  *push_prop_m(&obj) = mkprop_m("words", print_arrayify(&words));
-  return print_objectify(&obj);
+  com_json_endArray(w);
+  key_m(w, "precision");
+  com_json_writeUint(w, com_bigdecimal_get_precision(bigdecimal));
+  com_json_endObj(w);
 }
 
-static com_json_Elem print_bigdecimal(com_bigdecimal bigdecimal,
-                                      com_allocator *a) {
-  com_vec obj = print_vec_create_m(a);
-  *push_prop_m(&obj) =
-      mkprop_m("kind", com_json_str_m(com_str_lit_m("bigdecimal")));
-  *push_prop_m(&obj) =
-      mkprop_m("negative", com_json_bool_m(com_bigdecimal_sign(&bigdecimal) ==
-                                           com_math_NEGATIVE));
-  com_vec words = print_vec_create_m(a);
-  for (usize i = 0; i < com_bigdecimal_len(&bigdecimal); i++) {
-    *push_elem_m(&words) =
-        com_json_uint_m(com_bigdecimal_get_at(&bigdecimal, i));
+static void print_diagnostic(com_json_Writer *w, DiagnosticLogger *dlogger,
+                             const DiagnosticEntry *de, com_vec *scratch) {
+  com_json_beginObj(w);
+  key_m(w, "kind");
+  com_json_writeStr(w, com_str_lit_m("diagnostic"));
+  key_m(w, "severity");
+  com_json_writeStr(w, strDiagnosticSeverityKind(dlogger_severity(de->kind)));
+  key_m(w, "message");
+  com_json_writeStr(w, dlogger_message(dlogger, de, scratch));
+  key_m(w, "span");
+  print_Span(w, de->span);
+  key_m(w, "children");
+  com_json_beginArray(w);
+  for (u32 i = de->first_child; i != DIAGNOSTIC_NONE;
+       i = dlogger_child(dlogger, i)->next_sibling) {
+    print_diagnostic(w, dlogger, dlogger_child(dlogger, i), scratch);
   }
-  *push_prop_m(&obj) = mkprop_m("words", print_arrayify(&words));
-  *push_prop_m(&obj) = mkprop_m(
-      "precision", com_json_uint_m(com_bigdecimal_get_precision(&bigdecimal)));
-  return print_objectify(&obj);
+  com_json_endArray(w);
+  com_json_endObj(w);
 }
 
-static com_json_Elem print_diagnostic(Diagnostic diagnostic, com_allocator *a) {
-  com_vec obj = print_vec_create_m(a);
-  *push_prop_m(&obj) =
-      mkprop_m("kind", com_json_str_m(com_str_lit_m("diagnostic")));
-  *push_prop_m(&obj) =
-      mkprop_m("severity",
-               com_json_str_m(strDiagnosticSeverityKind(diagnostic.severity)));
-  *push_prop_m(&obj) = mkprop_m("message", com_json_str_m(diagnostic.message));
-  *push_prop_m(&obj) = mkprop_m("span", print_Span(diagnostic.span, a));
-  com_vec children = print_vec_create_m(a);
-  for (usize i = 0; i < diagnostic.children_len; i++) {
-    *push_elem_m(&children) = print_diagnostic(diagnostic.children[i], a);
-  }
-  *push_prop_m(&obj) = mkprop_m("children", print_arrayify(&children));
-  return print_objectify(&obj);
+static void print_Metadata(com_json_Writer *w, ast_Metadata metadata) {
+  com_json_beginObj(w);
+  key_m(w, "kind");
+  com_json_writeStr(w, com_str_lit_m("metadata"));
+  key_m(w, "data");
+  com_json_writeStr(w, metadata.data);
+  key_m(w, "significant");
+  com_json_writeBool(w, metadata.significant);
+  key_m(w, "span");
+  print_Span(w, metadata.span);
+  com_json_endObj(w);
 }
 
-static com_json_Elem print_Metadata(ast_Metadata metadata, com_allocator *a) {
-  com_vec obj = print_vec_create_m(a);
-  *push_prop_m(&obj) =
-      mkprop_m("kind", com_json_str_m(com_str_lit_m("metadata")));
-  *push_prop_m(&obj) = mkprop_m("data", com_json_str_m(metadata.data));
-  *push_prop_m(&obj) =
-      mkprop_m("significant", com_json_bool_m(metadata.significant));
-  *push_prop_m(&obj) = mkprop_m("span", print_Span(metadata.span, a));
-  return print_objectify(&obj);
-}
-
-// add shared data to the vector
-static void print_appendCommon(ast_Common node, com_vec *props,
-                               com_allocator *a) {
-  *push_prop_m(props) = mkprop_m("span", print_Span(node.span, a));
-  com_vec metadata = print_vec_create_m(a);
+// write the shared data into the currently open object
+static void print_appendCommon(com_json_Writer *w, ast_Common node) {
+  key_m(w, "span");
+  print_Span(w, node.span);
+  key_m(w, "metadata");
+  com_json_beginArray(w);
   for (usize i = 0; i < node.metadata_len; i++) {
-    *push_elem_m(&metadata) = print_Metadata(node.metadata[i], a);
+    print_Metadata(w, node.metadata[i]);
   }
-  *com_vec_push_m(props, com_json_Prop) =
-      mkprop_m("metadata", print_arrayify(&metadata));
+  com_json_endArray(w);
 }
 
 // Forward declare
-static com_json_Elem print_Expr(ast_Expr *ep, com_allocator *a);
-
-static com_json_Elem print_Identifier(ast_Identifier *identifier,
-                                      com_allocator *a) {
-  com_vec obj = print_vec_create_m(a);
-  *push_prop_m(&obj) =
-      mkprop_m("kind", com_json_str_m(com_str_lit_m("identifier")));
-  *push_prop_m(&obj) = mkprop_m("span", print_Span(identifier->span, a));
+static void print_Expr(com_json_Writer *w, com_allocator *a, ast_Expr *ep);
 
-  *push_prop_m(&obj) =
-      mkprop_m("identifier_kind",
-               com_json_str_m(ast_strIdentifierKind(identifier->kind)));
+static void print_Identifier(com_json_Writer *w, ast_Identifier *identifier) {
+  com_json_beginObj(w);
+  key_m(w, "kind");
+  com_json_writeStr(w, com_str_lit_m("identifier"));
+  key_m(w, "span");
+  print_Span(w, identifier->span);
+  key_m(w, "identifier_kind");
+  com_json_writeStr(w, ast_strIdentifierKind(identifier->kind));
   switch (identifier->kind) {
   case ast_IK_None: {
     // nop
     break;
   }
   case ast_IK_Identifier: {
-    *push_prop_m(&obj) = mkprop_m("name", com_json_str_m(identifier->id.name));
+    key_m(w, "name");
+    com_json_writeStr(w, identifier->id.name);
     break;
   }
   }
-
-  return print_objectify(&obj);
+  com_json_endObj(w);
 }
 
-static com_json_Elem print_Label(ast_Label *label, com_allocator *a) {
-  com_vec obj = print_vec_create_m(a);
-  *push_prop_m(&obj) = mkprop_m("kind", com_json_str_m(com_str_lit_m("label")));
-  *push_prop_m(&obj) = mkprop_m("span", print_Span(label->span, a));
-  *push_prop_m(&obj) =
-      mkprop_m("label_kind", com_json_str_m(ast_strLabelKind(label->kind)));
+static void print_Label(com_json_Writer *w, ast_Label *label) {
+  com_json_beginObj(w);
+  key_m(w, "kind");
+  com_json_writeStr(w, com_str_lit_m("label"));
+  key_m(w, "span");
+  print_Span(w, label->span);
+  key_m(w, "label_kind");
+  com_json_writeStr(w, ast_strLabelKind(label->kind));
   switch (label->kind) {
   case ast_LK_Label: {
-    *push_prop_m(&obj) = mkprop_m("label", com_json_str_m(label->label.label));
+    key_m(w, "label");
+    com_json_writeStr(w, label->label.label);
     break;
   }
   case ast_LK_None: {
@@ -165,17 +169,18 @@ static com_json_Elem print_Label(ast_Label *label, com_allocator *a) {
     break;
   }
   }
-  return print_objectify(&obj);
+  com_json_endObj(w);
 }
 
-static com_json_Elem print_Expr(ast_Expr *vep, com_allocator *a) {
+static void print_Expr(com_json_Writer *w, com_allocator *a, ast_Expr *vep) {
   if (vep == NULL) {
-    return com_json_null_m;
+    com_json_writeNull(w);
+    return;
   }
-  com_vec obj = print_vec_create_m(a);
-  print_appendCommon(vep->common, &obj, a);
-  *push_prop_m(&obj) =
-      mkprop_m("kind", com_json_str_m(ast_strExprKind(vep->kind)));
+  com_json_beginObj(w);
+  print_appendCommon(w, vep->common);
+  key_m(w, "kind");
+  com_json_writeStr(w, ast_strExprKind(vep->kind));
   switch (vep->kind) {
   case ast_EK_None:
   case ast_EK_Nil:
@@ -187,104 +192,115 @@ static com_json_Elem print_Expr(ast_Expr *vep, com_allocator *a) {
     break;
   }
   case ast_EK_Bind: {
-    *push_prop_m(&obj) = mkprop_m("bind", print_Identifier(vep->bind.bind, a));
+    key_m(w, "bind");
+    print_Identifier(w, vep->bind.bind);
     break;
   }
   case ast_EK_Bool: {
-    *push_prop_m(&obj) =
-        mkprop_m("bool", com_json_bool_m(vep->boolLiteral.value));
+    key_m(w, "bool");
+    com_json_writeBool(w, vep->boolLiteral.value);
     break;
   }
   case ast_EK_Int: {
-    *push_prop_m(&obj) =
-        mkprop_m("int", print_bigint(vep->intLiteral.value, a));
+    key_m(w, "int");
+    print_bigint(w, a, &vep->intLiteral.value);
     break;
   }
   case ast_EK_Real: {
-    *push_prop_m(&obj) =
-        mkprop_m("real", print_bigdecimal(vep->realLiteral.value, a));
+    key_m(w, "real");
+    print_bigdecimal(w, &vep->realLiteral.value);
     break;
   }
   case ast_EK_String: {
-    *push_prop_m(&obj) =
-        mkprop_m("string", com_json_str_m(vep->stringLiteral.value));
+    key_m(w, "string");
+    com_json_writeStr(w, vep->stringLiteral.value);
     break;
   }
   case ast_EK_Struct: {
-    *push_prop_m(&obj) =
-        mkprop_m("struct_expr", print_Expr(vep->structLiteral.expr, a));
+    key_m(w, "struct_expr");
+    print_Expr(w, a, vep->structLiteral.expr);
     break;
   }
   case ast_EK_Loop: {
-    *push_prop_m(&obj) = mkprop_m("loop_body", print_Expr(vep->loop.body, a));
+    key_m(w, "loop_body");
+    print_Expr(w, a, vep->loop.body);
     break;
   }
   case ast_EK_Reference: {
-    *push_prop_m(&obj) =
-        mkprop_m("reference", print_Identifier(vep->reference.reference, a));
+    key_m(w, "reference");
+    print_Identifier(w, vep->reference.reference);
     break;
   }
   case ast_EK_BinaryOp: {
-    *push_prop_m(&obj) =
-        mkprop_m("binary_operation",
-                 com_json_str_m(ast_strExprBinaryOpKind(vep->binaryOp.op)));
-    *push_prop_m(&obj) = mkprop_m("binary_left_operand",
-                                  print_Expr(vep->binaryOp.left_operand, a));
-    *push_prop_m(&obj) = mkprop_m("binary_right_operand",
-                                  print_Expr(vep->binaryOp.right_operand, a));
+    key_m(w, "binary_operation");
+    com_json_writeStr(w, ast_strExprBinaryOpKind(vep->binaryOp.op));
+    key_m(w, "binary_left_operand");
+    print_Expr(w, a, vep->binaryOp.left_operand);
+    key_m(w, "binary_right_operand");
+    print_Expr(w, a, vep->binaryOp.right_operand);
     break;
   }
   case ast_EK_Ret: {
-    *push_prop_m(&obj) = mkprop_m("ret_label", print_Label(vep->ret.label, a));
-    *push_prop_m(&obj) = mkprop_m("ret_value", print_Expr(vep->ret.expr, a));
+    key_m(w, "ret_label");
+    print_Label(w, vep->ret.label);
+    key_m(w, "ret_value");
+    print_Expr(w, a, vep->ret.expr);
     break;
   }
   case ast_EK_Defer: {
-    *push_prop_m(&obj) =
-        mkprop_m("defer_label", print_Label(vep->defer.label, a));
-    *push_prop_m(&obj) = mkprop_m("defer_val", print_Expr(vep->defer.val, a));
+    key_m(w, "defer_label");
+    print_Label(w, vep->defer.label);
+    key_m(w, "defer_val");
+    print_Expr(w, a, vep->defer.val);
     break;
   }
   case ast_EK_CaseOf: {
-    *push_prop_m(&obj) =
-        mkprop_m("caseof_expr", print_Expr(vep->caseof.expr, a));
-    *push_prop_m(&obj) =
-        mkprop_m("caseof_cases", print_Expr(vep->caseof.cases, a));
+    key_m(w, "caseof_expr");
+    print_Expr(w, a, vep->caseof.expr);
+    key_m(w, "caseof_cases");
+    print_Expr(w, a, vep->caseof.cases);
     break;
   }
   case ast_EK_IfThen: {
-    *push_prop_m(&obj) =
-        mkprop_m("ifthen_expr", print_Expr(vep->ifthen.expr, a));
-    *push_prop_m(&obj) =
-        mkprop_m("ifthen_then", print_Expr(vep->ifthen.then_expr, a));
-    *push_prop_m(&obj) =
-        mkprop_m("ifthen_else", print_Expr(vep->ifthen.else_expr, a));
+    key_m(w, "ifthen_expr");
+    print_Expr(w, a, vep->ifthen.expr);
+    key_m(w, "ifthen_then");
+    print_Expr(w, a, vep->ifthen.then_expr);
+    key_m(w, "ifthen_else");
+    print_Expr(w, a, vep->ifthen.else_expr);
     break;
   }
   case ast_EK_Group: {
-    *push_prop_m(&obj) = mkprop_m("group_expr", print_Expr(vep->group.expr, a));
+    key_m(w, "group_expr");
+    print_Expr(w, a, vep->group.expr);
     break;
   }
   case ast_EK_Val: {
-    *push_prop_m(&obj) = mkprop_m("val_expr", print_Expr(vep->val.val, a));
+    key_m(w, "val_expr");
+    print_Expr(w, a, vep->val.val);
     break;
   }
   case ast_EK_Pat: {
-    *push_prop_m(&obj) = mkprop_m("pat_expr", print_Expr(vep->pat.pat, a));
+    key_m(w, "pat_expr");
+    print_Expr(w, a, vep->pat.pat);
     break;
   }
   case ast_EK_Label: {
-    *push_prop_m(&obj) = mkprop_m("label_val", print_Expr(vep->label.val, a));
-    *push_prop_m(&obj) =
-        mkprop_m("label_label", print_Label(vep->label.label, a));
+    key_m(w, "label_val");
+    print_Expr(w, a, vep->label.val);
+    key_m(w, "label_label");
+    print_Label(w, vep->label.label);
     break;
   }
   }
-  return print_objectify(&obj);
+  com_json_endObj(w);
 }
 
 void print_stream(ast_Constructor *parser, com_allocator *a,
                   com_writer *writer) {
+  usize printed_diagnostics = 0;
+  // Vector<u8> that messages with arguments are rendered into
+  com_vec scratch = print_vec_create_m(a);
   while (true) {
 
     // check for EOF
@@ -297,22 +313,33 @@ void print_stream(ast_Constructor *parser, com_allocator *a,
       ast_Expr *expr = ast_parseExpr(&dlogger, parser);
 
       // print the json
-      com_json_Elem sjson = print_Expr(expr, a);
-      com_json_serialize(&sjson, writer);
+      com_json_Writer w = com_json_writerCreate(writer);
+      print_Expr(&w, a, expr);
       com_writer_append_u8(writer, '\n');
     }
 
-    // print the diagnostics
+    // print the diagnostics in source order, without repeats
+    dlogger_normalize(&dlogger);
     const com_vec *diagnosticEntries = dlogger_diagnostics(&dlogger);
-    for (usize i = 0; i < com_vec_len_m(diagnosticEntries, DiagnosticEntry);
-         i--) {
+    for (usize i = 0; i < com_vec_len_m(diagnosticEntries, DiagnosticEntry) &&
+                      printed_diagnostics <= MAX_PRINT_DIAGNOSTICS;
+         i++) {
       DiagnosticEntry *de =
           com_vec_get_m(diagnosticEntries, i, DiagnosticEntry);
-      if (de->visible) {
-        com_json_Elem djson = print_diagnostic(de->diagnostic, a);
-        com_json_serialize(&djson, writer);
-        com_writer_append_u8(writer, '\n');
+      DiagnosticEntry omitted;
+      if (printed_diagnostics == MAX_PRINT_DIAGNOSTICS) {
+        // note the first omitted diagnostic, then stay silent
+        omitted = (DiagnosticEntry){.span = de->span,
+                                    .kind = DK_TooManyDiagnostics,
+                                    .args_len = 0,
+                                    .first_child = DIAGNOSTIC_NONE,
+                                    .next_sibling = DIAGNOSTIC_NONE};
+        de = &omitted;
       }
+      com_json_Writer w = com_json_writerCreate(writer);
+      print_diagnostic(&w, &dlogger, de, &scratch);
+      com_writer_append_u8(writer, '\n');
+      printed_diagnostics++;
     }
 
     // flush what's been written
@@ -325,4 +352,5 @@ void print_stream(ast_Constructor *parser, com_allocator *a,
       break;
     }
   }
+  com_vec_destroy(&scratch);
 }
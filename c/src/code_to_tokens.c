@@ -5,6 +5,7 @@
 #include "com_bigdecimal.h"
 #include "com_bigint.h"
 #include "com_biguint.h"
+#include "com_fmath.h"
 #include "com_format.h"
 #include "com_scan.h"
 #include "com_vec.h"
@@ -172,12 +173,7 @@ static Token lexStringLiteral(com_reader *r, DiagnosticLogger *diagnostics,
       // deallocate resources
       com_writer_destroy(&writer);
       // give error
-      *dlogger_append(diagnostics, true) =
-          (Diagnostic){.span = ret.span,
-                       .severity = DSK_Error,
-                       .message = com_str_lit_m(
-                           "unexpected EOF, expected closing double quote"),
-                       .children_len = 0};
+      dlogger_append(diagnostics, DK_StrExpectedDoubleQuote, ret.span);
       // return invalid
       return (Token){
           .kind = tk_None,
@@ -185,19 +181,11 @@ static Token lexStringLiteral(com_reader *r, DiagnosticLogger *diagnostics,
       };
     }
     case com_scan_CheckedStrInvalidControlChar: {
-      *dlogger_append(diagnostics, true) = (Diagnostic){
-          .span = ret.span,
-          .severity = DSK_Error,
-          .message = com_str_lit_m("invalid control char after backslash"),
-          .children_len = 0};
+      dlogger_append(diagnostics, DK_StrInvalidControlChar, ret.span);
       break;
     }
     case com_scan_CheckedStrInvalidUnicodeSpecifier: {
-      *dlogger_append(diagnostics, true) =
-          (Diagnostic){.span = ret.span,
-                       .severity = DSK_Error,
-                       .message = com_str_lit_m("invalid unicode point"),
-                       .children_len = 0};
+      dlogger_append(diagnostics, DK_StrInvalidUnicodePoint, ret.span);
       break;
     }
     }
@@ -237,28 +225,15 @@ static Token lexBlockStringLiteral(com_reader *r, DiagnosticLogger *diagnostics,
       }
       case com_scan_CheckedStrReadFailed: {
         // give error
-        *dlogger_append(diagnostics, true) =
-            (Diagnostic){.span = ret.span,
-                         .severity = DSK_Error,
-                         .message = com_str_lit_m(
-                             "unexpected EOF, expected closing \\n character"),
-                         .children_len = 0};
+        dlogger_append(diagnostics, DK_BlockStrExpectedNewline, ret.span);
         goto END;
       }
       case com_scan_CheckedStrInvalidControlChar: {
-        *dlogger_append(diagnostics, true) = (Diagnostic){
-            .span = ret.span,
-            .severity = DSK_Error,
-            .message = com_str_lit_m("invalid control char after backslash"),
-            .children_len = 0};
+        dlogger_append(diagnostics, DK_StrInvalidControlChar, ret.span);
         break;
       }
       case com_scan_CheckedStrInvalidUnicodeSpecifier: {
-        *dlogger_append(diagnostics, true) =
-            (Diagnostic){.span = ret.span,
-                         .severity = DSK_Error,
-                         .message = com_str_lit_m("invalid unicode point"),
-                         .children_len = 0};
+        dlogger_append(diagnostics, DK_StrInvalidUnicodePoint, ret.span);
         break;
       }
       }
@@ -283,16 +258,10 @@ END:
                                  .data = com_str_demut(com_vec_to_str(&vec))}};
 }
 
-// Parses integer with radix
+// Appends the value of each digit with radix to `digits`, skipping underscores
 // Radix must be between 2 and 16 inclusive
-static com_biguint parseNumBaseComponent(com_reader *r,
-                                         DiagnosticLogger *diagnostics,
-                                         com_allocator *a, u8 radix) {
-  com_biguint integer_value = com_biguint_create(com_allocator_alloc(
-      a, (com_allocator_HandleData){.len = 10,
-                                    .flags = com_allocator_defaults(a) |
-                                             com_allocator_NOLEAK |
-                                             com_allocator_REALLOCABLE}));
+static void lexNumDigits(com_reader *r, DiagnosticLogger *diagnostics,
+                         com_vec *digits, u8 radix) {
   while (true) {
     com_loc_Span sp = com_reader_peek_span_u8(r);
     com_reader_ReadU8Result ret = com_reader_peek_u8(r, 1);
@@ -311,28 +280,21 @@ static com_biguint parseNumBaseComponent(com_reader *r,
     u8 digit_val = com_format_from_hex(ret.value);
 
     if (digit_val >= radix) {
-      *dlogger_append(diagnostics, true) = (Diagnostic){
-          .span = sp,
-          .severity = DSK_Error,
-          .message = com_str_lit_m("num literal char value exceeds radix"),
-          .children_len = 0};
+      dlogger_append(diagnostics, DK_NumCharExceedsRadix, sp);
       // put in dummy for the digit value
       digit_val = radix - 1;
     }
 
-    // integer_value = integer_value * radix + digit_val;
-
-    com_biguint_mul_u32(&integer_value, &integer_value, radix);
-    com_biguint_add_u32(&integer_value, &integer_value, digit_val);
+    *com_vec_push_m(digits, u8) = digit_val;
 
     // we can finally move past this char
     com_reader_drop_u8(r);
   }
-  return integer_value;
 }
 
-static com_bigdecimal parseNumFractionalComponent(com_reader *r,
-                                                  DiagnosticLogger *diagnostics,
+// Returns `base_component` plus the fractional `digits`, which are digit
+// values with radix
+static com_bigdecimal parseNumFractionalComponent(const u8 *digits, usize len,
                                                   com_allocator *a, u8 radix,
                                                   com_biguint base_component) {
 
@@ -354,46 +316,17 @@ static com_bigdecimal parseNumFractionalComponent(com_reader *r,
                                     .flags = com_allocator_defaults(a) |
                                              com_allocator_REALLOCABLE}));
 
-  com_bigdecimal radix_val = com_bigdecimal_create(com_allocator_alloc(
-      a, (com_allocator_HandleData){.len = 4,
-                                    .flags = com_allocator_defaults(a)}));
+  // these only ever hold a single digit, so are never allocated
+  com_bigdecimal radix_val = com_bigdecimal_create_inline(a);
 
-  com_bigdecimal digit_val = com_bigdecimal_create(com_allocator_alloc(
-      a, (com_allocator_HandleData){.len = 4,
-                                    .flags = com_allocator_defaults(a)}));
+  com_bigdecimal digit_val = com_bigdecimal_create_inline(a);
 
   com_bigdecimal_set_i64(&place, 1);
 
   com_bigdecimal_set_i64(&radix_val, radix);
 
-  while (true) {
-    com_loc_Span sp = com_reader_peek_span_u8(r);
-    com_reader_ReadU8Result ret = com_reader_peek_u8(r, 1);
-
-    // exit if misread or not a hex number
-    if (!ret.valid || !com_format_is_hex(ret.value)) {
-      break;
-    }
-
-    // ignore underscore
-    if (ret.value == '_') {
-      com_reader_drop_u8(r);
-      continue;
-    }
-
-    com_bigdecimal_set_i64(&digit_val, com_format_from_hex(ret.value));
-
-    // if radix_val < digit_val
-    if (com_bigdecimal_cmp(&digit_val, &radix_val) == com_math_LESS) {
-      *dlogger_append(diagnostics, true) = (Diagnostic){
-          .span = sp,
-          .severity = DSK_Error,
-          .message = com_str_lit_m("num literal char value exceeds radix"),
-          .children_len = 0};
-
-      // put in dummy for the digit value
-      com_bigdecimal_set_i64(&digit_val, 0);
-    }
+  for (usize i = 0; i < len; i++) {
+    com_bigdecimal_set_i64(&digit_val, digits[i]);
 
     // ensure precision is safe
     com_bigdecimal_set_precision(
@@ -415,13 +348,74 @@ static com_bigdecimal parseNumFractionalComponent(com_reader *r,
 
     // remove any trailing zeros
     com_bigdecimal_remove_trailing_zero(&fractional_value);
-
-    // we can finally move past this char
-    com_reader_drop_u8(r);
   }
   return fractional_value;
 }
 
+// Returns the value of a real literal, given the value of each of its digits
+// and how many of them come before the point
+static com_bigdecimal parseNumReal(const com_vec *digits, usize integer_len,
+                                   u8 radix, com_allocator *a) {
+  const u8 *data = com_vec_get(digits, 0);
+  usize len = com_vec_len_m(digits, u8);
+
+  // zeros at either end don't change how precisely the literal is written
+  usize first_significant = 0;
+  while (first_significant < len && data[first_significant] == 0) {
+    first_significant++;
+  }
+  usize end_significant = len;
+  while (end_significant > first_significant &&
+         data[end_significant - 1] == 0) {
+    end_significant--;
+  }
+
+  // Short decimal literals, which are most of them, are rounded once,
+  // correctly, to the nearest f64, which a bigdecimal then holds exactly.
+  // Up to 19 digits fit in a u64, so this never builds a bignum.
+  if (radix == 10 && end_significant - first_significant <= 19) {
+    com_fmath_Decimal decimal = com_fmath_decimal_create();
+    for (usize i = 0; i < len; i++) {
+      if (i == integer_len) {
+        com_fmath_decimal_push_point(&decimal);
+      }
+      com_fmath_decimal_push_digit(&decimal, data[i]);
+    }
+    f64 value = com_fmath_decimal_get_f64(&decimal, a);
+    if (com_fmath_f64_is_finite(value)) {
+      com_bigdecimal real = com_bigdecimal_create_inline(a);
+      com_bigdecimal_set_f64(&real, value);
+      return real;
+    }
+  }
+
+  if (radix == 10) {
+    // all the digits, divided once by 10^frac_len
+    com_biguint numerator = com_biguint_create_inline(a);
+    com_biguint_set_digits(&numerator, data, len, radix, a);
+    com_bigdecimal whole =
+        com_bigdecimal_from(com_bigint_from(numerator, false));
+
+    // enough words for every fractional digit (log2(10) < 3.33), and two
+    // more, so the value is far more precise than any f64
+    usize frac_len = len - integer_len;
+    usize prec = frac_len * 333 / 100 / 32 + 2;
+
+    com_bigdecimal real = com_bigdecimal_create_inline(a);
+    com_bigdecimal_mul_pow10(&real, &whole, -(i64)frac_len, prec,
+                             com_bigdecimal_RNE, a);
+    com_bigdecimal_remove_trailing_zero(&real);
+    com_bigdecimal_destroy(&whole);
+    return real;
+  }
+
+  // each place of a power of 2 radix is exact, so this is never rounded
+  com_biguint base_component = com_biguint_create_inline(a);
+  com_biguint_set_digits(&base_component, data, integer_len, radix, a);
+  return parseNumFractionalComponent(data + integer_len, len - integer_len, a,
+                                     radix, base_component);
+}
+
 // Call this function right before the first digit of the number literal
 // Returns control right after the number is finished
 // This function returns a Token or the error
@@ -465,26 +459,29 @@ static Token lexNumberLiteral(com_reader *r, DiagnosticLogger *diagnostics,
       }
       default: {
         radix = 10;
-        if (!com_format_is_digit(code.value)) {
-          // if it's not another digit, then we throw an error about an
+        if (com_format_is_alpha(code.value)) {
+          // if it's a letter, then we throw an error about an
           // unrecognized radix code + skip the first 2 chars
           com_reader_drop_u8(r);
           com_reader_drop_u8(r);
 
-          *dlogger_append(diagnostics, true) = (Diagnostic){
-              .span = com_loc_span_m(start, com_reader_position(r)),
-              .severity = DSK_Error,
-              .message = com_str_lit_m("num literal unrecognized radix code"),
-              .children_len = 0};
+          dlogger_append(diagnostics, DK_NumUnrecognizedRadixCode,
+                         com_loc_span_m(start, com_reader_position(r)));
         }
-        // if it was a digit then it parses like a normal decimal number
+        // otherwise it parses like a normal decimal number, like 0.5 or 07
         break;
       }
       }
     }
   }
 
-  com_biguint base_component = parseNumBaseComponent(r, diagnostics, a, radix);
+  // the digits are gathered first, and converted all at once
+  com_vec digits = com_vec_create(com_allocator_alloc(
+      a, (com_allocator_HandleData){.len = 20,
+                                    .flags = com_allocator_defaults(a) |
+                                             com_allocator_NOLEAK |
+                                             com_allocator_REALLOCABLE}));
+  lexNumDigits(r, diagnostics, &digits, radix);
 
   bool fractional = false;
   {
@@ -496,20 +493,28 @@ static Token lexNumberLiteral(com_reader *r, DiagnosticLogger *diagnostics,
   }
 
   if (fractional) {
-    com_bigdecimal decimal =
-        parseNumFractionalComponent(r, diagnostics, a, radix, base_component);
+    usize integer_len = com_vec_len_m(&digits, u8);
+    lexNumDigits(r, diagnostics, &digits, radix);
+    com_bigdecimal real = parseNumReal(&digits, integer_len, radix, a);
+    com_vec_destroy(&digits);
 
     return (Token){.kind = tk_Real,
-                   .realToken = {.data = decimal},
-                   .span = com_loc_span_m(start, com_reader_position(r))};
-  } else {
-    return (Token){.kind = tk_Int,
-                   .intToken =
-                       {
-                           .data = com_bigint_from(base_component, false),
-                       },
+                   .realToken = {.data = real},
                    .span = com_loc_span_m(start, com_reader_position(r))};
   }
+
+  // most literals are small, so this usually never allocates
+  com_biguint base_component = com_biguint_create_inline(a);
+  com_biguint_set_digits(&base_component, com_vec_get(&digits, 0),
+                         com_vec_len_m(&digits, u8), radix, a);
+  com_vec_destroy(&digits);
+
+  return (Token){.kind = tk_Int,
+                 .intToken =
+                     {
+                         .data = com_bigint_from(base_component, false),
+                     },
+                 .span = com_loc_span_m(start, com_reader_position(r))};
 }
 
 static Token lexStrop(com_reader *r, attr_UNUSED DiagnosticLogger *diagnostics,
@@ -713,11 +718,8 @@ static Token lexWord(com_reader *r, attr_UNUSED DiagnosticLogger *diagnostics,
 
 #define RETURN_UNKNOWN_TOKEN(n)                                                \
   {                                                                            \
-    *dlogger_append(diagnostics, true) =                                       \
-        (Diagnostic){.span = com_reader_peek_span_u8(r),                       \
-                     .severity = DSK_Error,                                    \
-                     .message = com_str_lit_m("lexer unrecognized character"), \
-                     .children_len = 0};                                       \
+    dlogger_append(diagnostics, DK_UnrecognizedCharacter,                      \
+                   com_reader_peek_span_u8(r));                                \
     RETURN_RESULT_TOKEN(n, tk_None)                                            \
   }
 
@@ -7,5 +7,12 @@
 #define DEBUG 1
 
 #define MAX_PRINT_LENGTH 4096
+// diagnostics printed per file before the rest are omitted
+#define MAX_PRINT_DIAGNOSTICS 1000
+
+// com_hash_fn used to intern diagnostic arguments
+// the arguments come from the source being compiled, but are short lived and
+// never probed by an attacker, so a fast hash is used over sip
+#define DIAGNOSTIC_ARG_HASHER com_hash_wyhash
 
 #endif
@@ -1,5 +1,10 @@
 #include "diagnostic.h"
 #include "com_assert.h"
+#include "com_hash.h"
+#include "com_mem.h"
+#include "com_str.h"
+
+#include "constants.h"
 
 com_str strDiagnosticSeverityKind(DiagnosticSeverityKind val) {
   switch (val) {
@@ -15,20 +20,344 @@ com_str strDiagnosticSeverityKind(DiagnosticSeverityKind val) {
   com_assert_unreachable_m("unreachable");
 }
 
+typedef struct {
+  DiagnosticSeverityKind severity;
+  com_str template;
+} DiagnosticTemplate;
+
+#define template_m(s, lit)                                                     \
+  {                                                                            \
+    .severity = (s), .template = {.data = (const u8 *)(lit),                   \
+                                  .len = sizeof(lit) - 1 }                     \
+  }
+
+static const DiagnosticTemplate dlogger_templates[] = {
+    [DK_StrExpectedDoubleQuote] =
+        template_m(DSK_Error, "unexpected EOF, expected closing double quote"),
+    [DK_BlockStrExpectedNewline] = template_m(
+        DSK_Error, "unexpected EOF, expected closing \\n character"),
+    [DK_StrInvalidControlChar] =
+        template_m(DSK_Error, "invalid control char after backslash"),
+    [DK_StrInvalidUnicodePoint] =
+        template_m(DSK_Error, "invalid unicode point"),
+    [DK_NumCharExceedsRadix] =
+        template_m(DSK_Error, "num literal char value exceeds radix"),
+    [DK_NumUnrecognizedRadixCode] =
+        template_m(DSK_Error, "num literal unrecognized radix code"),
+    [DK_UnrecognizedCharacter] =
+        template_m(DSK_Error, "lexer unrecognized character"),
+    [DK_ExpectedLabel] = template_m(DSK_Error, "Expected label"),
+    [DK_IdentifierExpectedIdentifier] =
+        template_m(DSK_Error, "identifier expected an identifier"),
+    [DK_ExpectedRightParen] = template_m(DSK_Error, "Expected right paren"),
+    [DK_ExpectedRightBrace] = template_m(DSK_Error, "Expected right brace"),
+    [DK_CaseOfExpectedOf] = template_m(DSK_Information, "Case Of expected of"),
+    [DK_IfExpectedThen] =
+        template_m(DSK_Information, "If expected then after expression"),
+    [DK_IfExpectedElse] =
+        template_m(DSK_Information, "If expected else after then expression"),
+    [DK_UnexpectedToken] = template_m(DSK_Error, "DK_UnexpectedToken"),
+    [DK_LabelNotFound] =
+        template_m(DSK_Error, "could not find label name in scope"),
+    [DK_BindOutsidePattern] =
+        template_m(DSK_Error, "bind is only valid in a pattern"),
+    [DK_BindIgnoreOutsidePattern] =
+        template_m(DSK_Error, "bind ignore is only valid in a pattern"),
+    [DK_BindSplatOutsidePattern] =
+        template_m(DSK_Error, "bind splat is only valid in a pattern"),
+    [DK_ValOutsidePattern] =
+        template_m(DSK_Error, "val expr is only valid in a pattern"),
+    [DK_ExpectedCaseOption] = template_m(DSK_Error, "expected a case option"),
+    [DK_AsOutsidePattern] =
+        template_m(DSK_Error, "as operator is only valid in a pattern"),
+    [DK_ConstrainOutsidePattern] =
+        template_m(DSK_Error, "constrain operator is only valid in a pattern"),
+    [DK_CaseOptionOutsideCase] = template_m(
+        DSK_Error, "case option operator is only valid in a case context"),
+    [DK_ExpectedIdentifier] = template_m(DSK_Error, "expected an identifier"),
+    [DK_InvalidIdentifier] = template_m(DSK_Error, "identifier must be valid"),
+    [DK_AsExpectedBinding] =
+        template_m(DSK_Error, "Right hand side of as must be a valid binding"),
+    [DK_OperatorInPattern] =
+        template_m(DSK_Error, "operator not permitted in pattern"),
+    [DK_StructPatternExpectedAssign] =
+        template_m(DSK_Error, "only assigns are permitted in a struct pattern"),
+    [DK_ExprInPattern] =
+        template_m(DSK_Error, "expression not permitted in pattern"),
+    [DK_TooManyDiagnostics] = template_m(
+        DSK_Information, "too many diagnostics, the rest were omitted"),
+    [DK_Hint] = template_m(DSK_Hint, "{}"),
+};
+
+DiagnosticSeverityKind dlogger_severity(DiagnosticKind val) {
+  return dlogger_templates[val].severity;
+}
+
+// location of an interned argument in _arg_bytes
+typedef struct {
+  u32 offset;
+  u32 len;
+} DiagnosticArg;
+
+static com_vec dlogger_vec_create(com_allocator *a) {
+  return com_vec_create(com_allocator_alloc(
+      a, (com_allocator_HandleData){.len = 10,
+                                    .flags = com_allocator_defaults(a) |
+                                             com_allocator_NOLEAK |
+                                             com_allocator_REALLOCABLE}));
+}
+
 DiagnosticLogger dlogger_create(com_allocator *a) {
-  return (DiagnosticLogger){
-      ._a = a,
-      ._diagnostics = com_vec_create(com_allocator_alloc(
-          a, (com_allocator_HandleData){.len = 10,
-                                        .flags = com_allocator_defaults(a) |
-                                                 com_allocator_NOLEAK |
-                                                 com_allocator_REALLOCABLE}))};
+  return (DiagnosticLogger){._a = a,
+                            ._diagnostics = dlogger_vec_create(a),
+                            ._children = dlogger_vec_create(a),
+                            ._arg_bytes = dlogger_vec_create(a),
+                            ._args = dlogger_vec_create(a),
+                            ._arg_table = dlogger_vec_create(a)};
+}
+
+com_str dlogger_arg(const DiagnosticLogger *ptr, u32 arg) {
+  DiagnosticArg *da = com_vec_get_m(&ptr->_args, arg, DiagnosticArg);
+  return (com_str){.data = com_vec_get_m(&ptr->_arg_bytes, da->offset, u8),
+                   .len = da->len};
+}
+
+// places arg index `arg` in the first free slot of `table` for `hash`
+static void dlogger_table_place(com_vec *table, u64 hash, u32 arg) {
+  usize mask = com_vec_len_m(table, u32) - 1;
+  for (usize i = hash & mask;; i = (i + 1) & mask) {
+    u32 *slot = com_vec_get_m(table, i, u32);
+    if (*slot == 0) {
+      *slot = arg + 1;
+      return;
+    }
+  }
+}
+
+// doubles the table (or creates it), rehashing every argument
+static void dlogger_table_grow(DiagnosticLogger *ptr) {
+  usize old_capacity = com_vec_len_m(&ptr->_arg_table, u32);
+  usize capacity = old_capacity == 0 ? 16 : old_capacity * 2;
+  com_vec_set_len_m(&ptr->_arg_table, capacity, u32);
+  com_mem_zero(com_vec_get_m(&ptr->_arg_table, 0, u32),
+               capacity * sizeof(u32));
+  for (u32 i = 0; i < com_vec_len_m(&ptr->_args, DiagnosticArg); i++) {
+    dlogger_table_place(&ptr->_arg_table,
+                        DIAGNOSTIC_ARG_HASHER(0, dlogger_arg(ptr, i)), i);
+  }
+}
+
+// returns the index of `str` among the interned arguments, adding it if new
+static u32 dlogger_intern(DiagnosticLogger *ptr, com_str str) {
+  usize args_len = com_vec_len_m(&ptr->_args, DiagnosticArg);
+  // keep the table at most half full
+  if ((args_len + 1) * 2 > com_vec_len_m(&ptr->_arg_table, u32)) {
+    dlogger_table_grow(ptr);
+  }
+
+  u64 hash = DIAGNOSTIC_ARG_HASHER(0, str);
+  usize mask = com_vec_len_m(&ptr->_arg_table, u32) - 1;
+  for (usize i = hash & mask;; i = (i + 1) & mask) {
+    u32 *slot = com_vec_get_m(&ptr->_arg_table, i, u32);
+    if (*slot == 0) {
+      // not present, so copy it in
+      u32 arg = (u32)args_len;
+      usize offset = com_vec_len_m(&ptr->_arg_bytes, u8);
+      com_assert_m(offset + str.len < u32_max_m, "too many argument bytes");
+      com_mem_move(com_vec_push(&ptr->_arg_bytes, str.len), str.data, str.len);
+      *com_vec_push_m(&ptr->_args, DiagnosticArg) =
+          (DiagnosticArg){.offset = (u32)offset, .len = (u32)str.len};
+      *slot = arg + 1;
+      return arg;
+    }
+    if (com_str_equal(dlogger_arg(ptr, *slot - 1), str)) {
+      return *slot - 1;
+    }
+  }
+}
+
+static DiagnosticEntry dlogger_entry(DiagnosticLogger *ptr,
+                                     DiagnosticKind kind, com_loc_Span span,
+                                     const com_str *args, usize args_len) {
+  com_assert_m(args_len <= DIAGNOSTIC_MAX_ARGS, "too many arguments");
+  DiagnosticEntry de = {.span = span,
+                        .kind = kind,
+                        .args_len = (u32)args_len,
+                        .first_child = DIAGNOSTIC_NONE,
+                        .next_sibling = DIAGNOSTIC_NONE};
+  for (usize i = 0; i < args_len; i++) {
+    de.args[i] = dlogger_intern(ptr, args[i]);
+  }
+  return de;
+}
+
+u32 dlogger_append(DiagnosticLogger *ptr, DiagnosticKind kind,
+                   com_loc_Span span) {
+  return dlogger_appendArgs(ptr, kind, span, NULL, 0);
+}
+
+u32 dlogger_appendArgs(DiagnosticLogger *ptr, DiagnosticKind kind,
+                       com_loc_Span span, const com_str *args,
+                       usize args_len) {
+  u32 index = (u32)com_vec_len_m(&ptr->_diagnostics, DiagnosticEntry);
+  *com_vec_push_m(&ptr->_diagnostics, DiagnosticEntry) =
+      dlogger_entry(ptr, kind, span, args, args_len);
+  return index;
 }
 
-Diagnostic *dlogger_append(DiagnosticLogger *ptr, bool visible) {
-  DiagnosticEntry *de = com_vec_push_m(&ptr->_diagnostics, DiagnosticEntry);
-  de->visible = visible;
-  return &de->diagnostic;
+void dlogger_appendChild(DiagnosticLogger *ptr, u32 parent,
+                         DiagnosticKind kind, com_loc_Span span,
+                         const com_str *args, usize args_len) {
+  u32 index = (u32)com_vec_len_m(&ptr->_children, DiagnosticEntry);
+  *com_vec_push_m(&ptr->_children, DiagnosticEntry) =
+      dlogger_entry(ptr, kind, span, args, args_len);
+
+  // link it after the last child of the parent
+  u32 *link =
+      &com_vec_get_m(&ptr->_diagnostics, parent, DiagnosticEntry)->first_child;
+  while (*link != DIAGNOSTIC_NONE) {
+    link = &dlogger_child(ptr, *link)->next_sibling;
+  }
+  *link = index;
+}
+
+DiagnosticEntry *dlogger_child(DiagnosticLogger *ptr, u32 child) {
+  return com_vec_get_m(&ptr->_children, child, DiagnosticEntry);
+}
+
+com_str dlogger_message(const DiagnosticLogger *ptr,
+                        const DiagnosticEntry *entry, com_vec *scratch) {
+  com_str template = dlogger_templates[entry->kind].template;
+  if (entry->args_len == 0) {
+    return template;
+  }
+
+  com_vec_set_len_m(scratch, 0, u8);
+  u32 next_arg = 0;
+  for (usize i = 0; i < template.len; i++) {
+    if (template.data[i] == '{' && i + 1 < template.len &&
+        template.data[i + 1] == '}' && next_arg < entry->args_len) {
+      com_str arg = dlogger_arg(ptr, entry->args[next_arg++]);
+      com_mem_move(com_vec_push(scratch, arg.len), arg.data, arg.len);
+      i++;
+    } else {
+      *com_vec_push_m(scratch, u8) = template.data[i];
+    }
+  }
+  return (com_str){.data = com_vec_get_m(scratch, 0, u8),
+                   .len = com_vec_len_m(scratch, u8)};
+}
+
+// orders diagnostics by the start of their span, then by the end
+static i32 dlogger_cmp(const DiagnosticEntry *a, const DiagnosticEntry *b) {
+  u64 ka[4] = {a->span.start.ln.val, a->span.start.col.val,
+               a->span.end.ln.val, a->span.end.col.val};
+  u64 kb[4] = {b->span.start.ln.val, b->span.start.col.val,
+               b->span.end.ln.val, b->span.end.col.val};
+  for (usize i = 0; i < 4; i++) {
+    if (ka[i] != kb[i]) {
+      return ka[i] < kb[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+// since arguments are interned, equal arguments have equal indexes
+static bool dlogger_duplicate(const DiagnosticEntry *a,
+                              const DiagnosticEntry *b) {
+  if (dlogger_cmp(a, b) != 0 || a->kind != b->kind ||
+      a->args_len != b->args_len) {
+    return false;
+  }
+  for (usize i = 0; i < a->args_len; i++) {
+    if (a->args[i] != b->args[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// stable bottom up merge sort of `len` entries in `src`, using `tmp` as
+// scratch space of the same size
+// returns whichever of the two buffers holds the sorted result
+static DiagnosticEntry *dlogger_sort(DiagnosticEntry *src,
+                                     DiagnosticEntry *tmp, usize len) {
+  for (usize width = 1; width < len; width *= 2) {
+    for (usize lo = 0; lo < len; lo += 2 * width) {
+      usize mid = lo + width < len ? lo + width : len;
+      usize hi = lo + 2 * width < len ? lo + 2 * width : len;
+      usize i = lo;
+      usize j = mid;
+      usize k = lo;
+      while (i < mid && j < hi) {
+        if (dlogger_cmp(&src[j], &src[i]) < 0) {
+          tmp[k++] = src[j++];
+        } else {
+          tmp[k++] = src[i++];
+        }
+      }
+      while (i < mid) {
+        tmp[k++] = src[i++];
+      }
+      while (j < hi) {
+        tmp[k++] = src[j++];
+      }
+    }
+    DiagnosticEntry *swap = src;
+    src = tmp;
+    tmp = swap;
+  }
+  return src;
+}
+
+void dlogger_normalize(DiagnosticLogger *ptr) {
+  usize len = com_vec_len_m(&ptr->_diagnostics, DiagnosticEntry);
+  if (len < 2) {
+    return;
+  }
+  DiagnosticEntry *entries =
+      com_vec_get_m(&ptr->_diagnostics, 0, DiagnosticEntry);
+
+  // parsers mostly log in source order, so check before doing any work
+  bool sorted = true;
+  for (usize i = 1; i < len; i++) {
+    if (dlogger_cmp(&entries[i], &entries[i - 1]) < 0) {
+      sorted = false;
+      break;
+    }
+  }
+
+  if (!sorted) {
+    com_vec scratch = dlogger_vec_create(ptr->_a);
+    DiagnosticEntry *tmp =
+        com_vec_push(&scratch, len * sizeof(DiagnosticEntry));
+    DiagnosticEntry *result = dlogger_sort(entries, tmp, len);
+    if (result != entries) {
+      com_mem_move(entries, result, len * sizeof(DiagnosticEntry));
+    }
+    com_vec_destroy(&scratch);
+  }
+
+  // duplicates are now in the same run of equal spans as the diagnostic they
+  // repeat, so only diagnostics within a run need to be compared
+  usize out = 0;
+  usize run_start = 0;
+  for (usize i = 0; i < len; i++) {
+    if (out > 0 && dlogger_cmp(&entries[i], &entries[run_start]) != 0) {
+      run_start = out;
+    }
+    bool duplicate = false;
+    for (usize j = run_start; j < out; j++) {
+      if (dlogger_duplicate(&entries[j], &entries[i])) {
+        duplicate = true;
+        break;
+      }
+    }
+    if (!duplicate) {
+      entries[out++] = entries[i];
+    }
+  }
+  com_vec_set_len_m(&ptr->_diagnostics, out, DiagnosticEntry);
 }
 
 com_allocator* dlogger_alloc(DiagnosticLogger *ptr) {
@@ -37,6 +366,14 @@ com_allocator* dlogger_alloc(DiagnosticLogger *ptr) {
 
 const com_vec* dlogger_diagnostics(DiagnosticLogger *ptr) { return &ptr->_diagnostics; }
 
+const com_vec *dlogger_children(DiagnosticLogger *ptr) {
+  return &ptr->_children;
+}
+
 void dlogger_destroy(DiagnosticLogger* dlogger)  {
   com_vec_destroy(&dlogger->_diagnostics);
+  com_vec_destroy(&dlogger->_children);
+  com_vec_destroy(&dlogger->_arg_bytes);
+  com_vec_destroy(&dlogger->_args);
+  com_vec_destroy(&dlogger->_arg_table);
 }
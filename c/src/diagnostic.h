@@ -15,36 +15,135 @@ typedef enum {
 
 com_str strDiagnosticSeverityKind(DiagnosticSeverityKind val);
 
-typedef struct Diagnostic_s {
-  com_loc_Span span;
-  DiagnosticSeverityKind severity;
-  com_str message;
-  struct Diagnostic_s* children;
-  usize children_len;
-} Diagnostic;
+// Every kind of diagnostic has a fixed severity and a message template in
+// diagnostic.c. A `{}` in the template is replaced by the next argument of the
+// diagnostic when the message is rendered.
+typedef enum {
+  // lexer
+  DK_StrExpectedDoubleQuote,
+  DK_BlockStrExpectedNewline,
+  DK_StrInvalidControlChar,
+  DK_StrInvalidUnicodePoint,
+  DK_NumCharExceedsRadix,
+  DK_NumUnrecognizedRadixCode,
+  DK_UnrecognizedCharacter,
+  // parser
+  DK_ExpectedLabel,
+  DK_IdentifierExpectedIdentifier,
+  DK_ExpectedRightParen,
+  DK_ExpectedRightBrace,
+  DK_CaseOfExpectedOf,
+  DK_IfExpectedThen,
+  DK_IfExpectedElse,
+  DK_UnexpectedToken,
+  // ast to hir
+  DK_LabelNotFound,
+  DK_BindOutsidePattern,
+  DK_BindIgnoreOutsidePattern,
+  DK_BindSplatOutsidePattern,
+  DK_ValOutsidePattern,
+  DK_ExpectedCaseOption,
+  DK_AsOutsidePattern,
+  DK_ConstrainOutsidePattern,
+  DK_CaseOptionOutsideCase,
+  DK_ExpectedIdentifier,
+  DK_InvalidIdentifier,
+  DK_AsExpectedBinding,
+  DK_OperatorInPattern,
+  DK_StructPatternExpectedAssign,
+  DK_ExprInPattern,
+  // output
+  DK_TooManyDiagnostics,
+  // a hint whose message is its only argument
+  DK_Hint,
+} DiagnosticKind;
+
+// returns the severity of every diagnostic of kind `val`
+DiagnosticSeverityKind dlogger_severity(DiagnosticKind val);
+
+// the most arguments a diagnostic may have
+#define DIAGNOSTIC_MAX_ARGS 2
+// index used when there is no child or sibling
+#define DIAGNOSTIC_NONE u32_max_m
 
 typedef struct {
-    bool visible;
-    Diagnostic diagnostic;
+  com_loc_Span span;
+  DiagnosticKind kind;
+  u32 args_len;
+  // indexes of interned arguments, filling the template's `{}` in order
+  u32 args[DIAGNOSTIC_MAX_ARGS];
+  // index of the first child in the logger's children, or DIAGNOSTIC_NONE
+  u32 first_child;
+  // index of the next child with the same parent, or DIAGNOSTIC_NONE
+  u32 next_sibling;
 } DiagnosticEntry;
 
+// All memory of a logger is held in the vectors below, and is freed together
+// when the logger is destroyed. Messages are not stored, only rendered when
+// they are needed, and each distinct argument is stored once.
 typedef struct {
     com_allocator *_a;
     // Vector diagnostics<DiagnosticEntry>
     com_vec _diagnostics;
+    // Vector children<DiagnosticEntry>
+    com_vec _children;
+    // Vector<u8> with the bytes of every interned argument
+    com_vec _arg_bytes;
+    // Vector<DiagnosticArg> locating each interned argument in _arg_bytes
+    com_vec _args;
+    // Vector<u32> open addressing table of (argument index + 1), 0 is empty
+    com_vec _arg_table;
 } DiagnosticLogger;
 
 DiagnosticLogger dlogger_create(com_allocator *a);
 
-Diagnostic* dlogger_append(DiagnosticLogger* ptr, bool visible);
+// logs a diagnostic with no arguments and returns its index
+u32 dlogger_append(DiagnosticLogger* ptr, DiagnosticKind kind,
+                   com_loc_Span span);
+
+// logs a diagnostic with `args_len` arguments and returns its index
+// REQUIRES: `args_len` <= DIAGNOSTIC_MAX_ARGS
+// GUARANTEES: the arguments are copied, and need not outlive the call
+u32 dlogger_appendArgs(DiagnosticLogger* ptr, DiagnosticKind kind,
+                       com_loc_Span span, const com_str* args, usize args_len);
 
-// returns a reference to the diagnostic logger's allocator 
+// logs a child of the diagnostic at index `parent`, after its other children
+// REQUIRES: `parent` was returned by an append since the last normalize
+// REQUIRES: `args_len` <= DIAGNOSTIC_MAX_ARGS
+void dlogger_appendChild(DiagnosticLogger* ptr, u32 parent,
+                         DiagnosticKind kind, com_loc_Span span,
+                         const com_str* args, usize args_len);
+
+// returns the interned argument with index `arg`
+com_str dlogger_arg(const DiagnosticLogger* ptr, u32 arg);
+
+// returns the child diagnostic with index `child`
+DiagnosticEntry* dlogger_child(DiagnosticLogger* ptr, u32 child);
+
+// renders the message of `entry`
+// REQUIRES: `entry` belongs to `ptr`, or has no arguments
+// REQUIRES: `scratch` is a valid pointer to a valid Vector<u8>
+// GUARANTEES: the returned str is valid until `scratch` is next modified
+// GUARANTEES: if the message has no arguments, `scratch` is not used
+com_str dlogger_message(const DiagnosticLogger* ptr,
+                        const DiagnosticEntry* entry, com_vec* scratch);
+
+// sorts the diagnostics by span, and removes diagnostics that have the same
+// span, kind, and arguments as an earlier one
+// the order of diagnostics with equal spans is preserved
+// GUARANTEES: indexes returned by previous appends are invalidated
+void dlogger_normalize(DiagnosticLogger* ptr);
+
+// returns a reference to the diagnostic logger's allocator
 // should be used to allocate material with the lifetime of DiagnosticLogger
 com_allocator* dlogger_alloc(DiagnosticLogger* ptr);
 
 // returns a const reference to the diagnostics vector
 const com_vec* dlogger_diagnostics(DiagnosticLogger* ptr);
 
+// returns a const reference to the children vector
+const com_vec* dlogger_children(DiagnosticLogger* ptr);
+
 // destroys the dlogger, and frees all emmory associated with it
 void dlogger_destroy(DiagnosticLogger* dlogger);
 
@@ -225,9 +225,6 @@ static Token parse_peekPastMetadata(ast_Constructor *parser,
 static ast_Expr *ast_parseTermExpr(DiagnosticLogger *diagnostics,
                                    ast_Constructor *parser);
 
-// everything that can be seperated by a semicolon
-static ast_Expr *ast_parseSequenceable(DiagnosticLogger *diagnostics,
-                                       ast_Constructor *parser);
 
 static ast_Label *ast_parseLabel(DiagnosticLogger *diagnostics,
                                  ast_Constructor *parser) {
@@ -239,11 +236,7 @@ static ast_Label *ast_parseLabel(DiagnosticLogger *diagnostics,
     ptr->label.label = t.labelToken.data;
   } else {
     ptr->kind = ast_LK_None;
-    *dlogger_append(diagnostics, true) =
-        (Diagnostic){.span = t.span,
-                     .severity = DSK_Error,
-                     .message = com_str_lit_m("Expected label"),
-                     .children_len = 0};
+    dlogger_append(diagnostics, DK_ExpectedLabel, t.span);
   }
   return ptr;
 }
@@ -258,11 +251,7 @@ static ast_Identifier *ast_parseIdentifier(DiagnosticLogger *diagnostics,
     ptr->id.name = t.identifierToken.data;
   } else {
     ptr->kind = ast_IK_None;
-    *dlogger_append(diagnostics, true) = (Diagnostic){
-        .span = t.span,
-        .severity = DSK_Error,
-        .message = com_str_lit_m("identifier expected an identifier"),
-        .children_len = 0};
+    dlogger_append(diagnostics, DK_IdentifierExpectedIdentifier, t.span);
   }
   return ptr;
 }
@@ -354,11 +343,7 @@ static ast_Expr *ast_certain_parseGroupExpr(DiagnosticLogger *diagnostics,
 
   Token rparen = parse_next(parser, diagnostics);
   if (rparen.kind != tk_ParenRight) {
-    *dlogger_append(diagnostics, true) =
-        (Diagnostic){.span = rparen.span,
-                     .severity = DSK_Error,
-                     .message = com_str_lit_m("Expected right paren"),
-                     .children_len = 0};
+    dlogger_append(diagnostics, DK_ExpectedRightParen, rparen.span);
   }
 
   ptr->common.span = com_loc_span_m(lparen.span.start, rparen.span.end);
@@ -489,11 +474,7 @@ static ast_Expr *ast_certain_parseStructExpr(DiagnosticLogger *diagnostics,
   // expect rbrace
   Token rbrace = parse_next(parser, diagnostics);
   if (rbrace.kind != tk_BraceRight) {
-    *dlogger_append(diagnostics, true) =
-        (Diagnostic){.span = rbrace.span,
-                     .severity = DSK_Error,
-                     .message = com_str_lit_m("Expected right brace"),
-                     .children_len = 0};
+    dlogger_append(diagnostics, DK_ExpectedRightBrace, rbrace.span);
   }
 
   ptr->common.span = com_loc_span_m(lbrace.span.start, rbrace.span.end);
@@ -553,11 +534,7 @@ static ast_Expr *ast_certain_parseCaseExpr(DiagnosticLogger *diagnostics,
   // Expect of
   Token oftk = parse_next(parser, diagnostics);
   if (oftk.kind != tk_Of) {
-    *dlogger_append(diagnostics, true) =
-        (Diagnostic){.span = oftk.span,
-                     .severity = DSK_Information,
-                     .message = com_str_lit_m("Case Of expected of"),
-                     .children_len = 0};
+    dlogger_append(diagnostics, DK_CaseOfExpectedOf, oftk.span);
   }
 
   // parse CaseOptions
@@ -584,11 +561,7 @@ static ast_Expr *ast_certain_parseIfExpr(DiagnosticLogger *diagnostics,
   // Expect then
   Token thentk = parse_next(parser, diagnostics);
   if (thentk.kind != tk_Then) {
-    *dlogger_append(diagnostics, true) = (Diagnostic){
-        .span = thentk.span,
-        .severity = DSK_Information,
-        .message = com_str_lit_m("If expected then after expression"),
-        .children_len = 0};
+    dlogger_append(diagnostics, DK_IfExpectedThen, thentk.span);
   }
 
   // parse Then
@@ -597,11 +570,7 @@ static ast_Expr *ast_certain_parseIfExpr(DiagnosticLogger *diagnostics,
   // expect Else
   Token elsetk = parse_next(parser, diagnostics);
   if (elsetk.kind != tk_Else) {
-    *dlogger_append(diagnostics, true) = (Diagnostic){
-        .span = elsetk.span,
-        .severity = DSK_Information,
-        .message = com_str_lit_m("If expected else after then expression"),
-        .children_len = 0};
+    dlogger_append(diagnostics, DK_IfExpectedElse, elsetk.span);
   }
 
   // parse Else
@@ -724,17 +693,9 @@ static ast_Expr *ast_parseTermExpr(DiagnosticLogger *diagnostics,
     l->common.metadata = com_vec_release(&metadata);
     parse_next(parser, diagnostics);
 
-    Diagnostic *hint = dlogger_append(diagnostics, false);
-    *hint = (Diagnostic){.span = t.span,
-                         .severity = DSK_Hint,
-                         .message = tk_strKind(t.kind),
-                         .children_len = 0};
-    *dlogger_append(diagnostics, true) =
-        (Diagnostic){.span = t.span,
-                     .severity = DSK_Error,
-                     .message = com_str_lit_m("DK_UnexpectedToken"),
-                     .children = hint,
-                     .children_len = 1};
+    u32 d = dlogger_append(diagnostics, DK_UnexpectedToken, t.span);
+    com_str kind = tk_strKind(t.kind);
+    dlogger_appendChild(diagnostics, d, DK_Hint, t.span, &kind, 1);
     return l;
   }
   }
@@ -1078,6 +1039,31 @@ ast_Expr *ast_parseExpr(DiagnosticLogger *diagnostics,
   return ast_parseSequenceExpr(diagnostics, parser);
 }
 
+bool ast_parseSequenceSeparator(DiagnosticLogger *diagnostics,
+                                ast_Constructor *parser, ast_Common *sep) {
+  if (parse_peekPastMetadata(parser, diagnostics, 1).kind != tk_Sequence) {
+    return false;
+  }
+  com_vec metadata = parse_getMetadata(parser, diagnostics);
+  sep->metadata_len = com_vec_len_m(&metadata, ast_Metadata);
+  sep->metadata = com_vec_release(&metadata);
+  sep->span = parse_next(parser, diagnostics).span;
+  return true;
+}
+
 bool ast_eof(ast_Constructor *parser, DiagnosticLogger *d) {
   return parse_peek(parser, d, 1).kind == tk_Eof;
 }
+
+com_loc_Span ast_peekSpan(ast_Constructor *parser, DiagnosticLogger *d) {
+  return parse_peek(parser, d, 1).span;
+}
+
+com_loc_Span ast_peekNthSpan(ast_Constructor *parser, DiagnosticLogger *d,
+                             usize k) {
+  return parse_peek(parser, d, k).span;
+}
+
+usize ast_lookaheadLen(const ast_Constructor *parser) {
+  return com_queue_len_m(&parser->_next_tokens_queue, Token);
+}
@@ -21,9 +21,27 @@ ast_Constructor ast_create(com_reader *r, com_allocator* a);
 // parse statement with errors
 ast_Expr* ast_parseExpr(DiagnosticLogger* diagnostics, ast_Constructor *parser);
 
+// parse a single element of a `;` separated sequence with errors
+ast_Expr* ast_parseSequenceable(DiagnosticLogger* diagnostics, ast_Constructor *parser);
+
+// if the next token past any metadata is a `;`, consumes it and the metadata before it
+// the metadata and the span of the `;` are written into sep
+// returns false and consumes nothing otherwise
+bool ast_parseSequenceSeparator(DiagnosticLogger* diagnostics, ast_Constructor *parser, ast_Common* sep);
+
 // test eof 
 bool ast_eof(ast_Constructor *parser, DiagnosticLogger*d);
 
+// span of the next token (including metadata), without consuming it
+com_loc_Span ast_peekSpan(ast_Constructor *parser, DiagnosticLogger*d);
+
+// span of the k'th next token (including metadata), without consuming it
+// k must be greater than 0
+com_loc_Span ast_peekNthSpan(ast_Constructor *parser, DiagnosticLogger*d, usize k);
+
+// number of tokens that have been lexed by peeking, but not consumed yet
+usize ast_lookaheadLen(const ast_Constructor *parser);
+
 // Frees memory associated with the parser and cleans up
 void ast_destroy(ast_Constructor *pp);
 
@@ -0,0 +1,264 @@
+// Checks that editing an ast_Document gives the same statements, including
+// their diagnostics, as parsing the edited text from scratch.
+
+#include "ast_document.h"
+
+#include "com_assert.h"
+#include "com_os_allocator.h"
+#include "com_str.h"
+
+typedef struct {
+  const char *source;
+  com_loc_Span span;
+  const char *text;
+} Case;
+
+static com_str internal_cstr(const char *s) {
+  usize len = 0;
+  while (s[len] != '\0') {
+    len++;
+  }
+  return (com_str){.data = (const u8 *)s, .len = len};
+}
+
+static bool internal_span_equal(com_loc_Span a, com_loc_Span b) {
+  return a.start.ln.val == b.start.ln.val &&
+         a.start.col.val == b.start.col.val && a.end.ln.val == b.end.ln.val &&
+         a.end.col.val == b.end.col.val;
+}
+
+static void internal_check_common(const ast_Common *a, const ast_Common *b) {
+  com_assert_m(internal_span_equal(a->span, b->span),
+               "expression span differs");
+  com_assert_m(a->metadata_len == b->metadata_len,
+               "expression metadata differs");
+  for (usize i = 0; i < a->metadata_len; i++) {
+    com_assert_m(internal_span_equal(a->metadata[i].span, b->metadata[i].span),
+                 "metadata span differs");
+    com_assert_m(com_str_equal(a->metadata[i].data, b->metadata[i].data),
+                 "metadata differs");
+  }
+}
+
+static void internal_check_identifier(const ast_Identifier *a,
+                                      const ast_Identifier *b) {
+  com_assert_m(a->kind == b->kind, "identifier kind differs");
+  com_assert_m(internal_span_equal(a->span, b->span),
+               "identifier span differs");
+}
+
+static void internal_check_label(const ast_Label *a, const ast_Label *b) {
+  com_assert_m(a->kind == b->kind, "label kind differs");
+  com_assert_m(internal_span_equal(a->span, b->span), "label span differs");
+}
+
+// compares two expressions and everything inside them
+static void internal_check_expr(const ast_Expr *a, const ast_Expr *b) {
+  com_assert_m((a == NULL) == (b == NULL), "expression presence differs");
+  if (a == NULL) {
+    return;
+  }
+  com_assert_m(a->kind == b->kind, "expression kind differs");
+  internal_check_common(&a->common, &b->common);
+  switch (a->kind) {
+  case ast_EK_None:
+  case ast_EK_Nil:
+  case ast_EK_NilType:
+  case ast_EK_NeverType:
+  case ast_EK_Int:
+  case ast_EK_Bool:
+  case ast_EK_Real:
+  case ast_EK_String:
+  case ast_EK_BindIgnore:
+  case ast_EK_BindSplat: {
+    break;
+  }
+  case ast_EK_Bind: {
+    internal_check_identifier(a->bind.bind, b->bind.bind);
+    break;
+  }
+  case ast_EK_Reference: {
+    internal_check_identifier(a->reference.reference, b->reference.reference);
+    break;
+  }
+  case ast_EK_Struct: {
+    internal_check_expr(a->structLiteral.expr, b->structLiteral.expr);
+    break;
+  }
+  case ast_EK_Loop: {
+    internal_check_expr(a->loop.body, b->loop.body);
+    break;
+  }
+  case ast_EK_Val: {
+    internal_check_expr(a->val.val, b->val.val);
+    break;
+  }
+  case ast_EK_Pat: {
+    internal_check_expr(a->pat.pat, b->pat.pat);
+    break;
+  }
+  case ast_EK_Label: {
+    internal_check_label(a->label.label, b->label.label);
+    internal_check_expr(a->label.val, b->label.val);
+    break;
+  }
+  case ast_EK_Defer: {
+    internal_check_label(a->defer.label, b->defer.label);
+    internal_check_expr(a->defer.val, b->defer.val);
+    break;
+  }
+  case ast_EK_Ret: {
+    internal_check_label(a->ret.label, b->ret.label);
+    internal_check_expr(a->ret.expr, b->ret.expr);
+    break;
+  }
+  case ast_EK_BinaryOp: {
+    com_assert_m(a->binaryOp.op == b->binaryOp.op, "operator differs");
+    internal_check_expr(a->binaryOp.left_operand, b->binaryOp.left_operand);
+    internal_check_expr(a->binaryOp.right_operand, b->binaryOp.right_operand);
+    break;
+  }
+  case ast_EK_CaseOf: {
+    internal_check_expr(a->caseof.expr, b->caseof.expr);
+    internal_check_expr(a->caseof.cases, b->caseof.cases);
+    break;
+  }
+  case ast_EK_IfThen: {
+    internal_check_expr(a->ifthen.expr, b->ifthen.expr);
+    internal_check_expr(a->ifthen.then_expr, b->ifthen.then_expr);
+    internal_check_expr(a->ifthen.else_expr, b->ifthen.else_expr);
+    break;
+  }
+  case ast_EK_Group: {
+    internal_check_expr(a->group.expr, b->group.expr);
+    break;
+  }
+  }
+}
+
+static void internal_check_entries(const com_vec *da, const com_vec *db) {
+  usize len = com_vec_len_m(da, DiagnosticEntry);
+  com_assert_m(len == com_vec_len_m(db, DiagnosticEntry),
+               "number of diagnostics differs");
+  for (usize i = 0; i < len; i++) {
+    DiagnosticEntry *ea = com_vec_get_m(da, i, DiagnosticEntry);
+    DiagnosticEntry *eb = com_vec_get_m(db, i, DiagnosticEntry);
+    com_assert_m(ea->kind == eb->kind, "diagnostic kind differs");
+    com_assert_m(internal_span_equal(ea->span, eb->span),
+                 "diagnostic span differs");
+  }
+}
+
+static void internal_check_diagnostics(DiagnosticLogger *a,
+                                       DiagnosticLogger *b) {
+  internal_check_entries(dlogger_diagnostics(a), dlogger_diagnostics(b));
+  internal_check_entries(dlogger_children(a), dlogger_children(b));
+}
+
+// compares an edited document with one parsed from its text
+static void internal_check_document(ast_Document *edited, com_allocator *a) {
+  ast_Document full = ast_documentCreate(ast_documentSource(edited), a);
+  usize len = ast_documentLen(&full);
+  com_assert_m(ast_documentLen(edited) == len, "number of statements differs");
+  for (usize i = 0; i < len; i++) {
+    ast_Statement *se = ast_documentGet(edited, i);
+    ast_Statement *sf = ast_documentGet(&full, i);
+    com_assert_m(se->separated == sf->separated, "separator differs");
+    if (se->separated) {
+      internal_check_common(&se->separator, &sf->separator);
+    }
+    com_assert_m(internal_span_equal(se->extent, sf->extent),
+                 "statement extent differs");
+    internal_check_expr(se->expr, sf->expr);
+    internal_check_expr(se->sequence, sf->sequence);
+    internal_check_diagnostics(&se->diagnostics, &sf->diagnostics);
+  }
+  ast_documentDestroy(&full);
+}
+
+static com_loc_Span internal_span(u32 start_ln, u32 start_col, u32 end_ln,
+                                  u32 end_col) {
+  return com_loc_span_m(
+      com_loc_lncol_m(com_loc_ln_m(start_ln), com_loc_col_m(start_col)),
+      com_loc_lncol_m(com_loc_ln_m(end_ln), com_loc_col_m(end_col)));
+}
+
+static const char *internal_sources[] = {
+    "# ;i.  = struct1 + 1;\n{$.5o !co# #';{[ pow =mutate '] b;\n\n"
+    "#!neat(a,}->",
+    "val x = 1;\nval y = x + 2;\n\nloop { y; };\n",
+    "a b c\n$d; e @ f;\n# comment\n\"str\" ; 1.5 ;",
+    "",
+};
+
+static const char *internal_texts[] = {
+    "", " ", "\n", ";", "x", "mod", "$y = 2;", "# c\n", "(", ")", "\"",
+    "@", " + ", "\n\n#!m\n", "{", "}",
+};
+
+// a small deterministic generator, so failures can be reproduced
+static u32 internal_next(u32 *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+// returns the position of byte `offset` of `source`
+static com_loc_LnCol internal_position(com_str source, usize offset) {
+  com_loc_LnCol loc = com_loc_lncol_m(com_loc_ln_m(1), com_loc_col_m(1));
+  for (usize i = 0; i < offset; i++) {
+    if (source.data[i] == '\n') {
+      loc = com_loc_lncol_m(com_loc_ln_m(loc.ln.val + 1), com_loc_col_m(1));
+    } else {
+      loc = com_loc_lncol_m(loc.ln, com_loc_col_m(loc.col.val + 1));
+    }
+  }
+  return loc;
+}
+
+int main(void) {
+  com_allocator a = com_os_allocator();
+
+  // edits that have gone wrong before
+  const Case cases[] = {
+      {.source = internal_sources[0],
+       .span = internal_span(4, 10, 4, 12),
+       .text = "mod"},
+  };
+  for (usize i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    ast_Document doc = ast_documentCreate(internal_cstr(cases[i].source), &a);
+    ast_documentEdit(&doc, (ast_Edit){.span = cases[i].span,
+                                      .text = internal_cstr(cases[i].text)});
+    internal_check_document(&doc, &a);
+    ast_documentDestroy(&doc);
+  }
+
+  // sequences of random edits
+  u32 state = 0x2545F491;
+  const usize num_sources =
+      sizeof(internal_sources) / sizeof(internal_sources[0]);
+  const usize num_texts = sizeof(internal_texts) / sizeof(internal_texts[0]);
+  for (usize i = 0; i < num_sources; i++) {
+    ast_Document doc =
+        ast_documentCreate(internal_cstr(internal_sources[i]), &a);
+    for (usize n = 0; n < 300; n++) {
+      com_str source = ast_documentSource(&doc);
+      usize start = internal_next(&state) % (source.len + 1);
+      usize end = start + internal_next(&state) % 6;
+      if (end > source.len) {
+        end = source.len;
+      }
+      ast_Edit edit = {
+          .span = com_loc_span_m(internal_position(source, start),
+                                 internal_position(source, end)),
+          .text = internal_cstr(internal_texts[internal_next(&state) %
+                                               num_texts])};
+      ast_documentEdit(&doc, edit);
+      internal_check_document(&doc, &a);
+    }
+    ast_documentDestroy(&doc);
+  }
+
+  return 0;
+}
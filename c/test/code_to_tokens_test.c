@@ -0,0 +1,96 @@
+// Checks the values the lexer gives real literals, including ones too large
+// for an f64.
+
+#include "code_to_tokens.h"
+
+#include "com_assert.h"
+#include "com_bigdecimal.h"
+#include "com_fmath.h"
+#include "com_os_allocator.h"
+#include "com_reader_buffered.h"
+#include "com_reader_str.h"
+#include "com_str.h"
+
+static u64 internal_bits(f64 value) {
+  union {
+    f64 value;
+    u64 bits;
+  } u = {.value = value};
+  return u.bits;
+}
+
+// lexes `source`, which must be a single real literal, and returns its value
+static f64 internal_lex_real(com_str source, com_allocator *a) {
+  com_reader_str_backing backing;
+  com_reader sr = com_reader_str_create(&source, 0, &backing);
+  com_reader br = com_reader_buffered(&sr, a);
+  DiagnosticLogger diagnostics = dlogger_create(a);
+
+  Token tk = tk_next(&br, &diagnostics, a);
+  com_assert_m(tk.kind == tk_Real, "expected a real literal");
+  com_assert_m(com_vec_len_m(dlogger_diagnostics(&diagnostics),
+                             DiagnosticEntry) == 0,
+               "expected no diagnostics");
+  com_assert_m(tk_next(&br, &diagnostics, a).kind == tk_Eof,
+               "expected a single token");
+
+  f64 value = com_bigdecimal_get_f64(&tk.realToken.data);
+  dlogger_destroy(&diagnostics);
+  com_reader_destroy(&br);
+  com_reader_destroy(&sr);
+  return value;
+}
+
+typedef struct {
+  const char *source;
+  f64 value;
+} Case;
+
+static com_str internal_cstr(const char *s) {
+  usize len = 0;
+  while (s[len] != '\0') {
+    len++;
+  }
+  return (com_str){.data = (const u8 *)s, .len = len};
+}
+
+int main(void) {
+  com_allocator a = com_os_allocator();
+
+  const Case cases[] = {
+      {.source = "1.5", .value = 1.5},
+      {.source = "0.1", .value = 0.1},
+      {.source = "000.000125", .value = 0.000125},
+      {.source = "1234567890.123456789", .value = 1234567890.123456789},
+      {.source = "0.50000000000000000000", .value = 0.5},
+      {.source = "2.5000000000000000000000", .value = 2.5},
+      {.source = "0.10000000000000000000", .value = 0.1},
+      {.source = "0.1000000000000000000000000001", .value = 0.1},
+      {.source = "1.000000000000000000000001", .value = 1.0},
+      {.source = "3.14159265358979323846264338327950288",
+       .value = 3.141592653589793},
+      {.source = "0.000000000000000000000000000000000000000000000000001"
+                 "00000000000000000000000000000000000000000000000001",
+       .value = 1e-51},
+      {.source = "0x1.8", .value = 1.5},
+      {.source = "0b10.01", .value = 2.25},
+  };
+  for (usize i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    f64 value = internal_lex_real(internal_cstr(cases[i].source), &a);
+    com_assert_m(internal_bits(value) == internal_bits(cases[i].value),
+                 "wrong value for real literal");
+  }
+
+  // a literal above the largest f64 must still lex, without being rounded
+  u8 huge[403];
+  for (usize i = 0; i < 400; i++) {
+    huge[i] = '9';
+  }
+  huge[400] = '.';
+  huge[401] = '0';
+  huge[402] = '\0';
+  f64 value = internal_lex_real(internal_cstr((const char *)huge), &a);
+  com_assert_m(!com_fmath_f64_is_finite(value), "expected a huge literal");
+
+  return 0;
+}